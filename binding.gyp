@@ -2,8 +2,42 @@
   "targets": [
     {
       "target_name": "bindings",
+      "variables": {
+        "conditions": [
+          [
+            'OS=="linux"',
+            {
+              "wayland_client%": "<!(pkg-config --exists wayland-client && echo 1 || echo 0)"
+            },
+            {
+              "wayland_client%": 0
+            }
+          ]
+        ]
+      },
       "sources": [
-        "src/export.cc"
+        "src/auto_archive.cc",
+        "src/buffer_pool.cc",
+        "src/clipboard_formats.cc",
+        "src/convert_images.cc",
+        "src/deflate_encoder.cc",
+        "src/export.cc",
+        "src/hash.cc",
+        "src/html_text.cc",
+        "src/image_files.cc",
+        "src/image_ops.cc",
+        "src/lazy_image_file.cc",
+        "src/memory_clipboard.cc",
+        "src/path_list.cc",
+        "src/png_encoder.cc",
+        "src/save_screenshot.cc",
+        "src/save_transformed.cc",
+        "src/shared_memory.cc",
+        "src/target_digest.cc",
+        "src/task_batch.cc",
+        "src/thumbnails.cc",
+        "src/tile_store.cc",
+        "src/utf8.cc"
       ],
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")"
@@ -15,7 +49,7 @@
       "cflags_cc!": ["-fno-exceptions"],
       "defines": [
         "NAPI_CPP_EXCEPTIONS",
-        "NAPI_VERSION=3",
+        "NAPI_VERSION=4",
       ],
       "conditions": [
         [
@@ -28,6 +62,7 @@
               'libraries': [
                 '-framework Cocoa',
                 '-framework CoreFoundation',
+                '-framework ImageIO',
               ]
             },
             "xcode_settings": {
@@ -49,7 +84,8 @@
             "libraries": [
               "Gdiplus.lib",
               "Shlwapi.lib",
-              "Shcore.lib"
+              "Shcore.lib",
+              "Windowscodecs.lib"
             ],
             "msvs_settings": {
               "VCCLCompilerTool": {
@@ -62,17 +98,35 @@
           'OS=="linux"',
           {
             "sources": [
-              "src/clipboard_linux.cc"
+              "src/clipboard_linux.cc",
+              "src/jpeg_codec.cc",
+              "src/jpeg_transform.cc",
+              "src/selection_payload.cc",
+              "src/wayland_data_control.cc",
+              "src/x11_selection_owner.cc"
             ],
+            "defines": ["CLIPBOARD_EX_LIBJPEG"],
             "cflags": [
-              "<!@(pkg-config --cflags gtk+-3.0 gdk-pixbuf-2.0)",
+              "<!@(pkg-config --cflags gtk+-3.0 gdk-pixbuf-2.0 x11 libjpeg)",
             ],
             "cflags_cc": ["-std=c++17"],
             'link_settings': {
               'libraries': [
-                "<!@(pkg-config --libs gtk+-3.0 gdk-pixbuf-2.0)"
+                "<!@(pkg-config --libs gtk+-3.0 gdk-pixbuf-2.0 x11 libjpeg)"
               ]
-            }
+            },
+            "conditions": [
+              [
+                'wayland_client==1',
+                {
+                  "defines": ["CLIPBOARD_EX_WAYLAND"],
+                  "cflags": ["<!@(pkg-config --cflags wayland-client)"],
+                  'link_settings': {
+                    'libraries': ["<!@(pkg-config --libs wayland-client)"]
+                  }
+                }
+              ]
+            ]
           }
         ],
       ]
@@ -1,67 +1,582 @@
 /**
+ * Options accepted by every clipboard operation.
+ */
+export interface ClipboardOptions {
+  /**
+   * The X11 selection to operate on, defaults to `'clipboard'`.
+   * `'primary'` and `'secondary'` are only available on Linux and behave like an empty clipboard elsewhere.
+   */
+  selection?: 'clipboard' | 'primary' | 'secondary';
+}
+
+/**
+ * @param {ClipboardOptions} [options]
  * @returns {string[]} An Array of file paths in clipboard.
  */
-export function readFilePaths(): string[];
+export function readFilePaths(options?: ClipboardOptions): string[];
 
 /**
  * @param {string[]} filePaths An Array of file paths.
+ * @param {ClipboardOptions} [options]
  * @returns {string[]} An Array of file paths that successfully written into clipboard.
  */
-export function writeFilePaths(filePaths: string[]): string[];
+export function writeFilePaths(filePaths: string[], options?: ClipboardOptions): string[];
+/**
+ * Writes a PathList without converting it to JS strings.
+ * @returns {PathList} The paths read back from the clipboard.
+ */
+export function writeFilePaths(filePaths: PathList, options?: ClipboardOptions): PathList;
+
+/**
+ * File paths stored front-coded in native memory: paths sharing a directory
+ * cost a few bytes each, and JS strings are only created when read.
+ */
+export class PathList implements Iterable<string> {
+  constructor(paths?: string[]);
+  /** Parses the output of `toPacked`, throws if it is malformed. */
+  static fromPacked(packed: Buffer): PathList;
+  readonly length: number;
+  /** Native bytes held by the encoded paths. */
+  readonly encodedBytes: number;
+  /** The path at `index`, undefined when out of range. */
+  get(index: number): string | undefined;
+  /** Like `Array.prototype.slice`. */
+  slice(start?: number, end?: number): string[];
+  /** Longest prefix shared by all paths, not necessarily ending at a separator. */
+  commonPrefix(): string;
+  /** A compact serialization that `PathList.fromPacked` restores. */
+  toPacked(): Buffer;
+  toArray(): string[];
+  /** Decodes lazily, a chunk of paths at a time. */
+  [Symbol.iterator](): Iterator<string>;
+}
+
+/**
+ * Like `readFilePaths`, without creating a JS string per path.
+ * @param {ClipboardOptions} [options]
+ * @returns {PathList}
+ */
+export function readFilePathList(options?: ClipboardOptions): PathList;
 
 /**
  * Clear clipboard.
+ * @param {ClipboardOptions} [options]
+ */
+export function clear(options?: ClipboardOptions): void;
+
+/**
+ * Progress of a long operation. `total` is 0 when unknown.
+ * - `transfer`: bytes received from the clipboard owner
+ * - `decode`: rows of the image decoded
+ * - `encode`: bytes of the target file encoded
+ */
+export interface Progress {
+  phase: 'transfer' | 'decode' | 'encode';
+  done: number;
+  total: number;
+}
+
+/**
+ * Options of the async image saving functions.
  */
-export function clear(): void;
+export interface SaveImageOptions extends ClipboardOptions {
+  /** Called at most every 50 ms per phase, and at the end of each phase whose total is known. */
+  onProgress?: (progress: Progress) => void;
+  /**
+   * Aborts the operation, the promise then rejects with an `AbortError` and no file is written. An abort arriving
+   * after the file was written is ignored.
+   */
+  signal?: AbortSignal;
+}
 
 /**
  * Save image in clipboard as a jpeg file.
  * @param {string} targetPath Target jpeg file path.
  * @param {number} compressionFactor A float number ranges 0-1.
+ * @param {ClipboardOptions} [options]
  * @returns {boolean} True if the target jpeg file is created, false otherwise.
  */
-export function saveImageAsJpegSync(targetPath: string, compressionFactor: number): boolean;
+export function saveImageAsJpegSync(targetPath: string, compressionFactor: number, options?: ClipboardOptions): boolean;
 
 /**
  * Async version of `saveImageAsJpegSync`.
  * @param {string} targetPath
  * @param {number} compressionFactor
+ * @param {SaveImageOptions} [options]
  * @returns {Promise<boolean>}
  * @see saveImageAsJpegSync
  */
-export function saveImageAsJpeg(targetPath: string, compressionFactor: number): Promise<boolean>;
+export function saveImageAsJpeg(targetPath: string, compressionFactor: number, options?: SaveImageOptions): Promise<boolean>;
+
+export interface PngPresetOptions {
+  /**
+   * `'screenshot'` uses an encoder tuned for UI captures: a palette of up to 256 colors when the image allows it,
+   * per row filters and matching against the pixel and row above, giving smaller files faster than the default
+   * encoder on flat areas and text. Defaults to `'default'`.
+   */
+  preset?: 'default' | 'screenshot';
+}
 
 /**
  * Save image in clipboard as a png file.
  * @param {string} targetPath Target png file path.
+ * @param {ClipboardOptions & PngPresetOptions} [options]
  * @returns {boolean} True if the target png file is created, false otherwise.
  */
-export function saveImageAsPngSync(targetPath: string): boolean;
+export function saveImageAsPngSync(targetPath: string, options?: ClipboardOptions & PngPresetOptions): boolean;
 
 /**
  * Async version of `saveImageAsPngSync`.
  * @param {string} targetPath
+ * @param {SaveImageOptions & PngPresetOptions} [options]
  * @returns {Promise<boolean>}
  * @see saveImageAsPngSync
  */
-export function saveImageAsPng(targetPath: string): Promise<boolean>;
+export function saveImageAsPng(targetPath: string, options?: SaveImageOptions & PngPresetOptions): Promise<boolean>;
+
+/**
+ * Crop, then clockwise rotation, then flips.
+ */
+export interface ImageTransform {
+  /** Pixels of the clipboard image to keep, `width` and `height` default to the right and bottom edges. */
+  crop?: {x?: number; y?: number; width?: number; height?: number};
+  rotate?: 0 | 90 | 180 | 270;
+  flipHorizontal?: boolean;
+  flipVertical?: boolean;
+}
+
+export interface SaveTransformedOptions extends SaveImageOptions {
+  /** Defaults to `'jpeg'` for `.jpg` and `.jpeg` targets, `'png'` otherwise. */
+  format?: 'png' | 'jpeg';
+  /** JPEG quality 0-1 when the image has to be encoded again, default 0.9. */
+  quality?: number;
+}
+
+/**
+ * Save the clipboard image cropped, rotated and flipped.
+ *
+ * On Linux, when the owner offers `image/jpeg` and the target is a JPEG,
+ * the transform is lossless: DCT blocks are moved instead of decoding and
+ * encoding again. The crop origin then snaps up and left to the 8 or 16
+ * pixel block grid, and partial blocks that would end up on the top or
+ * left edge are dropped, like `jpegtran -trim`.
+ * @param {string} targetPath
+ * @param {ImageTransform} transform
+ * @param {SaveTransformedOptions} [options]
+ * @returns {Promise<boolean>} False if the clipboard holds no image or the crop is empty.
+ */
+export function saveImageTransformed(targetPath: string, transform: ImageTransform,
+                                     options?: SaveTransformedOptions): Promise<boolean>;
 
 /**
  * Put an image into clipboard.
  * @param {string} imagePath The source image file path.
+ * @param {ClipboardOptions} [options]
  * @returns {boolean} True is successfully done.
  */
-export function putImageSync(imagePath: string): boolean;
+export function putImageSync(imagePath: string, options?: ClipboardOptions): boolean;
 
 /**
  * Async version of `putImageSync`.
  * @param {string} imagePath
+ * @param {ClipboardOptions} [options]
  * @returns {Promise<boolean>}
  * @see putImageSync
  */
-export function putImage(imagePath: string): Promise<boolean>;
+export function putImage(imagePath: string, options?: ClipboardOptions): Promise<boolean>;
 
 /**
+ * @param {ClipboardOptions} [options]
  * @returns {boolean} If clipboard has an image in it.
  */
-export function hasImage(): boolean;
+export function hasImage(options?: ClipboardOptions): boolean;
+
+/**
+ * Options of `readImageShared`.
+ */
+export interface ReadImageSharedOptions extends ClipboardOptions {
+  /** Premultiply the color by alpha, as Skia bitmaps are; defaults to true. */
+  premultiplied?: boolean;
+  /**
+   * Also return a file descriptor of the shared memory (Linux and macOS),
+   * e.g. to pass to a utility process. The caller has to close it.
+   */
+  fd?: boolean;
+}
+
+/**
+ * The clipboard image as BGRA pixels in shared memory, rows `stride` bytes
+ * apart from top to bottom.
+ */
+export interface SharedImage {
+  width: number;
+  height: number;
+  stride: number;
+  premultiplied: boolean;
+  /** A view of the shared memory, or a copy where external buffers are not allowed. */
+  data: ArrayBuffer;
+  /** Descriptor of the shared memory when `fd` was requested, otherwise null. */
+  fd: number | null;
+}
+
+/**
+ * Read the clipboard image without encoding it, e.g. for
+ * `nativeImage.createFromBitmap(Buffer.from(image.data), image)`.
+ * @param {ReadImageSharedOptions} [options]
+ * @returns {SharedImage | null} Null if clipboard has no image in it.
+ */
+export function readImageShared(options?: ReadImageSharedOptions): SharedImage | null;
+
+/**
+ * Options of `readText`.
+ */
+export interface ReadTextOptions extends ClipboardOptions {
+  /**
+   * Return the UTF-8 bytes as a Buffer instead of a string, defaults to `'string'`.
+   */
+  as?: 'string' | 'buffer';
+}
+
+/**
+ * Read text from clipboard. Latin-1 only owners are converted to UTF-8.
+ * @param {ReadTextOptions} [options]
+ * @returns {string | Buffer} Empty if clipboard has no text in it.
+ */
+export function readText(options?: ReadTextOptions & { as?: 'string' }): string;
+export function readText(options: ReadTextOptions & { as: 'buffer' }): Buffer;
+
+/**
+ * Write text into clipboard.
+ * @param {string | Buffer} text A string or a Buffer of UTF-8 bytes.
+ * @param {ClipboardOptions} [options]
+ * @returns {boolean} True is successfully done.
+ */
+export function writeText(text: string | Buffer, options?: ClipboardOptions): boolean;
+
+/**
+ * Rich text flavors.
+ */
+export interface RichContent {
+  html?: string;
+  rtf?: string;
+  text?: string;
+}
+
+/**
+ * Read every rich text flavor from the current clipboard owner.
+ * @param {ClipboardOptions} [options]
+ * @returns {RichContent} Flavors that are not available are left out.
+ */
+export function readRich(options?: ClipboardOptions): RichContent;
+
+/**
+ * Write html, rtf and plain text into clipboard at once.
+ * When `text` is omitted it is derived from `html`.
+ * @param {RichContent} content
+ * @param {ClipboardOptions} [options]
+ * @returns {boolean} True is successfully done.
+ */
+export function writeRich(content: RichContent, options?: ClipboardOptions): boolean;
+
+/**
+ * Flavors offered together by `writeMulti`.
+ */
+export interface MultiContent {
+  files?: string[];
+  /** An image file, mutually exclusive with `imageBuffer`. */
+  imagePath?: string;
+  /** An encoded image (png, jpeg, ...). */
+  imageBuffer?: Buffer;
+  /**
+   * Without `files`, also offers `imageBuffer` as a file of this name to
+   * file managers. The file is only written, into a temporary directory,
+   * when one asks for it, and removed when the clipboard content is
+   * replaced. Linux only.
+   */
+  imageFileName?: string;
+  /** Defaults to the file paths, one per line, or `imagePath`. */
+  text?: string;
+}
+
+/**
+ * Offer files, an image and text from one clipboard ownership, so that a
+ * file manager pastes the files, an image editor the pixels and a text field the text.
+ * @param {MultiContent} content
+ * @param {ClipboardOptions} [options]
+ * @returns {boolean} True is successfully done.
+ */
+export function writeMulti(content: MultiContent, options?: ClipboardOptions): boolean;
+
+/**
+ * A number that increases every time the clipboard content changes.
+ * Rapid PRIMARY selection updates (e.g. drag-select) are coalesced into one change.
+ * @param {ClipboardOptions} [options]
+ * @returns {number}
+ */
+export function getSequenceNumber(options?: ClipboardOptions): number;
+
+/**
+ * Digest of the raw bytes of one clipboard target.
+ */
+export interface TargetDigest {
+  /** XXH64 as 16 hex digits. */
+  digest: string;
+  size: number;
+  /** True when the content had not changed since the digest was computed. */
+  cached: boolean;
+}
+
+/**
+ * Hash the bytes the clipboard owner offers for `mimeType` (e.g. `'image/png'`)
+ * as they arrive, without holding or decoding them. Cheap to call again:
+ * digests are reused until the sequence number changes. On macOS and Windows
+ * other names are used as pasteboard types or clipboard format names.
+ * @param {string} mimeType
+ * @param {ClipboardOptions} [options]
+ * @returns {TargetDigest | null} Null if the target is not offered.
+ */
+export function targetDigest(mimeType: string, options?: ClipboardOptions): TargetDigest | null;
+
+/**
+ * Reply times of one target (mime type) of a selection owner.
+ */
+export interface TargetStats {
+  requests: number;
+  timeouts: number;
+  /** Mean reply time, replies that arrived after a timeout included. */
+  meanMs: number;
+  maxMs: number;
+  /** Timeout of the next request, adapted from the owner's replies. */
+  timeoutMs: number;
+}
+
+/**
+ * An application that owned a selection while it was read.
+ */
+export interface OwnerStats {
+  /** 0 if the owner does not set `_NET_WM_PID`. */
+  pid: number;
+  wmClass: string;
+  targets: {[target: string]: TargetStats};
+}
+
+/**
+ * Scratch buffers recycled across transfers and image encodes.
+ */
+export interface BufferPoolStats {
+  acquires: number;
+  hits: number;
+  /** `hits / acquires`, 0 before the first acquire. */
+  hitRate: number;
+  retainedBytes: number;
+  retainedBuffers: number;
+}
+
+/**
+ * Requests other applications made while we owned a selection. On X11, file
+ * lists, images and `writeMulti` content are served from a private connection
+ * where every requestor gets its own INCR transfer.
+ */
+export interface ServingStats {
+  requests: number;
+  /** Requests answered in chunks because they exceeded the X server's request size. */
+  incrTransfers: number;
+  bytes: number;
+  /** Transfers dropped because the requestor stopped reading. */
+  timeouts: number;
+  activeTransfers: number;
+  maxActiveTransfers: number;
+  /**
+   * Requests for a target produced on demand (such as a PNG encoded from
+   * another image format), answered once a background thread produced it.
+   */
+  deferred: number;
+  /** Targets being produced right now. */
+  rendering: number;
+  /** Longest time taken to produce a target. */
+  maxRenderMs: number;
+}
+
+/**
+ * Image codec setup kept per thread and reused by later saves: libjpeg
+ * compressors and decompressors on Linux, GDI+ encoder lookups on Windows.
+ */
+export interface CodecContextStats {
+  acquires: number;
+  /** Acquires served by a context that an earlier call set up. */
+  reuses: number;
+  /** `reuses / acquires`, 0 before the first acquire. */
+  reuseRate: number;
+  /** Contexts held right now. */
+  live: number;
+}
+
+export interface ClipboardStats {
+  owners: OwnerStats[];
+  bufferPool: BufferPoolStats;
+  serving: ServingStats;
+  codecContexts: CodecContextStats;
+}
+
+/**
+ * Statistics of the backend. Owners and serving are only recorded on X11,
+ * where pastes wait for the owning application to convert the selection.
+ * @returns {ClipboardStats}
+ */
+export function getStats(): ClipboardStats;
+
+/**
+ * Switches between the system clipboard and an in-process clipboard kept in
+ * native memory. The memory backend has all selections and flavors, sequence
+ * numbers included, and needs no display server. On Linux it is picked
+ * automatically when neither X11 nor a Wayland data-control compositor is
+ * reachable.
+ * @param {'memory' | 'native'} backend
+ */
+export function setBackend(backend: 'memory' | 'native'): void;
+
+/**
+ * @returns {'memory' | 'native'} The backend in use.
+ */
+export function getBackend(): 'memory' | 'native';
+
+export interface AutoArchiveOptions extends ClipboardOptions {
+  /** Defaults to `'png'`. */
+  format?: 'png' | 'jpeg';
+  /** JPEG quality between 0 and 1, defaults to 0.9. */
+  quality?: number;
+  /** Longest edge in pixels, larger images are scaled down. */
+  maxSize?: number;
+  /** Skip images identical to one of the last 1024 archived, defaults to true. */
+  dedupe?: boolean;
+  /**
+   * Change polling interval in milliseconds, defaults to 250. Only the change check runs on the JS thread, changed
+   * images are read, decoded, scaled, encoded and written on native threads.
+   */
+  interval?: number;
+}
+
+export interface ArchivedImage {
+  path: string;
+  width: number;
+  height: number;
+}
+
+export interface AutoArchive {
+  on(event: 'archived', listener: (image: ArchivedImage) => void): this;
+  on(event: 'error', listener: (error: Error) => void): this;
+  /** Stops watching, the image being encoded is still written. */
+  stop(): void;
+}
+
+/**
+ * Saves every image copied from now on into `dir`, as
+ * `clipboard-<time>-<fingerprint>.png` (or `.jpg`).
+ * @param {string} dir An existing directory.
+ * @param {AutoArchiveOptions} [options]
+ * @returns {AutoArchive}
+ */
+export function startAutoArchive(dir: string, options?: AutoArchiveOptions): AutoArchive;
+
+export interface ThumbnailOptions {
+  /** Longest edge in pixels, defaults to 256. Smaller images keep their size. */
+  size?: number;
+  /** Defaults to `'png'`. */
+  format?: 'png' | 'jpeg';
+  /** JPEG quality between 0 and 1, defaults to 0.8. */
+  quality?: number;
+  /** Defaults to a directory in `os.tmpdir()`. */
+  cacheDir?: string;
+  signal?: AbortSignal;
+}
+
+export interface ThumbnailResult {
+  /** Index into the requested paths. */
+  index: number;
+  path: string;
+  /** File in the cache directory, absent on error. */
+  thumbnailPath?: string;
+  /** True if the thumbnail was generated earlier for the unchanged file. */
+  cached?: boolean;
+  error?: string;
+}
+
+/**
+ * Generates thumbnails of image files on all cores and yields them in
+ * completion order. Thumbnails are cached by path, size and mtime.
+ * @param {string[]} paths
+ * @param {ThumbnailOptions} [options]
+ * @returns {AsyncIterable<ThumbnailResult>}
+ */
+export function thumbnailsForPaths(paths: string[], options?: ThumbnailOptions): AsyncIterable<ThumbnailResult>;
+
+export interface ConvertTask {
+  src: string;
+  dst: string;
+  /** Defaults to the extension of `dst`, PNG unless `.jpg` or `.jpeg`. */
+  format?: 'png' | 'jpeg';
+  /** JPEG quality between 0 and 1, defaults to 0.9. */
+  quality?: number;
+  /** Longest edge in pixels, larger images are scaled down. */
+  maxSize?: number;
+}
+
+export interface ConvertResult {
+  width?: number;
+  height?: number;
+  /** Set when the task failed, the other tasks still run. */
+  error?: string;
+}
+
+export interface ConvertOptions {
+  /** Images decoded at a time, defaults to one per core (at most 8). */
+  concurrency?: number;
+  signal?: AbortSignal;
+}
+
+/**
+ * Converts image files with the same codecs as the clipboard functions.
+ * Each `dst` is written atomically.
+ * @param {ConvertTask[]} tasks
+ * @param {ConvertOptions} [options]
+ * @returns {Promise<ConvertResult[]>} One result per task, in task order.
+ */
+export function convertImages(tasks: ConvertTask[], options?: ConvertOptions): Promise<ConvertResult[]>;
+
+export interface ImageHistoryEntry {
+  id: number;
+  width: number;
+  height: number;
+  tiles: number;
+  /** Tiles not shared with any entry still in the history. */
+  newTiles: number;
+  /** Pixel bytes this entry added to the history. */
+  deltaBytes: number;
+}
+
+export interface Region {
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+export interface ImageHistory {
+  /** Adds the clipboard image, null if there is none. */
+  add(options?: ClipboardOptions): ImageHistoryEntry | null;
+  /** Straight alpha RGBA pixels, rows `width * 4` bytes apart. */
+  get(id: number): {width: number, height: number, data: Buffer} | null;
+  save(id: number, path: string, options?: {format?: 'png' | 'jpeg', quality?: number}): boolean;
+  remove(id: number): boolean;
+  /** Tile-aligned rectangles where `id` differs from `previousId`. */
+  changedRegions(id: number, previousId: number): Region[] | null;
+  stats(): {entries: number, uniqueTiles: number, storedBytes: number, logicalBytes: number};
+}
+
+/**
+ * An in-memory history of clipboard images that stores identical tiles of
+ * similar images (e.g. successive screenshots) only once.
+ * @param {{tileSize?: number}} [options] Tile edge in pixels, defaults to 64.
+ * @returns {ImageHistory}
+ */
+export function createImageHistory(options?: {tileSize?: number}): ImageHistory;
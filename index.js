@@ -1,26 +1,198 @@
+const {EventEmitter} = require('events');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
 const {promisify} = require('util');
 const {
   readFilePaths,
   writeFilePaths,
+  readFilePathList,
+  PathList,
   clear,
   saveImageAsJpegSync,
   saveImageAsJpegAsync,
   saveImageAsPngSync,
   saveImageAsPngAsync,
+  saveImageTransformedAsync,
   putImageSync,
   putImageAsync,
   hasImage,
+  readImageShared,
+  readText,
+  writeText,
+  readRich,
+  writeRich,
+  writeMulti,
+  getSequenceNumber,
+  targetDigest,
+  getStats,
+  setBackend,
+  getBackend,
+  startAutoArchive: startAutoArchiveNative,
+  thumbnailsForPaths: thumbnailsForPathsNative,
+  convertImages,
+  createImageHistory,
 } = require('node-gyp-build')(__dirname);
 
+// Paths are decoded in chunks, so iterating a million entry list never
+// holds more than a chunk of JS strings
+const PATH_LIST_CHUNK = 1024;
+
+PathList.prototype[Symbol.iterator] = function* () {
+  for (let start = 0; start < this.length; start += PATH_LIST_CHUNK) {
+    yield* this.slice(start, start + PATH_LIST_CHUNK);
+  }
+};
+
+PathList.prototype.toArray = function () {
+  return this.slice(0, this.length);
+};
+
+function abortError() {
+  const error = new Error('The operation was aborted');
+  error.name = 'AbortError';
+  error.code = 'ABORT_ERR';
+  return error;
+}
+
+// Promisifies a native function that returns a `{cancel()}` handle, the
+// `signal` of the options object at `optionsIndex` aborts it.
+function cancellable(asyncFn, optionsIndex) {
+  return (...args) => new Promise((resolve, reject) => {
+    const options = args[optionsIndex];
+    const signal = options && options.signal;
+    if (signal && signal.aborted) {
+      reject(abortError());
+      return;
+    }
+    let onAbort = null;
+    const handle = asyncFn(...args, (error, result) => {
+      if (onAbort) {
+        signal.removeEventListener('abort', onAbort);
+      }
+      if (error) {
+        reject(error);
+      } else {
+        resolve(result);
+      }
+    });
+    if (signal) {
+      onAbort = () => handle.cancel();
+      signal.addEventListener('abort', onAbort, {once: true});
+    }
+  });
+}
+
+// Emits 'archived' with `{path, width, height}` for every saved image and
+// 'error' when one could not be written, until `stop()` is called.
+class AutoArchive extends EventEmitter {
+  constructor(dir, options) {
+    super();
+    this._handle = startAutoArchiveNative(dir, options || {}, (error, image) => {
+      if (error) {
+        this.emit('error', error);
+      } else {
+        this.emit('archived', image);
+      }
+    });
+    // Changes are polled and read on this thread, only encoding runs on
+    // native threads
+    this._timer = setInterval(() => this._handle.poll(), this._handle.interval);
+  }
+
+  stop() {
+    clearInterval(this._timer);
+    this._handle.stop();
+  }
+}
+
+function startAutoArchive(dir, options) {
+  return new AutoArchive(dir, options);
+}
+
+// Yields `{index, path, thumbnailPath, cached}` (or `{index, path, error}`)
+// as thumbnails complete. Leaving the loop early cancels the rest.
+async function* thumbnailsForPaths(paths, options = {}) {
+  const {signal} = options;
+  if (signal && signal.aborted) {
+    throw abortError();
+  }
+  const cacheDir = options.cacheDir || path.join(os.tmpdir(), 'electron-clipboard-ex-thumbnails');
+  fs.mkdirSync(cacheDir, {recursive: true});
+
+  const results = [];
+  let finished = false;
+  let wake = null;
+  const notify = () => {
+    if (wake) {
+      wake();
+      wake = null;
+    }
+  };
+  const handle = thumbnailsForPathsNative(paths, {...options, cacheDir}, (error, result) => {
+    if (result) {
+      results.push(result);
+    } else {
+      finished = true;
+    }
+    notify();
+  });
+  const onAbort = () => {
+    handle.cancel();
+    notify();
+  };
+  if (signal) {
+    signal.addEventListener('abort', onAbort, {once: true});
+  }
+  try {
+    while (true) {
+      if (results.length) {
+        yield results.shift();
+      } else if (signal && signal.aborted) {
+        throw abortError();
+      } else if (finished) {
+        return;
+      } else {
+        await new Promise((resolve) => {
+          wake = resolve;
+        });
+      }
+    }
+  } finally {
+    if (signal) {
+      signal.removeEventListener('abort', onAbort);
+    }
+    handle.cancel();
+  }
+}
+
 module.exports = {
   readFilePaths,
   writeFilePaths,
+  readFilePathList,
+  PathList,
   clear,
-  saveImageAsJpeg: promisify(saveImageAsJpegAsync),
+  saveImageAsJpeg: cancellable(saveImageAsJpegAsync, 2),
   saveImageAsJpegSync,
-  saveImageAsPng: promisify(saveImageAsPngAsync),
+  saveImageAsPng: cancellable(saveImageAsPngAsync, 1),
   saveImageAsPngSync,
+  saveImageTransformed: cancellable(saveImageTransformedAsync, 2),
   putImageSync,
   putImage: promisify(putImageAsync),
   hasImage,
+  readImageShared,
+  readText,
+  writeText,
+  readRich,
+  writeRich,
+  writeMulti,
+  getSequenceNumber,
+  targetDigest,
+  getStats,
+  setBackend,
+  getBackend,
+  startAutoArchive,
+  thumbnailsForPaths,
+  convertImages: cancellable(convertImages, 1),
+  createImageHistory,
 };
@@ -0,0 +1,144 @@
+#include "auto_archive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include "image_files.h"
+#include "image_ops.h"
+
+namespace {
+
+const unsigned kMaxEncoderThreads = 2;
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+AutoArchive::AutoArchive(AutoArchiveOptions options, Callback callback)
+        : _options(std::move(options)), _callback(std::move(callback)),
+          _sequence(ClipboardSequenceNumber(_options.selection)) {
+    unsigned encoders = std::max(1u, std::min(kMaxEncoderThreads, std::thread::hardware_concurrency()));
+    for (unsigned i = 0; i < encoders; ++i) {
+        _encoders.emplace_back(&AutoArchive::Encode, this);
+    }
+}
+
+AutoArchive::~AutoArchive() {
+    Stop();
+}
+
+void AutoArchive::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopping) {
+            return;
+        }
+        _stopping = true;
+        _jobs.clear();
+    }
+    _changed.notify_all();
+    for (std::thread &encoder : _encoders) {
+        encoder.join();
+    }
+}
+
+bool AutoArchive::Remember(uint64_t fingerprint) {
+    auto it = _recent_index.find(fingerprint);
+    if (it != _recent_index.end()) {
+        _recent.splice(_recent.begin(), _recent, it->second);
+        return false;
+    }
+    _recent.push_front(fingerprint);
+    _recent_index.emplace(fingerprint, _recent.begin());
+    if (_recent.size() > kMaxFingerprints) {
+        _recent_index.erase(_recent.back());
+        _recent.pop_back();
+    }
+    return true;
+}
+
+void AutoArchive::Poll() {
+    {
+        // Back-pressure: the change is left for a later poll
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopping || _jobs.size() >= kMaxPendingJobs) {
+            return;
+        }
+    }
+    uint64_t current = ClipboardSequenceNumber(_options.selection);
+    if (current == _sequence) {
+        return;
+    }
+    _sequence = current;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_stopping) {
+        _read_pending = true;
+        _changed.notify_one();
+    }
+}
+
+void AutoArchive::Encode() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _changed.wait(lock, [this] { return _stopping || !_jobs.empty() || (_read_pending && !_reading); });
+        if (_stopping) {
+            return;
+        }
+        if (_read_pending && !_reading) {
+            // The transfer and decode stay off the polling thread
+            _read_pending = false;
+            _reading = true;
+            lock.unlock();
+            ImagePixels read;
+            bool ok = ReadImagePixelsAnyThread(read, _options.selection);
+            lock.lock();
+            _reading = false;
+            if (ok && !_stopping) {
+                _jobs.push_back(std::move(read));
+            }
+            _changed.notify_all();
+            continue;
+        }
+        ImagePixels image = std::move(_jobs.front());
+        _jobs.pop_front();
+        lock.unlock();
+
+        uint64_t fingerprint = FingerprintPixels(image);
+        lock.lock();
+        if (!Remember(fingerprint) && _options.dedupe) {
+            continue;
+        }
+        lock.unlock();
+
+        ImagePixels scaled;
+        const ImagePixels *output = &image;
+        uint32_t width, height;
+        FitWithin(image.width, image.height, _options.max_size, width, height);
+        if (width != image.width || height != image.height) {
+            if (Downscale(image, width, height, scaled)) {
+                output = &scaled;
+                image.pixels.Reset();
+            }
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "clipboard-%" PRId64 "-%016" PRIx64 ".%s", NowMs(), fingerprint,
+                 _options.format == ImageFormat::Jpeg ? "jpg" : "png");
+        ArchivedImage archived;
+        archived.path = JoinPath(_options.directory, name);
+        archived.width = output->width;
+        archived.height = output->height;
+        archived.fingerprint = fingerprint;
+
+        if (SaveImagePixelsAtomically(*output, archived.path, _options.format, _options.quality)) {
+            _callback(&archived, std::string());
+        } else {
+            _callback(nullptr, "Failed to write " + archived.path);
+        }
+        lock.lock();
+    }
+}
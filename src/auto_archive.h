@@ -0,0 +1,87 @@
+#ifndef ELECTRON_CLIPBOARD_EX_AUTO_ARCHIVE_H
+#define ELECTRON_CLIPBOARD_EX_AUTO_ARCHIVE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "clipboard.h"
+
+struct AutoArchiveOptions {
+    std::string directory;
+    ImageFormat format = ImageFormat::Png;
+    float quality = 0.9f; // JPEG only
+    uint32_t max_size = 0; // Longest edge in pixels, 0 keeps the original size
+    bool dedupe = true; // Skip images archived recently
+    uint32_t interval_ms = 250; // Change polling interval
+    ClipboardSelection selection = ClipboardSelection::Clipboard;
+};
+
+struct ArchivedImage {
+    std::string path;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t fingerprint = 0;
+};
+
+// Saves every image copied to a selection into a directory. The owner polls
+// the sequence number on the thread that uses the clipboard; the encoder
+// threads read changed images with ReadImagePixelsAnyThread, then
+// fingerprint, downscale, encode and write them. Files are written under a
+// temporary name and renamed, so readers never see partial images.
+class AutoArchive {
+public:
+    // Called on the encoder threads with either an image or an error.
+    using Callback = std::function<void(const ArchivedImage *image, const std::string &error)>;
+
+    // What is on the selection when archiving starts is not archived.
+    AutoArchive(AutoArchiveOptions options, Callback callback);
+
+    ~AutoArchive();
+
+    AutoArchive(const AutoArchive &) = delete;
+
+    AutoArchive &operator=(const AutoArchive &) = delete;
+
+    // To be called every `interval_ms` on the thread the clipboard is used
+    // from (GTK's on Linux), like the constructor. Only compares sequence
+    // numbers and hands a change to the encoders; while they are behind,
+    // changes collapse into the latest one.
+    void Poll();
+
+    // Waits for the image being read or encoded, pending ones are dropped.
+    void Stop();
+
+private:
+    void Encode();
+
+    // Remembers `fingerprint`, false if it was already seen
+    bool Remember(uint64_t fingerprint);
+
+    static const size_t kMaxPendingJobs = 4;
+    static const size_t kMaxFingerprints = 1024;
+
+    AutoArchiveOptions _options;
+    Callback _callback;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    bool _stopping = false;
+    bool _read_pending = false; // The selection changed since the last read started
+    bool _reading = false; // Reads run one at a time, in the order of the changes
+    std::deque<ImagePixels> _jobs;
+
+    std::list<uint64_t> _recent; // Most recently seen first
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> _recent_index;
+
+    uint64_t _sequence; // Only used by the polling thread
+    std::vector<std::thread> _encoders;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_AUTO_ARCHIVE_H
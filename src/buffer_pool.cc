@@ -0,0 +1,193 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const size_t kCacheLineSize = 64;
+const size_t kHugePageSize = 2 << 20;
+
+// Classes grow by a quarter of a power of two, so at most 20% of a buffer
+// is wasted. Requests above the largest class are not pooled.
+const size_t kMinClassSize = 64 << 10;
+const size_t kMaxClassSize = 128 << 20;
+
+// Retained memory is capped overall and per class, an unusually large
+// image must not pin its buffers forever
+const size_t kMaxRetainedBytes = 256 << 20;
+const size_t kMaxRetainedPerClass = 4;
+
+size_t RoundUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+const std::vector<size_t> &ClassSizes() {
+    static const std::vector<size_t> sizes = [] {
+        std::vector<size_t> result;
+        for (size_t base = kMinClassSize; base <= kMaxClassSize; base *= 2) {
+            for (size_t quarter = 0; quarter < 4; ++quarter) {
+                size_t size = base + base / 4 * quarter;
+                size = RoundUp(size, size >= kHugePageSize ? kHugePageSize : kCacheLineSize);
+                if (size <= kMaxClassSize && (result.empty() || size > result.back())) {
+                    result.push_back(size);
+                }
+            }
+        }
+        return result;
+    }();
+    return sizes;
+}
+
+char *AllocateBlock(size_t size) {
+#ifdef __linux__
+    if (size >= kHugePageSize && size % kHugePageSize == 0) {
+        // Over-map by one huge page and trim, so the block is 2 MiB aligned
+        // and can be backed by huge pages from its first byte
+        size_t length = size + kHugePageSize;
+        void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return nullptr;
+        }
+        char *start = static_cast<char *>(mapping);
+        char *aligned = reinterpret_cast<char *>(RoundUp(reinterpret_cast<uintptr_t>(start), kHugePageSize));
+        if (aligned > start) {
+            munmap(start, static_cast<size_t>(aligned - start));
+        }
+        size_t tail = static_cast<size_t>(start + length - (aligned + size));
+        if (tail) {
+            munmap(aligned + size, tail);
+        }
+        madvise(aligned, size, MADV_HUGEPAGE);
+        return aligned;
+    }
+#endif
+    return static_cast<char *>(::operator new(size, std::align_val_t(kCacheLineSize), std::nothrow));
+}
+
+void FreeBlock(char *data, size_t size) {
+#ifdef __linux__
+    if (size >= kHugePageSize && size % kHugePageSize == 0) {
+        munmap(data, size);
+        return;
+    }
+#endif
+    ::operator delete(data, std::align_val_t(kCacheLineSize));
+}
+
+class BufferPool {
+public:
+    static BufferPool &Get() {
+        // Leaked, buffers may be released by threads running at exit
+        static BufferPool *pool = new BufferPool();
+        return *pool;
+    }
+
+    char *Acquire(size_t size, size_t &capacity) {
+        const std::vector<size_t> &sizes = ClassSizes();
+        auto it = std::lower_bound(sizes.begin(), sizes.end(), std::max(size, kMinClassSize));
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_stats.acquires;
+            if (it != sizes.end()) {
+                std::vector<char *> &free_list = _free_lists[static_cast<size_t>(it - sizes.begin())];
+                if (!free_list.empty()) {
+                    char *data = free_list.back();
+                    free_list.pop_back();
+                    ++_stats.hits;
+                    _stats.retained_bytes -= *it;
+                    --_stats.retained_buffers;
+                    capacity = *it;
+                    return data;
+                }
+            }
+        }
+        capacity = it != sizes.end() ? *it : RoundUp(size, kHugePageSize);
+        char *data = AllocateBlock(capacity);
+        if (!data) {
+            capacity = 0;
+        }
+        return data;
+    }
+
+    void Release(char *data, size_t capacity) {
+        const std::vector<size_t> &sizes = ClassSizes();
+        auto it = std::lower_bound(sizes.begin(), sizes.end(), capacity);
+        if (it != sizes.end() && *it == capacity) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::vector<char *> &free_list = _free_lists[static_cast<size_t>(it - sizes.begin())];
+            if (free_list.size() < kMaxRetainedPerClass && _stats.retained_bytes + capacity <= kMaxRetainedBytes) {
+                free_list.push_back(data);
+                _stats.retained_bytes += capacity;
+                ++_stats.retained_buffers;
+                return;
+            }
+        }
+        FreeBlock(data, capacity);
+    }
+
+    BufferPoolStats Stats() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+private:
+    BufferPool() : _free_lists(ClassSizes().size()) {}
+
+    std::mutex _mutex;
+    std::vector<std::vector<char *>> _free_lists;
+    BufferPoolStats _stats;
+};
+
+} // namespace
+
+PooledBuffer::PooledBuffer(size_t size) {
+    _data = BufferPool::Get().Acquire(size, _capacity);
+}
+
+PooledBuffer &PooledBuffer::operator=(PooledBuffer &&other) noexcept {
+    if (this != &other) {
+        Reset();
+        std::swap(_data, other._data);
+        std::swap(_capacity, other._capacity);
+    }
+    return *this;
+}
+
+bool PooledBuffer::Grow(size_t size, size_t used) {
+    if (size <= _capacity) {
+        return true;
+    }
+    PooledBuffer grown(size);
+    if (!grown.data()) {
+        return false;
+    }
+    if (used) {
+        memcpy(grown._data, _data, std::min(used, _capacity));
+    }
+    *this = static_cast<PooledBuffer &&>(grown);
+    return true;
+}
+
+void PooledBuffer::Reset() {
+    if (_data) {
+        BufferPool::Get().Release(_data, _capacity);
+    }
+    _data = nullptr;
+    _capacity = 0;
+}
+
+void PooledBuffer::Delete(void *hint) {
+    delete static_cast<PooledBuffer *>(hint);
+}
+
+BufferPoolStats GetBufferPoolStats() {
+    return BufferPool::Get().Stats();
+}
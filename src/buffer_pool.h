@@ -0,0 +1,63 @@
+#ifndef ELECTRON_CLIPBOARD_EX_BUFFER_POOL_H
+#define ELECTRON_CLIPBOARD_EX_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Large scratch buffers for transfers, decoding and encoding, recycled by
+// size class so that saving image after image does not churn tens of MB
+// through malloc. Buffers of 2 MiB and more are 2 MiB aligned anonymous
+// mappings advised for transparent huge pages on Linux. Thread-safe.
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+
+    // Holds at least `size` bytes, check `data()` for allocation failure.
+    explicit PooledBuffer(size_t size);
+
+    PooledBuffer(const PooledBuffer &) = delete;
+
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+    PooledBuffer(PooledBuffer &&other) noexcept {
+        *this = static_cast<PooledBuffer &&>(other);
+    }
+
+    PooledBuffer &operator=(PooledBuffer &&other) noexcept;
+
+    ~PooledBuffer() {
+        Reset();
+    }
+
+    char *data() const {
+        return _data;
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    // Moves the first `used` bytes into a buffer of at least `size` bytes.
+    bool Grow(size_t size, size_t used);
+
+    // Returns the memory to the pool.
+    void Reset();
+
+    // `ClipboardData::ReleaseFunc` for a heap allocated PooledBuffer.
+    static void Delete(void *hint);
+
+private:
+    char *_data = nullptr;
+    size_t _capacity = 0;
+};
+
+struct BufferPoolStats {
+    uint64_t acquires = 0;
+    uint64_t hits = 0; // Acquires served from a retained buffer
+    uint64_t retained_bytes = 0;
+    uint64_t retained_buffers = 0;
+};
+
+BufferPoolStats GetBufferPoolStats();
+
+#endif //ELECTRON_CLIPBOARD_EX_BUFFER_POOL_H
@@ -1,21 +1,281 @@
 #ifndef ELECTRON_CLIPBOARD_EX_CLIPBOARD_H
 #define ELECTRON_CLIPBOARD_EX_CLIPBOARD_H
 
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
+#include <utility>
+#include "buffer_pool.h"
+#include "path_list.h"
 
-std::vector<std::string> ReadFilePaths();
+// X11 style selections. Platforms other than Linux only have `Clipboard`,
+// operations on the other selections behave like an empty clipboard there.
+enum class ClipboardSelection {
+    Clipboard,
+    Primary,
+    Secondary,
+};
 
-void WriteFilePaths(const std::vector<std::string> &file_paths);
+// Bytes owned by a backend. Ownership can be detached so that the memory is
+// handed to JS as an external buffer without being copied.
+class ClipboardData {
+public:
+    using ReleaseFunc = void (*)(void *hint);
 
-void ClearClipboard();
+    ClipboardData() = default;
 
-bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor);
+    ClipboardData(const char *data, size_t size, ReleaseFunc release, void *hint)
+            : _data(data), _size(size), _release(release), _hint(hint) {}
 
-bool SaveClipboardImageAsPng(const std::string &target_path);
+    ClipboardData(const ClipboardData &) = delete;
 
-bool PutImageIntoClipboard(const std::string &image_path);
+    ClipboardData &operator=(const ClipboardData &) = delete;
 
-bool ClipboardHasImage();
+    ClipboardData(ClipboardData &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    ClipboardData &operator=(ClipboardData &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_release, other._release);
+            std::swap(_hint, other._hint);
+        }
+        return *this;
+    }
+
+    ~ClipboardData() {
+        Reset();
+    }
+
+    const char *data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    // The caller becomes responsible for calling `release(hint)`.
+    void Detach(ReleaseFunc &release, void *&hint) {
+        release = _release;
+        hint = _hint;
+        _data = nullptr;
+        _size = 0;
+        _release = nullptr;
+        _hint = nullptr;
+    }
+
+    void Reset() {
+        if (_release) {
+            _release(_hint);
+        }
+        _data = nullptr;
+        _size = 0;
+        _release = nullptr;
+        _hint = nullptr;
+    }
+
+private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+    ReleaseFunc _release = nullptr;
+    void *_hint = nullptr;
+};
+
+enum class ProgressPhase {
+    Transfer, // Bytes received from the selection owner
+    Decode, // Rows decoded
+    Encode, // Bytes encoded
+};
+
+// Receives the progress of long operations on the thread running them.
+// `total` is 0 when unknown. Returning false cancels the operation.
+class ProgressSink {
+public:
+    virtual ~ProgressSink() = default;
+
+    virtual bool Report(ProgressPhase phase, uint64_t done, uint64_t total) = 0;
+};
+
+inline bool ReportProgress(ProgressSink *progress, ProgressPhase phase, uint64_t done, uint64_t total) {
+    return !progress || progress->Report(phase, done, total);
+}
+
+std::vector<std::string> ReadFilePaths(ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+void WriteFilePaths(const std::vector<std::string> &file_paths,
+                    ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Like ReadFilePaths, decoding straight into a front-coded list instead of
+// one std::string per path.
+PathList ReadFilePathList(ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+void WriteFilePathList(const PathList &file_paths, ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+void ClearClipboard(ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor,
+                              ClipboardSelection selection = ClipboardSelection::Clipboard,
+                              ProgressSink *progress = nullptr);
+
+bool SaveClipboardImageAsPng(const std::string &target_path,
+                             ClipboardSelection selection = ClipboardSelection::Clipboard,
+                             ProgressSink *progress = nullptr);
+
+bool PutImageIntoClipboard(const std::string &image_path,
+                           ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+bool ClipboardHasImage(ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// A decoded image, `height` rows of `width` straight alpha RGBA pixels from
+// top to bottom, `stride` bytes apart.
+struct ImagePixels {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t stride = 0;
+    PooledBuffer pixels;
+};
+
+bool ReadImagePixels(ImagePixels &image, ClipboardSelection selection = ClipboardSelection::Clipboard,
+                     ProgressSink *progress = nullptr);
+
+// Like ReadImagePixels, for threads other than the one the clipboard is
+// used from, once it was used there. Linux reads the owner's encoded image
+// through data-control or a private X11 connection and decodes it with
+// DecodeImageData, GTK is never entered; a GTK ownership of this process
+// is answered when that thread next iterates the main loop.
+bool ReadImagePixelsAnyThread(ImagePixels &image, ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Called with the decoded size, returns where `height` rows of `width * 4`
+// bytes go, nullptr to give up.
+using PixelDestination = std::function<char *(uint32_t width, uint32_t height)>;
+
+// Reads the image as BGRA, premultiplied if asked (see ToBgra), converting
+// the decoder's pixels straight into `destination` rather than through
+// the RGBA copy of ReadImagePixels.
+bool ReadImageBgra(const PixelDestination &destination, bool premultiplied,
+                   ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// The owner's image/jpeg flavor as is, false when it offers none. Lets a
+// JPEG be cropped or rotated without decoding it. Linux only.
+bool ReadClipboardJpeg(ClipboardData &data, ClipboardSelection selection = ClipboardSelection::Clipboard,
+                       ProgressSink *progress = nullptr);
+
+enum class ImageFormat {
+    Png,
+    Jpeg,
+};
+
+// Decodes an image file, scaled down to fit `max_size` on its longest edge
+// unless it is 0. Decoders that can scale while decoding (JPEG DCT scaling)
+// do so. Thread-safe.
+bool DecodeImageFile(const std::string &path, uint32_t max_size, ImagePixels &image);
+
+// Decodes an encoded image held in memory.
+bool DecodeImageData(const char *data, size_t size, ImagePixels &image);
+
+// Encodes `image` into `target_path`, `quality` (0..1) only applies to JPEG.
+bool SaveImagePixels(const ImagePixels &image, const std::string &target_path, ImageFormat format,
+                     float quality, ProgressSink *progress = nullptr);
+
+// Reads text as UTF-8.
+bool ReadText(ClipboardData &text, ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Writes UTF-8 text.
+bool WriteText(const char *data, size_t size, ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Rich text flavors, an empty member is not offered or was not available.
+struct RichContent {
+    std::string html; // UTF-8 fragment
+    std::string rtf;
+    std::string text; // UTF-8
+};
+
+RichContent ReadRich(ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Offers all non-empty flavors at once. If `text` is empty it is derived
+// from `html`.
+bool WriteRich(const RichContent &content, ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Flavors offered together by `WriteMulti`, empty members are left out.
+struct MultiContent {
+    std::vector<std::string> file_paths;
+    std::string image_path;
+    std::string image_data; // Encoded image, used when `image_path` is empty
+    // With `image_data` and no `file_paths`, also offers the image as a file
+    // of this name, written only when a requestor asks for file paths. Linux
+    // and the memory backend.
+    std::string image_file_name;
+    std::string text; // Defaults to the file paths, one per line
+};
+
+// Offers files, an image and text from a single clipboard ownership.
+bool WriteMulti(const MultiContent &content, ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Receives a target's bytes piece by piece, returning false stops the read.
+using ChunkConsumer = std::function<bool(const char *data, size_t size)>;
+
+// Streams the bytes the owner offers for `mime_type` as they arrive, without
+// converting or collecting them. Linux passes on Wayland pipe reads and X11
+// INCR chunks, macOS and Windows the whole flavor at once. Unknown mime
+// types are used as pasteboard types or clipboard format names there.
+// False if the target is not offered or the read was stopped.
+bool ReadClipboardTarget(const std::string &mime_type, ClipboardSelection selection, const ChunkConsumer &consume);
+
+// Increases every time the content of the selection changes.
+uint64_t ClipboardSequenceNumber(ClipboardSelection selection = ClipboardSelection::Clipboard);
+
+// Reply times of one target of a selection owner.
+struct TargetStats {
+    std::string target;
+    uint64_t requests = 0;
+    uint64_t timeouts = 0;
+    double mean_ms = 0; // Of the replies, late ones included
+    double max_ms = 0;
+    uint32_t timeout_ms = 0; // Budget of the next request
+};
+
+// An application that owned a selection while we read from it.
+struct OwnerStats {
+    int64_t pid = 0; // 0 if unknown
+    std::string wm_class;
+    std::vector<TargetStats> targets;
+};
+
+// Requests served while we owned a selection.
+struct ServingStats {
+    uint64_t requests = 0;
+    uint64_t incr_transfers = 0; // Requests answered in chunks
+    uint64_t bytes = 0; // Target data written, all requestors together
+    uint64_t timeouts = 0; // Transfers dropped by a requestor that stopped reading
+    uint32_t active_transfers = 0;
+    uint32_t max_active_transfers = 0;
+    uint64_t deferred = 0; // Requests answered after their target was produced off the owner thread
+    uint32_t rendering = 0; // Targets being produced
+    uint32_t max_render_ms = 0;
+};
+
+// Image codec contexts set up once per thread and reused by later saves.
+struct CodecContextStats {
+    uint64_t acquires = 0;
+    uint64_t reuses = 0; // Acquires served by a context an earlier call set up
+    uint32_t live = 0; // Contexts held by threads
+};
+
+struct ClipboardStats {
+    std::vector<OwnerStats> owners;
+    ServingStats serving;
+    CodecContextStats codec_contexts;
+};
+
+// Only the X11 backend, which has to wait for other applications to
+// convert selections and serves large selections itself, collects owners
+// and serving. Codec contexts are libjpeg objects on Linux and GDI+ encoder
+// lookups on Windows.
+ClipboardStats GetClipboardStats();
 
 #endif //ELECTRON_CLIPBOARD_EX_CLIPBOARD_H
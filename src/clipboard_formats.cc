@@ -0,0 +1,382 @@
+#include "clipboard_formats.h"
+
+namespace clipboard_formats {
+
+namespace {
+
+// Characters left unescaped in a file URI path, as g_filename_to_uri does
+bool IsUriPathChar(unsigned char ch) {
+    if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')) {
+        return true;
+    }
+    switch (ch) {
+        case '-': case '_': case '.': case '!': case '~': case '*': case '\'': case '(': case ')':
+        case '/': case '&': case '=': case ':': case '@': case '+': case '$': case ',':
+            return true;
+        default:
+            return false;
+    }
+}
+
+int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+uint16_t ReadU16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadU32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void WriteU16(uint8_t *p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void WriteU32(uint8_t *p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+size_t DibStride(uint32_t width, uint16_t bits_per_pixel) {
+    return ((static_cast<size_t>(width) * bits_per_pixel + 31) / 32) * 4;
+}
+
+const uint32_t kBiRgb = 0;
+const uint32_t kBiBitfields = 3;
+
+} // namespace
+
+size_t EncodeFileUri(std::string_view path, char *out, size_t capacity) {
+    if (path.empty() || path[0] != '/') {
+        return 0;
+    }
+    static const char kPrefix[] = "file://";
+    static const char kHex[] = "0123456789ABCDEF";
+    size_t written = sizeof(kPrefix) - 1;
+    if (written <= capacity) {
+        memcpy(out, kPrefix, written);
+    }
+    for (char c : path) {
+        unsigned char ch = static_cast<unsigned char>(c);
+        if (IsUriPathChar(ch)) {
+            if (written < capacity) {
+                out[written] = c;
+            }
+            written += 1;
+        } else {
+            if (written + 3 <= capacity) {
+                out[written] = '%';
+                out[written + 1] = kHex[ch >> 4];
+                out[written + 2] = kHex[ch & 0xF];
+            }
+            written += 3;
+        }
+    }
+    return written;
+}
+
+size_t DecodeFileUri(std::string_view uri, char *out) {
+    static const std::string_view kScheme = "file://";
+    if (uri.size() <= kScheme.size()) {
+        return 0;
+    }
+    for (size_t i = 0; i < kScheme.size(); ++i) {
+        char ch = uri[i];
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+        if (ch != kScheme[i]) {
+            return 0;
+        }
+    }
+    std::string_view rest = uri.substr(kScheme.size());
+    size_t path_start = rest.find('/');
+    if (path_start == std::string_view::npos) {
+        return 0;
+    }
+    std::string_view host = rest.substr(0, path_start);
+    if (!host.empty() && host != "localhost") {
+        return 0;
+    }
+
+    std::string_view path = rest.substr(path_start);
+    size_t written = 0;
+    for (size_t i = 0; i < path.size(); ++i) {
+        char ch = path[i];
+        if (ch == '%') {
+            if (i + 2 >= path.size()) {
+                return 0;
+            }
+            int high = HexValue(path[i + 1]);
+            int low = HexValue(path[i + 2]);
+            if (high < 0 || low < 0 || (high == 0 && low == 0)) {
+                return 0;
+            }
+            out[written++] = static_cast<char>((high << 4) | low);
+            i += 2;
+        } else if (ch == '#' || ch == '?') {
+            return 0; // fragments and queries are not part of a file path
+        } else {
+            out[written++] = ch;
+        }
+    }
+    return written;
+}
+
+bool UriListReader::Next(std::string_view &uri) {
+    while (_pos < _data.size()) {
+        size_t end = _data.find('\n', _pos);
+        if (end == std::string_view::npos) {
+            end = _data.size();
+        }
+        std::string_view line = _data.substr(_pos, end - _pos);
+        _pos = end + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        uri = line;
+        return true;
+    }
+    return false;
+}
+
+GnomeCopiedFilesReader::GnomeCopiedFilesReader(std::string_view data) : _uris(std::string_view()) {
+    size_t end = data.find('\n');
+    std::string_view header = data.substr(0, end);
+    if (!header.empty() && header.back() == '\r') {
+        header.remove_suffix(1);
+    }
+    if (header == "copy") {
+        _operation = FileOperation::Copy;
+    } else if (header == "cut") {
+        _operation = FileOperation::Cut;
+    } else {
+        return;
+    }
+    _valid = true;
+    _uris = UriListReader(end == std::string_view::npos ? std::string_view() : data.substr(end + 1));
+}
+
+namespace internal {
+
+size_t WriteDropFilesHeader(bool wide, uint8_t *out, size_t capacity) {
+    if (kDropFilesHeaderSize <= capacity) {
+        memset(out, 0, kDropFilesHeaderSize);
+        WriteU32(out, static_cast<uint32_t>(kDropFilesHeaderSize));
+        WriteU32(out + 16, wide ? 1 : 0);
+    }
+    return kDropFilesHeaderSize;
+}
+
+} // namespace internal
+
+DropFilesReader::DropFilesReader(const uint8_t *data, size_t size) : _data(data), _size(size) {
+    if (!data || size < kDropFilesHeaderSize) {
+        return;
+    }
+    uint32_t files_offset = ReadU32(data);
+    if (files_offset < kDropFilesHeaderSize || files_offset > size) {
+        return;
+    }
+    _wide = ReadU32(data + 16) != 0;
+    _pos = files_offset;
+    _valid = true;
+}
+
+bool DropFilesReader::Next(const uint8_t *&path, size_t &length) {
+    if (!_valid) {
+        return false;
+    }
+    const size_t unit = _wide ? 2 : 1;
+    size_t end = _pos;
+    while (end + unit <= _size) {
+        bool terminator = _wide ? (_data[end] == 0 && _data[end + 1] == 0) : _data[end] == 0;
+        if (terminator) {
+            break;
+        }
+        end += unit;
+    }
+    // A missing terminator is malformed, an empty string ends the list
+    if (end + unit > _size) {
+        _valid = false;
+        return false;
+    }
+    if (end == _pos) {
+        return false;
+    }
+    path = _data + _pos;
+    length = (end - _pos) / unit;
+    _pos = end + unit;
+    return true;
+}
+
+bool ParseDib(const uint8_t *data, size_t size, DibInfo &info) {
+    if (!data || size < kBitmapInfoHeaderSize) {
+        return false;
+    }
+    uint32_t header_size = ReadU32(data);
+    if (header_size < kBitmapInfoHeaderSize || header_size > size) {
+        return false;
+    }
+    int32_t width = static_cast<int32_t>(ReadU32(data + 4));
+    int32_t height = static_cast<int32_t>(ReadU32(data + 8));
+    uint16_t bits_per_pixel = ReadU16(data + 14);
+    uint32_t compression = ReadU32(data + 16);
+    uint32_t colors_used = ReadU32(data + 32);
+    if (width <= 0 || height == 0 || height == INT32_MIN || (bits_per_pixel != 24 && bits_per_pixel != 32)) {
+        return false;
+    }
+
+    size_t masks_size = 0;
+    if (compression == kBiBitfields) {
+        if (bits_per_pixel != 32) {
+            return false;
+        }
+        // BITMAPINFOHEADER keeps the masks after the header, later versions inside it
+        const uint8_t *masks = data + kBitmapInfoHeaderSize;
+        if (header_size == kBitmapInfoHeaderSize) {
+            masks_size = 12;
+            if (size < kBitmapInfoHeaderSize + masks_size) {
+                return false;
+            }
+        }
+        if (ReadU32(masks) != 0x00FF0000 || ReadU32(masks + 4) != 0x0000FF00 || ReadU32(masks + 8) != 0x000000FF) {
+            return false;
+        }
+    } else if (compression != kBiRgb) {
+        return false;
+    }
+
+    info.width = static_cast<uint32_t>(width);
+    info.height = static_cast<uint32_t>(height < 0 ? -height : height);
+    info.top_down = height < 0;
+    info.bits_per_pixel = bits_per_pixel;
+    info.stride = DibStride(info.width, bits_per_pixel);
+    info.pixel_offset = header_size + masks_size + static_cast<size_t>(colors_used) * 4;
+    return info.pixel_offset <= size && (size - info.pixel_offset) / info.stride >= info.height;
+}
+
+bool ParseBmp(const uint8_t *data, size_t size, DibInfo &info) {
+    if (!data || size < kBitmapFileHeaderSize || data[0] != 'B' || data[1] != 'M') {
+        return false;
+    }
+    if (!ParseDib(data + kBitmapFileHeaderSize, size - kBitmapFileHeaderSize, info)) {
+        return false;
+    }
+    uint32_t pixel_offset = ReadU32(data + 10);
+    if (pixel_offset < kBitmapFileHeaderSize || pixel_offset > size ||
+        (size - pixel_offset) / info.stride < info.height) {
+        return false;
+    }
+    info.pixel_offset = pixel_offset;
+    return true;
+}
+
+bool DecodeDibPixels(const uint8_t *data, size_t size, const DibInfo &info,
+                     PixelFormat format, uint8_t *out, size_t out_stride) {
+    if (info.pixel_offset + info.stride * info.height > size) {
+        return false;
+    }
+    const size_t in_bpp = info.bits_per_pixel / 8;
+    const bool swap = format == PixelFormat::Rgba;
+    uint8_t alpha_seen = 0;
+    for (uint32_t y = 0; y < info.height; ++y) {
+        uint32_t source_row = info.top_down ? y : info.height - 1 - y;
+        const uint8_t *in = data + info.pixel_offset + source_row * info.stride;
+        uint8_t *row = out + y * out_stride;
+        for (uint32_t x = 0; x < info.width; ++x, in += in_bpp, row += 4) {
+            row[0] = swap ? in[2] : in[0];
+            row[1] = in[1];
+            row[2] = swap ? in[0] : in[2];
+            row[3] = in_bpp == 4 ? in[3] : 0xFF;
+            alpha_seen |= row[3];
+        }
+    }
+    if (in_bpp == 4 && alpha_seen == 0) {
+        for (uint32_t y = 0; y < info.height; ++y) {
+            uint8_t *row = out + y * out_stride;
+            for (uint32_t x = 0; x < info.width; ++x) {
+                row[x * 4 + 3] = 0xFF;
+            }
+        }
+    }
+    return true;
+}
+
+size_t EncodeDib(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride, PixelFormat format,
+                 uint16_t bits_per_pixel, bool top_down, uint8_t *out, size_t capacity) {
+    if ((bits_per_pixel != 24 && bits_per_pixel != 32) || width == 0 || height == 0 || height > INT32_MAX) {
+        return 0;
+    }
+    const size_t out_stride = DibStride(width, bits_per_pixel);
+    const size_t total = kBitmapInfoHeaderSize + out_stride * height;
+    if (total > capacity) {
+        return total;
+    }
+
+    memset(out, 0, kBitmapInfoHeaderSize);
+    WriteU32(out, static_cast<uint32_t>(kBitmapInfoHeaderSize));
+    WriteU32(out + 4, width);
+    WriteU32(out + 8, top_down ? static_cast<uint32_t>(-static_cast<int32_t>(height)) : height);
+    WriteU16(out + 12, 1);
+    WriteU16(out + 14, bits_per_pixel);
+    WriteU32(out + 16, kBiRgb);
+    WriteU32(out + 20, static_cast<uint32_t>(out_stride * height));
+
+    const size_t out_bpp = bits_per_pixel / 8;
+    const bool swap = format == PixelFormat::Rgba;
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *in = pixels + y * stride;
+        uint8_t *row = out + kBitmapInfoHeaderSize + (top_down ? y : height - 1 - y) * out_stride;
+        uint8_t *cursor = row;
+        for (uint32_t x = 0; x < width; ++x, in += 4, cursor += out_bpp) {
+            cursor[0] = swap ? in[2] : in[0];
+            cursor[1] = in[1];
+            cursor[2] = swap ? in[0] : in[2];
+            if (out_bpp == 4) {
+                cursor[3] = in[3];
+            }
+        }
+        memset(cursor, 0, out_stride - static_cast<size_t>(cursor - row));
+    }
+    return total;
+}
+
+size_t EncodeBmp(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride, PixelFormat format,
+                 uint16_t bits_per_pixel, bool top_down, uint8_t *out, size_t capacity) {
+    size_t room = capacity >= kBitmapFileHeaderSize ? capacity - kBitmapFileHeaderSize : 0;
+    size_t dib_size = EncodeDib(pixels, width, height, stride, format, bits_per_pixel, top_down,
+                                room ? out + kBitmapFileHeaderSize : nullptr, room);
+    if (dib_size == 0) {
+        return 0;
+    }
+    size_t total = kBitmapFileHeaderSize + dib_size;
+    if (total <= capacity) {
+        memset(out, 0, kBitmapFileHeaderSize);
+        out[0] = 'B';
+        out[1] = 'M';
+        WriteU32(out + 2, static_cast<uint32_t>(total));
+        WriteU32(out + 10, static_cast<uint32_t>(kBitmapFileHeaderSize + kBitmapInfoHeaderSize));
+    }
+    return total;
+}
+
+} // namespace clipboard_formats
@@ -0,0 +1,233 @@
+#ifndef ELECTRON_CLIPBOARD_EX_CLIPBOARD_FORMATS_H
+#define ELECTRON_CLIPBOARD_EX_CLIPBOARD_FORMATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Platform neutral encoders and decoders of the clipboard formats used by
+// the backends. None of them allocate: encoders follow snprintf semantics
+// (they write at most `capacity` bytes and return the full encoded size, so
+// a first call with capacity 0 sizes the buffer) and decoders return views
+// into the input.
+namespace clipboard_formats {
+
+// ---- file URIs, text/uri-list and x-special/gnome-copied-files ----
+
+// Encodes an absolute POSIX path as a file:// URI. Returns 0 for relative
+// paths, which have no URI.
+size_t EncodeFileUri(std::string_view path, char *out, size_t capacity);
+
+// Decodes a file:// URI (empty or "localhost" host) into a path. `out`
+// must hold `uri.size()` bytes. Returns the path length, or 0 if `uri` is
+// not a local file URI.
+size_t DecodeFileUri(std::string_view uri, char *out);
+
+namespace internal {
+
+template<typename It>
+size_t EncodeUriLines(It first, It last, std::string_view separator, bool trailing,
+                      size_t written, char *out, size_t capacity) {
+    bool first_line = true;
+    for (; first != last; ++first) {
+        std::string_view path(first->data(), first->size());
+        if (path.empty() || path[0] != '/') {
+            continue;
+        }
+        if (!first_line && !trailing) {
+            if (written + separator.size() <= capacity) {
+                memcpy(out + written, separator.data(), separator.size());
+            }
+            written += separator.size();
+        }
+        size_t room = written < capacity ? capacity - written : 0;
+        written += EncodeFileUri(path, room ? out + written : nullptr, room);
+        if (trailing) {
+            if (written + separator.size() <= capacity) {
+                memcpy(out + written, separator.data(), separator.size());
+            }
+            written += separator.size();
+        }
+        first_line = false;
+    }
+    return written;
+}
+
+} // namespace internal
+
+// Encodes paths as a CRLF terminated text/uri-list, relative paths are
+// skipped. `It` iterates anything with `data()` and `size()`.
+template<typename It>
+size_t EncodeUriList(It first, It last, char *out, size_t capacity) {
+    return internal::EncodeUriLines(first, last, "\r\n", true, 0, out, capacity);
+}
+
+// Iterates the URIs of a text/uri-list, skipping comments and blank lines.
+class UriListReader {
+public:
+    explicit UriListReader(std::string_view data) : _data(data) {}
+
+    bool Next(std::string_view &uri);
+
+private:
+    std::string_view _data;
+    size_t _pos = 0;
+};
+
+enum class FileOperation {
+    Copy,
+    Cut,
+};
+
+// Encodes x-special/gnome-copied-files: the operation followed by one URI
+// per line, without a trailing newline.
+template<typename It>
+size_t EncodeGnomeCopiedFiles(FileOperation operation, It first, It last, char *out, size_t capacity) {
+    std::string_view header = operation == FileOperation::Cut ? "cut" : "copy";
+    size_t written = 0;
+    if (header.size() <= capacity) {
+        memcpy(out, header.data(), header.size());
+    }
+    written += header.size();
+    if (first == last) {
+        return written;
+    }
+    if (written + 1 <= capacity) {
+        out[written] = '\n';
+    }
+    written += 1;
+    return internal::EncodeUriLines(first, last, "\n", false, written, out, capacity);
+}
+
+class GnomeCopiedFilesReader {
+public:
+    explicit GnomeCopiedFilesReader(std::string_view data);
+
+    bool valid() const {
+        return _valid;
+    }
+
+    FileOperation operation() const {
+        return _operation;
+    }
+
+    bool Next(std::string_view &uri) {
+        return _valid && _uris.Next(uri);
+    }
+
+private:
+    bool _valid = false;
+    FileOperation _operation = FileOperation::Copy;
+    UriListReader _uris;
+};
+
+// ---- DROPFILES (CF_HDROP) ----
+
+// sizeof(DROPFILES): pFiles, pt.x, pt.y, fNC, fWide
+const size_t kDropFilesHeaderSize = 20;
+
+namespace internal {
+
+size_t WriteDropFilesHeader(bool wide, uint8_t *out, size_t capacity);
+
+template<typename It>
+size_t EncodeDropFiles(It first, It last, bool wide, uint8_t *out, size_t capacity) {
+    const size_t unit = wide ? 2 : 1;
+    size_t written = WriteDropFilesHeader(wide, out, capacity);
+    for (; first != last; ++first) {
+        static_assert(sizeof(*first->data()) <= 2, "paths must be 8 or 16 bit code units");
+        size_t bytes = first->size() * unit;
+        if (written + bytes + unit <= capacity) {
+            memcpy(out + written, first->data(), bytes);
+            memset(out + written + bytes, 0, unit);
+        }
+        written += bytes + unit;
+    }
+    if (written + unit <= capacity) {
+        memset(out + written, 0, unit);
+    }
+    return written + unit;
+}
+
+} // namespace internal
+
+// Encodes UTF-16 paths (`It` iterates strings of 16 bit code units).
+template<typename It>
+size_t EncodeDropFilesWide(It first, It last, uint8_t *out, size_t capacity) {
+    return internal::EncodeDropFiles(first, last, true, out, capacity);
+}
+
+// Encodes paths in the ANSI code page (`It` iterates byte strings).
+template<typename It>
+size_t EncodeDropFilesAnsi(It first, It last, uint8_t *out, size_t capacity) {
+    return internal::EncodeDropFiles(first, last, false, out, capacity);
+}
+
+class DropFilesReader {
+public:
+    DropFilesReader(const uint8_t *data, size_t size);
+
+    bool valid() const {
+        return _valid;
+    }
+
+    // Paths are UTF-16 if true, ANSI otherwise.
+    bool wide() const {
+        return _wide;
+    }
+
+    // `path` points at `length` code units of 2 (wide) or 1 byte each.
+    bool Next(const uint8_t *&path, size_t &length);
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _pos = 0;
+    bool _valid = false;
+    bool _wide = false;
+};
+
+// ---- CF_DIB and BMP ----
+
+enum class PixelFormat {
+    Rgba,
+    Bgra,
+};
+
+struct DibInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint16_t bits_per_pixel = 0; // 24 or 32
+    bool top_down = false;
+    size_t pixel_offset = 0; // from the start of the parsed data
+    size_t stride = 0;
+};
+
+const size_t kBitmapInfoHeaderSize = 40;
+const size_t kBitmapFileHeaderSize = 14;
+
+// Parses a BITMAPINFOHEADER (or a later version) as found in CF_DIB.
+// Supports uncompressed 24/32 bit and BI_BITFIELDS with BGRA masks.
+bool ParseDib(const uint8_t *data, size_t size, DibInfo &info);
+
+// Parses a BMP file, a BITMAPFILEHEADER followed by a DIB.
+bool ParseBmp(const uint8_t *data, size_t size, DibInfo &info);
+
+// Converts the pixels of a parsed DIB/BMP to top-down 32 bit `format`.
+// A 32 bit image whose alpha is zero everywhere is treated as opaque.
+bool DecodeDibPixels(const uint8_t *data, size_t size, const DibInfo &info,
+                     PixelFormat format, uint8_t *out, size_t out_stride);
+
+// Encodes top-down 32 bit pixels as a BITMAPINFOHEADER followed by 24 or
+// 32 bit rows, bottom-up unless `top_down` is set.
+size_t EncodeDib(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride, PixelFormat format,
+                 uint16_t bits_per_pixel, bool top_down, uint8_t *out, size_t capacity);
+
+// Same as `EncodeDib` prefixed by a BITMAPFILEHEADER.
+size_t EncodeBmp(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride, PixelFormat format,
+                 uint16_t bits_per_pixel, bool top_down, uint8_t *out, size_t capacity);
+
+} // namespace clipboard_formats
+
+#endif //ELECTRON_CLIPBOARD_EX_CLIPBOARD_FORMATS_H
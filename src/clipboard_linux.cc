@@ -1,62 +1,655 @@
 #include <gtk/gtk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib/gstdio.h>
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#endif
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <string_view>
 #include <algorithm>
+#include <cstring>
+#include "buffer_pool.h"
 #include "clipboard.h"
+#include "clipboard_formats.h"
+#include "html_text.h"
+#include "image_files.h"
+#include "image_ops.h"
+#include "jpeg_codec.h"
+#include "lazy_image_file.h"
+#include "memory_clipboard.h"
+#include "utf8.h"
+#include "wayland_data_control.h"
+#include "x11_selection_owner.h"
 
 namespace {
 
 bool EnsureGtkInitialized() {
-    static bool attempted = false;
-    static bool initialized = false;
-    if (!attempted) {
-        attempted = true;
-        // Try to initialize without exiting on failure
+    // Try to initialize without exiting on failure. In a host that set GTK
+    // up already (Electron), this returns its display connection. Workers
+    // may get here first, the static makes the others wait.
+    static const bool initialized = [] {
         int argc = 0;
         char **argv = nullptr;
-        initialized = gtk_init_check(&argc, &argv);
-    }
+        if (!gtk_init_check(&argc, &argv)) {
+            return false;
+        }
+#ifdef GDK_WINDOWING_X11
+        // Chains to the handler GDK just installed
+        if (GDK_IS_X11_DISPLAY(gdk_display_get_default())) {
+            x11_selection_owner::InstallErrorHandler();
+        }
+#endif
+        return true;
+    }();
     return initialized;
 }
 
-std::vector<std::string> splitLines(const std::string &data) {
-    std::vector<std::string> lines;
-    std::string current;
-    for (char ch : data) {
-        if (ch == '\r') {
-            continue;
+// Owner changes of PRIMARY arriving closer than this are folded into one
+// sequence bump, a drag-select would otherwise produce one per mouse move.
+const gint64 kPrimaryCoalesceUs = 100 * 1000;
+
+// Conversion timeouts adapt per owner and target. An owner gets twice its
+// recent slowest reply; one that let a request time out only gets a short
+// budget until it replies again, late replies included.
+const gint64 kDefaultTimeoutMs = 5000;
+const gint64 kUnresponsiveTimeoutMs = 500;
+const gint64 kMinTimeoutMs = 1000;
+const gint64 kMaxTimeoutMs = 30000;
+
+struct TargetTiming {
+    uint64_t requests = 0;
+    uint64_t replies = 0;
+    uint64_t timeouts = 0;
+    uint32_t consecutive_timeouts = 0;
+    double total_ms = 0;
+    double max_ms = 0;
+    double recent_max_ms = 0; // Decays so that one slow reply is forgotten
+};
+
+gint64 TimeoutMs(const TargetTiming &timing) {
+    if (timing.consecutive_timeouts > 0) {
+        return kUnresponsiveTimeoutMs;
+    }
+    if (timing.replies == 0) {
+        return kDefaultTimeoutMs;
+    }
+    return std::max(kMinTimeoutMs, std::min(kMaxTimeoutMs, static_cast<gint64>(timing.recent_max_ms * 2)));
+}
+
+struct OwnerRecord {
+    int64_t pid = 0;
+    std::string wm_class;
+    std::map<std::string, TargetTiming> targets;
+};
+
+// Requests are timed on every thread that reads, stats are taken on the JS
+// thread. Guards OwnerRecords() and every TargetTiming in it; records are
+// never erased, so pointers into the maps stay valid without it.
+std::mutex owner_records_mutex;
+
+// Keyed by class and pid, records outlive ownerships
+std::map<std::pair<std::string, int64_t>, OwnerRecord> &OwnerRecords() {
+    static std::map<std::pair<std::string, int64_t>, OwnerRecord> records;
+    return records;
+}
+
+// Counts a request of `target` from `owner`, returns its timing and the
+// timeout it gets
+TargetTiming *StartTiming(OwnerRecord *owner, const std::string &target, gint64 &timeout_ms) {
+    std::lock_guard<std::mutex> lock(owner_records_mutex);
+    TargetTiming *timing = &owner->targets[target];
+    ++timing->requests;
+    timeout_ms = TimeoutMs(*timing);
+    return timing;
+}
+
+// Timeout of `target` from `owner` for reads not timed here
+gint64 TargetTimeoutMs(OwnerRecord *owner, const std::string &target) {
+    std::lock_guard<std::mutex> lock(owner_records_mutex);
+    return TimeoutMs(owner->targets[target]);
+}
+
+void RecordTimeout(TargetTiming *timing) {
+    std::lock_guard<std::mutex> lock(owner_records_mutex);
+    ++timing->timeouts;
+    ++timing->consecutive_timeouts;
+}
+
+void RecordReply(TargetTiming *timing, double elapsed_ms) {
+    std::lock_guard<std::mutex> lock(owner_records_mutex);
+    ++timing->replies;
+    timing->consecutive_timeouts = 0;
+    timing->total_ms += elapsed_ms;
+    timing->max_ms = std::max(timing->max_ms, elapsed_ms);
+    timing->recent_max_ms = std::max(elapsed_ms, timing->recent_max_ms * 0.75);
+}
+
+struct SelectionState {
+    // Set once by GetSelectionState
+    GtkClipboard *clipboard = nullptr;
+    GdkAtom atom = GDK_NONE;
+    gint64 coalesce_us = 0;
+
+    // Owner changes are dispatched by whichever thread iterates the main
+    // context while reads run on the JS thread and on workers; the rest is
+    // guarded by `mutex`.
+    std::mutex mutex;
+    uint64_t sequence = 0;
+    uint64_t owner_changes = 0; // Every change, coalesced or not
+    gint64 last_change_us = 0;
+    bool pending_change = false;
+    // Cached TARGETS of the current owner, dropped on every owner change
+    std::vector<GdkAtom> targets;
+    bool targets_valid = false;
+    // Current owner, resolved on the first request after an owner change
+    OwnerRecord *owner = nullptr;
+    unsigned long owner_xid = 0;
+    bool self_owned = false; // Through GTK or x11_selection_owner
+    bool gtk_owned = false;
+};
+
+void OnOwnerChange(GtkClipboard *clipboard, GdkEvent *event, gpointer user_data) {
+    (void)clipboard;
+    SelectionState *state = static_cast<SelectionState *>(user_data);
+
+    unsigned long owner_xid = 0;
+    bool gtk_owned = false;
+    bool raw_owned = false;
+    GdkWindow *owner = event ? event->owner_change.owner : nullptr;
+    if (owner) {
+        // GDK hands back our own windows, other clients' are wrapped as
+        // foreign; so is the window of our private connection
+        gtk_owned = gdk_window_get_window_type(owner) != GDK_WINDOW_FOREIGN;
+#ifdef GDK_WINDOWING_X11
+        if (GDK_IS_X11_WINDOW(owner)) {
+            owner_xid = GDK_WINDOW_XID(owner);
+            raw_owned = owner_xid != None && owner_xid == x11_selection_owner::OwnerWindow();
         }
-        if (ch == '\n') {
-            if (!current.empty()) {
-                lines.emplace_back(current);
-                current.clear();
+#endif
+    }
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    ++state->owner_changes;
+    state->targets.clear();
+    state->targets_valid = false;
+    state->owner = nullptr;
+    state->owner_xid = owner_xid;
+    state->self_owned = gtk_owned || raw_owned;
+    state->gtk_owned = gtk_owned;
+
+    gint64 now = g_get_monotonic_time();
+    if (state->coalesce_us > 0 && now - state->last_change_us < state->coalesce_us) {
+        state->pending_change = true;
+        return;
+    }
+    state->last_change_us = now;
+    state->pending_change = false;
+    ++state->sequence;
+}
+
+// Dispatches of the default main context by this backend on this thread
+thread_local int own_dispatch_depth = 0;
+std::atomic<GThread *> host_loop_thread{nullptr};
+
+// Electron's main process runs JS from a dispatch of GLib's default main
+// context, which its message pump iterates for the life of the process.
+// Seen once from that thread, GTK traffic is left to the host's loop:
+// nothing here iterates the context again, which would run the host's
+// tasks and timers re-entrantly.
+bool HostDrivesMainContext() {
+    if (!host_loop_thread.load(std::memory_order_acquire) && own_dispatch_depth == 0 && g_main_depth() > 0 &&
+        g_main_context_is_owner(g_main_context_default())) {
+        host_loop_thread.store(g_thread_self(), std::memory_order_release);
+    }
+    return host_loop_thread.load(std::memory_order_acquire) != nullptr;
+}
+
+// Dispatch pending owner-change notifications without blocking
+void PumpPendingEvents() {
+    if (HostDrivesMainContext()) {
+        return; // The host's loop has dispatched them
+    }
+    ++own_dispatch_depth;
+    while (g_main_context_pending(nullptr)) {
+        g_main_context_iteration(nullptr, FALSE);
+    }
+    --own_dispatch_depth;
+}
+
+SelectionState *GetSelectionState(ClipboardSelection selection) {
+    static SelectionState states[3];
+    static std::mutex setup_mutex;
+    if (!EnsureGtkInitialized()) {
+        return nullptr;
+    }
+
+    size_t index = static_cast<size_t>(selection);
+    SelectionState *state = &states[index];
+    std::lock_guard<std::mutex> lock(setup_mutex);
+    if (!state->clipboard) {
+        static const GdkAtom atoms[] = {
+            GDK_SELECTION_CLIPBOARD,
+            GDK_SELECTION_PRIMARY,
+            GDK_SELECTION_SECONDARY,
+        };
+        state->clipboard = gtk_clipboard_get(atoms[index]);
+        if (!state->clipboard) {
+            return nullptr;
+        }
+        state->atom = atoms[index];
+        if (selection == ClipboardSelection::Primary) {
+            state->coalesce_us = kPrimaryCoalesceUs;
+        }
+        g_signal_connect(state->clipboard, "owner-change", G_CALLBACK(OnOwnerChange), state);
+    }
+    return state;
+}
+
+GtkClipboard *GetClipboard(ClipboardSelection selection) {
+    SelectionState *state = GetSelectionState(selection);
+    return state ? state->clipboard : nullptr;
+}
+
+#ifdef GDK_WINDOWING_X11
+unsigned long ReadWindowCardinal(GdkDisplay *display, Window window, const char *property, Atom type) {
+    Atom actual_type = None;
+    int format = 0;
+    unsigned long n_items = 0;
+    unsigned long bytes_after = 0;
+    unsigned char *data = nullptr;
+    unsigned long value = 0;
+    if (XGetWindowProperty(GDK_DISPLAY_XDISPLAY(display), window,
+                           gdk_x11_get_xatom_by_name_for_display(display, property), 0, 1, False, type,
+                           &actual_type, &format, &n_items, &bytes_after, &data) == Success && data) {
+        if (actual_type == type && format == 32 && n_items == 1) {
+            value = reinterpret_cast<unsigned long *>(data)[0]; // 32 bit items are stored as long
+        }
+        XFree(data);
+    }
+    return value;
+}
+#endif
+
+// Identifies the owner of `atom` by _NET_WM_PID and WM_CLASS, starting
+// from its window if known
+void ReadOwnerIdentity(GdkAtom atom, unsigned long owner_xid, int64_t &pid, std::string &wm_class) {
+#ifdef GDK_WINDOWING_X11
+    GdkDisplay *display = gdk_display_get_default();
+    if (!GDK_IS_X11_DISPLAY(display)) {
+        return;
+    }
+    Display *xdisplay = GDK_DISPLAY_XDISPLAY(display);
+    // The owner may be destroyed at any time
+    gdk_x11_display_error_trap_push(display);
+    Window window = owner_xid;
+    if (window == None) {
+        window = XGetSelectionOwner(xdisplay, gdk_x11_atom_to_xatom_for_display(display, atom));
+    }
+    // Toolkits own selections with hidden helper windows, the identity may
+    // only be set on their client leader
+    for (int attempt = 0; attempt < 2 && window != None; ++attempt) {
+        if (!pid) {
+            pid = static_cast<int64_t>(ReadWindowCardinal(display, window, "_NET_WM_PID", XA_CARDINAL));
+        }
+        if (wm_class.empty()) {
+            XClassHint hint = {nullptr, nullptr};
+            if (XGetClassHint(xdisplay, window, &hint)) {
+                wm_class = hint.res_class ? hint.res_class : "";
+                XFree(hint.res_name);
+                XFree(hint.res_class);
+            }
+        }
+        if (pid && !wm_class.empty()) {
+            break;
+        }
+        window = ReadWindowCardinal(display, window, "WM_CLIENT_LEADER", XA_WINDOW);
+    }
+    gdk_x11_display_error_trap_pop_ignored(display);
+#else
+    (void)atom;
+    (void)owner_xid;
+    (void)pid;
+    (void)wm_class;
+#endif
+}
+
+bool IsGtkOwned(SelectionState *state) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->gtk_owned;
+}
+
+// Looks the owner up once per ownership, our own changes need no round trip
+OwnerRecord *ResolveOwner(SelectionState *state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->owner) {
+        return state->owner;
+    }
+    uint64_t owner_changes = state->owner_changes;
+    bool self_owned = state->self_owned;
+    unsigned long owner_xid = state->owner_xid;
+    lock.unlock();
+
+    int64_t pid = 0;
+    std::string wm_class;
+    if (self_owned) {
+        pid = getpid();
+        const gchar *name = gdk_get_program_class();
+        wm_class = name ? name : "";
+    } else {
+        ReadOwnerIdentity(state->atom, owner_xid, pid, wm_class);
+    }
+    OwnerRecord *record;
+    {
+        std::lock_guard<std::mutex> records_lock(owner_records_mutex);
+        record = &OwnerRecords()[std::make_pair(wm_class, pid)];
+        record->pid = pid;
+        record->wm_class = wm_class;
+    }
+
+    lock.lock();
+    // Not cached if the owner changed while we looked
+    if (state->owner_changes == owner_changes) {
+        state->owner = record;
+    }
+    return record;
+}
+
+struct ContentsRequest {
+    SelectionState *state = nullptr;
+    GdkAtom target = GDK_NONE;
+    GMainLoop *loop = nullptr; // Only while we iterate the main context ourselves
+    guint host_timeout_id = 0; // Only while the host's loop answers for another thread
+    TargetTiming *timing = nullptr;
+    gint64 start_us = 0;
+    gint64 deadline_us = 0;
+    GtkSelectionData *data = nullptr;
+    // The reply may be dispatched by the host's thread while another waits
+    std::mutex mutex;
+    std::condition_variable replied;
+    bool done = false;
+    bool timed_out = false;
+    bool abandoned = false;
+};
+
+// Resolves the owner and counts the request against its timing, on the
+// thread that then starts it
+void BeginContentsRequest(ContentsRequest *request) {
+    gchar *target_name = gdk_atom_name(request->target);
+    gint64 timeout_ms = 0;
+    request->timing = StartTiming(ResolveOwner(request->state), target_name, timeout_ms);
+    g_free(target_name);
+    request->start_us = g_get_monotonic_time();
+    request->deadline_us = request->start_us + timeout_ms * 1000;
+}
+
+void FreeContentsRequest(ContentsRequest *request) {
+    if (request->loop) {
+        g_main_loop_unref(request->loop);
+    }
+    delete request;
+}
+
+void OnContentsReceived(GtkClipboard *clipboard, GtkSelectionData *selection_data, gpointer user_data) {
+    (void)clipboard;
+    ContentsRequest *request = static_cast<ContentsRequest *>(user_data);
+    double elapsed_ms = static_cast<double>(g_get_monotonic_time() - request->start_us) / 1000.0;
+    // GTK gives up on owners that never reply after its own 30 s
+    if (elapsed_ms < kMaxTimeoutMs) {
+        RecordReply(request->timing, elapsed_ms);
+    }
+    if (request->host_timeout_id) {
+        g_source_remove(request->host_timeout_id);
+        request->host_timeout_id = 0;
+    }
+    std::unique_lock<std::mutex> lock(request->mutex);
+    if (request->abandoned) {
+        lock.unlock();
+        FreeContentsRequest(request);
+        return;
+    }
+    if (selection_data && gtk_selection_data_get_length(selection_data) >= 0) {
+        request->data = gtk_selection_data_copy(selection_data);
+    }
+    request->done = true;
+    request->replied.notify_one();
+    if (request->loop) {
+        g_main_loop_quit(request->loop);
+    }
+}
+
+gboolean OnContentsTimeout(gpointer user_data) {
+    ContentsRequest *request = static_cast<ContentsRequest *>(user_data);
+    request->timed_out = true;
+    g_main_loop_quit(request->loop);
+    return G_SOURCE_REMOVE;
+}
+
+// Without a host loop: a nested loop on the default main context, as
+// gtk_clipboard_wait_for_contents does.
+void WaitInOwnLoop(ContentsRequest *request) {
+    request->loop = g_main_loop_new(nullptr, TRUE);
+    auto timeout_ms = static_cast<guint>((request->deadline_us - request->start_us) / 1000);
+    guint timeout_id = g_timeout_add(timeout_ms, OnContentsTimeout, request);
+    gtk_clipboard_request_contents(request->state->clipboard, request->target, OnContentsReceived, request);
+    // Requests to ourselves are answered synchronously
+    if (g_main_loop_is_running(request->loop)) {
+        ++own_dispatch_depth;
+        g_main_loop_run(request->loop);
+        --own_dispatch_depth;
+    }
+    if (!request->timed_out) {
+        g_source_remove(timeout_id);
+    }
+}
+
+#ifdef GDK_WINDOWING_X11
+bool IsSelectionEvent(const GdkEvent *event) {
+    switch (event->type) {
+        case GDK_SELECTION_CLEAR:
+        case GDK_SELECTION_REQUEST:
+        case GDK_SELECTION_NOTIFY:
+        case GDK_PROPERTY_NOTIFY: // INCR chunks
+        case GDK_OWNER_CHANGE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// On the host's thread, called from its dispatch: only GDK's selection
+// traffic is handled until the reply arrives. The host's sources do not run
+// re-entrantly, other GDK events are put back for its loop.
+void WaitOnHostThread(ContentsRequest *request, GdkDisplay *display) {
+    gtk_clipboard_request_contents(request->state->clipboard, request->target, OnContentsReceived, request);
+    Display *xdisplay = GDK_DISPLAY_XDISPLAY(display);
+    std::vector<GdkEvent *> deferred;
+    // The reply is dispatched on this thread, `done` needs no lock here
+    while (!request->done) {
+        if (GdkEvent *event = gdk_display_get_event(display)) {
+            if (IsSelectionEvent(event)) {
+                gtk_main_do_event(event);
+                gdk_event_free(event);
             } else {
-                lines.emplace_back("");
+                deferred.push_back(event);
             }
+            continue;
+        }
+        gint64 now = g_get_monotonic_time();
+        if (now >= request->deadline_us) {
+            break;
+        }
+        gdk_display_flush(display);
+        pollfd fd = {ConnectionNumber(xdisplay), POLLIN, 0};
+        poll(&fd, 1, static_cast<int>((request->deadline_us - now + 999) / 1000));
+    }
+    for (GdkEvent *event : deferred) {
+        gdk_display_put_event(display, event);
+        gdk_event_free(event);
+    }
+}
+#endif
+
+gboolean OnHostContentsTimeout(gpointer user_data) {
+    ContentsRequest *request = static_cast<ContentsRequest *>(user_data);
+    request->host_timeout_id = 0;
+    RecordTimeout(request->timing);
+    std::lock_guard<std::mutex> lock(request->mutex);
+    request->timed_out = true;
+    request->replied.notify_one();
+    return G_SOURCE_REMOVE;
+}
+
+// Runs on the host's thread: owner lookup, timing, the request and its
+// deadline all happen there
+gboolean StartContentsRequest(gpointer user_data) {
+    ContentsRequest *request = static_cast<ContentsRequest *>(user_data);
+    BeginContentsRequest(request);
+    auto timeout_ms = static_cast<guint>((request->deadline_us - request->start_us) / 1000);
+    request->host_timeout_id = g_timeout_add(timeout_ms, OnHostContentsTimeout, request);
+    gtk_clipboard_request_contents(request->state->clipboard, request->target, OnContentsReceived, request);
+    return G_SOURCE_REMOVE;
+}
+
+// Off the host's thread (async operations): the request is started and
+// answered by the host's own loop, this thread only waits for its reply or
+// deadline. A host that stops iterating is given GTK's own 30 s.
+void WaitThroughHostContext(ContentsRequest *request) {
+    g_main_context_invoke(nullptr, StartContentsRequest, request);
+    std::unique_lock<std::mutex> lock(request->mutex);
+    request->replied.wait_for(lock, std::chrono::milliseconds(kMaxTimeoutMs),
+                              [request] { return request->done || request->timed_out; });
+}
+
+// gtk_clipboard_wait_for_contents with a timeout learnt from the owner's
+// previous replies. Returns nullptr if the target could not be converted.
+GtkSelectionData *WaitForContents(SelectionState *state, GdkAtom target) {
+    ContentsRequest *request = new ContentsRequest();
+    request->state = state;
+    request->target = target;
+    bool through_host = HostDrivesMainContext() && !g_main_context_is_owner(g_main_context_default());
+    if (through_host) {
+        WaitThroughHostContext(request);
+    } else {
+        BeginContentsRequest(request);
+        if (!HostDrivesMainContext()) {
+            WaitInOwnLoop(request);
         } else {
-            current.push_back(ch);
+#ifdef GDK_WINDOWING_X11
+            GdkDisplay *display = gdk_display_get_default();
+            if (GDK_IS_X11_DISPLAY(display)) {
+                WaitOnHostThread(request, display);
+            } else {
+                WaitInOwnLoop(request);
+            }
+#else
+            WaitInOwnLoop(request);
+#endif
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(request->mutex);
+    if (!request->done) {
+        // The reply may still arrive, the callback then frees the request.
+        // The host's loop recorded its own timeout.
+        if (!through_host) {
+            RecordTimeout(request->timing);
         }
+        request->abandoned = true;
+        return nullptr;
+    }
+    lock.unlock();
+    GtkSelectionData *data = request->data;
+    FreeContentsRequest(request);
+    return data;
+}
+
+// Copies the owner's TARGETS, fetched once per ownership. A reply that
+// raced with an owner change is returned but not cached.
+bool GetTargets(SelectionState *state, std::vector<GdkAtom> &targets) {
+    PumpPendingEvents();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->targets_valid) {
+        targets = state->targets;
+        return !targets.empty();
+    }
+    uint64_t owner_changes = state->owner_changes;
+    lock.unlock();
+
+    targets.clear();
+    GtkSelectionData *sel = WaitForContents(state, gdk_atom_intern_static_string("TARGETS"));
+    GdkAtom *atoms = nullptr;
+    gint n_atoms = 0;
+    if (sel && gtk_selection_data_get_targets(sel, &atoms, &n_atoms)) {
+        targets.assign(atoms, atoms + n_atoms);
+        g_free(atoms);
     }
-    if (!current.empty()) {
-        lines.emplace_back(current);
+    if (sel) {
+        gtk_selection_data_free(sel);
+    }
+
+    lock.lock();
+    if (state->owner_changes == owner_changes) {
+        state->targets = targets;
+        state->targets_valid = true;
     }
-    return lines;
+    return !targets.empty();
+}
+
+bool HasTarget(SelectionState *state, GdkAtom target) {
+    std::vector<GdkAtom> targets;
+    return GetTargets(state, targets) && std::find(targets.begin(), targets.end(), target) != targets.end();
+}
+
+// CRLF terminated text/uri-list, relative paths are skipped. `Paths` is a
+// std::vector<std::string> or a PathList.
+template<typename Paths>
+std::string BuildUriList(const Paths &file_paths) {
+    std::string uri_list(clipboard_formats::EncodeUriList(file_paths.begin(), file_paths.end(), nullptr, 0), '\0');
+    clipboard_formats::EncodeUriList(file_paths.begin(), file_paths.end(), &uri_list[0], uri_list.size());
+    return uri_list;
+}
+
+template<typename Paths>
+std::string BuildGnomeCopiedFiles(const Paths &file_paths) {
+    using clipboard_formats::FileOperation;
+    std::string copied_files(clipboard_formats::EncodeGnomeCopiedFiles(
+            FileOperation::Copy, file_paths.begin(), file_paths.end(), nullptr, 0), '\0');
+    clipboard_formats::EncodeGnomeCopiedFiles(FileOperation::Copy, file_paths.begin(), file_paths.end(),
+                                              &copied_files[0], copied_files.size());
+    return copied_files;
 }
 
-std::string joinWithCrlf(const std::vector<std::string> &items) {
-    std::ostringstream oss;
-    for (size_t i = 0; i < items.size(); ++i) {
-        oss << items[i];
-        oss << "\r\n";
+// Plain text fallback: one path per line
+template<typename Paths>
+std::string JoinLines(const Paths &file_paths) {
+    std::ostringstream plain;
+    bool first = true;
+    for (const std::string &path : file_paths) {
+        if (!first) {
+            plain << '\n';
+        }
+        plain << path;
+        first = false;
     }
-    return oss.str();
+    return plain.str();
 }
 
 // Clipboard data for text/uri-list via gtk_clipboard_set_with_data
 struct UriListData {
     std::string uri_list; // CRLF terminated text/uri-list
+    std::string copied_files; // x-special/gnome-copied-files
     std::string plain_text; // Plain text fallback
 };
 
@@ -73,6 +666,12 @@ void clipboard_get_func(GtkClipboard *clipboard, GtkSelectionData *selection_dat
         gtk_selection_data_set(selection_data, target, 8,
                                reinterpret_cast<const guchar *>(data.data()),
                                static_cast<int>(data.size()));
+    } else if (info == 2) { // x-special/gnome-copied-files
+        const std::string &data = payload->copied_files;
+        GdkAtom target = gdk_atom_intern_static_string("x-special/gnome-copied-files");
+        gtk_selection_data_set(selection_data, target, 8,
+                               reinterpret_cast<const guchar *>(data.data()),
+                               static_cast<int>(data.size()));
     } else {
         const std::string &text = payload->plain_text;
         GdkAtom target = gdk_atom_intern_static_string("UTF8_STRING");
@@ -88,173 +687,1042 @@ void clipboard_clear_func(GtkClipboard *clipboard, gpointer user_data) {
     delete payload;
 }
 
-} // namespace
+// Clipboard data for text targets, `bytes` is UTF-8 allocated with g_malloc
+struct TextData {
+    gchar *bytes;
+    gsize size;
+};
+
+void text_get_func(GtkClipboard *clipboard, GtkSelectionData *selection_data, guint info, gpointer user_data) {
+    (void)clipboard;
+    (void)info;
+    TextData *payload = static_cast<TextData *>(user_data);
+    if (!payload) {
+        return;
+    }
+    // Converts to Latin-1 for STRING and to compound text where requested
+    gtk_selection_data_set_text(selection_data, payload->bytes, static_cast<gint>(payload->size));
+}
+
+void text_clear_func(GtkClipboard *clipboard, gpointer user_data) {
+    (void)clipboard;
+    TextData *payload = static_cast<TextData *>(user_data);
+    if (payload) {
+        g_free(payload->bytes);
+        delete payload;
+    }
+}
+
+// Clipboard data for writeRich, the plain text is derived on first request
+struct RichData {
+    RichContent content;
+    bool text_derived = false;
+};
+
+enum RichTargetInfo : guint {
+    kRichHtml,
+    kRichRtf,
+    kRichText,
+};
+
+void rich_get_func(GtkClipboard *clipboard, GtkSelectionData *selection_data, guint info, gpointer user_data) {
+    (void)clipboard;
+    RichData *payload = static_cast<RichData *>(user_data);
+    if (!payload) {
+        return;
+    }
+
+    RichContent &content = payload->content;
+    GdkAtom target = gtk_selection_data_get_target(selection_data);
+    if (info == kRichHtml || info == kRichRtf) {
+        const std::string &data = info == kRichHtml ? content.html : content.rtf;
+        gtk_selection_data_set(selection_data, target, 8,
+                               reinterpret_cast<const guchar *>(data.data()),
+                               static_cast<int>(data.size()));
+        return;
+    }
+
+    if (content.text.empty() && !payload->text_derived) {
+        content.text = HtmlToText(content.html.data(), content.html.size());
+        payload->text_derived = true;
+    }
+    gtk_selection_data_set_text(selection_data, content.text.data(), static_cast<gint>(content.text.size()));
+}
+
+void rich_clear_func(GtkClipboard *clipboard, gpointer user_data) {
+    (void)clipboard;
+    delete static_cast<RichData *>(user_data);
+}
+
+// MIME type of encoded image bytes, nullptr if unknown
+const char *SniffImageMimeType(const char *bytes, size_t size) {
+    static const struct {
+        const char *magic;
+        size_t size;
+        const char *mime_type;
+    } kSignatures[] = {
+        {"\x89PNG\r\n\x1a\n", 8, "image/png"},
+        {"\xff\xd8\xff", 3, "image/jpeg"},
+        {"GIF8", 4, "image/gif"},
+        {"BM", 2, "image/bmp"},
+    };
+    for (const auto &signature : kSignatures) {
+        if (size >= signature.size && memcmp(bytes, signature.magic, signature.size) == 0) {
+            return signature.mime_type;
+        }
+    }
+    return nullptr;
+}
+
+// Feeding the loader in chunks lets a cancelled decode stop early
+const size_t kDecodeChunkSize = 256 * 1024;
+
+struct DecodeProgress {
+    ProgressSink *progress = nullptr;
+    gint height = 0;
+    gint rows = 0;
+    bool cancelled = false;
+};
+
+void OnLoaderSizePrepared(GdkPixbufLoader *loader, gint width, gint height, gpointer user_data) {
+    (void)loader;
+    (void)width;
+    static_cast<DecodeProgress *>(user_data)->height = height;
+}
+
+void OnLoaderAreaUpdated(GdkPixbufLoader *loader, gint x, gint y, gint width, gint height, gpointer user_data) {
+    (void)loader;
+    (void)x;
+    (void)width;
+    DecodeProgress *decode = static_cast<DecodeProgress *>(user_data);
+    decode->rows = std::max(decode->rows, y + height);
+    if (!ReportProgress(decode->progress, ProgressPhase::Decode, static_cast<uint64_t>(decode->rows),
+                        static_cast<uint64_t>(decode->height))) {
+        decode->cancelled = true;
+    }
+}
+
+GdkPixbuf *DecodePixbuf(const char *bytes, size_t size, ProgressSink *progress = nullptr) {
+    GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+    GdkPixbuf *pixbuf = nullptr;
+    DecodeProgress decode;
+    decode.progress = progress;
+    bool written = true;
+    if (progress) {
+        g_signal_connect(loader, "size-prepared", G_CALLBACK(OnLoaderSizePrepared), &decode);
+        g_signal_connect(loader, "area-updated", G_CALLBACK(OnLoaderAreaUpdated), &decode);
+        for (size_t offset = 0; written && offset < size; offset += kDecodeChunkSize) {
+            size_t chunk = std::min(kDecodeChunkSize, size - offset);
+            written = gdk_pixbuf_loader_write(loader, reinterpret_cast<const guchar *>(bytes + offset), chunk,
+                                              nullptr) && !decode.cancelled;
+        }
+    } else {
+        written = gdk_pixbuf_loader_write(loader, reinterpret_cast<const guchar *>(bytes), size, nullptr);
+    }
+    if (written && gdk_pixbuf_loader_close(loader, nullptr) && !decode.cancelled) {
+        pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+        if (pixbuf) {
+            g_object_ref(pixbuf);
+        }
+    } else {
+        gdk_pixbuf_loader_close(loader, nullptr);
+    }
+    g_object_unref(loader);
+    return pixbuf;
+}
+
+// Clipboard data for writeMulti. Every flavor is produced on first request:
+// the uri-list is built, the image file read and, only for a format other
+// than the source one, decoded. An in-memory image offered as a file is
+// written when the uri-list is first asked for.
+struct MultiData {
+    MultiContent content;
+    std::shared_ptr<LazyImageFile> image_file;
+    std::string uri_list;
+    bool uri_list_built = false;
+    bool image_loaded = false;
+    GdkPixbuf *pixbuf = nullptr;
+};
+
+bool OffersImageFile(const MultiContent &content) {
+    return content.file_paths.empty() && content.image_path.empty() && !content.image_data.empty() &&
+           !content.image_file_name.empty();
+}
+
+enum MultiTargetInfo : guint {
+    kMultiUriList,
+    kMultiImage,
+    kMultiText,
+};
+
+void multi_get_func(GtkClipboard *clipboard, GtkSelectionData *selection_data, guint info, gpointer user_data) {
+    (void)clipboard;
+    MultiData *payload = static_cast<MultiData *>(user_data);
+    if (!payload) {
+        return;
+    }
+
+    MultiContent &content = payload->content;
+    GdkAtom target = gtk_selection_data_get_target(selection_data);
+    if (info == kMultiUriList) {
+        if (!payload->uri_list_built) {
+            if (payload->image_file) {
+                // GTK wants the reply before returning, the requestor is
+                // waiting for the file anyway
+                std::string path = payload->image_file->Path();
+                if (!path.empty()) {
+                    payload->uri_list = BuildUriList(std::vector<std::string>{path});
+                }
+            } else {
+                payload->uri_list = BuildUriList(content.file_paths);
+            }
+            payload->uri_list_built = true;
+        }
+        gtk_selection_data_set(selection_data, target, 8,
+                               reinterpret_cast<const guchar *>(payload->uri_list.data()),
+                               static_cast<int>(payload->uri_list.size()));
+        return;
+    }
+
+    if (info == kMultiImage) {
+        if (!payload->image_loaded) {
+            payload->image_loaded = true;
+            if (!content.image_path.empty()) {
+                gchar *bytes = nullptr;
+                gsize length = 0;
+                if (g_file_get_contents(content.image_path.c_str(), &bytes, &length, nullptr)) {
+                    content.image_data.assign(bytes, length);
+                    g_free(bytes);
+                }
+            }
+        }
+
+        // Pass the source bytes through when the requested format matches
+        const char *source_type = SniffImageMimeType(content.image_data.data(), content.image_data.size());
+        gchar *target_name = gdk_atom_name(target);
+        bool same_format = source_type && g_strcmp0(target_name, source_type) == 0;
+        g_free(target_name);
+        if (same_format) {
+            gtk_selection_data_set(selection_data, target, 8,
+                                   reinterpret_cast<const guchar *>(content.image_data.data()),
+                                   static_cast<int>(content.image_data.size()));
+            return;
+        }
+
+        if (!payload->pixbuf && !content.image_data.empty()) {
+            payload->pixbuf = DecodePixbuf(content.image_data.data(), content.image_data.size());
+        }
+        if (payload->pixbuf) {
+            gtk_selection_data_set_pixbuf(selection_data, payload->pixbuf);
+        }
+        return;
+    }
+
+    if (content.text.empty()) {
+        content.text = content.file_paths.empty() ? content.image_path : JoinLines(content.file_paths);
+    }
+    gtk_selection_data_set_text(selection_data, content.text.data(), static_cast<gint>(content.text.size()));
+}
+
+void multi_clear_func(GtkClipboard *clipboard, gpointer user_data) {
+    (void)clipboard;
+    MultiData *payload = static_cast<MultiData *>(user_data);
+    if (payload) {
+        if (payload->pixbuf) {
+            g_object_unref(payload->pixbuf);
+        }
+        delete payload;
+    }
+}
+
+// Compositors with a data-control protocol are talked to directly, GTK's
+// Wayland clipboard only works while one of our surfaces has keyboard focus
+bool UseDataControl(ClipboardSelection selection) {
+    return wayland_data_control::IsAvailable(selection);
+}
+
+// File lists, images and multi-flavor content can be large, on X11 they are
+// served from a private connection with per-requestor INCR transfers
+// instead of GTK's main loop; see x11_selection_owner.h. Like
+// gtk_clipboard_store it hands CLIPBOARD to the clipboard manager.
+bool UseRawOwner(ClipboardSelection selection) {
+    (void)selection;
+#ifdef GDK_WINDOWING_X11
+    return EnsureGtkInitialized() && GDK_IS_X11_DISPLAY(gdk_display_get_default());
+#else
+    return false;
+#endif
+}
+
+// Without a display or a data-control compositor every call would fail, the
+// in-memory clipboard keeps copy and paste within the process working
+bool UseMemoryBackend() {
+    if (memory_clipboard::IsActive()) {
+        return true;
+    }
+    if (UseDataControl(ClipboardSelection::Clipboard) || EnsureGtkInitialized()) {
+        return false;
+    }
+    memory_clipboard::SetActive(true);
+    return true;
+}
+
+// Reads `target` as a string, empty if the owner does not offer it
+std::string WaitForString(ClipboardSelection selection, SelectionState *state, const char *target) {
+    std::string result;
+    if (UseDataControl(selection)) {
+        ClipboardData data;
+        if (wayland_data_control::Read(selection, target, data)) {
+            result.assign(data.data(), data.size());
+        }
+        return result;
+    }
+    GdkAtom target_atom = gdk_atom_intern(target, FALSE);
+    if (!HasTarget(state, target_atom)) {
+        return result;
+    }
+    GtkSelectionData *sel = WaitForContents(state, target_atom);
+    if (!sel) {
+        return result;
+    }
+    const guchar *data_ptr = gtk_selection_data_get_data(sel);
+    gint length = gtk_selection_data_get_length(sel);
+    if (data_ptr && length > 0) {
+        result.assign(reinterpret_cast<const char *>(data_ptr), static_cast<size_t>(length));
+    }
+    gtk_selection_data_free(sel);
+    return result;
+}
+
+void FreeSelectionData(void *hint) {
+    gtk_selection_data_free(static_cast<GtkSelectionData *>(hint));
+}
+
+// Calls `add` with each UTF-8 path
+template<typename Add>
+void DecodeFilePaths(std::string_view data, bool uri_list, Add add) {
+    std::string_view uri;
+    std::string path;
+    auto append_path = [&add, &path](std::string_view file_uri) {
+        path.resize(file_uri.size());
+        size_t path_length = clipboard_formats::DecodeFileUri(file_uri, &path[0]);
+        if (path_length) {
+            add(std::string_view(path.data(), path_length));
+        }
+    };
+    if (uri_list) {
+        clipboard_formats::UriListReader reader(data);
+        while (reader.Next(uri)) {
+            append_path(uri);
+        }
+    } else {
+        clipboard_formats::GnomeCopiedFilesReader reader(data);
+        while (reader.Next(uri)) {
+            append_path(uri);
+        }
+    }
+}
+
+// Copies Latin-1 bytes into a g_malloc'ed UTF-8 string
+ClipboardData Latin1ToClipboardData(const char *data, size_t size) {
+    size_t utf8_length = Latin1ToUtf8Length(data, size);
+    gchar *utf8 = static_cast<gchar *>(g_malloc(utf8_length + 1));
+    Latin1ToUtf8(data, size, utf8);
+    utf8[utf8_length] = '\0';
+    return ClipboardData(utf8, utf8_length, g_free, utf8);
+}
+
+bool ReadTextDataControl(ClipboardData &text, ClipboardSelection selection) {
+    for (const char *mime_type : {"text/plain;charset=utf-8", "UTF8_STRING"}) {
+        ClipboardData data;
+        if (wayland_data_control::HasMimeType(selection, mime_type) &&
+            wayland_data_control::Read(selection, mime_type, data) && IsValidUtf8(data.data(), data.size())) {
+            text = std::move(data);
+            return true;
+        }
+    }
+    ClipboardData latin1;
+    if (!wayland_data_control::HasMimeType(selection, "STRING") ||
+        !wayland_data_control::Read(selection, "STRING", latin1)) {
+        return false;
+    }
+    text = Latin1ToClipboardData(latin1.data(), latin1.size());
+    return true;
+}
+
+// PNG if offered, otherwise the first image type, empty if none
+std::string DataControlImageType(ClipboardSelection selection) {
+    std::vector<std::string> mime_types = wayland_data_control::GetMimeTypes(selection);
+    auto it = std::find(mime_types.begin(), mime_types.end(), "image/png");
+    if (it == mime_types.end()) {
+        it = std::find_if(mime_types.begin(), mime_types.end(), [](const std::string &mime_type) {
+            return mime_type.compare(0, 6, "image/") == 0;
+        });
+    }
+    return it == mime_types.end() ? std::string() : *it;
+}
+
+GdkPixbuf *WaitForImage(ClipboardSelection selection, ProgressSink *progress) {
+    if (!UseDataControl(selection)) {
+        SelectionState *state = GetSelectionState(selection);
+        std::vector<GdkAtom> targets;
+        if (!state || !GetTargets(state, targets)) {
+            return nullptr;
+        }
+        GdkAtom png_target = gdk_atom_intern_static_string("image/png");
+        GdkAtom image_target = GDK_NONE;
+        for (GdkAtom &target : targets) {
+            if (target == png_target) {
+                image_target = png_target;
+                break;
+            }
+            if (image_target == GDK_NONE && gtk_targets_include_image(&target, 1, FALSE)) {
+                image_target = target;
+            }
+        }
+        // GTK reassembles INCR transfers internally, only their end is seen
+        if (image_target == GDK_NONE || !ReportProgress(progress, ProgressPhase::Transfer, 0, 0)) {
+            return nullptr;
+        }
+        GtkSelectionData *sel = WaitForContents(state, image_target);
+        if (!sel) {
+            return nullptr;
+        }
+        const guchar *data_ptr = gtk_selection_data_get_data(sel);
+        gint length = gtk_selection_data_get_length(sel);
+        GdkPixbuf *pixbuf = nullptr;
+        if (length > 0 && ReportProgress(progress, ProgressPhase::Transfer, static_cast<uint64_t>(length),
+                                         static_cast<uint64_t>(length))) {
+            pixbuf = DecodePixbuf(reinterpret_cast<const char *>(data_ptr), static_cast<size_t>(length), progress);
+        }
+        gtk_selection_data_free(sel);
+        return pixbuf;
+    }
+    std::string mime_type = DataControlImageType(selection);
+    ClipboardData data;
+    if (mime_type.empty() || !wayland_data_control::Read(selection, mime_type, data, progress)) {
+        return nullptr;
+    }
+    return DecodePixbuf(data.data(), data.size(), progress);
+}
+
+struct EncodeSink {
+    PooledBuffer buffer;
+    size_t size = 0;
+    ProgressSink *progress = nullptr;
+};
+
+gboolean AppendEncoded(const gchar *data, gsize count, GError **error, gpointer user_data) {
+    EncodeSink *sink = static_cast<EncodeSink *>(user_data);
+    if (sink->size + count > sink->buffer.capacity() &&
+        !sink->buffer.Grow(std::max(sink->size + count, sink->buffer.capacity() * 2), sink->size)) {
+        g_set_error_literal(error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "Out of memory");
+        return FALSE;
+    }
+    memcpy(sink->buffer.data() + sink->size, data, count);
+    sink->size += count;
+    // Encoders write as they go, failing here aborts them
+    if (!ReportProgress(sink->progress, ProgressPhase::Encode, sink->size, 0)) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Cancelled");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+bool WriteEncoded(const PooledBuffer &buffer, size_t size, const std::string &target_path, ProgressSink *progress) {
+    FILE *file = g_fopen(target_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(buffer.data(), 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    return ok && ReportProgress(progress, ProgressPhase::Encode, size, size);
+}
+
+// Encodes into a pooled buffer and writes the file at once, a guess of a
+// quarter of the pixel data only costs a Grow when wrong
+bool SavePixbuf(GdkPixbuf *pixbuf, const std::string &target_path, const char *type,
+                char **option_keys, char **option_values, ProgressSink *progress) {
+    EncodeSink sink;
+    sink.progress = progress;
+    size_t pixel_bytes = static_cast<size_t>(gdk_pixbuf_get_rowstride(pixbuf)) *
+                         static_cast<size_t>(gdk_pixbuf_get_height(pixbuf));
+    sink.buffer = PooledBuffer(pixel_bytes / 4);
+    return sink.buffer.data() &&
+           gdk_pixbuf_save_to_callbackv(pixbuf, AppendEncoded, &sink, type, option_keys, option_values, nullptr) &&
+           WriteEncoded(sink.buffer, sink.size, target_path, progress);
+}
+
+// Copies 8 bit RGB(A) pixels into straight alpha RGBA rows
+bool PixbufToPixels(GdkPixbuf *pixbuf, ImagePixels &image) {
+    if (gdk_pixbuf_get_colorspace(pixbuf) != GDK_COLORSPACE_RGB || gdk_pixbuf_get_bits_per_sample(pixbuf) != 8) {
+        return false;
+    }
+    int width = gdk_pixbuf_get_width(pixbuf);
+    int height = gdk_pixbuf_get_height(pixbuf);
+    int channels = gdk_pixbuf_get_n_channels(pixbuf);
+    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    const guchar *src = gdk_pixbuf_read_pixels(pixbuf);
+    image.width = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    image.stride = image.width * 4;
+    image.pixels = PooledBuffer(image.stride * image.height);
+    if (!image.pixels.data()) {
+        return false;
+    }
+    for (int y = 0; y < height; ++y) {
+        const guchar *in = src + static_cast<size_t>(y) * rowstride;
+        auto *out = reinterpret_cast<guchar *>(image.pixels.data() + y * image.stride);
+        if (channels == 4) {
+            memcpy(out, in, image.stride);
+            continue;
+        }
+        for (int x = 0; x < width; ++x, in += channels, out += 4) {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+            out[3] = 0xff;
+        }
+    }
+    return true;
+}
+
+// Converts 8 bit RGB(A) rows straight into the BGRA rows of `destination`
+bool PixbufToBgra(GdkPixbuf *pixbuf, const PixelDestination &destination, bool premultiplied) {
+    if (gdk_pixbuf_get_colorspace(pixbuf) != GDK_COLORSPACE_RGB || gdk_pixbuf_get_bits_per_sample(pixbuf) != 8) {
+        return false;
+    }
+    auto width = static_cast<uint32_t>(gdk_pixbuf_get_width(pixbuf));
+    auto height = static_cast<uint32_t>(gdk_pixbuf_get_height(pixbuf));
+    int channels = gdk_pixbuf_get_n_channels(pixbuf);
+    size_t rowstride = static_cast<size_t>(gdk_pixbuf_get_rowstride(pixbuf));
+    const guchar *src = gdk_pixbuf_read_pixels(pixbuf);
+    char *out = destination(width, height);
+    if (!out) {
+        return false;
+    }
+    size_t stride = static_cast<size_t>(width) * 4;
+    for (uint32_t y = 0; y < height; ++y) {
+        RowToBgra(src + y * rowstride, channels, width, premultiplied, reinterpret_cast<uint8_t *>(out + y * stride));
+    }
+    return true;
+}
+
+// Asks the loader for a smaller image, the JPEG loader then decodes at 1/2,
+// 1/4 or 1/8 scale through libjpeg's DCT scaling and resamples the rest
+void OnLoaderFitSize(GdkPixbufLoader *loader, gint width, gint height, gpointer user_data) {
+    uint32_t max_size = GPOINTER_TO_UINT(user_data);
+    gint longest = std::max(width, height);
+    if (max_size == 0 || longest <= 0 || static_cast<uint32_t>(longest) <= max_size) {
+        return;
+    }
+    gint fit_width = std::max(1, static_cast<gint>((static_cast<int64_t>(width) * max_size + longest / 2) / longest));
+    gint fit_height = std::max(1, static_cast<gint>((static_cast<int64_t>(height) * max_size + longest / 2) / longest));
+    gdk_pixbuf_loader_set_size(loader, fit_width, fit_height);
+}
+
+bool SavePixbufAs(GdkPixbuf *pixbuf, const std::string &target_path, ImageFormat format, float quality,
+                  ProgressSink *progress) {
+    if (format == ImageFormat::Png) {
+        return SavePixbuf(pixbuf, target_path, "png", nullptr, nullptr, progress);
+    }
+    // gdk-pixbuf looks its JPEG module up and sets a compressor up for each
+    // save, libjpeg's per thread one is reused
+    if (gdk_pixbuf_get_colorspace(pixbuf) == GDK_COLORSPACE_RGB && gdk_pixbuf_get_bits_per_sample(pixbuf) == 8) {
+        PooledBuffer out;
+        size_t out_size = 0;
+        return CompressJpeg(gdk_pixbuf_read_pixels(pixbuf), static_cast<uint32_t>(gdk_pixbuf_get_width(pixbuf)),
+                            static_cast<uint32_t>(gdk_pixbuf_get_height(pixbuf)),
+                            static_cast<size_t>(gdk_pixbuf_get_rowstride(pixbuf)), gdk_pixbuf_get_n_channels(pixbuf),
+                            quality, out, out_size, progress) &&
+               WriteEncoded(out, out_size, target_path, progress);
+    }
+    int percent = std::max(0, std::min(100, static_cast<int>(quality * 100.0f)));
+    char quality_str[8];
+    g_snprintf(quality_str, sizeof(quality_str), "%d", percent);
+
+    char *option_keys[] = {const_cast<char *>("quality"), nullptr};
+    char *option_values[] = {quality_str, nullptr};
+    return SavePixbuf(pixbuf, target_path, "jpeg", option_keys, option_values, progress);
+}
+
+const char *const kTextMimeTypes[] = {"text/plain;charset=utf-8", "UTF8_STRING", "text/plain"};
+
+// Adds `bytes` to `offer` under each of `mime_types`, sharing one payload
+template<size_t N>
+bool OfferBytes(wayland_data_control::Offer &offer, const char *data, size_t size,
+                const char *const (&mime_types)[N]) {
+    std::shared_ptr<wayland_data_control::Payload> payload = wayland_data_control::Payload::FromBytes(data, size);
+    if (!payload) {
+        return false;
+    }
+    for (const char *mime_type : mime_types) {
+        offer.emplace_back(mime_type, payload);
+    }
+    return true;
+}
+
+// Hands an offer to the data-control compositor or the X11 owner, an empty
+// one clears the selection.
+bool WriteOffer(ClipboardSelection selection, const wayland_data_control::Offer &offer) {
+    if (UseDataControl(selection)) {
+        return offer.empty() ? wayland_data_control::Clear(selection) : wayland_data_control::Write(selection, offer);
+    }
+    if (offer.empty()) {
+        ClearClipboard(selection);
+        return true;
+    }
+    return x11_selection_owner::Own(selection, offer);
+}
+
+// PNG of an image in another format, converted on the first request
+std::shared_ptr<wayland_data_control::Payload> LazyPngPayload(
+        std::shared_ptr<wayland_data_control::Payload> source) {
+    return wayland_data_control::Payload::Lazy([source]() {
+        std::shared_ptr<wayland_data_control::Payload> png_payload;
+        std::string_view bytes = source->Bytes();
+        GdkPixbuf *pixbuf = bytes.empty() ? nullptr : DecodePixbuf(bytes.data(), bytes.size());
+        if (!pixbuf) {
+            return png_payload;
+        }
+        gchar *png = nullptr;
+        gsize png_size = 0;
+        if (gdk_pixbuf_save_to_buffer(pixbuf, &png, &png_size, "png", nullptr, NULL)) {
+            png_payload = wayland_data_control::Payload::FromBytes(png, png_size);
+            g_free(png);
+        }
+        g_object_unref(pixbuf);
+        return png_payload;
+    });
+}
+
+// Offers the image in its own format, served from the file when there is
+// one, and as PNG converted when first asked for. Formats only gdk-pixbuf
+// understands are converted to PNG up front.
+bool OfferImage(wayland_data_control::Offer &offer, const std::string &image_path, const std::string &image_data) {
+    std::string header = image_data.substr(0, 8);
+    std::shared_ptr<wayland_data_control::Payload> payload;
+    if (!image_path.empty()) {
+        payload = wayland_data_control::Payload::FromFile(image_path);
+        char bytes[8];
+        ssize_t n = payload ? pread(payload->fd(), bytes, sizeof(bytes), 0) : -1;
+        header.assign(bytes, n > 0 ? static_cast<size_t>(n) : 0);
+    } else {
+        payload = wayland_data_control::Payload::FromBytes(image_data.data(), image_data.size());
+    }
+    if (!payload) {
+        return false;
+    }
+    const char *mime_type = SniffImageMimeType(header.data(), header.size());
+    if (mime_type) {
+        offer.emplace_back(mime_type, payload);
+        if (strcmp(mime_type, "image/png") != 0) {
+            offer.emplace_back("image/png", LazyPngPayload(payload));
+        }
+        return true;
+    }
+
+    GdkPixbuf *pixbuf = nullptr;
+    if (!image_path.empty()) {
+        pixbuf = gdk_pixbuf_new_from_file(image_path.c_str(), nullptr);
+    } else {
+        pixbuf = DecodePixbuf(image_data.data(), image_data.size());
+    }
+    if (!pixbuf) {
+        return false;
+    }
+    gchar *png = nullptr;
+    gsize png_size = 0;
+    gboolean ok = gdk_pixbuf_save_to_buffer(pixbuf, &png, &png_size, "png", nullptr, NULL);
+    g_object_unref(pixbuf);
+    if (!ok) {
+        return false;
+    }
+    static const char *const kPngMimeTypes[] = {"image/png"};
+    bool offered = OfferBytes(offer, png, png_size, kPngMimeTypes);
+    g_free(png);
+    return offered;
+}
 
-std::vector<std::string> ReadFilePaths() {
-    std::vector<std::string> result;
-    if (!EnsureGtkInitialized()) {
-        return result;
+// Calls `add` with each path offered by the native clipboard
+template<typename Add>
+void ReadNativeFilePaths(ClipboardSelection selection, Add add) {
+    if (UseDataControl(selection)) {
+        bool uri_list = wayland_data_control::HasMimeType(selection, "text/uri-list");
+        const char *mime_type = uri_list ? "text/uri-list" : "x-special/gnome-copied-files";
+        ClipboardData data;
+        if (wayland_data_control::Read(selection, mime_type, data)) {
+            DecodeFilePaths(std::string_view(data.data(), data.size()), uri_list, add);
+        }
+        return;
     }
 
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
-    if (!clipboard) {
-        return result;
+    SelectionState *state = GetSelectionState(selection);
+    if (!state) {
+        return;
     }
 
-    GdkAtom target = gdk_atom_intern_static_string("text/uri-list");
-    GtkSelectionData *sel = gtk_clipboard_wait_for_contents(clipboard, target);
+    // Nautilus and other GNOME file managers may only offer their own target
+    GdkAtom uri_list_target = gdk_atom_intern_static_string("text/uri-list");
+    GdkAtom gnome_target = gdk_atom_intern_static_string("x-special/gnome-copied-files");
+    GdkAtom target = uri_list_target;
+    if (!HasTarget(state, target)) {
+        target = gnome_target;
+        if (!HasTarget(state, target)) {
+            return;
+        }
+    }
+    GtkSelectionData *sel = WaitForContents(state, target);
     if (!sel) {
-        return result;
+        return;
     }
 
     const guchar *data_ptr = gtk_selection_data_get_data(sel);
     gint length = gtk_selection_data_get_length(sel);
-    if (!data_ptr || length <= 0) {
-        gtk_selection_data_free(sel);
-        return result;
+    if (data_ptr && length > 0) {
+        std::string_view data(reinterpret_cast<const char *>(data_ptr), static_cast<size_t>(length));
+        DecodeFilePaths(data, target == uri_list_target, add);
     }
-
-    std::string data(reinterpret_cast<const char *>(data_ptr), static_cast<size_t>(length));
     gtk_selection_data_free(sel);
-
-    auto lines = splitLines(data);
-    for (const std::string &line : lines) {
-        if (line.empty()) {
-            continue;
-        }
-        if (!line.empty() && line[0] == '#') { // comments in text/uri-list
-            continue;
-        }
-        GError *error = nullptr;
-        gchar *filename = g_filename_from_uri(line.c_str(), nullptr, &error);
-        if (filename) {
-            result.emplace_back(filename); // UTF-8
-            g_free(filename);
-        } else {
-            if (error) {
-                g_error_free(error);
-            }
-        }
-    }
-
-    return result;
 }
 
-void WriteFilePaths(const std::vector<std::string> &file_paths) {
-    if (!EnsureGtkInitialized()) {
+template<typename Paths>
+void WriteNativeFilePaths(const Paths &file_paths, ClipboardSelection selection) {
+    if (UseDataControl(selection) || UseRawOwner(selection)) {
+        static const char *const kUriListMimeTypes[] = {"text/uri-list"};
+        static const char *const kGnomeMimeTypes[] = {"x-special/gnome-copied-files"};
+        std::string uri_list = BuildUriList(file_paths);
+        std::string copied_files = BuildGnomeCopiedFiles(file_paths);
+        std::string plain_text = JoinLines(file_paths);
+        wayland_data_control::Offer offer;
+        if (OfferBytes(offer, uri_list.data(), uri_list.size(), kUriListMimeTypes) &&
+            OfferBytes(offer, copied_files.data(), copied_files.size(), kGnomeMimeTypes) &&
+            OfferBytes(offer, plain_text.data(), plain_text.size(), kTextMimeTypes)) {
+            WriteOffer(selection, offer);
+        }
         return;
     }
 
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+    GtkClipboard *clipboard = GetClipboard(selection);
     if (!clipboard) {
         return;
     }
 
-    // Build URI list and plain text fallback
-    std::vector<std::string> uris;
-    uris.reserve(file_paths.size());
-    for (const std::string &path : file_paths) {
-        GError *error = nullptr;
-        gchar *uri = g_filename_to_uri(path.c_str(), nullptr, &error);
-        if (uri) {
-            uris.emplace_back(uri);
-            g_free(uri);
-        } else {
-            if (error) {
-                g_error_free(error);
-            }
-        }
-    }
-
     UriListData *payload = new UriListData();
-    payload->uri_list = joinWithCrlf(uris);
-
-    // Plain text fallback: one path per line
-    std::ostringstream plain;
-    for (size_t i = 0; i < file_paths.size(); ++i) {
-        plain << file_paths[i];
-        if (i + 1 < file_paths.size()) {
-            plain << '\n';
-        }
-    }
-    payload->plain_text = plain.str();
+    payload->uri_list = BuildUriList(file_paths);
+    payload->copied_files = BuildGnomeCopiedFiles(file_paths);
+    payload->plain_text = JoinLines(file_paths);
 
     GtkTargetEntry targets[] = {
         {const_cast<gchar *>("text/uri-list"), 0, 0},
+        {const_cast<gchar *>("x-special/gnome-copied-files"), 0, 2},
         {const_cast<gchar *>("UTF8_STRING"), 0, 1},
         {const_cast<gchar *>("STRING"), 0, 1},
     };
 
-    gtk_clipboard_set_with_data(clipboard,
-                                targets,
-                                static_cast<gint>(sizeof(targets) / sizeof(targets[0])),
-                                clipboard_get_func,
-                                clipboard_clear_func,
-                                payload);
+    // On failure the clear function is never called, the payload is ours
+    if (!gtk_clipboard_set_with_data(clipboard,
+                                     targets,
+                                     static_cast<gint>(sizeof(targets) / sizeof(targets[0])),
+                                     clipboard_get_func,
+                                     clipboard_clear_func,
+                                     payload)) {
+        clipboard_clear_func(clipboard, payload);
+        return;
+    }
 
     // Persist clipboard in some environments even if our app exits
     gtk_clipboard_store(clipboard);
 }
 
-void ClearClipboard() {
-    if (!EnsureGtkInitialized()) {
+} // namespace
+
+std::vector<std::string> ReadFilePaths(ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadFilePaths(selection);
+    }
+    std::vector<std::string> result;
+    ReadNativeFilePaths(selection, [&result](std::string_view path) {
+        result.emplace_back(path);
+    });
+    return result;
+}
+
+PathList ReadFilePathList(ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        std::vector<std::string> file_paths = memory_clipboard::ReadFilePaths(selection);
+        return PathList(file_paths.begin(), file_paths.end());
+    }
+    PathList result;
+    ReadNativeFilePaths(selection, [&result](std::string_view path) {
+        result.Append(path);
+    });
+    return result;
+}
+
+void WriteFilePaths(const std::vector<std::string> &file_paths, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        memory_clipboard::WriteFilePaths(file_paths, selection);
+        return;
+    }
+    WriteNativeFilePaths(file_paths, selection);
+}
+
+void WriteFilePathList(const PathList &file_paths, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        memory_clipboard::WriteFilePaths(std::vector<std::string>(file_paths.begin(), file_paths.end()), selection);
+        return;
+    }
+    WriteNativeFilePaths(file_paths, selection);
+}
+
+void ClearClipboard(ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        memory_clipboard::Clear(selection);
+        return;
+    }
+    if (UseDataControl(selection)) {
+        wayland_data_control::Clear(selection);
         return;
     }
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+    GtkClipboard *clipboard = GetClipboard(selection);
     if (!clipboard) {
         return;
     }
+    x11_selection_owner::Release(selection);
     gtk_clipboard_clear(clipboard);
 }
 
-bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor) {
-    if (!EnsureGtkInitialized()) {
+bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor,
+                              ClipboardSelection selection, ProgressSink *progress) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::SaveImage(target_path, ImageFormat::Jpeg, compression_factor, selection, progress);
+    }
+    GdkPixbuf *pixbuf = WaitForImage(selection, progress);
+    if (!pixbuf) {
         return false;
     }
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
-    if (!clipboard) {
+    bool ok = SavePixbufAs(pixbuf, target_path, ImageFormat::Jpeg, compression_factor, progress);
+    g_object_unref(pixbuf);
+    return ok;
+}
+
+bool SaveClipboardImageAsPng(const std::string &target_path, ClipboardSelection selection,
+                             ProgressSink *progress) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::SaveImage(target_path, ImageFormat::Png, 0, selection, progress);
+    }
+    if (UseDataControl(selection) && wayland_data_control::HasMimeType(selection, "image/png")) {
+        // The owner's PNG is spliced from its pipe into the file as is
+        return WriteFileAtomically(target_path, [&](FILE *file) {
+            int fd = fileno(file);
+            if (!wayland_data_control::ReadToFd(selection, "image/png", fd, progress)) {
+                return false;
+            }
+            off_t size = lseek(fd, 0, SEEK_CUR);
+            return size > 0 && ReportProgress(progress, ProgressPhase::Transfer, static_cast<uint64_t>(size),
+                                              static_cast<uint64_t>(size));
+        });
+    }
+    GdkPixbuf *pixbuf = WaitForImage(selection, progress);
+    if (!pixbuf) {
         return false;
     }
-    GdkPixbuf *pixbuf = gtk_clipboard_wait_for_image(clipboard);
+    bool ok = SavePixbufAs(pixbuf, target_path, ImageFormat::Png, 0, progress);
+    g_object_unref(pixbuf);
+    return ok;
+}
+
+bool ReadImagePixels(ImagePixels &image, ClipboardSelection selection, ProgressSink *progress) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadImagePixels(image, selection);
+    }
+    GdkPixbuf *pixbuf = WaitForImage(selection, progress);
     if (!pixbuf) {
         return false;
     }
+    bool ok = PixbufToPixels(pixbuf, image);
+    g_object_unref(pixbuf);
+    return ok;
+}
 
-    int quality = std::max(0, std::min(100, static_cast<int>(compression_factor * 100.0f)));
-    char quality_str[8];
-    g_snprintf(quality_str, sizeof(quality_str), "%d", quality);
+bool ReadImagePixelsAnyThread(ImagePixels &image, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadImagePixels(image, selection);
+    }
+    if (UseDataControl(selection)) {
+        std::string mime_type = DataControlImageType(selection);
+        ClipboardData data;
+        return !mime_type.empty() && wayland_data_control::Read(selection, mime_type, data) &&
+               DecodeImageData(data.data(), data.size(), image);
+    }
+#ifdef GDK_WINDOWING_X11
+    // TARGETS would need GTK to name the atoms, so the usual image types are
+    // asked for in turn; owners refuse the ones they lack at once. Our own
+    // GTK ownership answers once the clipboard thread iterates the loop.
+    for (const char *target : {"image/png", "image/jpeg", "image/bmp", "image/tiff"}) {
+        std::string bytes;
+        bool read = x11_selection_owner::ReadTarget(selection, target, std::chrono::milliseconds(kDefaultTimeoutMs),
+                                                    [&bytes](const char *data, size_t size) {
+            bytes.append(data, size);
+            return true;
+        });
+        if (read) {
+            return !bytes.empty() && DecodeImageData(bytes.data(), bytes.size(), image);
+        }
+    }
+#endif
+    return false;
+}
 
-    GError *error = nullptr;
-    gboolean ok = gdk_pixbuf_save(pixbuf, target_path.c_str(), "jpeg", &error, "quality", quality_str, NULL);
+bool ReadImageBgra(const PixelDestination &destination, bool premultiplied, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadImageBgra(destination, premultiplied, selection);
+    }
+    GdkPixbuf *pixbuf = WaitForImage(selection, nullptr);
+    if (!pixbuf) {
+        return false;
+    }
+    bool ok = PixbufToBgra(pixbuf, destination, premultiplied);
     g_object_unref(pixbuf);
-    if (!ok && error) {
-        g_error_free(error);
+    return ok;
+}
+
+bool ReadClipboardJpeg(ClipboardData &data, ClipboardSelection selection, ProgressSink *progress) {
+    if (UseMemoryBackend()) {
+        return false; // Only decoded pixels are kept there
+    }
+    const char *mime_type = "image/jpeg";
+    ClipboardData jpeg;
+    if (UseDataControl(selection)) {
+        if (!wayland_data_control::HasMimeType(selection, mime_type) ||
+            !wayland_data_control::Read(selection, mime_type, jpeg, progress)) {
+            return false;
+        }
+    } else {
+        SelectionState *state = GetSelectionState(selection);
+        GdkAtom target = gdk_atom_intern_static_string(mime_type);
+        if (!state || !HasTarget(state, target)) {
+            return false;
+        }
+        GtkSelectionData *sel = WaitForContents(state, target);
+        if (!sel) {
+            return false;
+        }
+        gint length = gtk_selection_data_get_length(sel);
+        if (length < 0) {
+            gtk_selection_data_free(sel);
+            return false;
+        }
+        jpeg = ClipboardData(reinterpret_cast<const char *>(gtk_selection_data_get_data(sel)),
+                             static_cast<size_t>(length), FreeSelectionData, sel);
+    }
+    // Some owners label whatever they have as image/jpeg
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(jpeg.data());
+    if (jpeg.size() < 3 || bytes[0] != 0xff || bytes[1] != 0xd8 || bytes[2] != 0xff) {
+        return false;
+    }
+    data = std::move(jpeg);
+    return true;
+}
+
+bool ReadClipboardTarget(const std::string &mime_type, ClipboardSelection selection, const ChunkConsumer &consume) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadTarget(mime_type, selection, consume);
+    }
+    if (UseDataControl(selection)) {
+        return wayland_data_control::HasMimeType(selection, mime_type) &&
+               wayland_data_control::ReadChunks(selection, mime_type, consume);
     }
+    SelectionState *state = GetSelectionState(selection);
+    GdkAtom target = gdk_atom_intern(mime_type.c_str(), FALSE);
+    if (!state || !HasTarget(state, target)) {
+        return false;
+    }
+#ifdef GDK_WINDOWING_X11
+    // GTK collects INCR transfers whole, the private connection passes each
+    // chunk on. Our own GTK ownership is answered by the main loop only,
+    // which that read would block.
+    if (!IsGtkOwned(state) && GDK_IS_X11_DISPLAY(gdk_display_get_default())) {
+        gint64 timeout_ms = TargetTimeoutMs(ResolveOwner(state), mime_type);
+        return x11_selection_owner::ReadTarget(selection, mime_type, std::chrono::milliseconds(timeout_ms),
+                                               consume);
+    }
+#endif
+    GtkSelectionData *sel = WaitForContents(state, target);
+    if (!sel) {
+        return false;
+    }
+    gint length = gtk_selection_data_get_length(sel);
+    bool ok = length >= 0 && consume(reinterpret_cast<const char *>(gtk_selection_data_get_data(sel)),
+                                     static_cast<size_t>(length));
+    gtk_selection_data_free(sel);
     return ok;
 }
 
-bool SaveClipboardImageAsPng(const std::string &target_path) {
-    if (!EnsureGtkInitialized()) {
+bool DecodeImageFile(const std::string &path, uint32_t max_size, ImagePixels &image) {
+    FILE *file = g_fopen(path.c_str(), "rb");
+    if (!file) {
         return false;
     }
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
-    if (!clipboard) {
+    GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+    g_signal_connect(loader, "size-prepared", G_CALLBACK(OnLoaderFitSize), GUINT_TO_POINTER(max_size));
+    char chunk[64 << 10];
+    bool ok = true;
+    size_t read;
+    while (ok && (read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        ok = gdk_pixbuf_loader_write(loader, reinterpret_cast<const guchar *>(chunk), read, nullptr);
+    }
+    fclose(file);
+    ok = gdk_pixbuf_loader_close(loader, nullptr) && ok;
+    GdkPixbuf *pixbuf = ok ? gdk_pixbuf_loader_get_pixbuf(loader) : nullptr;
+    // Photos are commonly stored sideways with an EXIF orientation
+    GdkPixbuf *oriented = pixbuf ? gdk_pixbuf_apply_embedded_orientation(pixbuf) : nullptr;
+    g_object_unref(loader);
+    if (!oriented) {
         return false;
     }
-    GdkPixbuf *pixbuf = gtk_clipboard_wait_for_image(clipboard);
+    ok = PixbufToPixels(oriented, image);
+    g_object_unref(oriented);
+    return ok;
+}
+
+bool DecodeImageData(const char *data, size_t size, ImagePixels &image) {
+    GdkPixbuf *pixbuf = DecodePixbuf(data, size);
     if (!pixbuf) {
         return false;
     }
-    GError *error = nullptr;
-    gboolean ok = gdk_pixbuf_save(pixbuf, target_path.c_str(), "png", &error, NULL);
+    bool ok = PixbufToPixels(pixbuf, image);
     g_object_unref(pixbuf);
-    if (!ok && error) {
-        g_error_free(error);
+    return ok;
+}
+
+bool SaveImagePixels(const ImagePixels &image, const std::string &target_path, ImageFormat format,
+                     float quality, ProgressSink *progress) {
+    if (!image.pixels.data() || !image.width || !image.height) {
+        return false;
     }
+    // Wraps the pixels without copying, the pixbuf does not outlive them
+    GdkPixbuf *pixbuf = gdk_pixbuf_new_from_data(reinterpret_cast<const guchar *>(image.pixels.data()),
+                                                 GDK_COLORSPACE_RGB, TRUE, 8, static_cast<int>(image.width),
+                                                 static_cast<int>(image.height), static_cast<int>(image.stride),
+                                                 nullptr, nullptr);
+    if (!pixbuf) {
+        return false;
+    }
+    bool ok = SavePixbufAs(pixbuf, target_path, format, quality, progress);
+    g_object_unref(pixbuf);
     return ok;
 }
 
-bool PutImageIntoClipboard(const std::string &image_path) {
+bool PutImageIntoClipboard(const std::string &image_path, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::PutImage(image_path, selection);
+    }
+    if (UseDataControl(selection) || UseRawOwner(selection)) {
+        wayland_data_control::Offer offer;
+        return OfferImage(offer, image_path, std::string()) && WriteOffer(selection, offer);
+    }
     if (!EnsureGtkInitialized()) {
         return false;
     }
@@ -266,7 +1734,7 @@ bool PutImageIntoClipboard(const std::string &image_path) {
         }
         return false;
     }
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+    GtkClipboard *clipboard = GetClipboard(selection);
     if (!clipboard) {
         g_object_unref(pixbuf);
         return false;
@@ -277,24 +1745,353 @@ bool PutImageIntoClipboard(const std::string &image_path) {
     return true;
 }
 
-bool ClipboardHasImage() {
-    if (!EnsureGtkInitialized()) {
+bool ClipboardHasImage(ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::HasImage(selection);
+    }
+    if (UseDataControl(selection)) {
+        std::vector<std::string> mime_types = wayland_data_control::GetMimeTypes(selection);
+        return std::any_of(mime_types.begin(), mime_types.end(), [](const std::string &mime_type) {
+            return mime_type.compare(0, 6, "image/") == 0;
+        });
+    }
+    SelectionState *state = GetSelectionState(selection);
+    if (!state) {
+        return false;
+    }
+    std::vector<GdkAtom> targets;
+    if (!GetTargets(state, targets)) {
+        return false;
+    }
+    return gtk_targets_include_image(targets.data(), static_cast<gint>(targets.size()), FALSE);
+}
+
+bool ReadText(ClipboardData &text, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadText(text, selection);
+    }
+    if (UseDataControl(selection)) {
+        return ReadTextDataControl(text, selection);
+    }
+    SelectionState *state = GetSelectionState(selection);
+    if (!state) {
+        return false;
+    }
+
+    // GTK reassembles INCR transfers, the reply is handed out without copying
+    const GdkAtom utf8_targets[] = {
+        gdk_atom_intern_static_string("UTF8_STRING"),
+        gdk_atom_intern_static_string("text/plain;charset=utf-8"),
+    };
+    for (GdkAtom target : utf8_targets) {
+        if (!HasTarget(state, target)) {
+            continue;
+        }
+        GtkSelectionData *sel = WaitForContents(state, target);
+        if (!sel) {
+            continue;
+        }
+        const guchar *data_ptr = gtk_selection_data_get_data(sel);
+        gint length = gtk_selection_data_get_length(sel);
+        if (length < 0 || !IsValidUtf8(reinterpret_cast<const char *>(data_ptr), static_cast<size_t>(length))) {
+            gtk_selection_data_free(sel);
+            continue;
+        }
+        text = ClipboardData(reinterpret_cast<const char *>(data_ptr), static_cast<size_t>(length),
+                             FreeSelectionData, sel);
+        return true;
+    }
+
+    GdkAtom latin1_target = gdk_atom_intern_static_string("STRING");
+    if (!HasTarget(state, latin1_target)) {
+        return false;
+    }
+    GtkSelectionData *sel = WaitForContents(state, latin1_target);
+    if (!sel) {
+        return false;
+    }
+    const char *data_ptr = reinterpret_cast<const char *>(gtk_selection_data_get_data(sel));
+    gint length = gtk_selection_data_get_length(sel);
+    if (length < 0) {
+        gtk_selection_data_free(sel);
         return false;
     }
-    GtkClipboard *clipboard = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+    text = Latin1ToClipboardData(data_ptr, static_cast<size_t>(length));
+    gtk_selection_data_free(sel);
+    return true;
+}
+
+bool WriteText(const char *data, size_t size, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::WriteText(data, size, selection);
+    }
+    if (UseDataControl(selection)) {
+        wayland_data_control::Offer offer;
+        return OfferBytes(offer, data, size, kTextMimeTypes) && wayland_data_control::Write(selection, offer);
+    }
+    GtkClipboard *clipboard = GetClipboard(selection);
     if (!clipboard) {
         return false;
     }
-#if GTK_CHECK_VERSION(2,6,0)
-    return gtk_clipboard_wait_is_image_available(clipboard);
-#else
-    GdkPixbuf *pixbuf = gtk_clipboard_wait_for_image(clipboard);
-    if (pixbuf) {
-        g_object_unref(pixbuf);
+
+    TextData *payload = new TextData();
+    payload->bytes = static_cast<gchar *>(g_malloc(size + 1));
+    memcpy(payload->bytes, data, size);
+    payload->bytes[size] = '\0';
+    payload->size = size;
+
+    GtkTargetList *list = gtk_target_list_new(nullptr, 0);
+    gtk_target_list_add_text_targets(list, 0);
+    gint n_targets = 0;
+    GtkTargetEntry *targets = gtk_target_table_new_from_list(list, &n_targets);
+    gtk_target_list_unref(list);
+
+    gboolean ok = gtk_clipboard_set_with_data(clipboard, targets, n_targets,
+                                              text_get_func, text_clear_func, payload);
+    gtk_target_table_free(targets, n_targets);
+    if (!ok) {
+        text_clear_func(clipboard, payload);
+        return false;
+    }
+
+    gtk_clipboard_store(clipboard);
+    return true;
+}
+
+RichContent ReadRich(ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::ReadRich(selection);
+    }
+    RichContent content;
+    SelectionState *state = nullptr;
+    if (!UseDataControl(selection)) {
+        state = GetSelectionState(selection);
+        if (!state) {
+            return content;
+        }
+
+        // TARGETS is fetched once and every flavor is requested from the same owner
+        std::vector<GdkAtom> targets;
+        if (!GetTargets(state, targets)) {
+            return content;
+        }
+    }
+
+    content.html = WaitForString(selection, state, "text/html");
+    if (content.html.size() >= 2 && static_cast<unsigned char>(content.html[0]) == 0xFF &&
+        static_cast<unsigned char>(content.html[1]) == 0xFE) {
+        // Some owners (e.g. Firefox) offer UTF-16 with a BOM
+        gchar *utf8 = g_convert(content.html.data() + 2, static_cast<gssize>(content.html.size() - 2),
+                                "UTF-8", "UTF-16LE", nullptr, nullptr, nullptr);
+        content.html = utf8 ? utf8 : "";
+        g_free(utf8);
+    }
+    content.rtf = WaitForString(selection, state, "text/rtf");
+    if (content.rtf.empty()) {
+        content.rtf = WaitForString(selection, state, "application/rtf");
+    }
+
+    ClipboardData text;
+    if (ReadText(text, selection)) {
+        content.text.assign(text.data(), text.size());
+    }
+    return content;
+}
+
+bool WriteRich(const RichContent &content, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::WriteRich(content, selection);
+    }
+    if (UseDataControl(selection)) {
+        static const char *const kHtmlMimeTypes[] = {"text/html"};
+        static const char *const kRtfMimeTypes[] = {"text/rtf", "application/rtf"};
+        wayland_data_control::Offer offer;
+        if ((!content.html.empty() && !OfferBytes(offer, content.html.data(), content.html.size(), kHtmlMimeTypes)) ||
+            (!content.rtf.empty() && !OfferBytes(offer, content.rtf.data(), content.rtf.size(), kRtfMimeTypes)) ||
+            (!content.text.empty() &&
+             !OfferBytes(offer, content.text.data(), content.text.size(), kTextMimeTypes))) {
+            return false;
+        }
+        if (content.text.empty() && !content.html.empty()) {
+            // Plain text of the HTML, derived from its payload when first asked for
+            std::shared_ptr<wayland_data_control::Payload> html = offer.front().second;
+            auto text = wayland_data_control::Payload::Lazy([html]() {
+                std::string_view bytes = html->Bytes();
+                std::string plain = HtmlToText(bytes.data(), bytes.size());
+                return wayland_data_control::Payload::FromBytes(plain.data(), plain.size());
+            });
+            for (const char *mime_type : kTextMimeTypes) {
+                offer.emplace_back(mime_type, text);
+            }
+        }
+        return offer.empty() ? wayland_data_control::Clear(selection) : wayland_data_control::Write(selection, offer);
+    }
+
+    GtkClipboard *clipboard = GetClipboard(selection);
+    if (!clipboard) {
+        return false;
+    }
+
+    GtkTargetList *list = gtk_target_list_new(nullptr, 0);
+    if (!content.html.empty()) {
+        gtk_target_list_add(list, gdk_atom_intern_static_string("text/html"), 0, kRichHtml);
+    }
+    if (!content.rtf.empty()) {
+        gtk_target_list_add(list, gdk_atom_intern_static_string("text/rtf"), 0, kRichRtf);
+        gtk_target_list_add(list, gdk_atom_intern_static_string("application/rtf"), 0, kRichRtf);
+    }
+    if (!content.text.empty() || !content.html.empty()) {
+        gtk_target_list_add_text_targets(list, kRichText);
+    }
+    gint n_targets = 0;
+    GtkTargetEntry *targets = gtk_target_table_new_from_list(list, &n_targets);
+    gtk_target_list_unref(list);
+    if (n_targets == 0) {
+        gtk_target_table_free(targets, n_targets);
+        gtk_clipboard_clear(clipboard);
         return true;
     }
-    return false;
-#endif
+
+    RichData *payload = new RichData();
+    payload->content = content;
+    gboolean ok = gtk_clipboard_set_with_data(clipboard, targets, n_targets,
+                                              rich_get_func, rich_clear_func, payload);
+    gtk_target_table_free(targets, n_targets);
+    if (!ok) {
+        rich_clear_func(clipboard, payload);
+        return false;
+    }
+
+    gtk_clipboard_store(clipboard);
+    return true;
+}
+
+bool WriteMulti(const MultiContent &content, ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::WriteMulti(content, selection);
+    }
+    if (!content.image_path.empty() && !g_file_test(content.image_path.c_str(), G_FILE_TEST_IS_REGULAR)) {
+        return false;
+    }
+    if (UseDataControl(selection) || UseRawOwner(selection)) {
+        static const char *const kUriListMimeTypes[] = {"text/uri-list"};
+        wayland_data_control::Offer offer;
+        if (!content.file_paths.empty()) {
+            std::string uri_list = BuildUriList(content.file_paths);
+            if (!OfferBytes(offer, uri_list.data(), uri_list.size(), kUriListMimeTypes)) {
+                return false;
+            }
+        } else if (OffersImageFile(content)) {
+            // Written by the thread serving the first request, off GTK's loop
+            auto image_file = std::make_shared<LazyImageFile>(content.image_data, content.image_file_name);
+            offer.emplace_back("text/uri-list", wayland_data_control::Payload::Lazy([image_file]() {
+                std::string path = image_file->Path();
+                if (path.empty()) {
+                    return std::shared_ptr<wayland_data_control::Payload>();
+                }
+                std::string uri_list = BuildUriList(std::vector<std::string>{path});
+                return wayland_data_control::Payload::FromBytes(uri_list.data(), uri_list.size());
+            }));
+        }
+        if ((!content.image_path.empty() || !content.image_data.empty()) &&
+            !OfferImage(offer, content.image_path, content.image_data)) {
+            return false;
+        }
+        std::string text = content.text;
+        if (text.empty()) {
+            text = content.file_paths.empty() ? content.image_path : JoinLines(content.file_paths);
+        }
+        if (!text.empty() && !OfferBytes(offer, text.data(), text.size(), kTextMimeTypes)) {
+            return false;
+        }
+        return WriteOffer(selection, offer);
+    }
+
+    GtkClipboard *clipboard = GetClipboard(selection);
+    if (!clipboard) {
+        return false;
+    }
+
+    GtkTargetList *list = gtk_target_list_new(nullptr, 0);
+    if (!content.file_paths.empty() || OffersImageFile(content)) {
+        gtk_target_list_add(list, gdk_atom_intern_static_string("text/uri-list"), 0, kMultiUriList);
+    }
+    if (!content.image_path.empty() || !content.image_data.empty()) {
+        gtk_target_list_add_image_targets(list, kMultiImage, TRUE);
+    }
+    if (!content.text.empty() || !content.file_paths.empty() || !content.image_path.empty()) {
+        gtk_target_list_add_text_targets(list, kMultiText);
+    }
+    gint n_targets = 0;
+    GtkTargetEntry *targets = gtk_target_table_new_from_list(list, &n_targets);
+    gtk_target_list_unref(list);
+    if (n_targets == 0) {
+        gtk_target_table_free(targets, n_targets);
+        gtk_clipboard_clear(clipboard);
+        return true;
+    }
+
+    MultiData *payload = new MultiData();
+    payload->content = content;
+    if (OffersImageFile(content)) {
+        payload->image_file = std::make_shared<LazyImageFile>(content.image_data, content.image_file_name);
+    }
+    gboolean ok = gtk_clipboard_set_with_data(clipboard, targets, n_targets,
+                                              multi_get_func, multi_clear_func, payload);
+    gtk_target_table_free(targets, n_targets);
+    if (!ok) {
+        multi_clear_func(clipboard, payload);
+        return false;
+    }
+
+    gtk_clipboard_store(clipboard);
+    return true;
 }
 
+uint64_t ClipboardSequenceNumber(ClipboardSelection selection) {
+    if (UseMemoryBackend()) {
+        return memory_clipboard::SequenceNumber(selection);
+    }
+    if (UseDataControl(selection)) {
+        return wayland_data_control::SequenceNumber(selection);
+    }
+    SelectionState *state = GetSelectionState(selection);
+    if (!state) {
+        return 0;
+    }
+    PumpPendingEvents();
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->pending_change && g_get_monotonic_time() - state->last_change_us >= state->coalesce_us) {
+        state->last_change_us = g_get_monotonic_time();
+        state->pending_change = false;
+        ++state->sequence;
+    }
+    return state->sequence;
+}
 
+ClipboardStats GetClipboardStats() {
+    ClipboardStats stats;
+    std::unique_lock<std::mutex> lock(owner_records_mutex);
+    for (const auto &entry : OwnerRecords()) {
+        const OwnerRecord &record = entry.second;
+        OwnerStats owner;
+        owner.pid = record.pid;
+        owner.wm_class = record.wm_class;
+        for (const auto &target : record.targets) {
+            const TargetTiming &timing = target.second;
+            TargetStats target_stats;
+            target_stats.target = target.first;
+            target_stats.requests = timing.requests;
+            target_stats.timeouts = timing.timeouts;
+            target_stats.mean_ms = timing.replies ? timing.total_ms / static_cast<double>(timing.replies) : 0;
+            target_stats.max_ms = timing.max_ms;
+            target_stats.timeout_ms = static_cast<uint32_t>(TimeoutMs(timing));
+            owner.targets.push_back(std::move(target_stats));
+        }
+        stats.owners.push_back(std::move(owner));
+    }
+    lock.unlock();
+    stats.serving = x11_selection_owner::GetStats();
+    stats.codec_contexts = GetJpegContextStats();
+    return stats;
+}
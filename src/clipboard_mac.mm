@@ -1,29 +1,29 @@
 #import <Foundation/Foundation.h>
 #import <Cocoa/Cocoa.h>
+#import <ImageIO/ImageIO.h>
 #include "clipboard.h"
+#include "html_text.h"
+#include "image_ops.h"
+#include "memory_clipboard.h"
 
-std::vector<std::string> ReadFilePaths() {
+namespace {
+
+// Calls `add` with the path of each file URL on the pasteboard
+template<typename Add>
+void ReadPasteboardFilePaths(Add add) {
     NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
     NSArray<NSURL *> *urls = [pasteboard readObjectsForClasses:@[NSURL.class] options:@{
             NSPasteboardURLReadingFileURLsOnlyKey: @YES,
     }];
-
-    if (!urls) {
-        return {};
-    }
-
-    auto result = std::vector<std::string>();
-    result.reserve(urls.count);
     for (NSURL *url in urls) {
-        result.emplace_back([url.path UTF8String]);
+        add([url.path UTF8String]);
     }
-
-    return result;
 }
 
-void WriteFilePaths(const std::vector<std::string> &file_paths) {
+template<typename Paths>
+void WritePasteboardFilePaths(const Paths &file_paths) {
     NSMutableArray *urls = [[NSMutableArray alloc] initWithCapacity:file_paths.size()];
-    for (const auto &path : file_paths) {
+    for (const std::string &path : file_paths) {
         NSString *pathStr = [NSString stringWithUTF8String:path.c_str()];
         [urls addObject:[NSURL fileURLWithPath:pathStr]];
     }
@@ -33,7 +33,67 @@ void WriteFilePaths(const std::vector<std::string> &file_paths) {
     [pasteboard writeObjects:urls];
 }
 
-void ClearClipboard() {
+} // namespace
+
+std::vector<std::string> ReadFilePaths(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadFilePaths(selection);
+    }
+    auto result = std::vector<std::string>();
+    if (selection != ClipboardSelection::Clipboard) {
+        return result;
+    }
+    ReadPasteboardFilePaths([&result](const char *path) {
+        result.emplace_back(path);
+    });
+    return result;
+}
+
+PathList ReadFilePathList(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        std::vector<std::string> file_paths = memory_clipboard::ReadFilePaths(selection);
+        return PathList(file_paths.begin(), file_paths.end());
+    }
+    PathList result;
+    if (selection != ClipboardSelection::Clipboard) {
+        return result;
+    }
+    ReadPasteboardFilePaths([&result](const char *path) {
+        result.Append(path);
+    });
+    return result;
+}
+
+void WriteFilePaths(const std::vector<std::string> &file_paths, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        memory_clipboard::WriteFilePaths(file_paths, selection);
+        return;
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return;
+    }
+    WritePasteboardFilePaths(file_paths);
+}
+
+void WriteFilePathList(const PathList &file_paths, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        memory_clipboard::WriteFilePaths(std::vector<std::string>(file_paths.begin(), file_paths.end()), selection);
+        return;
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return;
+    }
+    WritePasteboardFilePaths(file_paths);
+}
+
+void ClearClipboard(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        memory_clipboard::Clear(selection);
+        return;
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return;
+    }
     NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
     [pasteboard clearContents];
 }
@@ -55,37 +115,265 @@ NSBitmapImageRep *getBitmapImageRepFromPasteboard() {
     return bitmapRep;
 }
 
-bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor) {
+bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor,
+                              ClipboardSelection selection, ProgressSink *progress) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::SaveImage(target_path, ImageFormat::Jpeg, compression_factor, selection, progress);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     NSBitmapImageRep *bitmapRep = getBitmapImageRepFromPasteboard();
-    if (!bitmapRep) {
+    // ImageIO encodes in one call, only the phase boundaries are reported
+    if (!bitmapRep || !ReportProgress(progress, ProgressPhase::Encode, 0, 0)) {
         return false;
     }
 
     NSData *imageData = [bitmapRep representationUsingType:NSBitmapImageFileTypeJPEG properties:@{
             NSImageCompressionFactor: @(compression_factor)
     }];
-    if (!imageData) {
+    if (!imageData || !ReportProgress(progress, ProgressPhase::Encode, imageData.length, imageData.length)) {
         return false;
     }
 
     return [imageData writeToFile:[NSString stringWithUTF8String:target_path.c_str()] atomically:YES];
 }
 
-bool SaveClipboardImageAsPng(const std::string &target_path) {
+bool SaveClipboardImageAsPng(const std::string &target_path, ClipboardSelection selection,
+                             ProgressSink *progress) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::SaveImage(target_path, ImageFormat::Png, 0, selection, progress);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     NSBitmapImageRep *bitmapRep = getBitmapImageRepFromPasteboard();
-    if (!bitmapRep) {
+    if (!bitmapRep || !ReportProgress(progress, ProgressPhase::Encode, 0, 0)) {
         return false;
     }
 
     NSData *imageData = [bitmapRep representationUsingType:NSBitmapImageFileTypePNG properties:@{}];
-    if (!imageData) {
+    if (!imageData || !ReportProgress(progress, ProgressPhase::Encode, imageData.length, imageData.length)) {
         return false;
     }
 
     return [imageData writeToFile:[NSString stringWithUTF8String:target_path.c_str()] atomically:YES];
 }
 
-bool PutImageIntoClipboard(const std::string &image_path) {
+// Draws `cgImage` into straight alpha RGBA rows
+bool CGImageToPixels(CGImageRef cgImage, ImagePixels &image) {
+    size_t width = CGImageGetWidth(cgImage);
+    size_t height = CGImageGetHeight(cgImage);
+    if (width == 0 || height == 0) {
+        return false;
+    }
+    image.width = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    image.stride = image.width * 4;
+    image.pixels = PooledBuffer(image.stride * image.height);
+    if (!image.pixels.data()) {
+        return false;
+    }
+
+    // Core Graphics only draws premultiplied RGBA, the alpha is divided out below
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGContextRef context = CGBitmapContextCreate(image.pixels.data(), image.width, image.height, 8, image.stride,
+                                                 colorSpace, kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return false;
+    }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, image.width, image.height), cgImage);
+    CGContextRelease(context);
+
+    for (uint32_t y = 0; y < image.height; ++y) {
+        UnpremultiplyRow(reinterpret_cast<uint8_t *>(image.pixels.data() + y * image.stride), image.width);
+    }
+    return true;
+}
+
+bool ReadImagePixels(ImagePixels &image, ClipboardSelection selection, ProgressSink *progress) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadImagePixels(image, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    NSBitmapImageRep *bitmapRep = getBitmapImageRepFromPasteboard();
+    if (!bitmapRep || !bitmapRep.CGImage ||
+        !ReportProgress(progress, ProgressPhase::Decode, 0, bitmapRep.pixelsHigh)) {
+        return false;
+    }
+    return CGImageToPixels(bitmapRep.CGImage, image) &&
+           ReportProgress(progress, ProgressPhase::Decode, image.height, image.height);
+}
+
+// NSPasteboard may be read from any thread, which may lack a pool
+bool ReadImagePixelsAnyThread(ImagePixels &image, ClipboardSelection selection) {
+    @autoreleasepool {
+        return ReadImagePixels(image, selection);
+    }
+}
+
+// Core Graphics draws premultiplied BGRA natively, straight alpha is
+// divided out in place
+bool ReadImageBgra(const PixelDestination &destination, bool premultiplied, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadImageBgra(destination, premultiplied, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    NSBitmapImageRep *bitmapRep = getBitmapImageRepFromPasteboard();
+    CGImageRef cgImage = bitmapRep ? bitmapRep.CGImage : nullptr;
+    if (!cgImage || CGImageGetWidth(cgImage) == 0 || CGImageGetHeight(cgImage) == 0) {
+        return false;
+    }
+    auto width = static_cast<uint32_t>(CGImageGetWidth(cgImage));
+    auto height = static_cast<uint32_t>(CGImageGetHeight(cgImage));
+    char *out = destination(width, height);
+    if (!out) {
+        return false;
+    }
+    size_t stride = static_cast<size_t>(width) * 4;
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGContextRef context = CGBitmapContextCreate(out, width, height, 8, stride, colorSpace,
+                                                 kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return false;
+    }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), cgImage);
+    CGContextRelease(context);
+    for (uint32_t y = 0; !premultiplied && y < height; ++y) {
+        UnpremultiplyRow(reinterpret_cast<uint8_t *>(out + y * stride), width);
+    }
+    return true;
+}
+
+bool ReadClipboardJpeg(ClipboardData &data, ClipboardSelection selection, ProgressSink *progress) {
+    // Lossless transforms need libjpeg, which is not linked on macOS
+    return false;
+}
+
+bool ReadClipboardTarget(const std::string &mime_type, ClipboardSelection selection, const ChunkConsumer &consume) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadTarget(mime_type, selection, consume);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    static NSDictionary<NSString *, NSString *> *const types = @{
+        @"text/plain": NSPasteboardTypeString,
+        @"text/plain;charset=utf-8": NSPasteboardTypeString,
+        @"text/html": NSPasteboardTypeHTML,
+        @"text/rtf": NSPasteboardTypeRTF,
+        @"image/png": NSPasteboardTypePNG,
+        @"image/tiff": NSPasteboardTypeTIFF,
+        @"image/jpeg": @"public.jpeg",
+        @"text/uri-list": NSPasteboardTypeFileURL,
+    };
+    @autoreleasepool {
+        NSString *name = [NSString stringWithUTF8String:mime_type.c_str()];
+        NSString *type = types[name] ?: name;
+        NSData *data = [[NSPasteboard generalPasteboard] dataForType:type];
+        if (!data) {
+            return false;
+        }
+        // Large flavors may be backed by several ranges
+        __block bool ok = true;
+        [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange range, BOOL *stop) {
+            if (!consume(static_cast<const char *>(bytes), range.length)) {
+                ok = false;
+                *stop = YES;
+            }
+        }];
+        return ok;
+    }
+}
+
+bool DecodeImageFile(const std::string &path, uint32_t max_size, ImagePixels &image) {
+    NSURL *url = [NSURL fileURLWithPath:[NSString stringWithUTF8String:path.c_str()]];
+    CGImageSourceRef source = CGImageSourceCreateWithURL((__bridge CFURLRef) url, nullptr);
+    if (!source) {
+        return false;
+    }
+    // ImageIO thumbnails decode JPEGs subsampled and apply the EXIF orientation
+    CGImageRef cgImage = nullptr;
+    if (max_size) {
+        NSDictionary *options = @{
+                (__bridge NSString *) kCGImageSourceCreateThumbnailFromImageAlways: @YES,
+                (__bridge NSString *) kCGImageSourceCreateThumbnailWithTransform: @YES,
+                (__bridge NSString *) kCGImageSourceThumbnailMaxPixelSize: @(max_size),
+                (__bridge NSString *) kCGImageSourceShouldCacheImmediately: @YES,
+        };
+        cgImage = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef) options);
+    } else {
+        cgImage = CGImageSourceCreateImageAtIndex(source, 0, nullptr);
+    }
+    CFRelease(source);
+    if (!cgImage) {
+        return false;
+    }
+    bool ok = CGImageToPixels(cgImage, image);
+    CGImageRelease(cgImage);
+    return ok;
+}
+
+bool DecodeImageData(const char *data, size_t size, ImagePixels &image) {
+    NSData *bytes = [NSData dataWithBytesNoCopy:const_cast<char *>(data) length:size freeWhenDone:NO];
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef) bytes, nullptr);
+    if (!source) {
+        return false;
+    }
+    CGImageRef cgImage = CGImageSourceCreateImageAtIndex(source, 0, nullptr);
+    CFRelease(source);
+    if (!cgImage) {
+        return false;
+    }
+    bool ok = CGImageToPixels(cgImage, image);
+    CGImageRelease(cgImage);
+    return ok;
+}
+
+bool SaveImagePixels(const ImagePixels &image, const std::string &target_path, ImageFormat format,
+                     float quality, ProgressSink *progress) {
+    if (!image.pixels.data() || !image.width || !image.height ||
+        !ReportProgress(progress, ProgressPhase::Encode, 0, 0)) {
+        return false;
+    }
+
+    unsigned char *planes[] = {reinterpret_cast<unsigned char *>(image.pixels.data())};
+    NSBitmapImageRep *bitmapRep = [[NSBitmapImageRep alloc]
+            initWithBitmapDataPlanes:planes pixelsWide:image.width pixelsHigh:image.height
+                       bitsPerSample:8 samplesPerPixel:4 hasAlpha:YES isPlanar:NO
+                      colorSpaceName:NSDeviceRGBColorSpace bitmapFormat:NSBitmapFormatAlphaNonpremultiplied
+                         bytesPerRow:image.stride bitsPerPixel:32];
+    if (!bitmapRep) {
+        return false;
+    }
+
+    NSData *imageData = format == ImageFormat::Jpeg
+            ? [bitmapRep representationUsingType:NSBitmapImageFileTypeJPEG properties:@{
+                    NSImageCompressionFactor: @(quality)
+            }]
+            : [bitmapRep representationUsingType:NSBitmapImageFileTypePNG properties:@{}];
+    if (!imageData || !ReportProgress(progress, ProgressPhase::Encode, imageData.length, imageData.length)) {
+        return false;
+    }
+
+    return [imageData writeToFile:[NSString stringWithUTF8String:target_path.c_str()] atomically:YES];
+}
+
+bool PutImageIntoClipboard(const std::string &image_path, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::PutImage(image_path, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     NSImage *image = [[NSImage alloc] initWithContentsOfFile:[NSString stringWithUTF8String:image_path.c_str()]];
     if (!image) {
         return false;
@@ -96,7 +384,171 @@ bool PutImageIntoClipboard(const std::string &image_path) {
     return [pasteboard writeObjects:@[image]];
 }
 
-bool ClipboardHasImage() {
+bool ClipboardHasImage(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::HasImage(selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
     return [pasteboard canReadObjectForClasses:@[NSImage.class] options:nil];
 }
+
+RichContent ReadRich(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadRich(selection);
+    }
+    RichContent content;
+    if (selection != ClipboardSelection::Clipboard) {
+        return content;
+    }
+
+    NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+    NSString *html = [pasteboard stringForType:NSPasteboardTypeHTML];
+    if (html) {
+        content.html = [html UTF8String];
+    }
+    NSData *rtf = [pasteboard dataForType:NSPasteboardTypeRTF];
+    if (rtf) {
+        content.rtf.assign(static_cast<const char *>(rtf.bytes), rtf.length);
+    }
+    NSString *text = [pasteboard stringForType:NSPasteboardTypeString];
+    if (text) {
+        content.text = [text UTF8String];
+    }
+    return content;
+}
+
+bool WriteRich(const RichContent &content, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::WriteRich(content, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+
+    NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+    [pasteboard clearContents];
+    bool ok = true;
+    if (!content.html.empty()) {
+        ok &= [pasteboard setString:[NSString stringWithUTF8String:content.html.c_str()]
+                            forType:NSPasteboardTypeHTML];
+    }
+    if (!content.rtf.empty()) {
+        ok &= [pasteboard setData:[NSData dataWithBytes:content.rtf.data() length:content.rtf.size()]
+                          forType:NSPasteboardTypeRTF];
+    }
+    std::string text = content.text.empty() ? HtmlToText(content.html.data(), content.html.size()) : content.text;
+    if (!text.empty()) {
+        ok &= [pasteboard setString:[NSString stringWithUTF8String:text.c_str()]
+                            forType:NSPasteboardTypeString];
+    }
+    return ok;
+}
+
+bool WriteMulti(const MultiContent &content, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::WriteMulti(content, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+
+    NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:content.file_paths.size() + 1];
+    for (const auto &path : content.file_paths) {
+        NSString *pathStr = [NSString stringWithUTF8String:path.c_str()];
+        [objects addObject:[NSURL fileURLWithPath:pathStr]];
+    }
+
+    NSImage *image = nil;
+    if (!content.image_path.empty()) {
+        image = [[NSImage alloc] initWithContentsOfFile:[NSString stringWithUTF8String:content.image_path.c_str()]];
+    } else if (!content.image_data.empty()) {
+        NSData *data = [NSData dataWithBytes:content.image_data.data() length:content.image_data.size()];
+        image = [[NSImage alloc] initWithData:data];
+    }
+    if ((!content.image_path.empty() || !content.image_data.empty()) && !image) {
+        return false;
+    }
+    if (image) {
+        [objects addObject:image];
+    }
+
+    std::string text = content.text;
+    if (text.empty()) {
+        for (size_t i = 0; i < content.file_paths.size(); ++i) {
+            text += content.file_paths[i];
+            if (i + 1 < content.file_paths.size()) {
+                text += "\n";
+            }
+        }
+        if (text.empty()) {
+            text = content.image_path;
+        }
+    }
+
+    NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+    [pasteboard clearContents];
+    bool ok = objects.count == 0 || [pasteboard writeObjects:objects];
+    if (!text.empty()) {
+        ok &= [pasteboard setString:[NSString stringWithUTF8String:text.c_str()] forType:NSPasteboardTypeString];
+    }
+    return ok;
+}
+
+uint64_t ClipboardSequenceNumber(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::SequenceNumber(selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return 0;
+    }
+    return static_cast<uint64_t>([[NSPasteboard generalPasteboard] changeCount]);
+}
+
+bool ReadText(ClipboardData &text, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadText(text, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    NSString *string = [[NSPasteboard generalPasteboard] stringForType:NSPasteboardTypeString];
+    if (!string) {
+        return false;
+    }
+
+    NSUInteger length = [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    char *bytes = static_cast<char *>(malloc(length + 1));
+    if (!bytes) {
+        return false;
+    }
+    NSUInteger used = 0;
+    [string getBytes:bytes maxLength:length usedLength:&used encoding:NSUTF8StringEncoding
+             options:0 range:NSMakeRange(0, string.length) remainingRange:NULL];
+    bytes[used] = '\0';
+    text = ClipboardData(bytes, used, free, bytes);
+    return true;
+}
+
+bool WriteText(const char *data, size_t size, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::WriteText(data, size, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    NSString *string = [[NSString alloc] initWithBytes:data length:size encoding:NSUTF8StringEncoding];
+    if (!string) {
+        return false;
+    }
+
+    NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+    [pasteboard clearContents];
+    return [pasteboard setString:string forType:NSPasteboardTypeString];
+}
+
+ClipboardStats GetClipboardStats() {
+    return ClipboardStats();
+}
@@ -1,8 +1,19 @@
 #include <Windows.h>
 #include <ShlObj.h>
+#include <Shlwapi.h>
 #include <gdiplus.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <cstdio>
+#include <map>
 #include <memory>
+#include <mutex>
 #include "clipboard.h"
+#include "clipboard_formats.h"
+#include "html_text.h"
+#include "image_ops.h"
+#include "memory_clipboard.h"
 
 using namespace Gdiplus;
 
@@ -13,6 +24,13 @@ std::string Utf16CStringToUtf8String(LPCWSTR input, UINT len) {
     return result;
 }
 
+std::string AnsiCStringToUtf8String(LPCSTR input, UINT len) {
+    int wide_len = MultiByteToWideChar(CP_ACP, 0, input, len, NULL, 0);
+    std::unique_ptr<WCHAR[]> wide(new WCHAR[wide_len]);
+    MultiByteToWideChar(CP_ACP, 0, input, len, wide.get(), wide_len);
+    return Utf16CStringToUtf8String(wide.get(), wide_len);
+}
+
 class ClipboardScope {
 
     bool valid;
@@ -31,29 +49,62 @@ public:
     }
 };
 
-std::vector<std::string> ReadFilePaths() {
-    auto result = std::vector<std::string>();
-
+// Calls `add` with each CF_HDROP path converted to UTF-8
+template<typename Add>
+void ReadDropFilePaths(Add add) {
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
-        return result;
+        return;
     }
 
-    HDROP drop_files_handle = (HDROP)GetClipboardData(CF_HDROP);
+    HANDLE drop_files_handle = GetClipboardData(CF_HDROP);
     if (!drop_files_handle) {
-        return result;
+        return;
+    }
+    const uint8_t *data = static_cast<const uint8_t *>(GlobalLock(drop_files_handle));
+    if (!data) {
+        return;
     }
 
-    UINT file_count = DragQueryFileW(drop_files_handle, 0xFFFFFFFF, NULL, 0);
-    result.reserve(file_count);
-    for (UINT i = 0; i < file_count; ++i) {
-        UINT path_len = DragQueryFileW(drop_files_handle, i, NULL, 0);
-        UINT buffer_len = path_len + 1;
-        std::unique_ptr<WCHAR[]> buffer(new WCHAR[buffer_len]);
-        path_len = DragQueryFileW(drop_files_handle, i, buffer.get(), buffer_len);
-        result.emplace_back(Utf16CStringToUtf8String(buffer.get(), path_len));
+    clipboard_formats::DropFilesReader reader(data, GlobalSize(drop_files_handle));
+    const uint8_t *path;
+    size_t length;
+    while (reader.Next(path, length)) {
+        if (reader.wide()) {
+            add(Utf16CStringToUtf8String(reinterpret_cast<LPCWSTR>(path), static_cast<UINT>(length)));
+        } else {
+            add(AnsiCStringToUtf8String(reinterpret_cast<LPCSTR>(path), static_cast<UINT>(length)));
+        }
+    }
+    GlobalUnlock(drop_files_handle);
+}
+
+std::vector<std::string> ReadFilePaths(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadFilePaths(selection);
+    }
+    auto result = std::vector<std::string>();
+    if (selection != ClipboardSelection::Clipboard) {
+        return result;
     }
+    ReadDropFilePaths([&result](std::string &&path) {
+        result.emplace_back(std::move(path));
+    });
+    return result;
+}
 
+PathList ReadFilePathList(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        std::vector<std::string> file_paths = memory_clipboard::ReadFilePaths(selection);
+        return PathList(file_paths.begin(), file_paths.end());
+    }
+    PathList result;
+    if (selection != ClipboardSelection::Clipboard) {
+        return result;
+    }
+    ReadDropFilePaths([&result](std::string &&path) {
+        result.Append(path);
+    });
     return result;
 }
 
@@ -74,51 +125,46 @@ std::wstring LongPathToShort(const std::wstring &long_path) {
     return buffer_pointer.get() + offset;
 }
 
-void WriteFilePaths(const std::vector<std::string> &file_paths) {
+// CF_HDROP payload: DROPFILES followed by a double null-terminated path list.
+// `Paths` is a std::vector<std::string> or a PathList.
+template<typename Paths>
+HANDLE CreateDropFilesHandle(const Paths &file_paths) {
     std::vector<std::wstring> file_paths_unicode;
     file_paths_unicode.reserve(file_paths.size());
-    for (auto p = file_paths.cbegin(); p != file_paths.cend(); ++p) {
-        std::wstring path_unicode = Utf8StringToUtf16String(*p);
+    for (const std::string &path : file_paths) {
+        std::wstring path_unicode = Utf8StringToUtf16String(path);
         if (path_unicode.size() > MAX_PATH) {
             path_unicode = LongPathToShort(path_unicode);
         }
         file_paths_unicode.emplace_back(path_unicode);
     }
 
-    // size of DROPFILES structure followed by file paths in double null-terminated string
-    SIZE_T structure_size_in_bytes = sizeof(DROPFILES);
-    for (auto p = file_paths_unicode.cbegin(); p != file_paths_unicode.cend(); ++p) {
-        structure_size_in_bytes += (p->size() + 1) * sizeof(WCHAR);
-    }
-    structure_size_in_bytes += sizeof(WCHAR);
-
+    SIZE_T structure_size_in_bytes = clipboard_formats::EncodeDropFilesWide(
+            file_paths_unicode.cbegin(), file_paths_unicode.cend(), nullptr, 0);
     HANDLE data_handle = GlobalAlloc(GMEM_MOVEABLE, structure_size_in_bytes);
     if (!data_handle) {
-        return;
+        return NULL;
     }
 
     BYTE *data_pointer = static_cast<BYTE *>(GlobalLock(data_handle));
     if (!data_pointer) {
-        return;
-    }
-
-    DROPFILES *drop_files_pointer = reinterpret_cast<DROPFILES *>(data_pointer);
-    drop_files_pointer->pFiles = sizeof(DROPFILES);
-    drop_files_pointer->fWide = TRUE;
-
-    SIZE_T current_offset_in_bytes = sizeof(DROPFILES);
-    for (auto p = file_paths_unicode.cbegin(); p != file_paths_unicode.cend(); ++p) {
-        WCHAR *target_path = reinterpret_cast<WCHAR *>(data_pointer + current_offset_in_bytes);
-        SIZE_T offset_in_chars = p->size() + 1;
-        SIZE_T offset_in_bytes = offset_in_chars * sizeof(WCHAR);
-        memcpy(target_path, p->c_str(), offset_in_bytes);
-        current_offset_in_bytes += offset_in_bytes;
+        GlobalFree(data_handle);
+        return NULL;
     }
 
-    WCHAR *tail = reinterpret_cast<WCHAR *>(data_pointer + current_offset_in_bytes);
-    *tail = L'\0';
+    clipboard_formats::EncodeDropFilesWide(file_paths_unicode.cbegin(), file_paths_unicode.cend(),
+                                           data_pointer, structure_size_in_bytes);
 
     GlobalUnlock(data_handle);
+    return data_handle;
+}
+
+template<typename Paths>
+void WriteDropFilePaths(const Paths &file_paths) {
+    HANDLE data_handle = CreateDropFilesHandle(file_paths);
+    if (!data_handle) {
+        return;
+    }
 
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
@@ -134,7 +180,36 @@ void WriteFilePaths(const std::vector<std::string> &file_paths) {
     }
 }
 
-void ClearClipboard() {
+void WriteFilePaths(const std::vector<std::string> &file_paths, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        memory_clipboard::WriteFilePaths(file_paths, selection);
+        return;
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return;
+    }
+    WriteDropFilePaths(file_paths);
+}
+
+void WriteFilePathList(const PathList &file_paths, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        memory_clipboard::WriteFilePaths(std::vector<std::string>(file_paths.begin(), file_paths.end()), selection);
+        return;
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return;
+    }
+    WriteDropFilePaths(file_paths);
+}
+
+void ClearClipboard(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        memory_clipboard::Clear(selection);
+        return;
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return;
+    }
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
         return;
@@ -169,7 +244,7 @@ struct FreeDeleter {
     }
 };
 
-bool GetEncoderClsid(const WCHAR *format, CLSID *pClsid)
+bool FindEncoderClsid(const WCHAR *format, CLSID *pClsid)
 {
     UINT  num = 0;          // number of image encoders
     UINT  size = 0;         // size of the image encoder array in bytes
@@ -200,6 +275,30 @@ bool GetEncoderClsid(const WCHAR *format, CLSID *pClsid)
     return false;
 }
 
+std::mutex encoder_mutex;
+std::map<std::wstring, CLSID> encoder_clsids;
+std::atomic<uint64_t> encoder_lookups{0};
+std::atomic<uint64_t> encoder_hits{0};
+
+// The installed encoders do not change while we run, so each format is
+// enumerated once instead of on every save
+bool GetEncoderClsid(const WCHAR *format, CLSID *pClsid)
+{
+    encoder_lookups.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(encoder_mutex);
+    auto it = encoder_clsids.find(format);
+    if (it != encoder_clsids.end()) {
+        encoder_hits.fetch_add(1, std::memory_order_relaxed);
+        *pClsid = it->second;
+        return true;
+    }
+    if (!FindEncoderClsid(format, pClsid)) {
+        return false;
+    }
+    encoder_clsids.emplace(format, *pClsid);
+    return true;
+}
+
 bool SaveBitmapAsJpeg(HBITMAP hBmp, LPCWSTR lpszFilename, ULONG uQuality)
 {
     GdiplusScope gdiplus_scope;
@@ -242,14 +341,22 @@ bool SaveBitmapAsPng(HBITMAP hBmp, LPCWSTR lpszFilename)
 }
 
 
-bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor) {
+bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_factor,
+                              ClipboardSelection selection, ProgressSink *progress) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::SaveImage(target_path, ImageFormat::Jpeg, compression_factor, selection, progress);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
         return false;
     }
 
     HBITMAP image_handle = (HBITMAP)GetClipboardData(CF_BITMAP);
-    if (!image_handle) {
+    // GDI+ encodes in one call, it can only be cancelled before
+    if (!image_handle || !ReportProgress(progress, ProgressPhase::Encode, 0, 0)) {
         return false;
     }
 
@@ -258,14 +365,21 @@ bool SaveClipboardImageAsJpeg(const std::string &target_path, float compression_
     return SaveBitmapAsJpeg(image_handle, target_path_unicode.c_str(), quality);
 }
 
-bool SaveClipboardImageAsPng(const std::string &target_path) {
+bool SaveClipboardImageAsPng(const std::string &target_path, ClipboardSelection selection,
+                             ProgressSink *progress) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::SaveImage(target_path, ImageFormat::Png, 0, selection, progress);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
         return false;
     }
 
     HBITMAP image_handle = (HBITMAP)GetClipboardData(CF_BITMAP);
-    if (!image_handle) {
+    if (!image_handle || !ReportProgress(progress, ProgressPhase::Encode, 0, 0)) {
         return false;
     }
 
@@ -273,38 +387,312 @@ bool SaveClipboardImageAsPng(const std::string &target_path) {
     return SaveBitmapAsPng(image_handle, target_path_unicode.c_str());
 }
 
-bool PutImageIntoClipboard(const std::string &image_path) {
+bool ReadImagePixels(ImagePixels &image, ClipboardSelection selection, ProgressSink *progress) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadImagePixels(image, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    ClipboardScope clipboard_scope;
+    if (!clipboard_scope.IsValid()) {
+        return false;
+    }
+
+    // CF_DIB is synthesized from CF_BITMAP and keeps 32 bit alpha
+    HANDLE dib_handle = GetClipboardData(CF_DIB);
+    const uint8_t *dib = dib_handle ? static_cast<const uint8_t *>(GlobalLock(dib_handle)) : nullptr;
+    if (!dib) {
+        return false;
+    }
+    size_t dib_size = GlobalSize(dib_handle);
+    clipboard_formats::DibInfo info;
+    bool ok = clipboard_formats::ParseDib(dib, dib_size, info) &&
+              ReportProgress(progress, ProgressPhase::Decode, 0, info.height);
+    if (ok) {
+        image.width = info.width;
+        image.height = info.height;
+        image.stride = static_cast<size_t>(info.width) * 4;
+        image.pixels = PooledBuffer(image.stride * image.height);
+        ok = image.pixels.data() &&
+             clipboard_formats::DecodeDibPixels(dib, dib_size, info, clipboard_formats::PixelFormat::Rgba,
+                                                reinterpret_cast<uint8_t *>(image.pixels.data()), image.stride);
+    }
+    GlobalUnlock(dib_handle);
+    return ok && ReportProgress(progress, ProgressPhase::Decode, image.height, image.height);
+}
+
+// The clipboard may be opened from any thread
+bool ReadImagePixelsAnyThread(ImagePixels &image, ClipboardSelection selection) {
+    return ReadImagePixels(image, selection);
+}
+
+bool ReadImageBgra(const PixelDestination &destination, bool premultiplied, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadImageBgra(destination, premultiplied, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    ClipboardScope clipboard_scope;
+    if (!clipboard_scope.IsValid()) {
+        return false;
+    }
+    HANDLE dib_handle = GetClipboardData(CF_DIB);
+    const uint8_t *dib = dib_handle ? static_cast<const uint8_t *>(GlobalLock(dib_handle)) : nullptr;
+    if (!dib) {
+        return false;
+    }
+    size_t dib_size = GlobalSize(dib_handle);
+    clipboard_formats::DibInfo info;
+    bool ok = clipboard_formats::ParseDib(dib, dib_size, info);
+    char *out = ok ? destination(info.width, info.height) : nullptr;
+    // Straight alpha RGBA rows, swapped and premultiplied in place below
+    size_t stride = static_cast<size_t>(info.width) * 4;
+    ok = out && clipboard_formats::DecodeDibPixels(dib, dib_size, info, clipboard_formats::PixelFormat::Rgba,
+                                                   reinterpret_cast<uint8_t *>(out), stride);
+    GlobalUnlock(dib_handle);
+    for (uint32_t y = 0; ok && y < info.height; ++y) {
+        auto *row = reinterpret_cast<uint8_t *>(out + y * stride);
+        RowToBgra(row, 4, info.width, premultiplied, row);
+    }
+    return ok;
+}
+
+// Decodes the first frame through WIC, whose scaler asks the JPEG decoder
+// for a DCT scaled frame (IWICBitmapSourceTransform) before resampling
+bool DecodeFrameWic(IWICImagingFactory *factory, IWICBitmapDecoder *decoder, uint32_t max_size,
+                    ImagePixels &image) {
+    using Microsoft::WRL::ComPtr;
+    ComPtr<IWICBitmapFrameDecode> frame;
+    if (FAILED(decoder->GetFrame(0, &frame))) {
+        return false;
+    }
+    UINT width = 0, height = 0;
+    if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0) {
+        return false;
+    }
+
+    ComPtr<IWICBitmapSource> source = frame;
+    UINT longest = max(width, height);
+    if (max_size && longest > max_size) {
+        UINT fit_width = max(1u, static_cast<UINT>((static_cast<uint64_t>(width) * max_size + longest / 2) / longest));
+        UINT fit_height = max(1u, static_cast<UINT>((static_cast<uint64_t>(height) * max_size + longest / 2) / longest));
+        ComPtr<IWICBitmapScaler> scaler;
+        if (FAILED(factory->CreateBitmapScaler(&scaler)) ||
+            FAILED(scaler->Initialize(frame.Get(), fit_width, fit_height, WICBitmapInterpolationModeFant))) {
+            return false;
+        }
+        source = scaler;
+        width = fit_width;
+        height = fit_height;
+    }
+
+    ComPtr<IWICFormatConverter> converter;
+    if (FAILED(factory->CreateFormatConverter(&converter)) ||
+        FAILED(converter->Initialize(source.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, NULL, 0,
+                                     WICBitmapPaletteTypeCustom))) {
+        return false;
+    }
+    image.width = width;
+    image.height = height;
+    image.stride = static_cast<size_t>(width) * 4;
+    image.pixels = PooledBuffer(image.stride * image.height);
+    return image.pixels.data() &&
+           SUCCEEDED(converter->CopyPixels(NULL, static_cast<UINT>(image.stride),
+                                           static_cast<UINT>(image.stride * image.height),
+                                           reinterpret_cast<BYTE *>(image.pixels.data())));
+}
+
+// Runs `decode(factory)` with COM initialized on the calling thread, which
+// may be a worker thread that has or has not initialized it already
+template<typename Func>
+bool WithWicFactory(Func decode) {
+    HRESULT init = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    bool ok = false;
+    {
+        Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+        if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER,
+                                       IID_PPV_ARGS(&factory)))) {
+            ok = decode(factory.Get());
+        }
+    }
+    if (SUCCEEDED(init)) {
+        CoUninitialize();
+    }
+    return ok;
+}
+
+bool ReadClipboardJpeg(ClipboardData &data, ClipboardSelection selection, ProgressSink *progress) {
+    // Lossless transforms need libjpeg, which is not linked on Windows
+    return false;
+}
+
+bool ReadClipboardTarget(const std::string &mime_type, ClipboardSelection selection, const ChunkConsumer &consume) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadTarget(mime_type, selection, consume);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    UINT format;
+    if (mime_type == "text/plain" || mime_type == "text/plain;charset=utf-8") {
+        format = CF_UNICODETEXT;
+    } else if (mime_type == "image/bmp") {
+        format = CF_DIB;
+    } else {
+        std::wstring name = mime_type == "image/png" ? L"PNG"
+                : mime_type == "text/html" ? L"HTML Format"
+                : mime_type == "text/rtf" ? L"Rich Text Format"
+                : Utf8StringToUtf16String(mime_type);
+        format = RegisterClipboardFormatW(name.c_str());
+    }
+
+    ClipboardScope clipboard_scope;
+    if (!format || !clipboard_scope.IsValid()) {
+        return false;
+    }
+    HANDLE data_handle = GetClipboardData(format);
+    if (!data_handle) {
+        return false;
+    }
+    const char *bytes = static_cast<const char *>(GlobalLock(data_handle));
+    if (!bytes) {
+        return false;
+    }
+    // The handle's size, padding included
+    bool ok = consume(bytes, GlobalSize(data_handle));
+    GlobalUnlock(data_handle);
+    return ok;
+}
+
+bool DecodeImageFile(const std::string &path, uint32_t max_size, ImagePixels &image) {
+    std::wstring path_unicode = Utf8StringToUtf16String(path);
+    return WithWicFactory([&](IWICImagingFactory *factory) {
+        Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+        return SUCCEEDED(factory->CreateDecoderFromFilename(path_unicode.c_str(), NULL, GENERIC_READ,
+                                                            WICDecodeMetadataCacheOnDemand, &decoder)) &&
+               DecodeFrameWic(factory, decoder.Get(), max_size, image);
+    });
+}
+
+bool DecodeImageData(const char *data, size_t size, ImagePixels &image) {
+    return WithWicFactory([&](IWICImagingFactory *factory) {
+        Microsoft::WRL::ComPtr<IWICStream> stream;
+        Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+        return SUCCEEDED(factory->CreateStream(&stream)) &&
+               SUCCEEDED(stream->InitializeFromMemory(reinterpret_cast<BYTE *>(const_cast<char *>(data)),
+                                                      static_cast<DWORD>(size))) &&
+               SUCCEEDED(factory->CreateDecoderFromStream(stream.Get(), NULL, WICDecodeMetadataCacheOnDemand,
+                                                          &decoder)) &&
+               DecodeFrameWic(factory, decoder.Get(), 0, image);
+    });
+}
+
+bool SaveImagePixels(const ImagePixels &image, const std::string &target_path, ImageFormat format,
+                     float quality, ProgressSink *progress) {
+    if (!image.pixels.data() || !image.width || !image.height ||
+        !ReportProgress(progress, ProgressPhase::Encode, 0, 0)) {
+        return false;
+    }
     GdiplusScope gdiplus_scope;
     if (!gdiplus_scope.IsValid()) {
         return false;
     }
 
-    std::wstring image_path_unicode = Utf8StringToUtf16String(image_path);
-    std::unique_ptr<Bitmap> pImage(new Bitmap(image_path_unicode.c_str()));
-    HBITMAP handle;
-
-    if (pImage->GetHBITMAP(Color::White, &handle) != Ok) {
+    // GDI+ wants BGRA, swizzle into a second pooled buffer
+    PooledBuffer bgra(image.stride * image.height);
+    if (!bgra.data()) {
         return false;
     }
+    for (uint32_t y = 0; y < image.height; ++y) {
+        const uint8_t *in = reinterpret_cast<const uint8_t *>(image.pixels.data() + y * image.stride);
+        uint8_t *out = reinterpret_cast<uint8_t *>(bgra.data() + y * image.stride);
+        for (uint32_t x = 0; x < image.width; ++x, in += 4, out += 4) {
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = in[0];
+            out[3] = in[3];
+        }
+    }
+    Bitmap bitmap(image.width, image.height, static_cast<INT>(image.stride), PixelFormat32bppARGB,
+                  reinterpret_cast<BYTE *>(bgra.data()));
 
-    BITMAP bm;
-    GetObject(handle, sizeof bm, &bm);
-    BITMAPINFOHEADER bi = { sizeof bi, bm.bmWidth, bm.bmHeight, 1, bm.bmBitsPixel, BI_RGB };
+    CLSID imageCLSID;
+    std::wstring target_path_unicode = Utf8StringToUtf16String(target_path);
+    Status result;
+    if (format == ImageFormat::Jpeg) {
+        if (!GetEncoderClsid(L"image/jpeg", &imageCLSID)) {
+            return false;
+        }
+        ULONG uQuality = (ULONG)(quality * 100);
+        EncoderParameters encoderParams;
+        encoderParams.Count = 1;
+        encoderParams.Parameter[0].NumberOfValues = 1;
+        encoderParams.Parameter[0].Guid = EncoderQuality;
+        encoderParams.Parameter[0].Type = EncoderParameterValueTypeLong;
+        encoderParams.Parameter[0].Value = &uQuality;
+        result = bitmap.Save(target_path_unicode.c_str(), &imageCLSID, &encoderParams);
+    } else {
+        if (!GetEncoderClsid(L"image/png", &imageCLSID)) {
+            return false;
+        }
+        result = bitmap.Save(target_path_unicode.c_str(), &imageCLSID, NULL);
+    }
+    return result == Ok && ReportProgress(progress, ProgressPhase::Encode, 1, 1);
+}
 
-    std::vector<BYTE> vec(bm.bmWidthBytes * bm.bmHeight);
-    auto hdc = GetDC(NULL);
-    GetDIBits(hdc, handle, 0, bi.biHeight, vec.data(), (BITMAPINFO*)&bi, 0);
-    ReleaseDC(NULL, hdc);
+// CF_DIB payload: BITMAPINFOHEADER followed by the 32 bit pixels of `image`
+HANDLE CreateDibHandle(Bitmap *image) {
+    if (image->GetLastStatus() != Ok) {
+        return NULL;
+    }
 
-    auto hmem = GlobalAlloc(GMEM_MOVEABLE, sizeof bi + vec.size());
-    if (!hmem) {
+    Rect rect(0, 0, image->GetWidth(), image->GetHeight());
+    BitmapData bitmap_data;
+    if (image->LockBits(&rect, ImageLockModeRead, PixelFormat32bppARGB, &bitmap_data) != Ok) {
+        return NULL;
+    }
+    if (bitmap_data.Stride <= 0) {
+        image->UnlockBits(&bitmap_data);
+        return NULL;
+    }
+
+    const uint8_t *pixels = static_cast<const uint8_t *>(bitmap_data.Scan0);
+    size_t dib_size = clipboard_formats::EncodeDib(pixels, bitmap_data.Width, bitmap_data.Height, bitmap_data.Stride,
+                                                   clipboard_formats::PixelFormat::Bgra, 32, false, nullptr, 0);
+    auto hmem = dib_size ? GlobalAlloc(GMEM_MOVEABLE, dib_size) : NULL;
+    auto buffer = hmem ? static_cast<uint8_t *>(GlobalLock(hmem)) : nullptr;
+    if (buffer) {
+        clipboard_formats::EncodeDib(pixels, bitmap_data.Width, bitmap_data.Height, bitmap_data.Stride,
+                                     clipboard_formats::PixelFormat::Bgra, 32, false, buffer, dib_size);
+        GlobalUnlock(hmem);
+    } else if (hmem) {
+        GlobalFree(hmem);
+        hmem = NULL;
+    }
+    image->UnlockBits(&bitmap_data);
+    return hmem;
+}
+
+bool PutImageIntoClipboard(const std::string &image_path, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::PutImage(image_path, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+    GdiplusScope gdiplus_scope;
+    if (!gdiplus_scope.IsValid()) {
         return false;
     }
 
-    auto buffer = (BYTE*)GlobalLock(hmem);
-    memcpy(buffer, &bi, sizeof bi);
-    memcpy(buffer + sizeof bi, vec.data(), vec.size());
-    GlobalUnlock(hmem);
+    std::wstring image_path_unicode = Utf8StringToUtf16String(image_path);
+    std::unique_ptr<Bitmap> pImage(new Bitmap(image_path_unicode.c_str()));
+    auto hmem = CreateDibHandle(pImage.get());
+    if (!hmem) {
+        return false;
+    }
 
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
@@ -322,11 +710,352 @@ bool PutImageIntoClipboard(const std::string &image_path) {
     return true;
 }
 
-bool ClipboardHasImage() {
+bool ClipboardHasImage(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::HasImage(selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
     ClipboardScope clipboard_scope;
     if (!clipboard_scope.IsValid()) {
         return false;
     }
 
     return static_cast<bool>(GetClipboardData(CF_BITMAP));
-}
\ No newline at end of file
+}
+
+bool ReadText(ClipboardData &text, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadText(text, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+
+    ClipboardScope clipboard_scope;
+    if (!clipboard_scope.IsValid()) {
+        return false;
+    }
+
+    HANDLE data_handle = GetClipboardData(CF_UNICODETEXT);
+    if (!data_handle) {
+        return false;
+    }
+    LPCWSTR wide = static_cast<LPCWSTR>(GlobalLock(data_handle));
+    if (!wide) {
+        return false;
+    }
+
+    // CF_UNICODETEXT is null-terminated, the handle may be larger than the text
+    int wide_len = static_cast<int>(wcsnlen(wide, GlobalSize(data_handle) / sizeof(WCHAR)));
+    int target_len = WideCharToMultiByte(CP_UTF8, 0, wide, wide_len, NULL, 0, NULL, NULL);
+    char *bytes = static_cast<char *>(malloc(target_len + 1));
+    if (!bytes) {
+        GlobalUnlock(data_handle);
+        return false;
+    }
+    WideCharToMultiByte(CP_UTF8, 0, wide, wide_len, bytes, target_len, NULL, NULL);
+    bytes[target_len] = '\0';
+    GlobalUnlock(data_handle);
+
+    text = ClipboardData(bytes, target_len, free, bytes);
+    return true;
+}
+
+bool WriteText(const char *data, size_t size, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::WriteText(data, size, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+
+    int wide_len = MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(size), NULL, 0);
+    HANDLE data_handle = GlobalAlloc(GMEM_MOVEABLE, (wide_len + 1) * sizeof(WCHAR));
+    if (!data_handle) {
+        return false;
+    }
+    WCHAR *wide = static_cast<WCHAR *>(GlobalLock(data_handle));
+    if (!wide) {
+        GlobalFree(data_handle);
+        return false;
+    }
+    MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(size), wide, wide_len);
+    wide[wide_len] = L'\0';
+    GlobalUnlock(data_handle);
+
+    ClipboardScope clipboard_scope;
+    if (!clipboard_scope.IsValid()) {
+        GlobalFree(data_handle);
+        return false;
+    }
+
+    EmptyClipboard();
+
+    if (!SetClipboardData(CF_UNICODETEXT, data_handle)) {
+        GlobalFree(data_handle);
+        return false;
+    }
+    return true;
+}
+
+HANDLE CreateUnicodeTextHandle(const std::string &text) {
+    std::wstring text_unicode = Utf8StringToUtf16String(text);
+    HANDLE data_handle = GlobalAlloc(GMEM_MOVEABLE, (text_unicode.size() + 1) * sizeof(WCHAR));
+    if (!data_handle) {
+        return NULL;
+    }
+    WCHAR *wide = static_cast<WCHAR *>(GlobalLock(data_handle));
+    if (!wide) {
+        GlobalFree(data_handle);
+        return NULL;
+    }
+    memcpy(wide, text_unicode.c_str(), (text_unicode.size() + 1) * sizeof(WCHAR));
+    GlobalUnlock(data_handle);
+    return data_handle;
+}
+
+// Wraps an HTML fragment in the CF_HTML description header
+std::string EncodeCfHtml(const std::string &fragment) {
+    const char *header_format =
+            "Version:0.9\r\n"
+            "StartHTML:%010d\r\n"
+            "EndHTML:%010d\r\n"
+            "StartFragment:%010d\r\n"
+            "EndFragment:%010d\r\n";
+    const std::string prefix = "<html><body>\r\n<!--StartFragment-->";
+    const std::string suffix = "<!--EndFragment-->\r\n</body></html>";
+
+    int header_size = snprintf(nullptr, 0, header_format, 0, 0, 0, 0);
+    int start_html = header_size;
+    int start_fragment = start_html + static_cast<int>(prefix.size());
+    int end_fragment = start_fragment + static_cast<int>(fragment.size());
+    int end_html = end_fragment + static_cast<int>(suffix.size());
+
+    std::string result(header_size + 1, '\0');
+    snprintf(&result[0], result.size(), header_format, start_html, end_html, start_fragment, end_fragment);
+    result.resize(header_size);
+    return result + prefix + fragment + suffix;
+}
+
+std::string DecodeCfHtml(const std::string &data) {
+    auto read_offset = [&data](const char *key) -> long {
+        size_t pos = data.find(key);
+        if (pos == std::string::npos) {
+            return -1;
+        }
+        return strtol(data.c_str() + pos + strlen(key), nullptr, 10);
+    };
+    long start = read_offset("StartFragment:");
+    long end = read_offset("EndFragment:");
+    if (start < 0 || end < start || static_cast<size_t>(end) > data.size()) {
+        return std::string();
+    }
+    return data.substr(start, end - start);
+}
+
+std::string GetClipboardBytes(UINT format) {
+    HANDLE data_handle = GetClipboardData(format);
+    if (!data_handle) {
+        return std::string();
+    }
+    const char *bytes = static_cast<const char *>(GlobalLock(data_handle));
+    if (!bytes) {
+        return std::string();
+    }
+    // Both CF_HTML and RTF are null-terminated, the handle may be padded
+    std::string result(bytes, strnlen(bytes, GlobalSize(data_handle)));
+    GlobalUnlock(data_handle);
+    return result;
+}
+
+bool SetClipboardBytes(UINT format, const std::string &data) {
+    HANDLE data_handle = GlobalAlloc(GMEM_MOVEABLE, data.size() + 1);
+    if (!data_handle) {
+        return false;
+    }
+    char *bytes = static_cast<char *>(GlobalLock(data_handle));
+    if (!bytes) {
+        GlobalFree(data_handle);
+        return false;
+    }
+    memcpy(bytes, data.c_str(), data.size() + 1);
+    GlobalUnlock(data_handle);
+
+    if (!SetClipboardData(format, data_handle)) {
+        GlobalFree(data_handle);
+        return false;
+    }
+    return true;
+}
+
+RichContent ReadRich(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::ReadRich(selection);
+    }
+    RichContent content;
+    if (selection != ClipboardSelection::Clipboard) {
+        return content;
+    }
+
+    {
+        ClipboardScope clipboard_scope;
+        if (!clipboard_scope.IsValid()) {
+            return content;
+        }
+        content.html = DecodeCfHtml(GetClipboardBytes(RegisterClipboardFormatW(L"HTML Format")));
+        content.rtf = GetClipboardBytes(RegisterClipboardFormatW(L"Rich Text Format"));
+    }
+
+    ClipboardData text;
+    if (ReadText(text, selection)) {
+        content.text.assign(text.data(), text.size());
+    }
+    return content;
+}
+
+bool WriteRich(const RichContent &content, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::WriteRich(content, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+
+    std::string text = content.text.empty() ? HtmlToText(content.html.data(), content.html.size()) : content.text;
+
+    ClipboardScope clipboard_scope;
+    if (!clipboard_scope.IsValid()) {
+        return false;
+    }
+
+    EmptyClipboard();
+
+    bool ok = true;
+    if (!content.html.empty()) {
+        ok &= SetClipboardBytes(RegisterClipboardFormatW(L"HTML Format"), EncodeCfHtml(content.html));
+    }
+    if (!content.rtf.empty()) {
+        ok &= SetClipboardBytes(RegisterClipboardFormatW(L"Rich Text Format"), content.rtf);
+    }
+    if (!text.empty()) {
+        HANDLE text_handle = CreateUnicodeTextHandle(text);
+        if (!text_handle || !SetClipboardData(CF_UNICODETEXT, text_handle)) {
+            if (text_handle) {
+                GlobalFree(text_handle);
+            }
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool WriteMulti(const MultiContent &content, ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::WriteMulti(content, selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return false;
+    }
+
+    // Windows has no lazy rendering without a clipboard window, every
+    // flavor is prepared before taking ownership.
+    std::vector<std::pair<UINT, HANDLE>> handles;
+    auto free_handles = [&handles]() {
+        for (auto &entry : handles) {
+            GlobalFree(entry.second);
+        }
+    };
+
+    if (!content.file_paths.empty()) {
+        HANDLE drop_files = CreateDropFilesHandle(content.file_paths);
+        if (!drop_files) {
+            return false;
+        }
+        handles.emplace_back(CF_HDROP, drop_files);
+    }
+
+    if (!content.image_path.empty() || !content.image_data.empty()) {
+        GdiplusScope gdiplus_scope;
+        if (!gdiplus_scope.IsValid()) {
+            free_handles();
+            return false;
+        }
+        std::unique_ptr<Bitmap> image;
+        if (!content.image_path.empty()) {
+            image.reset(new Bitmap(Utf8StringToUtf16String(content.image_path).c_str()));
+        } else {
+            IStream *stream = SHCreateMemStream(reinterpret_cast<const BYTE *>(content.image_data.data()),
+                                                static_cast<UINT>(content.image_data.size()));
+            if (stream) {
+                image.reset(new Bitmap(stream));
+                stream->Release();
+            }
+        }
+        HANDLE dib = image ? CreateDibHandle(image.get()) : NULL;
+        image.reset();
+        if (!dib) {
+            free_handles();
+            return false;
+        }
+        handles.emplace_back(CF_DIB, dib);
+    }
+
+    std::string text = content.text;
+    if (text.empty()) {
+        for (size_t i = 0; i < content.file_paths.size(); ++i) {
+            text += content.file_paths[i];
+            if (i + 1 < content.file_paths.size()) {
+                text += "\r\n";
+            }
+        }
+        if (text.empty()) {
+            text = content.image_path;
+        }
+    }
+    if (!text.empty()) {
+        HANDLE text_handle = CreateUnicodeTextHandle(text);
+        if (!text_handle) {
+            free_handles();
+            return false;
+        }
+        handles.emplace_back(CF_UNICODETEXT, text_handle);
+    }
+
+    ClipboardScope clipboard_scope;
+    if (!clipboard_scope.IsValid()) {
+        free_handles();
+        return false;
+    }
+
+    EmptyClipboard();
+
+    bool ok = true;
+    for (auto &entry : handles) {
+        if (!SetClipboardData(entry.first, entry.second)) {
+            GlobalFree(entry.second);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+uint64_t ClipboardSequenceNumber(ClipboardSelection selection) {
+    if (memory_clipboard::IsActive()) {
+        return memory_clipboard::SequenceNumber(selection);
+    }
+    if (selection != ClipboardSelection::Clipboard) {
+        return 0;
+    }
+    return GetClipboardSequenceNumber();
+}
+
+ClipboardStats GetClipboardStats() {
+    ClipboardStats stats;
+    stats.codec_contexts.acquires = encoder_lookups.load(std::memory_order_relaxed);
+    stats.codec_contexts.reuses = encoder_hits.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(encoder_mutex);
+    stats.codec_contexts.live = static_cast<uint32_t>(encoder_clsids.size());
+    return stats;
+}
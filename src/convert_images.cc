@@ -0,0 +1,34 @@
+#include "convert_images.h"
+
+#include "image_files.h"
+
+namespace {
+
+const unsigned kMaxThreads = 8;
+
+void Convert(const ConvertTask &task, ConvertResult &result) {
+    ImagePixels image;
+    if (!DecodeImageFile(task.src, task.max_size, image)) {
+        result.error = "Cannot decode " + task.src;
+        return;
+    }
+    result.width = image.width;
+    result.height = image.height;
+    if (!SaveImagePixelsAtomically(image, task.dst, task.format, task.quality)) {
+        result.error = "Cannot write " + task.dst;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<TaskBatch> StartConvertImages(std::vector<ConvertTask> tasks, unsigned concurrency,
+                                              std::shared_ptr<std::vector<ConvertResult>> results,
+                                              std::function<void()> on_done) {
+    unsigned threads = concurrency ? concurrency : TaskBatch::DefaultThreads(kMaxThreads);
+    size_t count = tasks.size();
+    results->assign(count, ConvertResult());
+    auto shared_tasks = std::make_shared<std::vector<ConvertTask>>(std::move(tasks));
+    return TaskBatch::Start(count, threads, [shared_tasks, results](size_t index) {
+        Convert((*shared_tasks)[index], (*results)[index]);
+    }, std::move(on_done));
+}
@@ -0,0 +1,34 @@
+#ifndef ELECTRON_CLIPBOARD_EX_CONVERT_IMAGES_H
+#define ELECTRON_CLIPBOARD_EX_CONVERT_IMAGES_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "clipboard.h"
+#include "task_batch.h"
+
+struct ConvertTask {
+    std::string src;
+    std::string dst;
+    ImageFormat format = ImageFormat::Png;
+    float quality = 0.9f; // JPEG only
+    uint32_t max_size = 0; // Longest edge in pixels, 0 keeps the original size
+};
+
+struct ConvertResult {
+    uint32_t width = 0; // Of the written image
+    uint32_t height = 0;
+    std::string error; // Empty on success
+};
+
+// Converts image files with the backend codecs: decode (scaled while
+// decoding where the codec can), encode, write atomically. At most
+// `concurrency` images are decoded at a time, which bounds memory.
+// `results` is filled by index and complete when `on_done` runs.
+std::shared_ptr<TaskBatch> StartConvertImages(std::vector<ConvertTask> tasks, unsigned concurrency,
+                                              std::shared_ptr<std::vector<ConvertResult>> results,
+                                              std::function<void()> on_done);
+
+#endif //ELECTRON_CLIPBOARD_EX_CONVERT_IMAGES_H
@@ -0,0 +1,622 @@
+#include "deflate_encoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t kWindowSize = 32768;
+const size_t kWindowMask = kWindowSize - 1;
+const int kHashBits = 15;
+const size_t kMinMatch = 4;
+const size_t kMaxMatch = 258;
+// Matches this long end the search
+const size_t kNiceMatch = 128;
+// Longer matches skip lazy evaluation, and only their last positions are
+// indexed: inside a run every position would find the same match again
+const size_t kLazyLimit = 32;
+const size_t kIndexedTail = 4;
+const size_t kBlockTokens = 1 << 16;
+const size_t kMaxStoredBlock = 65535;
+
+const int kLitLenSymbols = 286;
+const int kDistanceSymbols = 30;
+const int kCodeLengthSymbols = 19;
+const int kMaxCodeLength = 15;
+const int kMaxCodeLengthCodeLength = 7;
+const uint16_t kEndOfBlock = 256;
+
+const uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99,
+                                  115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5,
+                                  0};
+const uint16_t kDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                    12, 12, 13, 13};
+const uint8_t kCodeLengthOrder[kCodeLengthSymbols] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1,
+                                                      15};
+const uint8_t kCodeLengthExtra[kCodeLengthSymbols] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+
+// Index into kLengthBase of each match length, and of each distance: 1 to
+// 256 directly, longer ones in steps of 128
+struct CodeTables {
+    uint8_t length_code[kMaxMatch + 1];
+    uint8_t distance_code[512];
+
+    CodeTables() {
+        for (int code = 0; code < 29; ++code) {
+            for (int length = kLengthBase[code]; length < kLengthBase[code] + (1 << kLengthExtra[code]) &&
+                                                 length <= static_cast<int>(kMaxMatch); ++length) {
+                length_code[length] = static_cast<uint8_t>(code);
+            }
+        }
+        for (int code = 0; code < kDistanceSymbols; ++code) {
+            for (int distance = kDistanceBase[code]; distance < kDistanceBase[code] + (1 << kDistanceExtra[code]);
+                 ++distance) {
+                int index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+                distance_code[index] = static_cast<uint8_t>(code);
+            }
+        }
+    }
+
+    int DistanceCode(uint32_t distance) const {
+        return distance <= 256 ? distance_code[distance - 1] : distance_code[256 + ((distance - 1) >> 7)];
+    }
+};
+
+const CodeTables &Tables() {
+    static const CodeTables tables;
+    return tables;
+}
+
+struct Token {
+    uint16_t value; // A literal byte, or a match length
+    uint16_t distance; // 0 for a literal
+};
+
+struct Match {
+    size_t length = 0;
+    uint32_t distance = 0;
+};
+
+// Hash chains and the token buffer, kept per thread like the JPEG contexts
+struct MatchState {
+    std::vector<uint32_t> head; // Position + 1 of the latest occurrence of each hash, 0 for none
+    std::vector<uint32_t> prev; // Previous position + 1 with the same hash, by position in the window
+    std::vector<Token> tokens;
+
+    static MatchState &ForThread() {
+        static thread_local MatchState state;
+        if (state.head.empty()) {
+            state.head.resize(size_t(1) << kHashBits);
+            state.prev.resize(kWindowSize);
+            state.tokens.reserve(kBlockTokens);
+        } else {
+            std::fill(state.head.begin(), state.head.end(), 0);
+        }
+        state.tokens.clear();
+        return state;
+    }
+};
+
+// Writes codes least significant bit first, as deflate packs them. Callers
+// reserve room for a whole block up front.
+class BitWriter {
+public:
+    BitWriter(PooledBuffer &out, size_t &size) : _out(out), _size(size) {}
+
+    bool Reserve(size_t bytes) {
+        size_t needed = _size + bytes + 8;
+        return needed <= _out.capacity() || _out.Grow(std::max(needed, _out.capacity() * 2), _size);
+    }
+
+    void Put(uint32_t bits, int count) {
+        _bits |= static_cast<uint64_t>(bits) << _count;
+        _count += count;
+        while (_count >= 8) {
+            _out.data()[_size++] = static_cast<char>(_bits);
+            _bits >>= 8;
+            _count -= 8;
+        }
+    }
+
+    void AlignToByte() {
+        if (_count) {
+            Put(0, 8 - _count);
+        }
+    }
+
+    void PutBytes(const uint8_t *data, size_t size) {
+        if (!size) {
+            return;
+        }
+        memcpy(_out.data() + _size, data, size);
+        _size += size;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    PooledBuffer &_out;
+    size_t &_size;
+    uint64_t _bits = 0;
+    int _count = 0;
+};
+
+// Huffman code lengths of the symbols with a frequency, at most `limit`
+// bits. Lengths deeper than the limit are folded into it and the Kraft sum
+// restored by pushing the shallowest possible leaves one level down.
+void BuildLengths(const uint32_t *frequencies, int count, int limit, uint8_t *lengths) {
+    int symbols[kLitLenSymbols];
+    int used = 0;
+    for (int i = 0; i < count; ++i) {
+        lengths[i] = 0;
+        if (frequencies[i]) {
+            symbols[used++] = i;
+        }
+    }
+    if (used == 0) {
+        return;
+    }
+    if (used == 1) {
+        lengths[symbols[0]] = 1;
+        return;
+    }
+    std::stable_sort(symbols, symbols + used, [&](int a, int b) {
+        return frequencies[a] < frequencies[b];
+    });
+
+    // Two queues: the sorted leaves, and internal nodes in order of creation,
+    // which is also the order of their weights
+    uint64_t weights[2 * kLitLenSymbols];
+    int parents[2 * kLitLenSymbols];
+    for (int i = 0; i < used; ++i) {
+        weights[i] = frequencies[symbols[i]];
+    }
+    int leaf = 0;
+    int internal = used;
+    for (int node = used; node < 2 * used - 1; ++node) {
+        int picked[2];
+        for (int &pick : picked) {
+            if (leaf < used && (internal >= node || weights[leaf] <= weights[internal])) {
+                pick = leaf++;
+            } else {
+                pick = internal++;
+            }
+        }
+        weights[node] = weights[picked[0]] + weights[picked[1]];
+        parents[picked[0]] = parents[picked[1]] = node;
+    }
+    int depths[2 * kLitLenSymbols];
+    int root = 2 * used - 2;
+    depths[root] = 0;
+    int counts[kLitLenSymbols + 1] = {0};
+    for (int node = root - 1; node >= 0; --node) {
+        depths[node] = depths[parents[node]] + 1;
+        if (node < used) {
+            ++counts[std::min(depths[node], kLitLenSymbols)];
+        }
+    }
+
+    for (int length = limit + 1; length <= kLitLenSymbols; ++length) {
+        counts[limit] += counts[length];
+    }
+    uint32_t total = 0;
+    for (int length = 1; length <= limit; ++length) {
+        total += static_cast<uint32_t>(counts[length]) << (limit - length);
+    }
+    while (total > (1u << limit)) {
+        --counts[limit];
+        for (int length = limit - 1; length > 0; --length) {
+            if (counts[length]) {
+                --counts[length];
+                counts[length + 1] += 2;
+                break;
+            }
+        }
+        --total;
+    }
+    // The least frequent symbols come first and take the longest codes
+    int index = 0;
+    for (int length = limit; length > 0; --length) {
+        for (int i = 0; i < counts[length]; ++i) {
+            lengths[symbols[index++]] = static_cast<uint8_t>(length);
+        }
+    }
+}
+
+// Canonical codes, bit reversed for the writer
+void BuildCodes(const uint8_t *lengths, int count, uint16_t *codes) {
+    int length_counts[kMaxCodeLength + 1] = {0};
+    for (int i = 0; i < count; ++i) {
+        ++length_counts[lengths[i]];
+    }
+    length_counts[0] = 0;
+    uint32_t next[kMaxCodeLength + 1];
+    uint32_t code = 0;
+    for (int length = 1; length <= kMaxCodeLength; ++length) {
+        code = (code + length_counts[length - 1]) << 1;
+        next[length] = code;
+    }
+    for (int i = 0; i < count; ++i) {
+        int length = lengths[i];
+        if (!length) {
+            continue;
+        }
+        uint32_t value = next[length]++;
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < length; ++bit) {
+            reversed = (reversed << 1) | ((value >> bit) & 1);
+        }
+        codes[i] = static_cast<uint16_t>(reversed);
+    }
+}
+
+size_t MatchLength(const uint8_t *a, const uint8_t *b, size_t max) {
+    size_t length = 0;
+    while (length + 8 <= max) {
+        uint64_t x, y;
+        memcpy(&x, a + length, 8);
+        memcpy(&y, b + length, 8);
+        if (x != y) {
+            break;
+        }
+        length += 8;
+    }
+    while (length < max && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+class Compressor {
+public:
+    Compressor(const uint8_t *data, size_t size, const DeflateOptions &options, BitWriter &writer)
+            : _data(data), _size(size), _options(options), _writer(writer), _state(MatchState::ForThread()),
+              _tables(Tables()) {}
+
+    bool Run(ProgressSink *progress) {
+        size_t p = 0;
+        Match match = Find(0);
+        Insert(0);
+        while (p < _size) {
+            if (_state.tokens.size() >= kBlockTokens) {
+                if (!FlushBlock(p, false) ||
+                    !ReportProgress(progress, ProgressPhase::Encode, _writer.size(), 0)) {
+                    return false;
+                }
+            }
+            if (match.length >= kMinMatch && match.length < kLazyLimit) {
+                // Emits a literal instead when the next position matches longer
+                Match next = Find(p + 1);
+                Insert(p + 1);
+                if (next.length > match.length) {
+                    AddLiteral(p);
+                    ++p;
+                    match = next;
+                    continue;
+                }
+                AddMatch(match);
+                for (size_t i = p + 2; i < p + match.length; ++i) {
+                    Insert(i);
+                }
+                p += match.length;
+            } else if (match.length >= kMinMatch) {
+                AddMatch(match);
+                size_t end = p + match.length;
+                for (size_t i = end - kIndexedTail; i < end; ++i) {
+                    Insert(i);
+                }
+                p = end;
+            } else {
+                AddLiteral(p);
+                ++p;
+            }
+            match = Find(p);
+            Insert(p);
+        }
+        return FlushBlock(_size, true) && ReportProgress(progress, ProgressPhase::Encode, _writer.size(), 0);
+    }
+
+private:
+    static uint32_t Hash(const uint8_t *p) {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        return (value * 2654435761u) >> (32 - kHashBits);
+    }
+
+    void Insert(size_t p) {
+        if (p + kMinMatch > _size) {
+            return;
+        }
+        uint32_t &head = _state.head[Hash(_data + p)];
+        _state.prev[p & kWindowMask] = head;
+        head = static_cast<uint32_t>(p + 1);
+    }
+
+    // Longest match at `p`, the run distances first; call before inserting `p`
+    Match Find(size_t p) const {
+        Match best;
+        if (p + kMinMatch > _size) {
+            return best;
+        }
+        size_t max = std::min(kMaxMatch, _size - p);
+        const uint8_t *current = _data + p;
+        for (uint32_t distance : _options.run_distances) {
+            if (!distance || distance > p || distance > kWindowSize) {
+                continue;
+            }
+            size_t length = MatchLength(current - distance, current, max);
+            if (length > best.length) {
+                best.length = length;
+                best.distance = distance;
+            }
+        }
+        if (best.length < kNiceMatch && best.length < max) {
+            uint32_t candidate = _state.head[Hash(current)];
+            for (int chain = _options.max_chain; candidate && chain > 0; --chain) {
+                size_t position = candidate - 1;
+                size_t distance = p - position;
+                if (distance > kWindowSize) {
+                    break;
+                }
+                const uint8_t *earlier = _data + position;
+                // Only a match that gets past the current best can beat it
+                if (earlier[best.length] == current[best.length]) {
+                    size_t length = MatchLength(earlier, current, max);
+                    if (length > best.length) {
+                        best.length = length;
+                        best.distance = static_cast<uint32_t>(distance);
+                        if (length >= kNiceMatch || length == max) {
+                            break;
+                        }
+                    }
+                }
+                candidate = _state.prev[position & kWindowMask];
+            }
+        }
+        if (best.length < kMinMatch) {
+            best.length = 0;
+        }
+        return best;
+    }
+
+    void AddLiteral(size_t p) {
+        _state.tokens.push_back({_data[p], 0});
+    }
+
+    void AddMatch(const Match &match) {
+        _state.tokens.push_back({static_cast<uint16_t>(match.length), static_cast<uint16_t>(match.distance)});
+    }
+
+    // Writes the tokens covering input up to `end`
+    bool FlushBlock(size_t end, bool last) {
+        uint32_t litlen_frequencies[kLitLenSymbols] = {0};
+        uint32_t distance_frequencies[kDistanceSymbols] = {0};
+        for (const Token &token : _state.tokens) {
+            if (!token.distance) {
+                ++litlen_frequencies[token.value];
+            } else {
+                ++litlen_frequencies[257 + _tables.length_code[token.value]];
+                ++distance_frequencies[_tables.DistanceCode(token.distance)];
+            }
+        }
+        litlen_frequencies[kEndOfBlock] = 1;
+
+        uint8_t litlen_lengths[kLitLenSymbols];
+        uint8_t distance_lengths[kDistanceSymbols];
+        BuildLengths(litlen_frequencies, kLitLenSymbols, kMaxCodeLength, litlen_lengths);
+        BuildLengths(distance_frequencies, kDistanceSymbols, kMaxCodeLength, distance_lengths);
+        if (std::all_of(distance_lengths, distance_lengths + kDistanceSymbols, [](uint8_t l) { return !l; })) {
+            // A block without matches still declares one distance code
+            distance_lengths[0] = 1;
+        }
+        int litlen_count = kLitLenSymbols;
+        while (litlen_count > 257 && !litlen_lengths[litlen_count - 1]) {
+            --litlen_count;
+        }
+        int distance_count = kDistanceSymbols;
+        while (distance_count > 1 && !distance_lengths[distance_count - 1]) {
+            --distance_count;
+        }
+
+        // Both length sequences as one, run length coded with symbols 16 to 18
+        uint8_t sequence[kLitLenSymbols + kDistanceSymbols];
+        memcpy(sequence, litlen_lengths, litlen_count);
+        memcpy(sequence + litlen_count, distance_lengths, distance_count);
+        size_t sequence_size = static_cast<size_t>(litlen_count + distance_count);
+        uint8_t runs[kLitLenSymbols + kDistanceSymbols][2];
+        size_t run_count = 0;
+        uint32_t code_length_frequencies[kCodeLengthSymbols] = {0};
+        auto emit = [&](int symbol, int extra) {
+            runs[run_count][0] = static_cast<uint8_t>(symbol);
+            runs[run_count][1] = static_cast<uint8_t>(extra);
+            ++run_count;
+            ++code_length_frequencies[symbol];
+        };
+        for (size_t i = 0; i < sequence_size;) {
+            uint8_t length = sequence[i];
+            size_t run = 1;
+            while (i + run < sequence_size && sequence[i + run] == length) {
+                ++run;
+            }
+            i += run;
+            if (length == 0) {
+                while (run >= 11) {
+                    size_t count = std::min<size_t>(run, 138);
+                    emit(18, static_cast<int>(count - 11));
+                    run -= count;
+                }
+                if (run >= 3) {
+                    emit(17, static_cast<int>(run - 3));
+                    run = 0;
+                }
+            } else {
+                emit(length, 0);
+                --run;
+                while (run >= 3) {
+                    size_t count = std::min<size_t>(run, 6);
+                    emit(16, static_cast<int>(count - 3));
+                    run -= count;
+                }
+            }
+            for (; run > 0; --run) {
+                emit(length, 0);
+            }
+        }
+        uint8_t code_length_lengths[kCodeLengthSymbols];
+        BuildLengths(code_length_frequencies, kCodeLengthSymbols, kMaxCodeLengthCodeLength, code_length_lengths);
+        int code_length_count = kCodeLengthSymbols;
+        while (code_length_count > 4 && !code_length_lengths[kCodeLengthOrder[code_length_count - 1]]) {
+            --code_length_count;
+        }
+
+        uint64_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * static_cast<uint64_t>(code_length_count);
+        for (int i = 0; i < kCodeLengthSymbols; ++i) {
+            dynamic_bits += static_cast<uint64_t>(code_length_frequencies[i]) *
+                            (code_length_lengths[i] + kCodeLengthExtra[i]);
+        }
+        for (int i = 0; i < kLitLenSymbols; ++i) {
+            uint32_t extra = i > 256 ? kLengthExtra[i - 257] : 0;
+            dynamic_bits += static_cast<uint64_t>(litlen_frequencies[i]) * (litlen_lengths[i] + extra);
+        }
+        for (int i = 0; i < kDistanceSymbols; ++i) {
+            dynamic_bits += static_cast<uint64_t>(distance_frequencies[i]) * (distance_lengths[i] + kDistanceExtra[i]);
+        }
+        size_t stored_size = end - _block_start;
+        size_t stored_blocks = std::max<size_t>(1, (stored_size + kMaxStoredBlock - 1) / kMaxStoredBlock);
+        uint64_t stored_bits = static_cast<uint64_t>(stored_blocks) * (3 + 7 + 32) + stored_size * 8;
+
+        bool stored = stored_bits < dynamic_bits;
+        if (!_writer.Reserve(static_cast<size_t>(std::min(stored_bits, dynamic_bits) / 8 + 16))) {
+            return false;
+        }
+        if (stored) {
+            WriteStored(end, last);
+        } else {
+            _writer.Put(last ? 1 : 0, 1);
+            _writer.Put(2, 2);
+            _writer.Put(static_cast<uint32_t>(litlen_count - 257), 5);
+            _writer.Put(static_cast<uint32_t>(distance_count - 1), 5);
+            _writer.Put(static_cast<uint32_t>(code_length_count - 4), 4);
+            for (int i = 0; i < code_length_count; ++i) {
+                _writer.Put(code_length_lengths[kCodeLengthOrder[i]], 3);
+            }
+            uint16_t code_length_codes[kCodeLengthSymbols];
+            BuildCodes(code_length_lengths, kCodeLengthSymbols, code_length_codes);
+            for (size_t i = 0; i < run_count; ++i) {
+                int symbol = runs[i][0];
+                _writer.Put(code_length_codes[symbol], code_length_lengths[symbol]);
+                if (kCodeLengthExtra[symbol]) {
+                    _writer.Put(runs[i][1], kCodeLengthExtra[symbol]);
+                }
+            }
+            WriteTokens(litlen_lengths, distance_lengths);
+        }
+        _state.tokens.clear();
+        _block_start = end;
+        return true;
+    }
+
+    void WriteTokens(const uint8_t *litlen_lengths, const uint8_t *distance_lengths) {
+        uint16_t litlen_codes[kLitLenSymbols];
+        uint16_t distance_codes[kDistanceSymbols];
+        BuildCodes(litlen_lengths, kLitLenSymbols, litlen_codes);
+        BuildCodes(distance_lengths, kDistanceSymbols, distance_codes);
+        for (const Token &token : _state.tokens) {
+            if (!token.distance) {
+                _writer.Put(litlen_codes[token.value], litlen_lengths[token.value]);
+                continue;
+            }
+            int length_code = _tables.length_code[token.value];
+            _writer.Put(litlen_codes[257 + length_code], litlen_lengths[257 + length_code]);
+            if (kLengthExtra[length_code]) {
+                _writer.Put(token.value - kLengthBase[length_code], kLengthExtra[length_code]);
+            }
+            int distance_code = _tables.DistanceCode(token.distance);
+            _writer.Put(distance_codes[distance_code], distance_lengths[distance_code]);
+            if (kDistanceExtra[distance_code]) {
+                _writer.Put(token.distance - kDistanceBase[distance_code], kDistanceExtra[distance_code]);
+            }
+        }
+        _writer.Put(litlen_codes[kEndOfBlock], litlen_lengths[kEndOfBlock]);
+    }
+
+    // Incompressible data, such as a photo inside the screenshot, as is
+    void WriteStored(size_t end, bool last) {
+        size_t position = _block_start;
+        do {
+            size_t size = std::min(end - position, kMaxStoredBlock);
+            bool final = last && position + size == end;
+            _writer.Put(final ? 1 : 0, 1);
+            _writer.Put(0, 2);
+            _writer.AlignToByte();
+            uint8_t header[4] = {static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                                 static_cast<uint8_t>(~size), static_cast<uint8_t>(~size >> 8)};
+            _writer.PutBytes(header, sizeof(header));
+            _writer.PutBytes(_data + position, size);
+            position += size;
+        } while (position < end);
+    }
+
+    const uint8_t *_data;
+    size_t _size;
+    const DeflateOptions &_options;
+    BitWriter &_writer;
+    MatchState &_state;
+    const CodeTables &_tables;
+    size_t _block_start = 0;
+};
+
+} // namespace
+
+uint32_t Adler32(const uint8_t *data, size_t size, uint32_t adler) {
+    const uint32_t kModulus = 65521;
+    // The largest count of bytes before the sums can overflow 32 bits
+    const size_t kMaxUnreduced = 5552;
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t count = std::min(size, kMaxUnreduced);
+        size -= count;
+        for (; count > 0; --count) {
+            a += *data++;
+            b += a;
+        }
+        a %= kModulus;
+        b %= kModulus;
+    }
+    return (b << 16) | a;
+}
+
+bool CompressZlib(const uint8_t *data, size_t size, const DeflateOptions &options, PooledBuffer &out,
+                  size_t &out_size, ProgressSink *progress) {
+    // Positions are kept + 1 in 32 bits
+    if (size >= UINT32_MAX) {
+        return false;
+    }
+    BitWriter writer(out, out_size);
+    if (!writer.Reserve(2)) {
+        return false;
+    }
+    // 32 KiB window, no dictionary, "fast" level
+    const uint8_t header[2] = {0x78, 0x5e};
+    writer.PutBytes(header, sizeof(header));
+    Compressor compressor(data, size, options, writer);
+    if (!compressor.Run(progress)) {
+        return false;
+    }
+    writer.AlignToByte();
+    if (!writer.Reserve(4)) {
+        return false;
+    }
+    uint32_t adler = Adler32(data, size);
+    const uint8_t trailer[4] = {static_cast<uint8_t>(adler >> 24), static_cast<uint8_t>(adler >> 16),
+                                static_cast<uint8_t>(adler >> 8), static_cast<uint8_t>(adler)};
+    writer.PutBytes(trailer, sizeof(trailer));
+    return true;
+}
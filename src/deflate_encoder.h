@@ -0,0 +1,34 @@
+#ifndef ELECTRON_CLIPBOARD_EX_DEFLATE_ENCODER_H
+#define ELECTRON_CLIPBOARD_EX_DEFLATE_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "buffer_pool.h"
+#include "clipboard.h"
+
+// A zlib stream (RFC 1950 around RFC 1951 deflate) encoder for filtered
+// image rows, where most of the data repeats at a few known distances: the
+// previous byte in flat areas, the previous pixel, the previous row. Those
+// distances are tried first and a long enough match is taken without
+// searching the hash chains, and positions inside long matches are not
+// indexed, so runs cost little. Other data gets greedy matching with one
+// step of lazy evaluation on short hash chains. Blocks use dynamic Huffman
+// codes, or are stored when that is smaller.
+struct DeflateOptions {
+    // Tried before the hash chains, 0 for unused
+    uint32_t run_distances[3] = {1, 0, 0};
+    // Hash chain entries visited per position
+    int max_chain = 16;
+};
+
+// Appends the zlib stream of `size` bytes to `out` from `out_size` on,
+// growing it, and advances `out_size`. Reports the compressed bytes after
+// each block, returns false on cancellation, allocation failure or input
+// of 4 GiB and more.
+bool CompressZlib(const uint8_t *data, size_t size, const DeflateOptions &options, PooledBuffer &out,
+                  size_t &out_size, ProgressSink *progress = nullptr);
+
+// Checksum of the zlib trailer.
+uint32_t Adler32(const uint8_t *data, size_t size, uint32_t adler = 1);
+
+#endif //ELECTRON_CLIPBOARD_EX_DEFLATE_ENCODER_H
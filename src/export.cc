@@ -1,10 +1,98 @@
 #include <napi.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 #include <tuple>
+#include "auto_archive.h"
+#include "buffer_pool.h"
 #include "clipboard.h"
+#include "convert_images.h"
 #include "general_async_worker.h"
+#include "image_ops.h"
+#include "memory_clipboard.h"
+#include "progress_async_worker.h"
+#include "save_screenshot.h"
+#include "save_transformed.h"
+#include "shared_memory.h"
+#include "target_digest.h"
+#include "thumbnails.h"
+#include "tile_store.h"
+#include "utf8.h"
 
-Napi::Array ReadFilePathsInner(const Napi::Env &env) {
-    const auto file_paths = ReadFilePaths();
+// Reads `{selection}` from an optional options object at `index`. Throws and
+// returns false when the option is present but invalid.
+bool GetSelectionOption(const Napi::CallbackInfo &info, size_t index, ClipboardSelection &selection) {
+    selection = ClipboardSelection::Clipboard;
+    if (info.Length() <= index || !info[index].IsObject() || info[index].IsFunction()) {
+        return true;
+    }
+
+    Napi::Value value = info[index].As<Napi::Object>().Get("selection");
+    if (value.IsUndefined()) {
+        return true;
+    }
+    if (value.IsString()) {
+        std::string name = value.As<Napi::String>();
+        if (name == "clipboard") {
+            return true;
+        }
+        if (name == "primary") {
+            selection = ClipboardSelection::Primary;
+            return true;
+        }
+        if (name == "secondary") {
+            selection = ClipboardSelection::Secondary;
+            return true;
+        }
+    }
+
+    Napi::TypeError::New(info.Env(), "selection must be one of 'clipboard', 'primary' or 'secondary'")
+            .ThrowAsJavaScriptException();
+    return false;
+}
+
+// Async functions take the callback last, after an optional options object.
+Napi::Function GetTrailingCallback(const Napi::CallbackInfo &info, size_t min_index) {
+    if (info.Length() > min_index && info[info.Length() - 1].IsFunction()) {
+        return info[info.Length() - 1].As<Napi::Function>();
+    }
+    return Napi::Function();
+}
+
+// `preset` of saveImageAsPng: 'default' or 'screenshot'
+bool GetScreenshotPresetOption(const Napi::CallbackInfo &info, size_t index, bool &screenshot) {
+    screenshot = false;
+    if (info.Length() <= index || !info[index].IsObject() || info[index].IsFunction()) {
+        return true;
+    }
+    Napi::Value value = info[index].As<Napi::Object>().Get("preset");
+    if (value.IsUndefined()) {
+        return true;
+    }
+    if (value.IsString()) {
+        std::string name = value.As<Napi::String>();
+        if (name == "default" || name == "screenshot") {
+            screenshot = name == "screenshot";
+            return true;
+        }
+    }
+    Napi::TypeError::New(info.Env(), "preset must be 'default' or 'screenshot'").ThrowAsJavaScriptException();
+    return false;
+}
+
+// `onProgress` of an optional options object at `index`
+Napi::Value GetProgressOption(const Napi::CallbackInfo &info, size_t index) {
+    if (info.Length() <= index || !info[index].IsObject() || info[index].IsFunction()) {
+        return info.Env().Undefined();
+    }
+    return info[index].As<Napi::Object>().Get("onProgress");
+}
+
+Napi::Array ReadFilePathsInner(const Napi::Env &env, ClipboardSelection selection) {
+    const auto file_paths = ReadFilePaths(selection);
     auto result = Napi::Array::New(env, file_paths.size());
     for (size_t i = 0; i != file_paths.size(); ++i) {
         result.Set(i, file_paths[i]);
@@ -12,12 +100,175 @@ Napi::Array ReadFilePathsInner(const Napi::Env &env) {
     return result;
 }
 
-Napi::Array ReadFilePathsJs(const Napi::CallbackInfo &info) {
+Napi::Value ReadFilePathsJs(const Napi::CallbackInfo &info) {
     auto env = info.Env();
-    return ReadFilePathsInner(env);
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return env.Null();
+    }
+    return ReadFilePathsInner(env, selection);
 }
 
 
+// Converts a JS array of paths. Throws and returns false on empty paths.
+bool GetFilePaths(const Napi::Env &env, const Napi::Value &value, std::vector<std::string> &file_paths) {
+    auto file_paths_js = value.As<Napi::Array>();
+    file_paths.reserve(file_paths_js.Length());
+    for (size_t i = 0; i != file_paths_js.Length(); ++i) {
+        std::string path = file_paths_js.Get(i).As<Napi::String>();
+        if (path.empty()) {
+            Napi::TypeError::New(env, "Empty path is not allowed")
+                    .ThrowAsJavaScriptException();
+            return false;
+        }
+        file_paths.emplace_back(path);
+    }
+    return true;
+}
+
+// JS `PathList`: front-coded paths that stay native until read, e.g. for
+// selections of a million files
+class PathListWrap : public Napi::ObjectWrap<PathListWrap> {
+public:
+    static Napi::Function Define(const Napi::Env &env) {
+        Napi::Function constructor = DefineClass(env, "PathList", {
+            InstanceAccessor("length", &PathListWrap::Length, nullptr),
+            InstanceAccessor("encodedBytes", &PathListWrap::EncodedBytes, nullptr),
+            InstanceMethod("get", &PathListWrap::Get),
+            InstanceMethod("slice", &PathListWrap::Slice),
+            InstanceMethod("commonPrefix", &PathListWrap::CommonPrefix),
+            InstanceMethod("toPacked", &PathListWrap::ToPacked),
+            StaticMethod("fromPacked", &PathListWrap::FromPacked),
+        });
+        _constructor = Napi::Persistent(constructor);
+        _constructor.SuppressDestruct();
+        return constructor;
+    }
+
+    static Napi::Object New(PathList paths) {
+        Napi::Object object = _constructor.New({});
+        Unwrap(object)->_paths = std::move(paths);
+        return object;
+    }
+
+    // The wrapped list if `value` is a PathList, nullptr otherwise
+    static PathListWrap *FromValue(const Napi::Value &value) {
+        if (!value.IsObject() || !value.As<Napi::Object>().InstanceOf(_constructor.Value())) {
+            return nullptr;
+        }
+        return Unwrap(value.As<Napi::Object>());
+    }
+
+    // `new PathList(paths?: string[])`
+    explicit PathListWrap(const Napi::CallbackInfo &info) : Napi::ObjectWrap<PathListWrap>(info) {
+        if (info.Length() > 0 && info[0].IsArray()) {
+            auto paths = info[0].As<Napi::Array>();
+            for (uint32_t i = 0; i < paths.Length(); ++i) {
+                Napi::Value path = paths.Get(i);
+                if (!path.IsString()) {
+                    Napi::TypeError::New(info.Env(), "Expect an array of paths.").ThrowAsJavaScriptException();
+                    return;
+                }
+                _paths.Append(path.As<Napi::String>().Utf8Value());
+            }
+        }
+    }
+
+    const PathList &paths() const {
+        return _paths;
+    }
+
+private:
+    Napi::Value Length(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), static_cast<double>(_paths.size()));
+    }
+
+    Napi::Value EncodedBytes(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), static_cast<double>(_paths.encoded_bytes()));
+    }
+
+    Napi::Value Get(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            Napi::TypeError::New(env, "Expect an index.").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        int64_t index = info[0].As<Napi::Number>().Int64Value();
+        if (index < 0 || static_cast<uint64_t>(index) >= _paths.size()) {
+            return env.Undefined();
+        }
+        return Napi::String::New(env, _paths.Get(static_cast<size_t>(index)));
+    }
+
+    // `slice(start, end)`, decoding the range sequentially
+    Napi::Value Slice(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        size_t start = 0;
+        size_t end = _paths.size();
+        if (info.Length() > 0 && info[0].IsNumber()) {
+            start = ClampIndex(info[0].As<Napi::Number>().Int64Value());
+        }
+        if (info.Length() > 1 && info[1].IsNumber()) {
+            end = ClampIndex(info[1].As<Napi::Number>().Int64Value());
+        }
+        end = std::max(start, end);
+        auto result = Napi::Array::New(env, end - start);
+        PathList::const_iterator it = _paths.IteratorAt(start);
+        for (size_t i = start; i < end; ++i, ++it) {
+            result.Set(static_cast<uint32_t>(i - start), Napi::String::New(env, *it));
+        }
+        return result;
+    }
+
+    Napi::Value CommonPrefix(const Napi::CallbackInfo &info) {
+        std::string_view prefix = _paths.CommonPrefix();
+        return Napi::String::New(info.Env(), prefix.data(), prefix.size());
+    }
+
+    Napi::Value ToPacked(const Napi::CallbackInfo &info) {
+        std::string packed = _paths.ToPacked();
+        return Napi::Buffer<char>::Copy(info.Env(), packed.data(), packed.size());
+    }
+
+    static Napi::Value FromPacked(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1 || !info[0].IsBuffer()) {
+            Napi::TypeError::New(env, "Expect a Buffer.").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        auto packed = info[0].As<Napi::Buffer<char>>();
+        PathList paths;
+        if (!PathList::FromPacked(std::string_view(packed.Data(), packed.Length()), paths)) {
+            Napi::TypeError::New(env, "Malformed packed path list.").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        return New(std::move(paths));
+    }
+
+    // Like Array.prototype.slice, negative indexes count from the end
+    size_t ClampIndex(int64_t index) const {
+        int64_t size = static_cast<int64_t>(_paths.size());
+        if (index < 0) {
+            index += size;
+        }
+        return static_cast<size_t>(std::min(std::max(index, int64_t(0)), size));
+    }
+
+    static Napi::FunctionReference _constructor;
+
+    PathList _paths;
+};
+
+Napi::FunctionReference PathListWrap::_constructor;
+
+Napi::Value ReadFilePathListJs(const Napi::CallbackInfo &info) {
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return info.Env().Null();
+    }
+    return PathListWrap::New(ReadFilePathList(selection));
+}
+
 Napi::Value WriteFilePathsJs(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
 
@@ -27,25 +278,32 @@ Napi::Value WriteFilePathsJs(const Napi::CallbackInfo &info) {
         return env.Null();
     }
 
-    auto file_paths_js = info[0].As<Napi::Array>();
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return env.Null();
+    }
+
+    // A PathList is written and read back without converting its paths
+    if (PathListWrap *path_list = PathListWrap::FromValue(info[0])) {
+        WriteFilePathList(path_list->paths(), selection);
+        return PathListWrap::New(ReadFilePathList(selection));
+    }
+
     auto file_paths = std::vector<std::string>();
-    file_paths.reserve(file_paths_js.Length());
-    for (size_t i = 0; i != file_paths_js.Length(); ++i) {
-        std::string path = file_paths_js.Get(i).As<Napi::String>();
-        if (path.empty()) {
-            Napi::TypeError::New(env, "Empty path is not allowed")
-                    .ThrowAsJavaScriptException();
-            return env.Null();
-        }
-        file_paths.emplace_back(path);
+    if (!GetFilePaths(env, info[0], file_paths)) {
+        return env.Null();
     }
-    WriteFilePaths(file_paths);
+    WriteFilePaths(file_paths, selection);
 
-    return ReadFilePathsInner(env);
+    return ReadFilePathsInner(env, selection);
 }
 
 void ClearClipboardJs(const Napi::CallbackInfo &info) {
-    ClearClipboard();
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return;
+    }
+    ClearClipboard(selection);
 }
 
 Napi::Boolean SaveClipboardImageAsJpegSync(const Napi::CallbackInfo &info) {
@@ -57,33 +315,42 @@ Napi::Boolean SaveClipboardImageAsJpegSync(const Napi::CallbackInfo &info) {
         return Napi::Boolean::New(env, false);
     }
 
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 2, selection)) {
+        return Napi::Boolean::New(env, false);
+    }
+
     std::string target_path = info[0].As<Napi::String>();
     float compression_factor = info[1].As<Napi::Number>();
-    bool result = SaveClipboardImageAsJpeg(target_path, compression_factor);
+    bool result = SaveClipboardImageAsJpeg(target_path, compression_factor, selection);
 
     return Napi::Boolean::New(env, result);
 }
 
-void SaveClipboardImageAsJpegAsync(const Napi::CallbackInfo &info) {
+Napi::Value SaveClipboardImageAsJpegAsync(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expect at least 2 arguments.")
                 .ThrowAsJavaScriptException();
-        return;
+        return env.Undefined();
+    }
+
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 2, selection)) {
+        return env.Undefined();
     }
 
     std::string target_path = info[0].As<Napi::String>();
     float compression_factor = info[1].As<Napi::Number>();
+    Napi::Function callback = GetTrailingCallback(info, 2);
 
-    Napi::Function callback;
-    if (info.Length() > 2) {
-        callback = info[2].As<Napi::Function>();
-    }
-
-    auto worker = new GeneralAsyncWorker(callback, SaveClipboardImageAsJpeg,
-                                         std::make_tuple(target_path, compression_factor));
+    auto reporter = std::make_shared<ProgressReporter>(env, GetProgressOption(info, 2));
+    auto worker = new ProgressAsyncWorker(callback, [=](ProgressSink *progress) {
+        return SaveClipboardImageAsJpeg(target_path, compression_factor, selection, progress);
+    }, reporter);
     worker->Queue();
+    return ProgressAsyncWorker::CreateHandle(env, reporter);
 }
 
 Napi::Boolean SaveClipboardImageAsPngSync(const Napi::CallbackInfo &info) {
@@ -95,30 +362,134 @@ Napi::Boolean SaveClipboardImageAsPngSync(const Napi::CallbackInfo &info) {
         return Napi::Boolean::New(env, false);
     }
 
+    ClipboardSelection selection;
+    bool screenshot;
+    if (!GetSelectionOption(info, 1, selection) || !GetScreenshotPresetOption(info, 1, screenshot)) {
+        return Napi::Boolean::New(env, false);
+    }
+
     std::string target_path = info[0].As<Napi::String>();
-    bool result = SaveClipboardImageAsPng(target_path);
+    bool result = screenshot ? SaveClipboardImageAsScreenshotPng(target_path, selection)
+                             : SaveClipboardImageAsPng(target_path, selection);
 
     return Napi::Boolean::New(env, result);
 }
 
-void SaveClipboardImageAsPngAsync(const Napi::CallbackInfo &info) {
+Napi::Value SaveClipboardImageAsPngAsync(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expect at least 1 argument but got 0.")
                 .ThrowAsJavaScriptException();
-        return;
+        return env.Undefined();
+    }
+
+    ClipboardSelection selection;
+    bool screenshot;
+    if (!GetSelectionOption(info, 1, selection) || !GetScreenshotPresetOption(info, 1, screenshot)) {
+        return env.Undefined();
     }
 
     std::string target_path = info[0].As<Napi::String>();
+    Napi::Function callback = GetTrailingCallback(info, 1);
+
+    auto reporter = std::make_shared<ProgressReporter>(env, GetProgressOption(info, 1));
+    auto worker = new ProgressAsyncWorker(callback, [=](ProgressSink *progress) {
+        return screenshot ? SaveClipboardImageAsScreenshotPng(target_path, selection, progress)
+                          : SaveClipboardImageAsPng(target_path, selection, progress);
+    }, reporter);
+    worker->Queue();
+    return ProgressAsyncWorker::CreateHandle(env, reporter);
+}
 
-    Napi::Function callback;
-    if (info.Length() > 1) {
-        callback = info[1].As<Napi::Function>();
+// {crop: {x, y, width, height}, rotate, flipHorizontal, flipVertical}
+bool GetImageTransform(const Napi::Env &env, const Napi::Value &value, ImageTransform &transform) {
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Expect a transform object.").ThrowAsJavaScriptException();
+        return false;
+    }
+    auto transform_js = value.As<Napi::Object>();
+    Napi::Value crop = transform_js.Get("crop");
+    if (crop.IsObject()) {
+        auto crop_js = crop.As<Napi::Object>();
+        std::tuple<const char *, uint32_t *> fields[] = {
+            {"x", &transform.crop_x},
+            {"y", &transform.crop_y},
+            {"width", &transform.crop_width},
+            {"height", &transform.crop_height},
+        };
+        for (const auto &field : fields) {
+            Napi::Value field_value = crop_js.Get(std::get<0>(field));
+            if (field_value.IsNumber()) {
+                *std::get<1>(field) = field_value.As<Napi::Number>().Uint32Value();
+            }
+        }
+    } else if (!crop.IsUndefined()) {
+        Napi::TypeError::New(env, "crop must be an object").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Value rotate = transform_js.Get("rotate");
+    if (rotate.IsNumber()) {
+        transform.rotate = rotate.As<Napi::Number>().Uint32Value();
+    }
+    if (transform.rotate % 90 != 0 || transform.rotate >= 360) {
+        Napi::TypeError::New(env, "rotate must be 0, 90, 180 or 270").ThrowAsJavaScriptException();
+        return false;
     }
+    transform.flip_horizontal = transform_js.Get("flipHorizontal").ToBoolean();
+    transform.flip_vertical = transform_js.Get("flipVertical").ToBoolean();
+    return true;
+}
+
+Napi::Value SaveImageTransformedAsync(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
 
-    auto worker = new GeneralAsyncWorker(callback, SaveClipboardImageAsPng, std::make_tuple(target_path));
+    if (info.Length() < 2 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expect a target path and a transform.")
+                .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string target_path = info[0].As<Napi::String>();
+    ImageTransform transform;
+    if (!GetImageTransform(env, info[1], transform)) {
+        return env.Undefined();
+    }
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 2, selection)) {
+        return env.Undefined();
+    }
+
+    // Like convertImages, the format follows the extension unless given
+    size_t dot = target_path.find_last_of('.');
+    std::string name = dot == std::string::npos ? std::string() : target_path.substr(dot + 1);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    name = name == "jpg" || name == "jpeg" ? "jpeg" : "png";
+    float quality = 0.9f;
+    if (info.Length() > 2 && info[2].IsObject() && !info[2].IsFunction()) {
+        auto options_js = info[2].As<Napi::Object>();
+        Napi::Value format = options_js.Get("format");
+        if (format.IsString()) {
+            name = format.As<Napi::String>().Utf8Value();
+        }
+        Napi::Value quality_js = options_js.Get("quality");
+        if (quality_js.IsNumber()) {
+            quality = quality_js.As<Napi::Number>();
+        }
+    }
+    if (name != "png" && name != "jpeg") {
+        Napi::TypeError::New(env, "format must be 'png' or 'jpeg'").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ImageFormat image_format = name == "jpeg" ? ImageFormat::Jpeg : ImageFormat::Png;
+    Napi::Function callback = GetTrailingCallback(info, 2);
+
+    auto reporter = std::make_shared<ProgressReporter>(env, GetProgressOption(info, 2));
+    auto worker = new ProgressAsyncWorker(callback, [=](ProgressSink *progress) {
+        return SaveClipboardImageTransformed(target_path, transform, image_format, quality, selection, progress);
+    }, reporter);
     worker->Queue();
+    return ProgressAsyncWorker::CreateHandle(env, reporter);
 }
 
 Napi::Boolean PutImageIntoClipboardSync(const Napi::CallbackInfo &info) {
@@ -130,8 +501,13 @@ Napi::Boolean PutImageIntoClipboardSync(const Napi::CallbackInfo &info) {
         return Napi::Boolean::New(env, false);
     }
 
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return Napi::Boolean::New(env, false);
+    }
+
     std::string image_path = info[0].As<Napi::String>();
-    bool result = PutImageIntoClipboard(image_path);
+    bool result = PutImageIntoClipboard(image_path, selection);
 
     return Napi::Boolean::New(env, result);
 }
@@ -145,34 +521,880 @@ void PutImageIntoClipboardAsync(const Napi::CallbackInfo &info) {
         return;
     }
 
-    std::string image_path = info[0].As<Napi::String>();
-
-    Napi::Function callback;
-    if (info.Length() > 1) {
-        callback = info[1].As<Napi::Function>();
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return;
     }
 
-    auto worker = new GeneralAsyncWorker(callback, PutImageIntoClipboard, std::make_tuple(image_path));
+    std::string image_path = info[0].As<Napi::String>();
+    Napi::Function callback = GetTrailingCallback(info, 1);
+
+    auto worker = new GeneralAsyncWorker(callback, PutImageIntoClipboard,
+                                         std::make_tuple(image_path, selection));
     worker->Queue();
 }
 
 Napi::Boolean ClipboardHasImageJs(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
-    bool result = ClipboardHasImage();
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return Napi::Boolean::New(env, false);
+    }
+    bool result = ClipboardHasImage(selection);
     return Napi::Boolean::New(env, result);
 }
 
+void ReleaseExternalData(napi_env env, void *data, void *hint) {
+    (void)env;
+    (void)data;
+    auto *owner = static_cast<std::pair<ClipboardData::ReleaseFunc, void *> *>(hint);
+    owner->first(owner->second);
+    delete owner;
+}
+
+// Hands the bytes to JS as an external buffer. Runtimes that forbid external
+// buffers (Electron with the V8 sandbox) get a copy instead.
+Napi::Value ClipboardDataToBuffer(const Napi::Env &env, ClipboardData &data) {
+    if (data.size() == 0) {
+        return Napi::Buffer<char>::New(env, 0);
+    }
+
+    const char *bytes = data.data();
+    size_t size = data.size();
+    ClipboardData::ReleaseFunc release;
+    void *release_hint;
+    data.Detach(release, release_hint);
+    auto *owner = new std::pair<ClipboardData::ReleaseFunc, void *>(release, release_hint);
+
+    napi_value result;
+    napi_status status = napi_create_external_buffer(env, size, const_cast<char *>(bytes),
+                                                     ReleaseExternalData, owner, &result);
+    if (status == napi_ok) {
+        return Napi::Value(env, result);
+    }
+
+    Napi::Buffer<char> copy = Napi::Buffer<char>::Copy(env, bytes, size);
+    ReleaseExternalData(env, nullptr, owner);
+    return copy;
+}
+
+void ReleaseSharedMemory(napi_env env, void *data, void *hint) {
+    (void)env;
+    (void)data;
+    SharedMemory::Delete(hint);
+}
+
+// The clipboard image as BGRA pixels in shared memory, for
+// nativeImage.createFromBitmap and for other processes through `fd`.
+Napi::Value ReadImageSharedJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return env.Undefined();
+    }
+    bool premultiplied = true;
+    bool keep_fd = false;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        auto options = info[0].As<Napi::Object>();
+        Napi::Value premultiplied_js = options.Get("premultiplied");
+        if (!premultiplied_js.IsUndefined()) {
+            premultiplied = premultiplied_js.ToBoolean();
+        }
+        keep_fd = options.Get("fd").ToBoolean();
+    }
+
+    // Decoded pixels are converted straight into the shared pages
+    std::unique_ptr<SharedMemory> shared;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool allocation_failed = false;
+    bool ok = ReadImageBgra([&](uint32_t image_width, uint32_t image_height) -> char * {
+        width = image_width;
+        height = image_height;
+        shared = SharedMemory::Create(static_cast<size_t>(width) * 4 * height);
+        allocation_failed = !shared;
+        return shared ? shared->data() : nullptr;
+    }, premultiplied, selection);
+    if (allocation_failed) {
+        Napi::Error::New(env, "Cannot allocate shared memory for the image").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!ok) {
+        return env.Null();
+    }
+    size_t stride = static_cast<size_t>(width) * 4;
+    int fd = keep_fd ? shared->ReleaseFd() : -1;
+
+    auto result = Napi::Object::New(env);
+    result.Set("width", Napi::Number::New(env, width));
+    result.Set("height", Napi::Number::New(env, height));
+    result.Set("stride", Napi::Number::New(env, static_cast<double>(stride)));
+    result.Set("premultiplied", Napi::Boolean::New(env, premultiplied));
+    result.Set("fd", fd >= 0 ? Napi::Value(Napi::Number::New(env, fd)) : env.Null());
+
+    // Runtimes that forbid external buffers (Electron with the V8 sandbox)
+    // get a copy, `fd` still refers to the shared pages
+    SharedMemory *memory = shared.get();
+    napi_value data;
+    if (napi_create_external_arraybuffer(env, memory->data(), memory->size(), ReleaseSharedMemory, memory,
+                                         &data) == napi_ok) {
+        shared.release();
+        result.Set("data", Napi::Value(env, data));
+    } else {
+        auto copy = Napi::ArrayBuffer::New(env, memory->size());
+        memcpy(copy.Data(), memory->data(), memory->size());
+        result.Set("data", copy);
+    }
+    return result;
+}
+
+Napi::Value ReadTextJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return env.Null();
+    }
+    bool as_buffer = false;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value as = info[0].As<Napi::Object>().Get("as");
+        if (!as.IsUndefined()) {
+            std::string as_name;
+            if (as.IsString()) {
+                as_name = as.As<Napi::String>();
+            }
+            if (as_name != "string" && as_name != "buffer") {
+                Napi::TypeError::New(env, "as must be either 'string' or 'buffer'")
+                        .ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            as_buffer = as_name == "buffer";
+        }
+    }
+
+    ClipboardData text;
+    if (!ReadText(text, selection)) {
+        return as_buffer ? Napi::Value(Napi::Buffer<char>::New(env, 0)) : Napi::Value(Napi::String::New(env, ""));
+    }
+    if (as_buffer) {
+        return ClipboardDataToBuffer(env, text);
+    }
+    // V8 decodes the UTF-8 straight from the backend memory
+    return Napi::String::New(env, text.data(), text.size());
+}
+
+Napi::Boolean WriteTextJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Expect 1 argument but got 0.")
+                .ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return Napi::Boolean::New(env, false);
+    }
+
+    if (info[0].IsBuffer()) {
+        auto buffer = info[0].As<Napi::Buffer<char>>();
+        if (!IsValidUtf8(buffer.Data(), buffer.Length())) {
+            Napi::TypeError::New(env, "Text buffer is not valid UTF-8")
+                    .ThrowAsJavaScriptException();
+            return Napi::Boolean::New(env, false);
+        }
+        return Napi::Boolean::New(env, WriteText(buffer.Data(), buffer.Length(), selection));
+    }
+
+    if (!info[0].IsString()) {
+        Napi::TypeError::New(env, "Expect a string or a Buffer.")
+                .ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    // Encode once into a plain array instead of going through std::string
+    size_t length = 0;
+    napi_get_value_string_utf8(env, info[0], nullptr, 0, &length);
+    std::unique_ptr<char[]> bytes(new char[length + 1]);
+    napi_get_value_string_utf8(env, info[0], bytes.get(), length + 1, &length);
+    return Napi::Boolean::New(env, WriteText(bytes.get(), length, selection));
+}
+
+Napi::Object ReadRichJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    auto result = Napi::Object::New(env);
+
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return result;
+    }
+
+    RichContent content = ReadRich(selection);
+    if (!content.html.empty()) {
+        result.Set("html", content.html);
+    }
+    if (!content.rtf.empty()) {
+        result.Set("rtf", content.rtf);
+    }
+    if (!content.text.empty()) {
+        result.Set("text", content.text);
+    }
+    return result;
+}
+
+Napi::Boolean WriteRichJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expect an object with html, rtf or text.")
+                .ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return Napi::Boolean::New(env, false);
+    }
+
+    auto content_js = info[0].As<Napi::Object>();
+    RichContent content;
+    const std::pair<const char *, std::string *> fields[] = {
+        {"html", &content.html},
+        {"rtf", &content.rtf},
+        {"text", &content.text},
+    };
+    for (const auto &field : fields) {
+        Napi::Value value = content_js.Get(field.first);
+        if (value.IsUndefined() || value.IsNull()) {
+            continue;
+        }
+        *field.second = value.As<Napi::String>();
+    }
+
+    return Napi::Boolean::New(env, WriteRich(content, selection));
+}
+
+Napi::Boolean WriteMultiJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expect an object with files, imagePath, imageBuffer or text.")
+                .ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return Napi::Boolean::New(env, false);
+    }
+
+    auto content_js = info[0].As<Napi::Object>();
+    MultiContent content;
+    Napi::Value files = content_js.Get("files");
+    if (!files.IsUndefined() && !GetFilePaths(env, files, content.file_paths)) {
+        return Napi::Boolean::New(env, false);
+    }
+    Napi::Value image_path = content_js.Get("imagePath");
+    if (!image_path.IsUndefined()) {
+        content.image_path = image_path.As<Napi::String>();
+    }
+    Napi::Value image_buffer = content_js.Get("imageBuffer");
+    if (!image_buffer.IsUndefined()) {
+        if (!content.image_path.empty()) {
+            Napi::TypeError::New(env, "imagePath and imageBuffer are mutually exclusive")
+                    .ThrowAsJavaScriptException();
+            return Napi::Boolean::New(env, false);
+        }
+        auto buffer = image_buffer.As<Napi::Buffer<char>>();
+        content.image_data.assign(buffer.Data(), buffer.Length());
+    }
+    Napi::Value image_file_name = content_js.Get("imageFileName");
+    if (!image_file_name.IsUndefined()) {
+        if (!image_file_name.IsString() || content.image_data.empty()) {
+            Napi::TypeError::New(env, "imageFileName must be a string and needs imageBuffer")
+                    .ThrowAsJavaScriptException();
+            return Napi::Boolean::New(env, false);
+        }
+        content.image_file_name = image_file_name.As<Napi::String>();
+    }
+    Napi::Value text = content_js.Get("text");
+    if (!text.IsUndefined()) {
+        content.text = text.As<Napi::String>();
+    }
+
+    return Napi::Boolean::New(env, WriteMulti(content, selection));
+}
+
+Napi::Number ClipboardSequenceNumberJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 0, selection)) {
+        return Napi::Number::New(env, 0);
+    }
+    uint64_t result = ClipboardSequenceNumber(selection);
+    return Napi::Number::New(env, static_cast<double>(result));
+}
+
+Napi::Value TargetDigestJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expect a mime type.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ClipboardSelection selection;
+    if (!GetSelectionOption(info, 1, selection)) {
+        return env.Undefined();
+    }
+    TargetDigest digest;
+    if (!GetTargetDigest(info[0].As<Napi::String>(), selection, digest)) {
+        return env.Null();
+    }
+    // 64 bits do not fit a Number
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(digest.digest));
+    auto result = Napi::Object::New(env);
+    result.Set("digest", Napi::String::New(env, hex));
+    result.Set("size", Napi::Number::New(env, static_cast<double>(digest.size)));
+    result.Set("cached", Napi::Boolean::New(env, digest.cached));
+    return result;
+}
+
+Napi::Object ClipboardStatsJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    ClipboardStats stats = GetClipboardStats();
+
+    auto owners = Napi::Array::New(env, stats.owners.size());
+    for (size_t i = 0; i < stats.owners.size(); ++i) {
+        const OwnerStats &owner_stats = stats.owners[i];
+        auto targets = Napi::Object::New(env);
+        for (const TargetStats &target_stats : owner_stats.targets) {
+            auto target = Napi::Object::New(env);
+            target.Set("requests", Napi::Number::New(env, static_cast<double>(target_stats.requests)));
+            target.Set("timeouts", Napi::Number::New(env, static_cast<double>(target_stats.timeouts)));
+            target.Set("meanMs", Napi::Number::New(env, target_stats.mean_ms));
+            target.Set("maxMs", Napi::Number::New(env, target_stats.max_ms));
+            target.Set("timeoutMs", Napi::Number::New(env, target_stats.timeout_ms));
+            targets.Set(target_stats.target, target);
+        }
+        auto owner = Napi::Object::New(env);
+        owner.Set("pid", Napi::Number::New(env, static_cast<double>(owner_stats.pid)));
+        owner.Set("wmClass", owner_stats.wm_class);
+        owner.Set("targets", targets);
+        owners.Set(static_cast<uint32_t>(i), owner);
+    }
+
+    BufferPoolStats pool_stats = GetBufferPoolStats();
+    auto buffer_pool = Napi::Object::New(env);
+    buffer_pool.Set("acquires", Napi::Number::New(env, static_cast<double>(pool_stats.acquires)));
+    buffer_pool.Set("hits", Napi::Number::New(env, static_cast<double>(pool_stats.hits)));
+    buffer_pool.Set("hitRate", Napi::Number::New(env, pool_stats.acquires
+            ? static_cast<double>(pool_stats.hits) / static_cast<double>(pool_stats.acquires) : 0));
+    buffer_pool.Set("retainedBytes", Napi::Number::New(env, static_cast<double>(pool_stats.retained_bytes)));
+    buffer_pool.Set("retainedBuffers", Napi::Number::New(env, static_cast<double>(pool_stats.retained_buffers)));
+
+    const ServingStats &serving_stats = stats.serving;
+    auto serving = Napi::Object::New(env);
+    serving.Set("requests", Napi::Number::New(env, static_cast<double>(serving_stats.requests)));
+    serving.Set("incrTransfers", Napi::Number::New(env, static_cast<double>(serving_stats.incr_transfers)));
+    serving.Set("bytes", Napi::Number::New(env, static_cast<double>(serving_stats.bytes)));
+    serving.Set("timeouts", Napi::Number::New(env, static_cast<double>(serving_stats.timeouts)));
+    serving.Set("activeTransfers", Napi::Number::New(env, serving_stats.active_transfers));
+    serving.Set("maxActiveTransfers", Napi::Number::New(env, serving_stats.max_active_transfers));
+    serving.Set("deferred", Napi::Number::New(env, static_cast<double>(serving_stats.deferred)));
+    serving.Set("rendering", Napi::Number::New(env, serving_stats.rendering));
+    serving.Set("maxRenderMs", Napi::Number::New(env, serving_stats.max_render_ms));
+
+    const CodecContextStats &codec_stats = stats.codec_contexts;
+    auto codec_contexts = Napi::Object::New(env);
+    codec_contexts.Set("acquires", Napi::Number::New(env, static_cast<double>(codec_stats.acquires)));
+    codec_contexts.Set("reuses", Napi::Number::New(env, static_cast<double>(codec_stats.reuses)));
+    codec_contexts.Set("reuseRate", Napi::Number::New(env, codec_stats.acquires
+            ? static_cast<double>(codec_stats.reuses) / static_cast<double>(codec_stats.acquires) : 0));
+    codec_contexts.Set("live", Napi::Number::New(env, codec_stats.live));
+
+    auto result = Napi::Object::New(env);
+    result.Set("owners", owners);
+    result.Set("bufferPool", buffer_pool);
+    result.Set("serving", serving);
+    result.Set("codecContexts", codec_contexts);
+    return result;
+}
+
+void SetBackendJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    std::string name = info.Length() > 0 && info[0].IsString() ? info[0].As<Napi::String>() : std::string();
+    if (name != "memory" && name != "native") {
+        Napi::TypeError::New(env, "backend must be 'memory' or 'native'").ThrowAsJavaScriptException();
+        return;
+    }
+    memory_clipboard::SetActive(name == "memory");
+}
+
+Napi::String GetBackendJs(const Napi::CallbackInfo &info) {
+    return Napi::String::New(info.Env(), memory_clipboard::IsActive() ? "memory" : "native");
+}
+
+// Event crossing from the archiver's threads to JS
+struct ArchiveEvent {
+    ArchivedImage image;
+    std::string error;
+};
+
+// Owns a running archiver, which is stopped before its callback is released
+struct AutoArchiveState {
+    Napi::ThreadSafeFunction tsfn;
+    std::unique_ptr<AutoArchive> archive;
+};
+
+void CallArchiveJs(Napi::Env env, Napi::Function callback, ArchiveEvent *event) {
+    if (env != nullptr && callback != nullptr) {
+        if (!event->error.empty()) {
+            callback.Call({Napi::Error::New(env, event->error).Value()});
+        } else {
+            auto image = Napi::Object::New(env);
+            image.Set("path", event->image.path);
+            image.Set("width", Napi::Number::New(env, event->image.width));
+            image.Set("height", Napi::Number::New(env, event->image.height));
+            callback.Call({env.Null(), image});
+        }
+    }
+    delete event;
+}
+
+Napi::Value StartAutoArchiveJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsString() || !info[2].IsFunction()) {
+        Napi::TypeError::New(env, "Expect a directory, options and a callback.")
+                .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    AutoArchiveOptions options;
+    options.directory = info[0].As<Napi::String>();
+    if (!GetSelectionOption(info, 1, options.selection)) {
+        return env.Undefined();
+    }
+    if (info[1].IsObject()) {
+        auto options_js = info[1].As<Napi::Object>();
+        Napi::Value format = options_js.Get("format");
+        if (format.IsString()) {
+            std::string name = format.As<Napi::String>();
+            if (name != "png" && name != "jpeg") {
+                Napi::TypeError::New(env, "format must be 'png' or 'jpeg'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.format = name == "jpeg" ? ImageFormat::Jpeg : ImageFormat::Png;
+        }
+        Napi::Value quality = options_js.Get("quality");
+        if (quality.IsNumber()) {
+            options.quality = quality.As<Napi::Number>();
+        }
+        Napi::Value max_size = options_js.Get("maxSize");
+        if (max_size.IsNumber()) {
+            options.max_size = max_size.As<Napi::Number>().Uint32Value();
+        }
+        Napi::Value dedupe = options_js.Get("dedupe");
+        if (dedupe.IsBoolean()) {
+            options.dedupe = dedupe.As<Napi::Boolean>();
+        }
+        Napi::Value interval = options_js.Get("interval");
+        if (interval.IsNumber()) {
+            options.interval_ms = std::max(10u, interval.As<Napi::Number>().Uint32Value());
+        }
+    }
+
+    // Non-blocking calls on an unbounded queue, `stop()` joins the encoders
+    // from the JS thread and must not wait for it
+    auto state = std::make_shared<AutoArchiveState>();
+    state->tsfn = Napi::ThreadSafeFunction::New(env, info[2].As<Napi::Function>(), "clipboardAutoArchive", 0, 1);
+    AutoArchiveState *raw_state = state.get();
+    state->archive.reset(new AutoArchive(options, [raw_state](const ArchivedImage *image, const std::string &error) {
+        auto *event = new ArchiveEvent{image ? *image : ArchivedImage(), error};
+        if (raw_state->tsfn.NonBlockingCall(event, CallArchiveJs) != napi_ok) {
+            delete event;
+        }
+    }));
+
+    // The JS wrapper calls `poll()` every `interval` ms, so the clipboard is
+    // read on the JS thread, which is GTK's in Electron
+    auto handle = Napi::Object::New(env);
+    handle.Set("interval", Napi::Number::New(env, options.interval_ms));
+    handle.Set("poll", Napi::Function::New(env, [state](const Napi::CallbackInfo &) {
+        if (state->archive) {
+            state->archive->Poll();
+        }
+    }));
+    handle.Set("stop", Napi::Function::New(env, [state](const Napi::CallbackInfo &) {
+        if (state->archive) {
+            state->archive.reset();
+            state->tsfn.Release();
+        }
+    }));
+    return handle;
+}
+
+// `null` marks the end of the results
+void CallThumbnailJs(Napi::Env env, Napi::Function callback, ThumbnailResult *result) {
+    if (env != nullptr && callback != nullptr) {
+        if (!result) {
+            callback.Call({env.Null(), env.Null()});
+            return;
+        }
+        auto result_js = Napi::Object::New(env);
+        result_js.Set("index", Napi::Number::New(env, static_cast<double>(result->index)));
+        result_js.Set("path", result->path);
+        if (result->error.empty()) {
+            result_js.Set("thumbnailPath", result->thumbnail_path);
+            result_js.Set("cached", Napi::Boolean::New(env, result->cached));
+        } else {
+            result_js.Set("error", result->error);
+        }
+        callback.Call({env.Null(), result_js});
+    }
+    delete result;
+}
+
+Napi::Value ThumbnailsForPathsJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[1].IsObject() || !info[2].IsFunction()) {
+        Napi::TypeError::New(env, "Expect paths, options and a callback.")
+                .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::vector<std::string> paths;
+    if (!GetFilePaths(env, info[0], paths)) {
+        return env.Undefined();
+    }
+
+    ThumbnailOptions options;
+    auto options_js = info[1].As<Napi::Object>();
+    Napi::Value cache_dir = options_js.Get("cacheDir");
+    if (!cache_dir.IsString()) {
+        Napi::TypeError::New(env, "cacheDir must be a string").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    options.cache_dir = cache_dir.As<Napi::String>();
+    Napi::Value size = options_js.Get("size");
+    if (size.IsNumber()) {
+        options.size = std::max(1u, size.As<Napi::Number>().Uint32Value());
+    }
+    Napi::Value format = options_js.Get("format");
+    if (format.IsString()) {
+        std::string name = format.As<Napi::String>();
+        if (name != "png" && name != "jpeg") {
+            Napi::TypeError::New(env, "format must be 'png' or 'jpeg'").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        options.format = name == "jpeg" ? ImageFormat::Jpeg : ImageFormat::Png;
+    }
+    Napi::Value quality = options_js.Get("quality");
+    if (quality.IsNumber()) {
+        options.quality = quality.As<Napi::Number>();
+    }
+
+    auto tsfn = std::make_shared<Napi::ThreadSafeFunction>(
+            Napi::ThreadSafeFunction::New(env, info[2].As<Napi::Function>(), "clipboardThumbnails", 0, 1));
+    auto job = StartThumbnails(std::move(paths), options, [tsfn](const ThumbnailResult &result) {
+        tsfn->BlockingCall(new ThumbnailResult(result), CallThumbnailJs);
+    }, [tsfn] {
+        tsfn->BlockingCall(static_cast<ThumbnailResult *>(nullptr), CallThumbnailJs);
+        tsfn->Release();
+    });
+
+    auto handle = Napi::Object::New(env);
+    handle.Set("cancel", Napi::Function::New(env, [job](const Napi::CallbackInfo &) {
+        job->Cancel();
+    }));
+    return handle;
+}
+
+// Reads `{src, dst, format, quality, maxSize}`, the format defaults to the
+// extension of `dst`. Throws and returns false when invalid.
+bool GetConvertTask(const Napi::Env &env, const Napi::Value &value, ConvertTask &task) {
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Expect {src, dst} objects.").ThrowAsJavaScriptException();
+        return false;
+    }
+    auto task_js = value.As<Napi::Object>();
+    Napi::Value src = task_js.Get("src");
+    Napi::Value dst = task_js.Get("dst");
+    if (!src.IsString() || !dst.IsString()) {
+        Napi::TypeError::New(env, "src and dst must be strings").ThrowAsJavaScriptException();
+        return false;
+    }
+    task.src = src.As<Napi::String>();
+    task.dst = dst.As<Napi::String>();
+
+    Napi::Value format = task_js.Get("format");
+    std::string name;
+    if (format.IsString()) {
+        name = format.As<Napi::String>();
+    } else {
+        size_t dot = task.dst.find_last_of('.');
+        std::string extension = dot == std::string::npos ? std::string() : task.dst.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        name = extension == "jpg" || extension == "jpeg" ? "jpeg" : "png";
+    }
+    if (name != "png" && name != "jpeg") {
+        Napi::TypeError::New(env, "format must be 'png' or 'jpeg'").ThrowAsJavaScriptException();
+        return false;
+    }
+    task.format = name == "jpeg" ? ImageFormat::Jpeg : ImageFormat::Png;
+    Napi::Value quality = task_js.Get("quality");
+    if (quality.IsNumber()) {
+        task.quality = quality.As<Napi::Number>();
+    }
+    Napi::Value max_size = task_js.Get("maxSize");
+    if (max_size.IsNumber()) {
+        task.max_size = max_size.As<Napi::Number>().Uint32Value();
+    }
+    return true;
+}
+
+struct ConvertCompletion {
+    std::shared_ptr<std::vector<ConvertResult>> results;
+    bool cancelled;
+};
+
+void CallConvertJs(Napi::Env env, Napi::Function callback, ConvertCompletion *completion) {
+    if (env != nullptr && callback != nullptr) {
+        if (completion->cancelled) {
+            auto error = Napi::Error::New(env, "The operation was aborted");
+            error.Set("name", "AbortError");
+            error.Set("code", "ABORT_ERR");
+            callback.Call({error.Value()});
+        } else {
+            const std::vector<ConvertResult> &results = *completion->results;
+            auto results_js = Napi::Array::New(env, results.size());
+            for (size_t i = 0; i < results.size(); ++i) {
+                auto result = Napi::Object::New(env);
+                if (results[i].error.empty()) {
+                    result.Set("width", Napi::Number::New(env, results[i].width));
+                    result.Set("height", Napi::Number::New(env, results[i].height));
+                } else {
+                    result.Set("error", results[i].error);
+                }
+                results_js.Set(static_cast<uint32_t>(i), result);
+            }
+            callback.Call({env.Null(), results_js});
+        }
+    }
+    delete completion;
+}
+
+Napi::Value ConvertImagesJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+
+    Napi::Function callback = GetTrailingCallback(info, 1);
+    if (info.Length() < 2 || !info[0].IsArray() || callback.IsEmpty()) {
+        Napi::TypeError::New(env, "Expect tasks, optional options and a callback.")
+                .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto tasks_js = info[0].As<Napi::Array>();
+    std::vector<ConvertTask> tasks(tasks_js.Length());
+    for (uint32_t i = 0; i < tasks_js.Length(); ++i) {
+        if (!GetConvertTask(env, tasks_js.Get(i), tasks[i])) {
+            return env.Undefined();
+        }
+    }
+    unsigned concurrency = 0;
+    if (info[1].IsObject() && !info[1].IsFunction()) {
+        Napi::Value value = info[1].As<Napi::Object>().Get("concurrency");
+        if (value.IsNumber()) {
+            concurrency = value.As<Napi::Number>().Uint32Value();
+        }
+    }
+
+    auto tsfn = std::make_shared<Napi::ThreadSafeFunction>(
+            Napi::ThreadSafeFunction::New(env, callback, "clipboardConvertImages", 0, 1));
+    auto results = std::make_shared<std::vector<ConvertResult>>();
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    auto batch = StartConvertImages(std::move(tasks), concurrency, results, [tsfn, results, cancelled] {
+        tsfn->BlockingCall(new ConvertCompletion{results, cancelled->load()}, CallConvertJs);
+        tsfn->Release();
+    });
+
+    auto handle = Napi::Object::New(env);
+    handle.Set("cancel", Napi::Function::New(env, [batch, cancelled](const Napi::CallbackInfo &) {
+        cancelled->store(true);
+        batch->Cancel();
+    }));
+    return handle;
+}
+
+Napi::Object EntryInfoToJs(const Napi::Env &env, const TileStore::EntryInfo &info) {
+    auto entry = Napi::Object::New(env);
+    entry.Set("id", Napi::Number::New(env, static_cast<double>(info.id)));
+    entry.Set("width", Napi::Number::New(env, info.width));
+    entry.Set("height", Napi::Number::New(env, info.height));
+    entry.Set("tiles", Napi::Number::New(env, info.tiles));
+    entry.Set("newTiles", Napi::Number::New(env, info.new_tiles));
+    entry.Set("deltaBytes", Napi::Number::New(env, static_cast<double>(info.delta_bytes)));
+    return entry;
+}
+
+// Entry id argument at `index`, throws and returns false when missing
+bool GetEntryId(const Napi::CallbackInfo &info, size_t index, uint64_t &id) {
+    if (info.Length() <= index || !info[index].IsNumber()) {
+        Napi::TypeError::New(info.Env(), "Expect an entry id.").ThrowAsJavaScriptException();
+        return false;
+    }
+    id = static_cast<uint64_t>(info[index].As<Napi::Number>().Int64Value());
+    return true;
+}
+
+// `{add, get, save, remove, changedRegions, stats}` around a TileStore
+Napi::Value CreateImageHistoryJs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    uint32_t tile_size = 64;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value value = info[0].As<Napi::Object>().Get("tileSize");
+        if (value.IsNumber()) {
+            tile_size = value.As<Napi::Number>().Uint32Value();
+        }
+    }
+    if (tile_size < 8 || tile_size > 1024) {
+        Napi::RangeError::New(env, "tileSize must be between 8 and 1024").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto store = std::make_shared<TileStore>(tile_size);
+    auto history = Napi::Object::New(env);
+
+    history.Set("add", Napi::Function::New(env, [store](const Napi::CallbackInfo &info) -> Napi::Value {
+        Napi::Env env = info.Env();
+        ClipboardSelection selection;
+        if (!GetSelectionOption(info, 0, selection)) {
+            return env.Undefined();
+        }
+        ImagePixels image;
+        if (!ReadImagePixels(image, selection)) {
+            return env.Null();
+        }
+        return EntryInfoToJs(env, store->Add(image));
+    }));
+
+    history.Set("get", Napi::Function::New(env, [store](const Napi::CallbackInfo &info) -> Napi::Value {
+        Napi::Env env = info.Env();
+        uint64_t id;
+        ImagePixels image;
+        if (!GetEntryId(info, 0, id) || !store->Read(id, image)) {
+            return env.Null();
+        }
+        auto result = Napi::Object::New(env);
+        result.Set("width", Napi::Number::New(env, image.width));
+        result.Set("height", Napi::Number::New(env, image.height));
+        size_t size = image.stride * image.height;
+        auto *pixels = new PooledBuffer(std::move(image.pixels));
+        ClipboardData data(pixels->data(), size, PooledBuffer::Delete, pixels);
+        result.Set("data", ClipboardDataToBuffer(env, data));
+        return result;
+    }));
+
+    history.Set("save", Napi::Function::New(env, [store](const Napi::CallbackInfo &info) -> Napi::Value {
+        Napi::Env env = info.Env();
+        uint64_t id;
+        if (!GetEntryId(info, 0, id)) {
+            return env.Undefined();
+        }
+        if (info.Length() < 2 || !info[1].IsString()) {
+            Napi::TypeError::New(env, "Expect a target path.").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        std::string target_path = info[1].As<Napi::String>();
+        ImageFormat format = ImageFormat::Png;
+        float quality = 0.9f;
+        if (info.Length() > 2 && info[2].IsObject()) {
+            auto options = info[2].As<Napi::Object>();
+            Napi::Value format_js = options.Get("format");
+            if (format_js.IsString() && format_js.As<Napi::String>().Utf8Value() == "jpeg") {
+                format = ImageFormat::Jpeg;
+            }
+            Napi::Value quality_js = options.Get("quality");
+            if (quality_js.IsNumber()) {
+                quality = quality_js.As<Napi::Number>();
+            }
+        }
+        ImagePixels image;
+        bool ok = store->Read(id, image) && SaveImagePixels(image, target_path, format, quality);
+        return Napi::Boolean::New(env, ok);
+    }));
+
+    history.Set("remove", Napi::Function::New(env, [store](const Napi::CallbackInfo &info) -> Napi::Value {
+        uint64_t id;
+        if (!GetEntryId(info, 0, id)) {
+            return info.Env().Undefined();
+        }
+        return Napi::Boolean::New(info.Env(), store->Remove(id));
+    }));
+
+    history.Set("changedRegions", Napi::Function::New(env, [store](const Napi::CallbackInfo &info) -> Napi::Value {
+        Napi::Env env = info.Env();
+        uint64_t id, previous;
+        std::vector<TileStore::Region> regions;
+        if (!GetEntryId(info, 0, id) || !GetEntryId(info, 1, previous) ||
+            !store->ChangedRegions(id, previous, regions)) {
+            return env.Null();
+        }
+        auto result = Napi::Array::New(env, regions.size());
+        for (size_t i = 0; i < regions.size(); ++i) {
+            auto region = Napi::Object::New(env);
+            region.Set("x", Napi::Number::New(env, regions[i].x));
+            region.Set("y", Napi::Number::New(env, regions[i].y));
+            region.Set("width", Napi::Number::New(env, regions[i].width));
+            region.Set("height", Napi::Number::New(env, regions[i].height));
+            result.Set(static_cast<uint32_t>(i), region);
+        }
+        return result;
+    }));
+
+    history.Set("stats", Napi::Function::New(env, [store](const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        TileStore::Stats stats = store->GetStats();
+        auto result = Napi::Object::New(env);
+        result.Set("entries", Napi::Number::New(env, static_cast<double>(stats.entries)));
+        result.Set("uniqueTiles", Napi::Number::New(env, static_cast<double>(stats.unique_tiles)));
+        result.Set("storedBytes", Napi::Number::New(env, static_cast<double>(stats.stored_bytes)));
+        result.Set("logicalBytes", Napi::Number::New(env, static_cast<double>(stats.logical_bytes)));
+        return result;
+    }));
+    return history;
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set("readFilePaths", Napi::Function::New(env, ReadFilePathsJs));
     exports.Set("writeFilePaths", Napi::Function::New(env, WriteFilePathsJs));
+    exports.Set("readFilePathList", Napi::Function::New(env, ReadFilePathListJs));
+    exports.Set("PathList", PathListWrap::Define(env));
     exports.Set("clear", Napi::Function::New(env, ClearClipboardJs));
     exports.Set("saveImageAsJpegSync", Napi::Function::New(env, SaveClipboardImageAsJpegSync));
     exports.Set("saveImageAsJpegAsync", Napi::Function::New(env, SaveClipboardImageAsJpegAsync));
     exports.Set("saveImageAsPngSync", Napi::Function::New(env, SaveClipboardImageAsPngSync));
     exports.Set("saveImageAsPngAsync", Napi::Function::New(env, SaveClipboardImageAsPngAsync));
+    exports.Set("saveImageTransformedAsync", Napi::Function::New(env, SaveImageTransformedAsync));
     exports.Set("putImageSync", Napi::Function::New(env, PutImageIntoClipboardSync));
     exports.Set("putImageAsync", Napi::Function::New(env, PutImageIntoClipboardAsync));
     exports.Set("hasImage", Napi::Function::New(env, ClipboardHasImageJs));
+    exports.Set("readImageShared", Napi::Function::New(env, ReadImageSharedJs));
+    exports.Set("readText", Napi::Function::New(env, ReadTextJs));
+    exports.Set("writeText", Napi::Function::New(env, WriteTextJs));
+    exports.Set("readRich", Napi::Function::New(env, ReadRichJs));
+    exports.Set("writeRich", Napi::Function::New(env, WriteRichJs));
+    exports.Set("writeMulti", Napi::Function::New(env, WriteMultiJs));
+    exports.Set("getSequenceNumber", Napi::Function::New(env, ClipboardSequenceNumberJs));
+    exports.Set("targetDigest", Napi::Function::New(env, TargetDigestJs));
+    exports.Set("getStats", Napi::Function::New(env, ClipboardStatsJs));
+    exports.Set("setBackend", Napi::Function::New(env, SetBackendJs));
+    exports.Set("getBackend", Napi::Function::New(env, GetBackendJs));
+    exports.Set("startAutoArchive", Napi::Function::New(env, StartAutoArchiveJs));
+    exports.Set("thumbnailsForPaths", Napi::Function::New(env, ThumbnailsForPathsJs));
+    exports.Set("convertImages", Napi::Function::New(env, ConvertImagesJs));
+    exports.Set("createImageHistory", Napi::Function::New(env, CreateImageHistoryJs));
     return exports;
 }
 
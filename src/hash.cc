@@ -0,0 +1,141 @@
+#include "hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little endian loads, memcpy compiles to a single unaligned move
+inline uint64_t Read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+inline uint32_t Read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+inline uint64_t Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = RotateLeft(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= Round(0, value);
+    return accumulator * kPrime1 + kPrime4;
+}
+
+// The remaining < 32 bytes and the avalanche
+uint64_t Finish(uint64_t hash, const uint8_t *p, const uint8_t *end) {
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Read64(p));
+        hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+        hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= static_cast<uint64_t>(*p) * kPrime5;
+        hash = RotateLeft(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t MergeLanes(const uint64_t lanes[4]) {
+    uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) +
+                    RotateLeft(lanes[3], 18);
+    for (int i = 0; i < 4; ++i) {
+        hash = MergeRound(hash, lanes[i]);
+    }
+    return hash;
+}
+
+// Consumes whole 32 byte stripes, returns where it stopped
+const uint8_t *Stripes(uint64_t lanes[4], const uint8_t *p, const uint8_t *end) {
+    for (; end - p >= 32; p += 32) {
+        lanes[0] = Round(lanes[0], Read64(p));
+        lanes[1] = Round(lanes[1], Read64(p + 8));
+        lanes[2] = Round(lanes[2], Read64(p + 16));
+        lanes[3] = Round(lanes[3], Read64(p + 24));
+    }
+    return p;
+}
+
+} // namespace
+
+uint64_t Xxh64(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t lanes[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+        p = Stripes(lanes, p, end);
+        hash = MergeLanes(lanes);
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += static_cast<uint64_t>(size);
+    return Finish(hash, p, end);
+}
+
+Xxh64Stream::Xxh64Stream(uint64_t seed)
+        : _seed(seed), _lanes{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1} {}
+
+void Xxh64Stream::Update(const void *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *end = p + size;
+    _total += size;
+
+    if (_buffered > 0) {
+        size_t take = std::min(size, sizeof(_buffer) - _buffered);
+        memcpy(_buffer + _buffered, p, take);
+        _buffered += take;
+        p += take;
+        if (_buffered < sizeof(_buffer)) {
+            return;
+        }
+        Stripes(_lanes, _buffer, _buffer + sizeof(_buffer));
+        _buffered = 0;
+    }
+    p = Stripes(_lanes, p, end);
+    memcpy(_buffer, p, static_cast<size_t>(end - p));
+    _buffered = static_cast<size_t>(end - p);
+}
+
+uint64_t Xxh64Stream::Digest() const {
+    uint64_t hash = _total >= 32 ? MergeLanes(_lanes) : _seed + kPrime5;
+    hash += _total;
+    return Finish(hash, _buffer, _buffer + _buffered);
+}
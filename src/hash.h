@@ -0,0 +1,34 @@
+#ifndef ELECTRON_CLIPBOARD_EX_HASH_H
+#define ELECTRON_CLIPBOARD_EX_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH64 (https://github.com/Cyan4973/xxHash), used to fingerprint clipboard
+// payloads. Hashes several GB/s, results match the reference implementation.
+uint64_t Xxh64(const void *data, size_t size, uint64_t seed = 0);
+
+// XXH64 of data arriving in pieces, such as a transfer read chunk by chunk.
+// The digest equals Xxh64 of all pieces concatenated, however they are cut.
+class Xxh64Stream {
+public:
+    explicit Xxh64Stream(uint64_t seed = 0);
+
+    void Update(const void *data, size_t size);
+
+    uint64_t Digest() const;
+
+    // Bytes passed to Update so far.
+    uint64_t size() const {
+        return _total;
+    }
+
+private:
+    uint64_t _seed;
+    uint64_t _lanes[4];
+    uint64_t _total = 0;
+    uint8_t _buffer[32];
+    size_t _buffered = 0;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_HASH_H
@@ -0,0 +1,193 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include "html_text.h"
+
+namespace {
+
+bool EqualsIgnoreCase(const char *a, size_t a_len, const char *b) {
+    size_t b_len = strlen(b);
+    if (a_len != b_len) {
+        return false;
+    }
+    for (size_t i = 0; i < a_len; ++i) {
+        char c = a[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        if (c != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsBlockElement(const char *name, size_t len) {
+    static const char *const kBlockElements[] = {
+        "br", "p", "div", "li", "tr", "h1", "h2", "h3", "h4", "h5", "h6",
+        "ul", "ol", "table", "blockquote", "pre", "hr", "section", "article",
+    };
+    for (const char *block : kBlockElements) {
+        if (EqualsIgnoreCase(name, len, block)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AppendCodePoint(std::string &out, unsigned long cp) {
+    if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        cp = 0xFFFD;
+    }
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Decodes the reference starting at `html[i] == '&'`, returns the number of
+// bytes consumed or 0 if it is not a reference we know.
+size_t DecodeReference(const char *html, size_t size, size_t i, std::string &out) {
+    size_t end = i + 1;
+    while (end < size && end - i < 12 && html[end] != ';') {
+        ++end;
+    }
+    if (end >= size || html[end] != ';') {
+        return 0;
+    }
+    const char *name = html + i + 1;
+    size_t len = end - i - 1;
+    if (len > 1 && name[0] == '#') {
+        char buffer[12] = {};
+        memcpy(buffer, name + 1, len - 1);
+        bool hex = buffer[0] == 'x' || buffer[0] == 'X';
+        char *parse_end = nullptr;
+        unsigned long cp = strtoul(hex ? buffer + 1 : buffer, &parse_end, hex ? 16 : 10);
+        if (!parse_end || *parse_end != '\0') {
+            return 0;
+        }
+        AppendCodePoint(out, cp);
+        return end - i + 1;
+    }
+
+    static const struct {
+        const char *name;
+        const char *text;
+    } kEntities[] = {
+        {"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"}, {"nbsp", " "},
+    };
+    for (const auto &entity : kEntities) {
+        if (len == strlen(entity.name) && memcmp(name, entity.name, len) == 0) {
+            out.append(entity.text);
+            return end - i + 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+std::string HtmlToText(const char *html, size_t size) {
+    std::string_view source(html, size);
+    std::string out;
+    out.reserve(size / 2);
+    bool pending_space = false;
+    size_t i = 0;
+    while (i < size) {
+        char ch = html[i];
+        if (ch == '<') {
+            if (source.compare(i, 4, "<!--") == 0) {
+                size_t close = source.find("-->", i + 4);
+                i = close == std::string_view::npos ? size : close + 3;
+                continue;
+            }
+            bool closing = i + 1 < size && html[i + 1] == '/';
+            size_t name_start = closing ? i + 2 : i + 1;
+            size_t name_end = name_start;
+            while (name_end < size && isalnum(static_cast<unsigned char>(html[name_end]))) {
+                ++name_end;
+            }
+            size_t tag_end = source.find('>', i);
+            size_t next = tag_end == std::string_view::npos ? size : tag_end + 1;
+            const char *name = html + name_start;
+            size_t name_len = name_end - name_start;
+
+            if (!closing && (EqualsIgnoreCase(name, name_len, "script") ||
+                             EqualsIgnoreCase(name, name_len, "style"))) {
+                // Skip the body up to the matching closing tag
+                size_t close = source.find("</", next);
+                while (close != std::string_view::npos &&
+                       !(size - close - 2 >= name_len && EqualsIgnoreCase(html + close + 2, name_len,
+                                                                          name_len == 6 ? "script" : "style"))) {
+                    close = source.find("</", close + 2);
+                }
+                if (close == std::string_view::npos) {
+                    break;
+                }
+                size_t close_end = source.find('>', close);
+                i = close_end == std::string_view::npos ? size : close_end + 1;
+                continue;
+            }
+
+            if (IsBlockElement(name, name_len)) {
+                while (!out.empty() && out.back() == ' ') {
+                    out.pop_back();
+                }
+                if (!out.empty() && out.back() != '\n') {
+                    out.push_back('\n');
+                } else if (EqualsIgnoreCase(name, name_len, "br")) {
+                    out.push_back('\n');
+                }
+                pending_space = false;
+            }
+            i = next;
+            continue;
+        }
+
+        if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\f') {
+            pending_space = !out.empty() && out.back() != '\n';
+            ++i;
+            continue;
+        }
+
+        if (pending_space) {
+            out.push_back(' ');
+            pending_space = false;
+        }
+        if (ch == '&') {
+            size_t consumed = DecodeReference(html, size, i, out);
+            if (consumed) {
+                i += consumed;
+                continue;
+            }
+        }
+        // Copy the run of ordinary characters at once
+        size_t run_end = i + 1;
+        while (run_end < size) {
+            char c = html[run_end];
+            if (c == '<' || c == '&' || c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f') {
+                break;
+            }
+            ++run_end;
+        }
+        out.append(html + i, run_end - i);
+        i = run_end;
+    }
+
+    while (!out.empty() && (out.back() == '\n' || out.back() == ' ')) {
+        out.pop_back();
+    }
+    return out;
+}
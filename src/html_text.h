@@ -0,0 +1,12 @@
+#ifndef ELECTRON_CLIPBOARD_EX_HTML_TEXT_H
+#define ELECTRON_CLIPBOARD_EX_HTML_TEXT_H
+
+#include <cstddef>
+#include <string>
+
+// Derives the plain text of an HTML fragment in a single pass: tags are
+// dropped, script/style bodies skipped, block elements become line breaks,
+// whitespace is collapsed and character references are decoded.
+std::string HtmlToText(const char *html, size_t size);
+
+#endif //ELECTRON_CLIPBOARD_EX_HTML_TEXT_H
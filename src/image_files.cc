@@ -0,0 +1,163 @@
+#include "image_files.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <atomic>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+std::wstring ToWide(const std::string &input) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, input.data(), static_cast<int>(input.size()), nullptr, 0);
+    std::wstring result(static_cast<size_t>(length), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, input.data(), static_cast<int>(input.size()), &result[0], length);
+    return result;
+}
+#endif
+
+bool RenameFile(const std::string &from, const std::string &to) {
+#ifdef _WIN32
+    return MoveFileExW(ToWide(from).c_str(), ToWide(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+FILE *OpenForWriting(const std::string &path) {
+#ifdef _WIN32
+    return _wfopen(ToWide(path).c_str(), L"wb");
+#else
+    return fopen(path.c_str(), "wb");
+#endif
+}
+
+// Dot prefixed so that directory watchers filtering hidden files skip it
+std::string TempPathFor(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    size_t name_start = slash == std::string::npos ? 0 : slash + 1;
+    return path.substr(0, name_start) + "." + path.substr(name_start) + ".part";
+}
+
+} // namespace
+
+void RemoveFile(const std::string &path) {
+#ifdef _WIN32
+    DeleteFileW(ToWide(path).c_str());
+#else
+    unlink(path.c_str());
+#endif
+}
+
+void RemoveEmptyDirectory(const std::string &path) {
+#ifdef _WIN32
+    RemoveDirectoryW(ToWide(path).c_str());
+#else
+    rmdir(path.c_str());
+#endif
+}
+
+bool CreateTempDirectory(std::string &path) {
+#ifdef _WIN32
+    wchar_t temp[MAX_PATH + 1];
+    DWORD length = GetTempPathW(MAX_PATH + 1, temp);
+    if (length == 0 || length > MAX_PATH) {
+        return false;
+    }
+    static std::atomic<unsigned> counter{0};
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        std::wstring candidate = std::wstring(temp, length) + L"clipboard-ex-" +
+                                 std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(counter++);
+        if (CreateDirectoryW(candidate.c_str(), nullptr)) {
+            int size = WideCharToMultiByte(CP_UTF8, 0, candidate.data(), static_cast<int>(candidate.size()),
+                                           nullptr, 0, nullptr, nullptr);
+            path.assign(static_cast<size_t>(size), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, candidate.data(), static_cast<int>(candidate.size()), &path[0], size,
+                                nullptr, nullptr);
+            return true;
+        }
+        if (GetLastError() != ERROR_ALREADY_EXISTS) {
+            return false;
+        }
+    }
+    return false;
+#else
+    const char *temp = getenv("TMPDIR");
+    std::string pattern = JoinPath(temp && *temp ? temp : "/tmp", "clipboard-ex-XXXXXX");
+    if (!mkdtemp(&pattern[0])) {
+        return false;
+    }
+    path = pattern;
+    return true;
+#endif
+}
+
+std::string JoinPath(const std::string &directory, const std::string &name) {
+    if (directory.empty() || directory.back() == '/' || directory.back() == '\\') {
+        return directory + name;
+    }
+    return directory + "/" + name;
+}
+
+bool StatFile(const std::string &path, FileStat &stat) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(ToWide(path).c_str(), GetFileExInfoStandard, &data)) {
+        return false;
+    }
+    stat.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    // 100 ns intervals since 1601, only compared for equality
+    stat.mtime_ns = static_cast<int64_t>(((static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                          data.ftLastWriteTime.dwLowDateTime) * 100);
+    return true;
+#else
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    stat.size = static_cast<uint64_t>(info.st_size);
+#ifdef __APPLE__
+    stat.mtime_ns = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    stat.mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    return true;
+#endif
+}
+
+bool SaveImagePixelsAtomically(const ImagePixels &image, const std::string &path, ImageFormat format,
+                               float quality) {
+    std::string temp_path = TempPathFor(path);
+    if (!SaveImagePixels(image, temp_path, format, quality) || !RenameFile(temp_path, path)) {
+        RemoveFile(temp_path);
+        return false;
+    }
+    return true;
+}
+
+bool WriteFileAtomically(const std::string &path, const char *data, size_t size) {
+    return WriteFileAtomically(path, [data, size](FILE *file) {
+        return fwrite(data, 1, size, file) == size;
+    });
+}
+
+bool WriteFileAtomically(const std::string &path, const std::function<bool(FILE *file)> &write) {
+    std::string temp_path = TempPathFor(path);
+    FILE *file = OpenForWriting(temp_path);
+    if (!file) {
+        return false;
+    }
+    bool ok = write(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok || !RenameFile(temp_path, path)) {
+        RemoveFile(temp_path);
+        return false;
+    }
+    return true;
+}
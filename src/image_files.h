@@ -0,0 +1,43 @@
+#ifndef ELECTRON_CLIPBOARD_EX_IMAGE_FILES_H
+#define ELECTRON_CLIPBOARD_EX_IMAGE_FILES_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include "clipboard.h"
+
+// Helpers for files written by background jobs. Paths are UTF-8 on every
+// platform.
+
+std::string JoinPath(const std::string &directory, const std::string &name);
+
+struct FileStat {
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+};
+
+bool StatFile(const std::string &path, FileStat &stat);
+
+// Errors are ignored, the path may already be gone.
+void RemoveFile(const std::string &path);
+
+void RemoveEmptyDirectory(const std::string &path);
+
+// Creates a new directory, private to the caller, under the system temp
+// directory.
+bool CreateTempDirectory(std::string &path);
+
+// Encodes into a temporary file next to `path` and renames it into place,
+// so that readers never see a partially written image.
+bool SaveImagePixelsAtomically(const ImagePixels &image, const std::string &path, ImageFormat format,
+                               float quality);
+
+// Writes `size` bytes the same way.
+bool WriteFileAtomically(const std::string &path, const char *data, size_t size);
+
+// Lets `write` fill the temporary file, which is renamed into place only if
+// it returns true.
+bool WriteFileAtomically(const std::string &path, const std::function<bool(FILE *file)> &write);
+
+#endif //ELECTRON_CLIPBOARD_EX_IMAGE_FILES_H
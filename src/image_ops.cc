@@ -0,0 +1,180 @@
+#include "image_ops.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "hash.h"
+
+void FitWithin(uint32_t width, uint32_t height, uint32_t max_size, uint32_t &out_width, uint32_t &out_height) {
+    uint32_t longest = std::max(width, height);
+    if (max_size == 0 || longest <= max_size) {
+        out_width = width;
+        out_height = height;
+        return;
+    }
+    out_width = std::max<uint32_t>(1, static_cast<uint32_t>((static_cast<uint64_t>(width) * max_size +
+                                                              longest / 2) / longest));
+    out_height = std::max<uint32_t>(1, static_cast<uint32_t>((static_cast<uint64_t>(height) * max_size +
+                                                               longest / 2) / longest));
+}
+
+bool Downscale(const ImagePixels &src, uint32_t width, uint32_t height, ImagePixels &dst) {
+    if (!src.pixels.data() || width == 0 || height == 0 || width > src.width || height > src.height) {
+        return false;
+    }
+    dst.width = width;
+    dst.height = height;
+    dst.stride = static_cast<size_t>(width) * 4;
+    dst.pixels = PooledBuffer(dst.stride * height);
+    if (!dst.pixels.data()) {
+        return false;
+    }
+
+    // Every destination column covers source columns [x_start[x], x_start[x + 1])
+    std::vector<uint32_t> x_start(width + 1);
+    for (uint32_t x = 0; x <= width; ++x) {
+        x_start[x] = static_cast<uint32_t>(static_cast<uint64_t>(x) * src.width / width);
+    }
+    std::vector<uint64_t> sums(static_cast<size_t>(width) * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+        uint32_t y_begin = static_cast<uint32_t>(static_cast<uint64_t>(y) * src.height / height);
+        uint32_t y_end = static_cast<uint32_t>(static_cast<uint64_t>(y + 1) * src.height / height);
+        std::fill(sums.begin(), sums.end(), 0);
+        for (uint32_t sy = y_begin; sy < y_end; ++sy) {
+            const auto *row = reinterpret_cast<const uint8_t *>(src.pixels.data() + sy * src.stride);
+            for (uint32_t x = 0; x < width; ++x) {
+                uint64_t *sum = &sums[x * 4];
+                for (uint32_t sx = x_start[x]; sx < x_start[x + 1]; ++sx) {
+                    const uint8_t *pixel = row + sx * 4;
+                    uint32_t alpha = pixel[3];
+                    sum[0] += pixel[0] * alpha;
+                    sum[1] += pixel[1] * alpha;
+                    sum[2] += pixel[2] * alpha;
+                    sum[3] += alpha;
+                }
+            }
+        }
+        auto *out = reinterpret_cast<uint8_t *>(dst.pixels.data() + y * dst.stride);
+        for (uint32_t x = 0; x < width; ++x, out += 4) {
+            const uint64_t *sum = &sums[x * 4];
+            uint64_t count = static_cast<uint64_t>(x_start[x + 1] - x_start[x]) * (y_end - y_begin);
+            uint64_t alpha = sum[3];
+            if (alpha == 0) {
+                out[0] = out[1] = out[2] = out[3] = 0;
+                continue;
+            }
+            out[0] = static_cast<uint8_t>((sum[0] + alpha / 2) / alpha);
+            out[1] = static_cast<uint8_t>((sum[1] + alpha / 2) / alpha);
+            out[2] = static_cast<uint8_t>((sum[2] + alpha / 2) / alpha);
+            out[3] = static_cast<uint8_t>((alpha + count / 2) / count);
+        }
+    }
+    return true;
+}
+
+Orientation GetOrientation(const ImageTransform &transform) {
+    Orientation orientation;
+    switch (transform.rotate % 360) {
+        case 90:
+            orientation.transpose = true;
+            orientation.mirror_x = true;
+            break;
+        case 180:
+            orientation.mirror_x = true;
+            orientation.mirror_y = true;
+            break;
+        case 270:
+            orientation.transpose = true;
+            orientation.mirror_y = true;
+            break;
+        default:
+            break;
+    }
+    orientation.mirror_x ^= transform.flip_horizontal;
+    orientation.mirror_y ^= transform.flip_vertical;
+    return orientation;
+}
+
+bool ResolveCrop(const ImageTransform &transform, uint32_t width, uint32_t height, uint32_t &x, uint32_t &y,
+                 uint32_t &crop_width, uint32_t &crop_height) {
+    if (transform.crop_x >= width || transform.crop_y >= height) {
+        return false;
+    }
+    x = transform.crop_x;
+    y = transform.crop_y;
+    crop_width = transform.crop_width ? std::min(transform.crop_width, width - x) : width - x;
+    crop_height = transform.crop_height ? std::min(transform.crop_height, height - y) : height - y;
+    return true;
+}
+
+bool TransformPixels(const ImagePixels &src, const ImageTransform &transform, ImagePixels &dst) {
+    uint32_t x0, y0, width, height;
+    if (!src.pixels.data() || !ResolveCrop(transform, src.width, src.height, x0, y0, width, height)) {
+        return false;
+    }
+    Orientation orientation = GetOrientation(transform);
+    dst.width = orientation.transpose ? height : width;
+    dst.height = orientation.transpose ? width : height;
+    dst.stride = static_cast<size_t>(dst.width) * 4;
+    dst.pixels = PooledBuffer(dst.stride * dst.height);
+    if (!dst.pixels.data()) {
+        return false;
+    }
+    for (uint32_t y = 0; y < dst.height; ++y) {
+        auto *out = reinterpret_cast<uint32_t *>(dst.pixels.data() + y * dst.stride);
+        uint32_t mirrored_y = orientation.mirror_y ? dst.height - 1 - y : y;
+        for (uint32_t x = 0; x < dst.width; ++x) {
+            uint32_t mirrored_x = orientation.mirror_x ? dst.width - 1 - x : x;
+            uint32_t sx = x0 + (orientation.transpose ? mirrored_y : mirrored_x);
+            uint32_t sy = y0 + (orientation.transpose ? mirrored_x : mirrored_y);
+            memcpy(out + x, src.pixels.data() + sy * src.stride + sx * 4, 4);
+        }
+    }
+    return true;
+}
+
+void ToBgra(const ImagePixels &src, bool premultiply, char *dst, size_t dst_stride) {
+    for (uint32_t y = 0; y < src.height; ++y) {
+        RowToBgra(reinterpret_cast<const uint8_t *>(src.pixels.data() + y * src.stride), 4, src.width, premultiply,
+                  reinterpret_cast<uint8_t *>(dst + y * dst_stride));
+    }
+}
+
+void RowToBgra(const uint8_t *in, int channels, uint32_t width, bool premultiply, uint8_t *out) {
+    for (uint32_t x = 0; x < width; ++x, in += channels, out += 4) {
+        uint32_t red = in[0];
+        uint32_t green = in[1];
+        uint32_t blue = in[2];
+        uint32_t alpha = channels == 4 ? in[3] : 255;
+        if (premultiply && alpha != 255) {
+            red = (red * alpha + 127) / 255;
+            green = (green * alpha + 127) / 255;
+            blue = (blue * alpha + 127) / 255;
+        }
+        out[0] = static_cast<uint8_t>(blue);
+        out[1] = static_cast<uint8_t>(green);
+        out[2] = static_cast<uint8_t>(red);
+        out[3] = static_cast<uint8_t>(alpha);
+    }
+}
+
+void UnpremultiplyRow(uint8_t *row, uint32_t width) {
+    for (uint32_t x = 0; x < width; ++x, row += 4) {
+        uint32_t alpha = row[3];
+        if (alpha != 0 && alpha != 255) {
+            row[0] = static_cast<uint8_t>(std::min<uint32_t>(255, (row[0] * 255 + alpha / 2) / alpha));
+            row[1] = static_cast<uint8_t>(std::min<uint32_t>(255, (row[1] * 255 + alpha / 2) / alpha));
+            row[2] = static_cast<uint8_t>(std::min<uint32_t>(255, (row[2] * 255 + alpha / 2) / alpha));
+        }
+    }
+}
+
+uint64_t FingerprintPixels(const ImagePixels &image) {
+    size_t row_bytes = static_cast<size_t>(image.width) * 4;
+    // Chained row by row, so the stride does not change the result
+    uint64_t hash = Xxh64(nullptr, 0, (static_cast<uint64_t>(image.width) << 32) | image.height);
+    for (uint32_t y = 0; y < image.height; ++y) {
+        hash = Xxh64(image.pixels.data() + y * image.stride, row_bytes, hash);
+    }
+    return hash;
+}
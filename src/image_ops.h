@@ -0,0 +1,61 @@
+#ifndef ELECTRON_CLIPBOARD_EX_IMAGE_OPS_H
+#define ELECTRON_CLIPBOARD_EX_IMAGE_OPS_H
+
+#include <cstdint>
+#include "clipboard.h"
+
+// Size of `width` x `height` scaled to fit `max_size` on its longest edge,
+// unchanged if it already fits or `max_size` is 0.
+void FitWithin(uint32_t width, uint32_t height, uint32_t max_size, uint32_t &out_width, uint32_t &out_height);
+
+// Box filter downscale of `src` into `width` x `height`, which must not be
+// larger than `src`. Averages in premultiplied alpha so that transparent
+// pixels do not bleed their color into the edges.
+bool Downscale(const ImagePixels &src, uint32_t width, uint32_t height, ImagePixels &dst);
+
+// Crop, then clockwise rotation, then flips.
+struct ImageTransform {
+    uint32_t crop_x = 0;
+    uint32_t crop_y = 0;
+    uint32_t crop_width = 0; // 0 extends the crop to the right edge
+    uint32_t crop_height = 0; // 0 extends the crop to the bottom edge
+    uint32_t rotate = 0; // 0, 90, 180 or 270
+    bool flip_horizontal = false;
+    bool flip_vertical = false;
+};
+
+// The rotation and flips of a transform as a transposition followed by
+// mirroring along the x and y axes of the transposed image.
+struct Orientation {
+    bool transpose = false;
+    bool mirror_x = false;
+    bool mirror_y = false;
+};
+
+Orientation GetOrientation(const ImageTransform &transform);
+
+// The crop of `transform` clamped to a `width` x `height` image, false if
+// it is empty.
+bool ResolveCrop(const ImageTransform &transform, uint32_t width, uint32_t height, uint32_t &x, uint32_t &y,
+                 uint32_t &crop_width, uint32_t &crop_height);
+
+bool TransformPixels(const ImagePixels &src, const ImageTransform &transform, ImagePixels &dst);
+
+// Copies `src` into `dst` as BGRA, the byte order of Skia's N32 bitmaps
+// that Electron's nativeImage.createFromBitmap takes, premultiplied if
+// asked. `dst` holds `src.height` rows `dst_stride` bytes apart.
+void ToBgra(const ImagePixels &src, bool premultiply, char *dst, size_t dst_stride);
+
+// One row of `width` RGB (`channels` 3) or straight alpha RGBA (4) pixels
+// as BGRA like `ToBgra`. `in` may equal `out` for RGBA rows, which converts
+// them in place.
+void RowToBgra(const uint8_t *in, int channels, uint32_t width, bool premultiply, uint8_t *out);
+
+// Divides the alpha out of a row of premultiplied 4 byte pixels whose alpha
+// is last, either RGBA or BGRA.
+void UnpremultiplyRow(uint8_t *row, uint32_t width);
+
+// Fingerprint of the size and pixels of `image`, row padding excluded.
+uint64_t FingerprintPixels(const ImagePixels &image);
+
+#endif //ELECTRON_CLIPBOARD_EX_IMAGE_OPS_H
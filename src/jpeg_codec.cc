@@ -0,0 +1,225 @@
+#include "jpeg_codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <jerror.h>
+#include "jpeg_contexts.h"
+
+namespace {
+
+const size_t kInitialOutputSize = 64 << 10;
+const uint32_t kRowsPerBatch = 16;
+
+std::atomic<uint64_t> acquires{0};
+std::atomic<uint64_t> reuses{0};
+std::atomic<uint32_t> live{0};
+
+void ExitOnError(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<JpegContexts::ErrorManager *>(cinfo->err)->jump, 1);
+}
+
+void IgnoreMessage(j_common_ptr cinfo) {
+    (void)cinfo;
+}
+
+void InitDestination(j_compress_ptr cinfo) {
+    auto *dest = reinterpret_cast<JpegContexts::PooledDestination *>(cinfo->dest);
+    if (dest->buffer->capacity() < kInitialOutputSize && !dest->buffer->Grow(kInitialOutputSize, 0)) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    dest->size = 0;
+    dest->pub.next_output_byte = reinterpret_cast<JOCTET *>(dest->buffer->data());
+    dest->pub.free_in_buffer = dest->buffer->capacity();
+}
+
+boolean EmptyOutputBuffer(j_compress_ptr cinfo) {
+    auto *dest = reinterpret_cast<JpegContexts::PooledDestination *>(cinfo->dest);
+    // Called with the buffer full, everything up to its capacity is written
+    dest->size = dest->buffer->capacity();
+    if (!dest->buffer->Grow(dest->size * 2, dest->size)) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    dest->pub.next_output_byte = reinterpret_cast<JOCTET *>(dest->buffer->data() + dest->size);
+    dest->pub.free_in_buffer = dest->buffer->capacity() - dest->size;
+    return TRUE;
+}
+
+void TermDestination(j_compress_ptr cinfo) {
+    auto *dest = reinterpret_cast<JpegContexts::PooledDestination *>(cinfo->dest);
+    dest->size = static_cast<size_t>(reinterpret_cast<char *>(dest->pub.next_output_byte) - dest->buffer->data());
+}
+
+size_t WrittenBytes(const JpegContexts::PooledDestination &destination) {
+    return static_cast<size_t>(reinterpret_cast<const char *>(destination.pub.next_output_byte) -
+                               destination.buffer->data());
+}
+
+} // namespace
+
+JpegContexts &JpegContexts::ForThread() {
+    static thread_local JpegContexts contexts;
+    return contexts;
+}
+
+JpegContexts::JpegContexts() {
+    memset(&_compress, 0, sizeof(_compress));
+    memset(&_decompress, 0, sizeof(_decompress));
+    jpeg_std_error(&errors.pub);
+    errors.pub.error_exit = ExitOnError;
+    errors.pub.output_message = IgnoreMessage;
+}
+
+JpegContexts::~JpegContexts() {
+    if (_compress_created) {
+        jpeg_destroy_compress(&_compress);
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (_decompress_created) {
+        jpeg_destroy_decompress(&_decompress);
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+jpeg_compress_struct &JpegContexts::Compressor() {
+    acquires.fetch_add(1, std::memory_order_relaxed);
+    if (_compress_created) {
+        reuses.fetch_add(1, std::memory_order_relaxed);
+        return _compress;
+    }
+    _compress.err = &errors.pub;
+    // Only fails by longjmp, leaving the object as before
+    jpeg_create_compress(&_compress);
+    _compress_created = true;
+    live.fetch_add(1, std::memory_order_relaxed);
+    _compress.in_color_space = JCS_RGB;
+    _compress.input_components = 3;
+    jpeg_set_defaults(&_compress);
+    for (int i = 0; i < 2; ++i) {
+        _dc_huff_tables[i] = *_compress.dc_huff_tbl_ptrs[i];
+        _ac_huff_tables[i] = *_compress.ac_huff_tbl_ptrs[i];
+    }
+    compress_quality = -1;
+    return _compress;
+}
+
+void JpegContexts::SetUpCompressor(int quality) {
+    if (compress_quality == quality) {
+        return;
+    }
+    jpeg_set_defaults(&_compress);
+    for (int i = 0; i < 2; ++i) {
+        *_compress.dc_huff_tbl_ptrs[i] = _dc_huff_tables[i];
+        *_compress.ac_huff_tbl_ptrs[i] = _ac_huff_tables[i];
+    }
+    jpeg_set_quality(&_compress, quality, TRUE);
+    compress_quality = quality;
+}
+
+jpeg_decompress_struct &JpegContexts::Decompressor() {
+    acquires.fetch_add(1, std::memory_order_relaxed);
+    if (_decompress_created) {
+        reuses.fetch_add(1, std::memory_order_relaxed);
+        return _decompress;
+    }
+    _decompress.err = &errors.pub;
+    jpeg_create_decompress(&_decompress);
+    _decompress_created = true;
+    live.fetch_add(1, std::memory_order_relaxed);
+    return _decompress;
+}
+
+void JpegContexts::Abort() {
+    if (_compress_created) {
+        jpeg_abort_compress(&_compress);
+    }
+    if (_decompress_created) {
+        jpeg_abort_decompress(&_decompress);
+    }
+}
+
+void JpegContexts::SetDestination(PooledDestination &destination, PooledBuffer &buffer) {
+    destination.buffer = &buffer;
+    destination.size = 0;
+    destination.pub.init_destination = InitDestination;
+    destination.pub.empty_output_buffer = EmptyOutputBuffer;
+    destination.pub.term_destination = TermDestination;
+    _compress.dest = &destination.pub;
+}
+
+// Everything between setjmp and the end may be skipped by the longjmp of a
+// libjpeg error, so only trivially destructible locals live there
+bool CompressJpeg(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride, int channels,
+                  float quality, PooledBuffer &out, size_t &out_size, ProgressSink *progress) {
+    if (!pixels || !width || !height || (channels != 3 && channels != 4)) {
+        return false;
+    }
+    JpegContexts &contexts = JpegContexts::ForThread();
+    JpegContexts::PooledDestination destination;
+    int percent = std::max(0, std::min(100, static_cast<int>(quality * 100.0f)));
+    if (setjmp(contexts.errors.jump)) {
+        contexts.Abort();
+        contexts.compress_quality = -1;
+        return false;
+    }
+
+    jpeg_compress_struct &cinfo = contexts.Compressor();
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    // The JPEG color space and tables do not depend on the input layout, so
+    // only a new quality sets the parameters up again
+    cinfo.in_color_space = JCS_RGB;
+    cinfo.input_components = 3;
+    contexts.SetUpCompressor(percent);
+    bool convert = channels == 4;
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo skips the padding byte itself
+    if (channels == 4) {
+        cinfo.in_color_space = JCS_EXT_RGBX;
+        cinfo.input_components = 4;
+        convert = false;
+    }
+#endif
+    contexts.SetDestination(destination, out);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPARRAY scratch = nullptr;
+    if (convert) {
+        scratch = (*cinfo.mem->alloc_sarray)(reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, width * 3,
+                                             kRowsPerBatch);
+    }
+    JSAMPROW rows[kRowsPerBatch];
+    while (cinfo.next_scanline < height) {
+        uint32_t count = std::min(kRowsPerBatch, height - cinfo.next_scanline);
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t *in = pixels + static_cast<size_t>(cinfo.next_scanline + i) * stride;
+            if (!convert) {
+                rows[i] = const_cast<JSAMPROW>(in);
+                continue;
+            }
+            JSAMPROW row = scratch[i];
+            for (uint32_t x = 0; x < width; ++x, in += 4, row += 3) {
+                row[0] = in[0];
+                row[1] = in[1];
+                row[2] = in[2];
+            }
+            rows[i] = scratch[i];
+        }
+        jpeg_write_scanlines(&cinfo, rows, count);
+        if (!ReportProgress(progress, ProgressPhase::Encode, WrittenBytes(destination), 0)) {
+            contexts.Abort();
+            return false;
+        }
+    }
+    jpeg_finish_compress(&cinfo);
+    out_size = destination.size;
+    return true;
+}
+
+CodecContextStats GetJpegContextStats() {
+    CodecContextStats stats;
+    stats.acquires = acquires.load(std::memory_order_relaxed);
+    stats.reuses = reuses.load(std::memory_order_relaxed);
+    stats.live = live.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,23 @@
+#ifndef ELECTRON_CLIPBOARD_EX_JPEG_CODEC_H
+#define ELECTRON_CLIPBOARD_EX_JPEG_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include "clipboard.h"
+
+// Baseline JPEG encoding through libjpeg with a compressor kept per thread
+// (see jpeg_contexts.h), so that saving many small images does not set up
+// the codec each time. Built where CLIPBOARD_EX_LIBJPEG is defined.
+//
+// `pixels` are `height` rows of 8 bit RGB (`channels` 3) or RGBA
+// (`channels` 4) pixels `stride` bytes apart, alpha is dropped. `quality`
+// goes from 0 to 1. Writes the JPEG into `out` and reports the encoded bytes
+// every few rows, returns false on a libjpeg error or cancellation.
+bool CompressJpeg(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride, int channels,
+                  float quality, PooledBuffer &out, size_t &out_size, ProgressSink *progress = nullptr);
+
+// Compressors and decompressors of all threads, the lossless transforms
+// included.
+CodecContextStats GetJpegContextStats();
+
+#endif //ELECTRON_CLIPBOARD_EX_JPEG_CODEC_H
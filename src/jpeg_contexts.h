@@ -0,0 +1,74 @@
+#ifndef ELECTRON_CLIPBOARD_EX_JPEG_CONTEXTS_H
+#define ELECTRON_CLIPBOARD_EX_JPEG_CONTEXTS_H
+
+#include <csetjmp>
+#include <cstddef>
+#include <cstdio>
+#include <jpeglib.h>
+#include "buffer_pool.h"
+
+// libjpeg objects kept per thread and reused across calls: creating one sets
+// up its memory manager, error tables and, for a compressor, the default
+// component, quantization and Huffman tables. Finished or aborted objects go
+// back to their start state with all of that kept, so the next image only
+// pays for its own data. Internal to the JPEG modules.
+struct JpegContexts {
+    struct ErrorManager {
+        jpeg_error_mgr pub;
+        jmp_buf jump;
+    };
+
+    // Compresses into a PooledBuffer that doubles whenever it fills up
+    struct PooledDestination {
+        jpeg_destination_mgr pub;
+        PooledBuffer *buffer;
+        size_t size;
+    };
+
+    // The contexts of the calling thread. libjpeg errors longjmp to
+    // `errors.jump`, which the caller sets before using either object and
+    // answers with `Abort`.
+    static JpegContexts &ForThread();
+
+    JpegContexts(const JpegContexts &) = delete;
+
+    JpegContexts &operator=(const JpegContexts &) = delete;
+
+    ~JpegContexts();
+
+    jpeg_compress_struct &Compressor();
+
+    jpeg_decompress_struct &Decompressor();
+
+    // Returns both objects to their start state after an error or an early
+    // exit, they stay usable.
+    void Abort();
+
+    // Standard parameters and tables of `quality` on the compressor, done
+    // again only when the quality changed or another use replaced them.
+    void SetUpCompressor(int quality);
+
+    // Points the compressor at `buffer`, `destination` must outlive the
+    // compression. `destination.size` holds the bytes written once it ends.
+    void SetDestination(PooledDestination &destination, PooledBuffer &buffer);
+
+    ErrorManager errors;
+    // Quality that the compressor's parameters were set up for, -1 once
+    // another use such as a lossless transform changed them
+    int compress_quality = -1;
+
+private:
+    JpegContexts();
+
+    // jpeg_set_defaults keeps existing Huffman tables, which optimized
+    // coding overwrites, so the standard ones are put back from here
+    JHUFF_TBL _dc_huff_tables[2];
+    JHUFF_TBL _ac_huff_tables[2];
+
+    jpeg_compress_struct _compress;
+    jpeg_decompress_struct _decompress;
+    bool _compress_created = false;
+    bool _decompress_created = false;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_JPEG_CONTEXTS_H
@@ -0,0 +1,194 @@
+#include "jpeg_transform.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include "jpeg_contexts.h"
+
+// Everything between setjmp and the end of TransformJpeg may be skipped by
+// the longjmp of a libjpeg error, so only trivially destructible locals
+// live there and libjpeg's pools hold the temporary arrays.
+
+namespace {
+
+// The source region that is moved, in pixels: its origin on an MCU
+// boundary and mirrored axes trimmed to whole MCUs
+struct Region {
+    Orientation orientation;
+    JDIMENSION x;
+    JDIMENSION y;
+    JDIMENSION width;
+    JDIMENSION height;
+};
+
+bool ResolveRegion(const jpeg_decompress_struct &src, const ImageTransform &transform, Region &region) {
+    uint32_t x, y, width, height;
+    if (!ResolveCrop(transform, src.image_width, src.image_height, x, y, width, height)) {
+        return false;
+    }
+    JDIMENSION mcu_width = static_cast<JDIMENSION>(src.max_h_samp_factor * DCTSIZE);
+    JDIMENSION mcu_height = static_cast<JDIMENSION>(src.max_v_samp_factor * DCTSIZE);
+    region.orientation = GetOrientation(transform);
+    region.x = x / mcu_width * mcu_width;
+    region.y = y / mcu_height * mcu_height;
+    region.width = x + width - region.x;
+    region.height = y + height - region.y;
+
+    // A mirrored axis would move the padding of a partial MCU to the front
+    const Orientation &o = region.orientation;
+    bool mirror_source_x = o.transpose ? o.mirror_y : o.mirror_x;
+    bool mirror_source_y = o.transpose ? o.mirror_x : o.mirror_y;
+    if (mirror_source_x) {
+        region.width = region.width / mcu_width * mcu_width;
+    }
+    if (mirror_source_y) {
+        region.height = region.height / mcu_height * mcu_height;
+    }
+    return region.width > 0 && region.height > 0;
+}
+
+JDIMENSION DivideRoundUp(JDIMENSION a, JDIMENSION b) {
+    return (a + b - 1) / b;
+}
+
+// Destination arrays cover whole output MCUs, as jpeg_write_coefficients reads them
+void OutputBlocks(const jpeg_decompress_struct &src, const Region &region, const jpeg_component_info &component,
+                  JDIMENSION &width_in_blocks, JDIMENSION &height_in_blocks) {
+    bool transpose = region.orientation.transpose;
+    int h_samp = transpose ? component.v_samp_factor : component.h_samp_factor;
+    int v_samp = transpose ? component.h_samp_factor : component.v_samp_factor;
+    int max_h_samp = transpose ? src.max_v_samp_factor : src.max_h_samp_factor;
+    int max_v_samp = transpose ? src.max_h_samp_factor : src.max_v_samp_factor;
+    JDIMENSION out_width = transpose ? region.height : region.width;
+    JDIMENSION out_height = transpose ? region.width : region.height;
+    width_in_blocks = DivideRoundUp(out_width, static_cast<JDIMENSION>(max_h_samp * DCTSIZE)) * h_samp;
+    height_in_blocks = DivideRoundUp(out_height, static_cast<JDIMENSION>(max_v_samp * DCTSIZE)) * v_samp;
+}
+
+// out = mirror_y(mirror_x(transpose(in))): transposing swaps the
+// frequencies, mirroring negates the odd ones of its axis
+void TransformBlock(const JCOEF *in, JCOEF *out, const Orientation &orientation) {
+    for (int row = 0; row < DCTSIZE; ++row) {
+        for (int col = 0; col < DCTSIZE; ++col) {
+            JCOEF value = orientation.transpose ? in[col * DCTSIZE + row] : in[row * DCTSIZE + col];
+            bool negate = (orientation.mirror_x && (col & 1)) != (orientation.mirror_y && (row & 1));
+            out[row * DCTSIZE + col] = negate ? static_cast<JCOEF>(-value) : value;
+        }
+    }
+}
+
+void TransformComponent(jpeg_decompress_struct &src, const Region &region, int index,
+                        jvirt_barray_ptr src_array, jvirt_barray_ptr dst_array) {
+    const jpeg_component_info &component = src.comp_info[index];
+    const Orientation &o = region.orientation;
+    JDIMENSION width_in_blocks, height_in_blocks;
+    OutputBlocks(src, region, component, width_in_blocks, height_in_blocks);
+    JDIMENSION x0 = region.x / static_cast<JDIMENSION>(src.max_h_samp_factor * DCTSIZE) * component.h_samp_factor;
+    JDIMENSION y0 = region.y / static_cast<JDIMENSION>(src.max_v_samp_factor * DCTSIZE) * component.v_samp_factor;
+    // Source arrays are padded to whole MCUs as well
+    JDIMENSION src_columns = DivideRoundUp(component.width_in_blocks, component.h_samp_factor) *
+                             component.h_samp_factor;
+    JDIMENSION src_rows = DivideRoundUp(component.height_in_blocks, component.v_samp_factor) *
+                          component.v_samp_factor;
+    auto *common = reinterpret_cast<j_common_ptr>(&src);
+
+    for (JDIMENSION y = 0; y < height_in_blocks; ++y) {
+        JBLOCKROW out_row = (*src.mem->access_virt_barray)(common, dst_array, y, 1, TRUE)[0];
+        JDIMENSION mirrored_y = o.mirror_y ? height_in_blocks - 1 - y : y;
+        JBLOCKROW src_row = nullptr;
+        if (!o.transpose && y0 + mirrored_y < src_rows) {
+            src_row = (*src.mem->access_virt_barray)(common, src_array, y0 + mirrored_y, 1, FALSE)[0];
+        }
+        for (JDIMENSION x = 0; x < width_in_blocks; ++x) {
+            JDIMENSION mirrored_x = o.mirror_x ? width_in_blocks - 1 - x : x;
+            JDIMENSION sx = x0 + (o.transpose ? mirrored_y : mirrored_x);
+            JDIMENSION sy = y0 + (o.transpose ? mirrored_x : mirrored_y);
+            if (sx >= src_columns || sy >= src_rows) {
+                // Padding beyond the source, never displayed
+                memset(out_row[x], 0, sizeof(JBLOCK));
+                continue;
+            }
+            JBLOCKROW row = o.transpose ? (*src.mem->access_virt_barray)(common, src_array, sy, 1, FALSE)[0] : src_row;
+            TransformBlock(row[sx], out_row[x], o);
+        }
+    }
+}
+
+// Transposing the image transposes every block, so its quantization too
+void TransposeQuantTables(jpeg_compress_struct &dst) {
+    for (JQUANT_TBL *table : dst.quant_tbl_ptrs) {
+        if (!table) {
+            continue;
+        }
+        for (int row = 0; row < DCTSIZE; ++row) {
+            for (int col = row + 1; col < DCTSIZE; ++col) {
+                std::swap(table->quantval[row * DCTSIZE + col], table->quantval[col * DCTSIZE + row]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+bool TransformJpeg(const char *data, size_t size, const ImageTransform &transform, PooledBuffer &out,
+                   size_t &out_size) {
+    JpegContexts &contexts = JpegContexts::ForThread();
+    JpegContexts::PooledDestination destination;
+    Region region;
+    // The compressor's parameters are about to be replaced by the source's
+    contexts.compress_quality = -1;
+    if (setjmp(contexts.errors.jump)) {
+        contexts.Abort();
+        return false;
+    }
+
+    jpeg_decompress_struct &src = contexts.Decompressor();
+    jpeg_mem_src(&src, const_cast<unsigned char *>(reinterpret_cast<const unsigned char *>(data)),
+                 static_cast<unsigned long>(size));
+    jpeg_save_markers(&src, JPEG_APP0 + 2, 0xffff); // ICC profile
+    jpeg_read_header(&src, TRUE);
+    if (!ResolveRegion(src, transform, region)) {
+        contexts.Abort();
+        return false;
+    }
+
+    // Requested before reading so that jpeg_read_coefficients realizes them
+    auto *dst_arrays = static_cast<jvirt_barray_ptr *>((*src.mem->alloc_small)(
+            reinterpret_cast<j_common_ptr>(&src), JPOOL_IMAGE, sizeof(jvirt_barray_ptr) * src.num_components));
+    for (int i = 0; i < src.num_components; ++i) {
+        JDIMENSION width_in_blocks, height_in_blocks;
+        OutputBlocks(src, region, src.comp_info[i], width_in_blocks, height_in_blocks);
+        int v_samp = region.orientation.transpose ? src.comp_info[i].h_samp_factor : src.comp_info[i].v_samp_factor;
+        dst_arrays[i] = (*src.mem->request_virt_barray)(reinterpret_cast<j_common_ptr>(&src), JPOOL_IMAGE, FALSE,
+                                                        width_in_blocks, height_in_blocks,
+                                                        static_cast<JDIMENSION>(v_samp));
+    }
+    jvirt_barray_ptr *src_arrays = jpeg_read_coefficients(&src);
+    for (int i = 0; i < src.num_components; ++i) {
+        TransformComponent(src, region, i, src_arrays[i], dst_arrays[i]);
+    }
+
+    jpeg_compress_struct &dst = contexts.Compressor();
+    jpeg_copy_critical_parameters(&src, &dst);
+    bool transpose = region.orientation.transpose;
+    dst.image_width = transpose ? region.height : region.width;
+    dst.image_height = transpose ? region.width : region.height;
+    if (transpose) {
+        for (int i = 0; i < dst.num_components; ++i) {
+            std::swap(dst.comp_info[i].h_samp_factor, dst.comp_info[i].v_samp_factor);
+        }
+        TransposeQuantTables(dst);
+    }
+    dst.optimize_coding = TRUE;
+    contexts.SetDestination(destination, out);
+    jpeg_write_coefficients(&dst, dst_arrays);
+    for (jpeg_saved_marker_ptr marker = src.marker_list; marker; marker = marker->next) {
+        jpeg_write_marker(&dst, marker->marker, marker->data, marker->data_length);
+    }
+    jpeg_finish_compress(&dst);
+    out_size = destination.size;
+
+    jpeg_finish_decompress(&src);
+    return true;
+}
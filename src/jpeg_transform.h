@@ -0,0 +1,23 @@
+#ifndef ELECTRON_CLIPBOARD_EX_JPEG_TRANSFORM_H
+#define ELECTRON_CLIPBOARD_EX_JPEG_TRANSFORM_H
+
+#include <cstddef>
+#include "buffer_pool.h"
+#include "image_ops.h"
+
+// Lossless JPEG crop, rotation and flips in the DCT domain, like jpegtran
+// -trim: coefficient blocks are rearranged and sign flipped, nothing is
+// decoded or quantized again. Needs libjpeg, built where
+// CLIPBOARD_EX_LIBJPEG is defined.
+//
+// Coefficients only move in whole MCUs (8 or 16 pixels), so the crop origin
+// is moved up and left to an MCU boundary, and the partial MCU row or
+// column that would end up at the top or left of the result is dropped.
+// ICC profiles are kept; EXIF is not, its orientation would be stale.
+//
+// Writes the new JPEG into `out`, returns false on malformed input or a
+// transform that would leave nothing.
+bool TransformJpeg(const char *data, size_t size, const ImageTransform &transform, PooledBuffer &out,
+                   size_t &out_size);
+
+#endif //ELECTRON_CLIPBOARD_EX_JPEG_TRANSFORM_H
@@ -0,0 +1,95 @@
+#include "lazy_image_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "clipboard.h"
+#include "image_files.h"
+
+namespace {
+
+// Extension of the formats file managers thumbnail and open, nullptr for
+// the rest
+const char *SniffExtension(const std::string &data) {
+    struct Signature {
+        const char *magic;
+        size_t size;
+        const char *extension;
+    };
+    static const Signature kSignatures[] = {
+        {"\x89PNG\r\n\x1a\n", 8, ".png"},
+        {"\xff\xd8\xff", 3, ".jpg"},
+        {"GIF8", 4, ".gif"},
+        {"BM", 2, ".bmp"},
+    };
+    for (const Signature &signature : kSignatures) {
+        if (data.size() >= signature.size && memcmp(data.data(), signature.magic, signature.size) == 0) {
+            return signature.extension;
+        }
+    }
+    if (data.size() >= 12 && memcmp(data.data(), "RIFF", 4) == 0 && memcmp(data.data() + 8, "WEBP", 4) == 0) {
+        return ".webp";
+    }
+    return nullptr;
+}
+
+// Replaces an extension that does not match the content
+std::string WithExtension(const std::string &file_name, const char *extension) {
+    size_t dot = file_name.find_last_of('.');
+    if (dot == std::string::npos || dot == 0) {
+        return (file_name.empty() ? std::string("image") : file_name) + extension;
+    }
+    std::string current = file_name.substr(dot);
+    std::transform(current.begin(), current.end(), current.begin(), ::tolower);
+    if (current == extension || (current == ".jpeg" && strcmp(extension, ".jpg") == 0)) {
+        return file_name;
+    }
+    return file_name.substr(0, dot) + extension;
+}
+
+} // namespace
+
+LazyImageFile::LazyImageFile(std::string data, std::string file_name)
+        : _data(std::move(data)), _file_name(std::move(file_name)) {
+    // Only the last component, the file must stay in its directory
+    size_t slash = _file_name.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        _file_name.erase(0, slash + 1);
+    }
+}
+
+LazyImageFile::~LazyImageFile() {
+    if (!_path.empty()) {
+        RemoveFile(_path);
+    }
+    if (!_directory.empty()) {
+        RemoveEmptyDirectory(_directory);
+    }
+}
+
+std::string LazyImageFile::Path() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_attempted) {
+        return _path;
+    }
+    _attempted = true;
+    if (_data.empty() || !CreateTempDirectory(_directory)) {
+        return _path;
+    }
+
+    const char *extension = SniffExtension(_data);
+    std::string path = JoinPath(_directory, WithExtension(_file_name, extension ? extension : ".png"));
+    bool written;
+    if (extension) {
+        written = WriteFileAtomically(path, _data.data(), _data.size());
+    } else {
+        ImagePixels image;
+        written = DecodeImageData(_data.data(), _data.size(), image) &&
+                  SaveImagePixelsAtomically(image, path, ImageFormat::Png, 1);
+    }
+    if (written) {
+        _path = std::move(path);
+        std::string().swap(_data);
+    }
+    return _path;
+}
@@ -0,0 +1,37 @@
+#ifndef ELECTRON_CLIPBOARD_EX_LAZY_IMAGE_FILE_H
+#define ELECTRON_CLIPBOARD_EX_LAZY_IMAGE_FILE_H
+
+#include <mutex>
+#include <string>
+
+// An encoded image offered as a file that is only written once a requestor
+// asks for it, typically a file manager pasting text/uri-list; image-aware
+// targets take the bytes directly and never cost any disk I/O. Bytes in a
+// format file managers recognize are written as is, anything else is
+// encoded as PNG. The file keeps `file_name` inside a directory of its own
+// under the system temp directory, both are removed with the object.
+// Thread-safe.
+class LazyImageFile {
+public:
+    LazyImageFile(std::string data, std::string file_name);
+
+    ~LazyImageFile();
+
+    LazyImageFile(const LazyImageFile &) = delete;
+
+    LazyImageFile &operator=(const LazyImageFile &) = delete;
+
+    // Writes the file on the first call, later calls return the same path.
+    // Empty if it could not be written.
+    std::string Path();
+
+private:
+    std::mutex _mutex;
+    std::string _data; // Released once written
+    std::string _file_name;
+    std::string _directory;
+    std::string _path;
+    bool _attempted = false;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_LAZY_IMAGE_FILE_H
@@ -0,0 +1,235 @@
+#include "memory_clipboard.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include "clipboard_formats.h"
+#include "html_text.h"
+#include "image_ops.h"
+#include "lazy_image_file.h"
+
+namespace memory_clipboard {
+
+namespace {
+
+// Content of one selection, replaced as a whole by every write
+struct Content {
+    std::vector<std::string> file_paths;
+    std::string text;
+    std::string html;
+    std::string rtf;
+    std::shared_ptr<const ImagePixels> image;
+    std::shared_ptr<LazyImageFile> image_file; // Read as the only file path
+};
+
+struct Selection {
+    std::shared_ptr<const Content> content = std::make_shared<Content>();
+    uint64_t sequence = 0;
+};
+
+std::atomic<bool> active{false};
+std::mutex mutex;
+Selection selections[3];
+
+// Readers take a snapshot and work on it without the lock
+std::shared_ptr<const Content> Snapshot(ClipboardSelection selection) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return selections[static_cast<size_t>(selection)].content;
+}
+
+void Replace(ClipboardSelection selection, std::shared_ptr<const Content> content) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Selection &state = selections[static_cast<size_t>(selection)];
+    state.content = std::move(content);
+    ++state.sequence;
+}
+
+std::string JoinLines(const std::vector<std::string> &file_paths) {
+    std::string result;
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+        result += file_paths[i];
+        if (i + 1 < file_paths.size()) {
+            result += "\n";
+        }
+    }
+    return result;
+}
+
+bool CopyPixels(const ImagePixels &from, ImagePixels &to) {
+    size_t row_bytes = static_cast<size_t>(from.width) * 4;
+    to.width = from.width;
+    to.height = from.height;
+    to.stride = row_bytes;
+    to.pixels = PooledBuffer(row_bytes * from.height);
+    if (!to.pixels.data()) {
+        return false;
+    }
+    for (uint32_t y = 0; y < from.height; ++y) {
+        memcpy(to.pixels.data() + y * row_bytes, from.pixels.data() + y * from.stride, row_bytes);
+    }
+    return true;
+}
+
+void DeleteString(void *hint) {
+    delete static_cast<std::string *>(hint);
+}
+
+} // namespace
+
+bool IsActive() {
+    return active.load(std::memory_order_relaxed);
+}
+
+void SetActive(bool value) {
+    active.store(value, std::memory_order_relaxed);
+}
+
+std::vector<std::string> ReadFilePaths(ClipboardSelection selection) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    if (content->image_file) {
+        std::string path = content->image_file->Path();
+        return path.empty() ? std::vector<std::string>() : std::vector<std::string>{path};
+    }
+    return content->file_paths;
+}
+
+void WriteFilePaths(const std::vector<std::string> &file_paths, ClipboardSelection selection) {
+    auto content = std::make_shared<Content>();
+    content->file_paths = file_paths;
+    content->text = JoinLines(file_paths);
+    Replace(selection, std::move(content));
+}
+
+void Clear(ClipboardSelection selection) {
+    Replace(selection, std::make_shared<Content>());
+}
+
+bool SaveImage(const std::string &target_path, ImageFormat format, float quality, ClipboardSelection selection,
+               ProgressSink *progress) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    return content->image && SaveImagePixels(*content->image, target_path, format, quality, progress);
+}
+
+bool PutImage(const std::string &image_path, ClipboardSelection selection) {
+    auto image = std::make_shared<ImagePixels>();
+    if (!DecodeImageFile(image_path, 0, *image)) {
+        return false;
+    }
+    auto content = std::make_shared<Content>();
+    content->image = std::move(image);
+    Replace(selection, std::move(content));
+    return true;
+}
+
+bool HasImage(ClipboardSelection selection) {
+    return Snapshot(selection)->image != nullptr;
+}
+
+bool ReadImagePixels(ImagePixels &image, ClipboardSelection selection) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    return content->image && CopyPixels(*content->image, image);
+}
+
+bool ReadImageBgra(const PixelDestination &destination, bool premultiplied, ClipboardSelection selection) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    if (!content->image) {
+        return false;
+    }
+    const ImagePixels &image = *content->image;
+    char *out = destination(image.width, image.height);
+    if (!out) {
+        return false;
+    }
+    ToBgra(image, premultiplied, out, static_cast<size_t>(image.width) * 4);
+    return true;
+}
+
+bool ReadText(ClipboardData &text, ClipboardSelection selection) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    if (content->text.empty()) {
+        return false;
+    }
+    auto *copy = new std::string(content->text);
+    text = ClipboardData(copy->data(), copy->size(), DeleteString, copy);
+    return true;
+}
+
+bool WriteText(const char *data, size_t size, ClipboardSelection selection) {
+    auto content = std::make_shared<Content>();
+    content->text.assign(data, size);
+    Replace(selection, std::move(content));
+    return true;
+}
+
+bool ReadTarget(const std::string &mime_type, ClipboardSelection selection, const ChunkConsumer &consume) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    std::string uri_list;
+    const std::string *bytes = nullptr;
+    if (mime_type == "text/plain" || mime_type == "text/plain;charset=utf-8" || mime_type == "UTF8_STRING") {
+        bytes = &content->text;
+    } else if (mime_type == "text/html") {
+        bytes = &content->html;
+    } else if (mime_type == "text/rtf") {
+        bytes = &content->rtf;
+    } else if (mime_type == "text/uri-list") {
+        std::vector<std::string> paths = memory_clipboard::ReadFilePaths(selection);
+        uri_list.resize(clipboard_formats::EncodeUriList(paths.begin(), paths.end(), nullptr, 0));
+        clipboard_formats::EncodeUriList(paths.begin(), paths.end(), &uri_list[0], uri_list.size());
+        bytes = &uri_list;
+    }
+    // Images are kept decoded, none of their encoded targets exist here
+    if (!bytes || bytes->empty()) {
+        return false;
+    }
+    return consume(bytes->data(), bytes->size());
+}
+
+RichContent ReadRich(ClipboardSelection selection) {
+    std::shared_ptr<const Content> content = Snapshot(selection);
+    RichContent result;
+    result.html = content->html;
+    result.rtf = content->rtf;
+    result.text = content->text;
+    return result;
+}
+
+bool WriteRich(const RichContent &rich, ClipboardSelection selection) {
+    auto content = std::make_shared<Content>();
+    content->html = rich.html;
+    content->rtf = rich.rtf;
+    content->text = rich.text.empty() ? HtmlToText(rich.html.data(), rich.html.size()) : rich.text;
+    Replace(selection, std::move(content));
+    return true;
+}
+
+bool WriteMulti(const MultiContent &multi, ClipboardSelection selection) {
+    auto content = std::make_shared<Content>();
+    if (!multi.image_path.empty() || !multi.image_data.empty()) {
+        auto image = std::make_shared<ImagePixels>();
+        bool decoded = multi.image_path.empty()
+                       ? DecodeImageData(multi.image_data.data(), multi.image_data.size(), *image)
+                       : DecodeImageFile(multi.image_path, 0, *image);
+        if (!decoded) {
+            return false;
+        }
+        content->image = std::move(image);
+    }
+    content->file_paths = multi.file_paths;
+    if (multi.file_paths.empty() && !multi.image_data.empty() && !multi.image_file_name.empty()) {
+        content->image_file = std::make_shared<LazyImageFile>(multi.image_data, multi.image_file_name);
+    }
+    content->text = multi.text;
+    if (content->text.empty()) {
+        content->text = multi.file_paths.empty() ? multi.image_path : JoinLines(multi.file_paths);
+    }
+    Replace(selection, std::move(content));
+    return true;
+}
+
+uint64_t SequenceNumber(ClipboardSelection selection) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return selections[static_cast<size_t>(selection)].sequence;
+}
+
+} // namespace memory_clipboard
@@ -0,0 +1,58 @@
+#ifndef ELECTRON_CLIPBOARD_EX_MEMORY_CLIPBOARD_H
+#define ELECTRON_CLIPBOARD_EX_MEMORY_CLIPBOARD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "clipboard.h"
+
+// An in-process clipboard for hosts without a display server and for
+// deterministic tests. Every selection keeps its own content in native
+// memory with the same flavors the platform backends offer: file paths
+// also read as text, text is derived from HTML, images are kept decoded.
+// Each write or clear bumps the selection's sequence number. Thread-safe.
+//
+// Platform backends route every operation here while it is active. It is
+// selected with `setBackend('memory')`, and on Linux also when neither a
+// display nor a Wayland data-control compositor is available.
+namespace memory_clipboard {
+
+bool IsActive();
+
+void SetActive(bool active);
+
+std::vector<std::string> ReadFilePaths(ClipboardSelection selection);
+
+void WriteFilePaths(const std::vector<std::string> &file_paths, ClipboardSelection selection);
+
+void Clear(ClipboardSelection selection);
+
+bool SaveImage(const std::string &target_path, ImageFormat format, float quality, ClipboardSelection selection,
+               ProgressSink *progress);
+
+bool PutImage(const std::string &image_path, ClipboardSelection selection);
+
+bool HasImage(ClipboardSelection selection);
+
+bool ReadImagePixels(ImagePixels &image, ClipboardSelection selection);
+
+bool ReadImageBgra(const PixelDestination &destination, bool premultiplied, ClipboardSelection selection);
+
+bool ReadText(ClipboardData &text, ClipboardSelection selection);
+
+bool WriteText(const char *data, size_t size, ClipboardSelection selection);
+
+// Text, HTML, RTF and a uri-list of the file paths.
+bool ReadTarget(const std::string &mime_type, ClipboardSelection selection, const ChunkConsumer &consume);
+
+RichContent ReadRich(ClipboardSelection selection);
+
+bool WriteRich(const RichContent &content, ClipboardSelection selection);
+
+bool WriteMulti(const MultiContent &content, ClipboardSelection selection);
+
+uint64_t SequenceNumber(ClipboardSelection selection);
+
+} // namespace memory_clipboard
+
+#endif //ELECTRON_CLIPBOARD_EX_MEMORY_CLIPBOARD_H
@@ -0,0 +1,161 @@
+#include "path_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kPackedMagic[] = "PATHLST1";
+const size_t kPackedMagicSize = sizeof(kPackedMagic) - 1;
+
+void WriteVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool ReadVarint(std::string_view data, size_t &offset, uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && offset < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[offset++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SharedLength(std::string_view a, std::string_view b) {
+    size_t limit = std::min(a.size(), b.size());
+    size_t length = 0;
+    while (length < limit && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+} // namespace
+
+void PathList::Append(std::string_view path) {
+    size_t shared = 0;
+    if (_size % kBlockSize == 0) {
+        _block_offsets.push_back(_data.size());
+    } else {
+        shared = SharedLength(_last, path);
+    }
+    WriteVarint(_data, shared);
+    WriteVarint(_data, path.size() - shared);
+    _data.append(path.data() + shared, path.size() - shared);
+    _last.assign(path.data(), path.size());
+
+    if (_size == 0) {
+        _first = _last;
+        _prefix_length = _first.size();
+    } else {
+        _prefix_length = SharedLength(std::string_view(_first.data(), _prefix_length), path);
+    }
+    ++_size;
+}
+
+bool PathList::DecodeEntry(size_t &offset, std::string &path) const {
+    uint64_t shared, suffix;
+    if (!ReadVarint(_data, offset, shared) || !ReadVarint(_data, offset, suffix) ||
+        shared > path.size() || suffix > _data.size() - offset) {
+        return false;
+    }
+    path.resize(static_cast<size_t>(shared));
+    path.append(_data.data() + offset, static_cast<size_t>(suffix));
+    offset += static_cast<size_t>(suffix);
+    return true;
+}
+
+std::string PathList::Get(size_t index) const {
+    return *IteratorAt(index);
+}
+
+std::string_view PathList::CommonPrefix() const {
+    size_t length = _prefix_length;
+    // Back off to the start of a UTF-8 sequence cut by the first mismatch
+    if (length < _first.size()) {
+        while (length > 0 && (static_cast<uint8_t>(_first[length]) & 0xc0) == 0x80) {
+            --length;
+        }
+    }
+    return std::string_view(_first.data(), length);
+}
+
+std::string PathList::ToPacked() const {
+    std::string packed(kPackedMagic, kPackedMagicSize);
+    WriteVarint(packed, _size);
+    packed += _data;
+    return packed;
+}
+
+bool PathList::FromPacked(std::string_view packed, PathList &paths) {
+    if (packed.size() < kPackedMagicSize || memcmp(packed.data(), kPackedMagic, kPackedMagicSize) != 0) {
+        return false;
+    }
+    size_t offset = kPackedMagicSize;
+    uint64_t count;
+    if (!ReadVarint(packed, offset, count) || count > packed.size() - offset) {
+        return false; // Every path takes at least two bytes
+    }
+
+    PathList result;
+    result._data.assign(packed.data() + offset, packed.size() - offset);
+    std::string path;
+    size_t data_offset = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (i % kBlockSize == 0) {
+            result._block_offsets.push_back(data_offset);
+            path.clear();
+        }
+        if (!result.DecodeEntry(data_offset, path)) {
+            return false;
+        }
+        if (i == 0) {
+            result._first = path;
+            result._prefix_length = path.size();
+        } else {
+            result._prefix_length = SharedLength(std::string_view(result._first.data(), result._prefix_length), path);
+        }
+    }
+    if (data_offset != result._data.size()) {
+        return false;
+    }
+    result._size = static_cast<size_t>(count);
+    result._last = std::move(path);
+    paths = std::move(result);
+    return true;
+}
+
+PathList::const_iterator PathList::begin() const {
+    return const_iterator(this, 0);
+}
+
+PathList::const_iterator PathList::end() const {
+    return const_iterator(this, _size);
+}
+
+PathList::const_iterator PathList::IteratorAt(size_t index) const {
+    return const_iterator(this, std::min(index, _size));
+}
+
+PathList::const_iterator::const_iterator(const PathList *list, size_t index) : _list(list), _index(index) {
+    if (_index < _list->_size) {
+        _offset = static_cast<size_t>(_list->_block_offsets[_index / kBlockSize]);
+        for (size_t i = 0; i <= _index % kBlockSize; ++i) {
+            _list->DecodeEntry(_offset, _path);
+        }
+    }
+}
+
+PathList::const_iterator &PathList::const_iterator::operator++() {
+    if (++_index < _list->_size) {
+        _list->DecodeEntry(_offset, _path);
+    }
+    return *this;
+}
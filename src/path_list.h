@@ -0,0 +1,115 @@
+#ifndef ELECTRON_CLIPBOARD_EX_PATH_LIST_H
+#define ELECTRON_CLIPBOARD_EX_PATH_LIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An append-only list of UTF-8 paths, front-coded in blocks of kBlockSize:
+// each path is stored as the length it shares with its predecessor and the
+// remaining suffix, and every block starts over with a whole path so that
+// `Get` decodes at most one block. Paths of one directory tree shrink to a
+// few bytes each. Not thread-safe.
+class PathList {
+public:
+    static constexpr size_t kBlockSize = 16;
+
+    class const_iterator;
+
+    PathList() = default;
+
+    template<typename It>
+    PathList(It first, It last) {
+        for (; first != last; ++first) {
+            Append(std::string_view(first->data(), first->size()));
+        }
+    }
+
+    void Append(std::string_view path);
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    // `index` must be below `size()`.
+    std::string Get(size_t index) const;
+
+    // Longest byte prefix of all paths, not splitting a UTF-8 sequence.
+    std::string_view CommonPrefix() const;
+
+    // Bytes held by the encoded paths and the block index.
+    size_t encoded_bytes() const {
+        return _data.size() + _block_offsets.size() * sizeof(uint64_t);
+    }
+
+    // Self-contained serialization: "PATHLST1", the path count as a LEB128
+    // and the blocks.
+    std::string ToPacked() const;
+
+    // Replaces `paths` with the content of `ToPacked` output, false if the
+    // data is malformed.
+    static bool FromPacked(std::string_view packed, PathList &paths);
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    // Iterator positioned at `index`, decoding its block up to there.
+    const_iterator IteratorAt(size_t index) const;
+
+private:
+    bool DecodeEntry(size_t &offset, std::string &path) const;
+
+    std::string _data;
+    std::vector<uint64_t> _block_offsets;
+    size_t _size = 0;
+    std::string _first;
+    size_t _prefix_length = 0;
+    std::string _last;
+};
+
+// Decodes sequentially, `->` yields the current path. Suitable for the
+// clipboard_formats encoders, which take anything with `data()` and `size()`.
+class PathList::const_iterator {
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::string;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string *;
+    using reference = const std::string &;
+
+    const_iterator(const PathList *list, size_t index);
+
+    reference operator*() const {
+        return _path;
+    }
+
+    pointer operator->() const {
+        return &_path;
+    }
+
+    const_iterator &operator++();
+
+    bool operator==(const const_iterator &other) const {
+        return _index == other._index;
+    }
+
+    bool operator!=(const const_iterator &other) const {
+        return _index != other._index;
+    }
+
+private:
+    const PathList *_list;
+    size_t _index;
+    size_t _offset = 0;
+    std::string _path;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_PATH_LIST_H
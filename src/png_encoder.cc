@@ -0,0 +1,374 @@
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "deflate_encoder.h"
+
+namespace {
+
+const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+const int kMaxPaletteSize = 256;
+const int kPaletteSlotBits = 10;
+const uint32_t kMaxChunkSize = 0x7fffffff;
+
+enum ColorType : uint8_t {
+    kTruecolor = 2,
+    kIndexed = 3,
+    kTruecolorAlpha = 6,
+};
+
+enum Filter : uint8_t {
+    kFilterNone,
+    kFilterSub,
+    kFilterUp,
+    kFilterAverage,
+    kFilterPaeth,
+};
+
+struct CrcTable {
+    uint32_t values[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+            }
+            values[i] = crc;
+        }
+    }
+};
+
+uint32_t LoadPixel(const char *pixel) {
+    uint32_t value;
+    memcpy(&value, pixel, 4);
+    return value;
+}
+
+// RGBA colors in order of first appearance, found through a small open
+// addressing table
+class Palette {
+public:
+    int size() const {
+        return _size;
+    }
+
+    uint32_t operator[](int index) const {
+        return _colors[index];
+    }
+
+    // Index of `color`, adding it when there is room, -1 when there is not
+    int Index(uint32_t color) {
+        for (uint32_t slot = Slot(color);; slot = (slot + 1) & kSlotMask) {
+            if (!_slots[slot]) {
+                if (_size == kMaxPaletteSize) {
+                    return -1;
+                }
+                _colors[_size] = color;
+                _slots[slot] = static_cast<uint16_t>(++_size);
+                return _size - 1;
+            }
+            if (_colors[_slots[slot] - 1] == color) {
+                return _slots[slot] - 1;
+            }
+        }
+    }
+
+    // Moves translucent colors to the front, keeping the order otherwise,
+    // and returns how many there are
+    int TranslucentFirst() {
+        uint32_t colors[kMaxPaletteSize];
+        uint16_t new_index[kMaxPaletteSize];
+        int next = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int i = 0; i < _size; ++i) {
+                bool opaque = Alpha(_colors[i]) == 0xff;
+                if (opaque == (pass == 1)) {
+                    new_index[i] = static_cast<uint16_t>(next);
+                    colors[next++] = _colors[i];
+                }
+            }
+            if (pass == 0) {
+                _translucent = next;
+            }
+        }
+        for (uint16_t &slot : _slots) {
+            if (slot) {
+                slot = static_cast<uint16_t>(new_index[slot - 1] + 1);
+            }
+        }
+        memcpy(_colors, colors, sizeof(uint32_t) * _size);
+        return _translucent;
+    }
+
+    static uint8_t Alpha(uint32_t color) {
+        uint8_t rgba[4];
+        memcpy(rgba, &color, 4);
+        return rgba[3];
+    }
+
+private:
+    static const uint32_t kSlotMask = (1u << kPaletteSlotBits) - 1;
+
+    static uint32_t Slot(uint32_t color) {
+        return (color * 2654435761u) >> (32 - kPaletteSlotBits);
+    }
+
+    uint32_t _colors[kMaxPaletteSize];
+    uint16_t _slots[1 << kPaletteSlotBits] = {0}; // Index + 1, 0 for empty
+    int _size = 0;
+    int _translucent = 0;
+};
+
+// Whether the image is opaque and fits a palette, stopping as soon as
+// neither can change any more
+void Analyze(const ImagePixels &image, Palette &palette, bool &indexed, bool &opaque) {
+    indexed = true;
+    opaque = true;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        const char *row = image.pixels.data() + y * image.stride;
+        uint32_t last = ~LoadPixel(row);
+        for (uint32_t x = 0; x < image.width; ++x) {
+            uint32_t pixel = LoadPixel(row + x * 4);
+            if (pixel == last) {
+                continue;
+            }
+            last = pixel;
+            opaque = opaque && Palette::Alpha(pixel) == 0xff;
+            indexed = indexed && palette.Index(pixel) >= 0;
+            if (!indexed && !opaque) {
+                return;
+            }
+        }
+    }
+}
+
+uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int pa = std::abs(static_cast<int>(b) - c);
+    int pb = std::abs(static_cast<int>(a) - c);
+    int pc = std::abs(static_cast<int>(a) + b - 2 * c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Filters `row` into `out` and returns the sum of the filtered bytes taken
+// as signed, giving up once it reaches `limit`
+template<Filter kFilter>
+uint64_t FilterRow(const uint8_t *row, const uint8_t *above, size_t size, size_t bpp, uint8_t *out, uint64_t limit) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t a = i >= bpp ? row[i - bpp] : 0;
+        uint8_t b = above[i];
+        uint8_t predicted = 0;
+        if (kFilter == kFilterSub) {
+            predicted = a;
+        } else if (kFilter == kFilterUp) {
+            predicted = b;
+        } else if (kFilter == kFilterAverage) {
+            predicted = static_cast<uint8_t>((a + b) >> 1);
+        } else if (kFilter == kFilterPaeth) {
+            predicted = Paeth(a, b, i >= bpp ? above[i - bpp] : 0);
+        }
+        uint8_t value = static_cast<uint8_t>(row[i] - predicted);
+        out[i] = value;
+        sum += value < 128 ? value : 256 - value;
+        // Checked every 64 bytes, the loop stays cheap
+        if ((i & 63) == 63 && sum >= limit) {
+            return sum;
+        }
+    }
+    return sum;
+}
+
+// Writes the filter byte and filtered row to `out`
+void FilterBest(const uint8_t *row, const uint8_t *above, size_t size, size_t bpp, uint8_t *out,
+                std::vector<uint8_t> &trial) {
+    // UI rows often repeat the row above: Up turns them into zeros
+    if (memcmp(row, above, size) == 0) {
+        out[0] = kFilterUp;
+        memset(out + 1, 0, size);
+        return;
+    }
+    typedef uint64_t (*FilterFunc)(const uint8_t *, const uint8_t *, size_t, size_t, uint8_t *, uint64_t);
+    static const FilterFunc kFilters[] = {FilterRow<kFilterNone>, FilterRow<kFilterSub>, FilterRow<kFilterUp>,
+                                          FilterRow<kFilterAverage>, FilterRow<kFilterPaeth>};
+    uint64_t best = UINT64_MAX;
+    for (uint8_t filter = kFilterNone; filter <= kFilterPaeth; ++filter) {
+        uint64_t sum = kFilters[filter](row, above, size, bpp, trial.data(), best);
+        if (sum < best) {
+            best = sum;
+            out[0] = filter;
+            memcpy(out + 1, trial.data(), size);
+        }
+    }
+}
+
+// The pixels as palette indices packed `depth` bits each, most significant
+// bits first
+void PackIndices(const char *pixels, uint32_t width, Palette &palette, int depth, uint8_t *out) {
+    uint32_t last = ~LoadPixel(pixels);
+    int index = 0;
+    int per_byte = 8 / depth;
+    uint8_t byte = 0;
+    for (uint32_t x = 0; x < width; ++x) {
+        uint32_t pixel = LoadPixel(pixels + x * 4);
+        if (pixel != last) {
+            last = pixel;
+            index = palette.Index(pixel);
+        }
+        byte = static_cast<uint8_t>(byte | (index << (8 - depth * (1 + x % per_byte))));
+        if (x % per_byte == static_cast<uint32_t>(per_byte - 1)) {
+            *out++ = byte;
+            byte = 0;
+        }
+    }
+    if (width % per_byte) {
+        *out = byte;
+    }
+}
+
+bool Append(PooledBuffer &out, size_t &size, const void *data, size_t count) {
+    if (!count) {
+        return true;
+    }
+    if (size + count > out.capacity() && !out.Grow(std::max(size + count, out.capacity() * 2), size)) {
+        return false;
+    }
+    memcpy(out.data() + size, data, count);
+    size += count;
+    return true;
+}
+
+void StoreBigEndian(uint8_t *out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+bool AppendChunk(PooledBuffer &out, size_t &size, const char *type, const uint8_t *data, uint32_t count) {
+    uint8_t header[8];
+    StoreBigEndian(header, count);
+    memcpy(header + 4, type, 4);
+    uint8_t crc[4];
+    StoreBigEndian(crc, Crc32(data, count, Crc32(header + 4, 4)));
+    return Append(out, size, header, sizeof(header)) && Append(out, size, data, count) &&
+           Append(out, size, crc, sizeof(crc));
+}
+
+} // namespace
+
+uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc) {
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool EncodeScreenshotPng(const ImagePixels &image, PooledBuffer &out, size_t &out_size, ProgressSink *progress) {
+    if (!image.pixels.data() || !image.width || !image.height || image.width > kMaxChunkSize ||
+        image.height > kMaxChunkSize) {
+        return false;
+    }
+    Palette palette;
+    bool indexed, opaque;
+    Analyze(image, palette, indexed, opaque);
+
+    int depth = 8;
+    int translucent = 0;
+    ColorType color_type = opaque ? kTruecolor : kTruecolorAlpha;
+    size_t bpp = opaque ? 3 : 4;
+    if (indexed) {
+        color_type = kIndexed;
+        bpp = 1;
+        depth = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : palette.size() <= 16 ? 4 : 8;
+        translucent = palette.TranslucentFirst();
+    }
+    size_t row_size = indexed ? (static_cast<size_t>(image.width) * depth + 7) / 8 : image.width * bpp;
+    PooledBuffer filtered((row_size + 1) * image.height);
+    if (!filtered.data()) {
+        return false;
+    }
+
+    std::vector<uint8_t> rows[2] = {std::vector<uint8_t>(row_size), std::vector<uint8_t>(row_size)};
+    std::vector<uint8_t> trial(row_size);
+    std::vector<uint8_t> zero_row(row_size, 0);
+    for (uint32_t y = 0; y < image.height; ++y) {
+        const char *pixels = image.pixels.data() + y * image.stride;
+        auto *out_row = reinterpret_cast<uint8_t *>(filtered.data()) + y * (row_size + 1);
+        if (indexed) {
+            // Filtering indices mostly breaks their runs up
+            out_row[0] = kFilterNone;
+            PackIndices(pixels, image.width, palette, depth, out_row + 1);
+            continue;
+        }
+        const uint8_t *row = reinterpret_cast<const uint8_t *>(pixels);
+        if (opaque) {
+            uint8_t *rgb = rows[y & 1].data();
+            for (uint32_t x = 0; x < image.width; ++x) {
+                memcpy(rgb + x * 3, pixels + x * 4, 3);
+            }
+            row = rgb;
+        }
+        const uint8_t *above = y == 0 ? zero_row.data()
+                                      : opaque ? rows[(y - 1) & 1].data()
+                                               : reinterpret_cast<const uint8_t *>(pixels - image.stride);
+        FilterBest(row, above, row_size, bpp, out_row, trial);
+    }
+
+    out_size = 0;
+    if (out.capacity() < filtered.capacity() / 8 + 1024 && !out.Grow(filtered.capacity() / 8 + 1024, 0)) {
+        return false;
+    }
+    uint8_t header[13];
+    StoreBigEndian(header, image.width);
+    StoreBigEndian(header + 4, image.height);
+    header[8] = static_cast<uint8_t>(depth);
+    header[9] = color_type;
+    header[10] = 0; // Deflate
+    header[11] = 0; // Adaptive filtering
+    header[12] = 0; // Not interlaced
+    if (!Append(out, out_size, kSignature, sizeof(kSignature)) ||
+        !AppendChunk(out, out_size, "IHDR", header, sizeof(header))) {
+        return false;
+    }
+    if (indexed) {
+        uint8_t entries[kMaxPaletteSize * 3];
+        uint8_t alphas[kMaxPaletteSize];
+        for (int i = 0; i < palette.size(); ++i) {
+            uint32_t color = palette[i];
+            memcpy(entries + i * 3, &color, 3);
+            alphas[i] = Palette::Alpha(color);
+        }
+        if (!AppendChunk(out, out_size, "PLTE", entries, static_cast<uint32_t>(palette.size() * 3)) ||
+            (translucent && !AppendChunk(out, out_size, "tRNS", alphas, static_cast<uint32_t>(translucent)))) {
+            return false;
+        }
+    }
+
+    // One IDAT chunk, its length and CRC filled in once compressed
+    size_t idat = out_size;
+    const uint8_t idat_header[8] = {0, 0, 0, 0, 'I', 'D', 'A', 'T'};
+    if (!Append(out, out_size, idat_header, sizeof(idat_header))) {
+        return false;
+    }
+    DeflateOptions options;
+    options.run_distances[1] = bpp > 1 ? static_cast<uint32_t>(bpp) : 0;
+    options.run_distances[2] = static_cast<uint32_t>(row_size + 1);
+    if (!CompressZlib(reinterpret_cast<const uint8_t *>(filtered.data()), (row_size + 1) * image.height, options,
+                      out, out_size, progress)) {
+        return false;
+    }
+    size_t idat_size = out_size - idat - sizeof(idat_header);
+    if (idat_size > kMaxChunkSize) {
+        return false;
+    }
+    auto *idat_start = reinterpret_cast<uint8_t *>(out.data()) + idat;
+    StoreBigEndian(idat_start, static_cast<uint32_t>(idat_size));
+    uint8_t crc[4];
+    StoreBigEndian(crc, Crc32(idat_start + 4, idat_size + 4));
+    return Append(out, out_size, crc, sizeof(crc)) && AppendChunk(out, out_size, "IEND", nullptr, 0);
+}
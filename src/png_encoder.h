@@ -0,0 +1,30 @@
+#ifndef ELECTRON_CLIPBOARD_EX_PNG_ENCODER_H
+#define ELECTRON_CLIPBOARD_EX_PNG_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "buffer_pool.h"
+#include "clipboard.h"
+
+// Lossless PNG encoder for UI screenshots: large flat areas, repeated rows
+// and few colors.
+//
+//  - Palette check first: up to 256 colors are written as an indexed image
+//    of 1, 2, 4 or 8 bits per pixel, translucent entries first so that tRNS
+//    stays short. Scanning stops at the 257th color. Opaque images without
+//    a palette drop the alpha channel.
+//  - Per row filters: indexed rows are not filtered, a row equal to the one
+//    above is filtered Up without trying the others, and other rows take the
+//    filter with the smallest sum of absolute differences.
+//  - Deflate with the pixel and row distances tried before the hash chains
+//    (see deflate_encoder.h).
+//
+// Writes the PNG file into `out`, returns false on cancellation or
+// allocation failure.
+bool EncodeScreenshotPng(const ImagePixels &image, PooledBuffer &out, size_t &out_size,
+                         ProgressSink *progress = nullptr);
+
+// CRC-32 of PNG chunks.
+uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+
+#endif //ELECTRON_CLIPBOARD_EX_PNG_ENCODER_H
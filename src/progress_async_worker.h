@@ -0,0 +1,144 @@
+#ifndef ELECTRON_CLIPBOARD_EX_PROGRESS_ASYNC_WORKER_H
+#define ELECTRON_CLIPBOARD_EX_PROGRESS_ASYNC_WORKER_H
+
+#include <napi.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include "clipboard.h"
+
+// Forwards progress to an optional JS `onProgress` function through a
+// thread-safe function. Updates closer than `kIntervalUs` are dropped, so a
+// report costs a clock read unless it is delivered; the last update of a
+// phase (`done == total`) always is, waiting for room in the queue if
+// needed. Reports come from worker threads only.
+class ProgressReporter : public ProgressSink {
+public:
+    static constexpr int64_t kIntervalUs = 50 * 1000;
+
+    ProgressReporter(const Napi::Env &env, const Napi::Value &on_progress) {
+        if (on_progress.IsFunction()) {
+            _tsfn = Napi::ThreadSafeFunction::New(env, on_progress.As<Napi::Function>(), "clipboardProgress",
+                                                  kMaxQueueSize, 1);
+            _has_tsfn = true;
+        }
+    }
+
+    bool Report(ProgressPhase phase, uint64_t done, uint64_t total) override {
+        if (_cancelled.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (!_has_tsfn) {
+            return true;
+        }
+        int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        bool last = total != 0 && done == total;
+        if (!last && phase == _last_phase && now - _last_report_us < kIntervalUs) {
+            return true;
+        }
+        _last_phase = phase;
+        _last_report_us = now;
+
+        auto *update = new Update{phase, done, total};
+        napi_status status = last ? _tsfn.BlockingCall(update, CallJs) : _tsfn.NonBlockingCall(update, CallJs);
+        if (status != napi_ok) {
+            delete update; // The queue is full, the next update catches up
+        }
+        return true;
+    }
+
+    // May be called from the JS thread while the worker runs
+    void Cancel() {
+        _cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled() const {
+        return _cancelled.load(std::memory_order_relaxed);
+    }
+
+    // Called once the operation finished, queued updates are still delivered
+    void Release() {
+        if (_has_tsfn) {
+            _tsfn.Release();
+            _has_tsfn = false;
+        }
+    }
+
+private:
+    static constexpr size_t kMaxQueueSize = 4;
+
+    struct Update {
+        ProgressPhase phase;
+        uint64_t done;
+        uint64_t total;
+    };
+
+    static void CallJs(Napi::Env env, Napi::Function on_progress, Update *update) {
+        static const char *const kPhaseNames[] = {"transfer", "decode", "encode"};
+        if (env != nullptr && on_progress != nullptr) {
+            auto progress = Napi::Object::New(env);
+            progress.Set("phase", kPhaseNames[static_cast<size_t>(update->phase)]);
+            progress.Set("done", Napi::Number::New(env, static_cast<double>(update->done)));
+            progress.Set("total", Napi::Number::New(env, static_cast<double>(update->total)));
+            on_progress.Call({progress});
+        }
+        delete update;
+    }
+
+    Napi::ThreadSafeFunction _tsfn;
+    bool _has_tsfn = false;
+    std::atomic<bool> _cancelled{false};
+    ProgressPhase _last_phase = ProgressPhase::Transfer;
+    int64_t _last_report_us = 0;
+};
+
+// Runs `func` on the worker pool with a reporter, the callback receives
+// `(error, result)` where a cancelled operation fails with code ABORT_ERR.
+class ProgressAsyncWorker : public Napi::AsyncWorker {
+public:
+    ProgressAsyncWorker(const Napi::Function &callback, std::function<bool(ProgressSink *)> func,
+                        std::shared_ptr<ProgressReporter> reporter)
+            : AsyncWorker(callback), _func(std::move(func)), _reporter(std::move(reporter)) {}
+
+    ~ProgressAsyncWorker() override = default;
+
+    void Execute() override {
+        _result = _func(_reporter.get());
+        // A cancel arriving after the operation completed, its file written,
+        // is too late to abort it
+        if (!_result && _reporter->cancelled()) {
+            SetError("The operation was aborted");
+        }
+    }
+
+    void OnOK() override {
+        _reporter->Release();
+        Callback().Call({Env().Null(), Napi::Boolean::New(Env(), _result)});
+    }
+
+    void OnError(const Napi::Error &error) override {
+        _reporter->Release();
+        Napi::Object abort_error = error.Value();
+        abort_error.Set("name", "AbortError");
+        abort_error.Set("code", "ABORT_ERR");
+        Callback().Call({abort_error});
+    }
+
+    // `{cancel()}`, handed back to JS to abort the operation
+    static Napi::Object CreateHandle(const Napi::Env &env, const std::shared_ptr<ProgressReporter> &reporter) {
+        auto handle = Napi::Object::New(env);
+        handle.Set("cancel", Napi::Function::New(env, [reporter](const Napi::CallbackInfo &) {
+            reporter->Cancel();
+        }));
+        return handle;
+    }
+
+private:
+    std::function<bool(ProgressSink *)> _func;
+    std::shared_ptr<ProgressReporter> _reporter;
+    bool _result = false;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_PROGRESS_ASYNC_WORKER_H
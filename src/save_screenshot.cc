@@ -0,0 +1,14 @@
+#include "save_screenshot.h"
+
+#include "image_files.h"
+#include "png_encoder.h"
+
+bool SaveClipboardImageAsScreenshotPng(const std::string &target_path, ClipboardSelection selection,
+                                       ProgressSink *progress) {
+    ImagePixels image;
+    PooledBuffer out;
+    size_t out_size = 0;
+    return ReadImagePixels(image, selection, progress) && EncodeScreenshotPng(image, out, out_size, progress) &&
+           ReportProgress(progress, ProgressPhase::Encode, out_size, out_size) &&
+           WriteFileAtomically(target_path, out.data(), out_size);
+}
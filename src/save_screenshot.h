@@ -0,0 +1,14 @@
+#ifndef ELECTRON_CLIPBOARD_EX_SAVE_SCREENSHOT_H
+#define ELECTRON_CLIPBOARD_EX_SAVE_SCREENSHOT_H
+
+#include <string>
+#include "clipboard.h"
+
+// Saves the clipboard image as PNG through EncodeScreenshotPng instead of
+// the platform encoder: smaller and faster for UI screenshots, the same on
+// every platform.
+bool SaveClipboardImageAsScreenshotPng(const std::string &target_path,
+                                       ClipboardSelection selection = ClipboardSelection::Clipboard,
+                                       ProgressSink *progress = nullptr);
+
+#endif //ELECTRON_CLIPBOARD_EX_SAVE_SCREENSHOT_H
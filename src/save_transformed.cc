@@ -0,0 +1,42 @@
+#include "save_transformed.h"
+
+#include "image_files.h"
+
+#ifdef CLIPBOARD_EX_LIBJPEG
+#include "jpeg_transform.h"
+#endif
+
+namespace {
+
+bool SaveTransformedPixels(const ImagePixels &image, const std::string &target_path,
+                           const ImageTransform &transform, ImageFormat format, float quality,
+                           ProgressSink *progress) {
+    ImagePixels transformed;
+    return TransformPixels(image, transform, transformed) &&
+           SaveImagePixels(transformed, target_path, format, quality, progress);
+}
+
+} // namespace
+
+bool SaveClipboardImageTransformed(const std::string &target_path, const ImageTransform &transform,
+                                   ImageFormat format, float quality, ClipboardSelection selection,
+                                   ProgressSink *progress) {
+#ifdef CLIPBOARD_EX_LIBJPEG
+    ClipboardData jpeg;
+    if (format == ImageFormat::Jpeg && ReadClipboardJpeg(jpeg, selection, progress)) {
+        PooledBuffer out;
+        size_t out_size = 0;
+        if (TransformJpeg(jpeg.data(), jpeg.size(), transform, out, out_size)) {
+            return ReportProgress(progress, ProgressPhase::Encode, out_size, out_size) &&
+                   WriteFileAtomically(target_path, out.data(), out_size);
+        }
+        // Crops smaller than one block, or data libjpeg rejects, go through pixels
+        ImagePixels image;
+        return DecodeImageData(jpeg.data(), jpeg.size(), image) &&
+               SaveTransformedPixels(image, target_path, transform, format, quality, progress);
+    }
+#endif
+    ImagePixels image;
+    return ReadImagePixels(image, selection, progress) &&
+           SaveTransformedPixels(image, target_path, transform, format, quality, progress);
+}
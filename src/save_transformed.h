@@ -0,0 +1,17 @@
+#ifndef ELECTRON_CLIPBOARD_EX_SAVE_TRANSFORMED_H
+#define ELECTRON_CLIPBOARD_EX_SAVE_TRANSFORMED_H
+
+#include <string>
+#include "clipboard.h"
+#include "image_ops.h"
+
+// Saves the clipboard image cropped, rotated and flipped. A JPEG saved as
+// JPEG is transformed losslessly when the owner offers image/jpeg and the
+// build has libjpeg (Linux); the crop origin then snaps to the JPEG's 8 or
+// 16 pixel blocks. Everything else is decoded, transformed and encoded.
+bool SaveClipboardImageTransformed(const std::string &target_path, const ImageTransform &transform,
+                                   ImageFormat format, float quality,
+                                   ClipboardSelection selection = ClipboardSelection::Clipboard,
+                                   ProgressSink *progress = nullptr);
+
+#endif //ELECTRON_CLIPBOARD_EX_SAVE_TRANSFORMED_H
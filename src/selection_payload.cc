@@ -0,0 +1,99 @@
+#include "selection_payload.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+std::shared_ptr<SelectionPayload> SelectionPayload::FromBytes(const char *data, size_t size) {
+    int fd = memfd_create("clipboard-ex", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return nullptr;
+    }
+    for (size_t written = 0; written < size;) {
+        ssize_t n = write(fd, data + written, size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close(fd);
+            return nullptr;
+        }
+        written += static_cast<size_t>(n);
+    }
+    // Requestors are served concurrently from the same pages
+    bool sealed = fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0;
+    return std::shared_ptr<SelectionPayload>(new SelectionPayload(fd, size, sealed));
+}
+
+std::shared_ptr<SelectionPayload> SelectionPayload::FromFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+    return std::shared_ptr<SelectionPayload>(new SelectionPayload(fd, static_cast<size_t>(st.st_size), false));
+}
+
+std::shared_ptr<SelectionPayload> SelectionPayload::Lazy(std::function<std::shared_ptr<SelectionPayload>()> produce) {
+    std::shared_ptr<SelectionPayload> payload(new SelectionPayload(-1, 0, false));
+    payload->_lazy = true;
+    payload->_produce = std::move(produce);
+    return payload;
+}
+
+SelectionPayload *SelectionPayload::Resolve() {
+    if (!_lazy) {
+        return this;
+    }
+    std::call_once(_produced_once, [this] {
+        _produced = _produce();
+        _produce = nullptr; // Drops what the producer captured
+        _produced_ready.store(true, std::memory_order_release);
+    });
+    return _produced.get();
+}
+
+std::string_view SelectionPayload::Bytes() {
+    std::call_once(_bytes_once, [this] {
+        if (_fd < 0 || _size == 0) {
+            return;
+        }
+        if (_sealed) {
+            void *mapping = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+            _mapping = mapping == MAP_FAILED ? nullptr : mapping;
+            return;
+        }
+        std::string copy(_size, '\0');
+        size_t done = 0;
+        while (done < _size) {
+            ssize_t n = pread(_fd, &copy[done], _size - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            done += static_cast<size_t>(n);
+        }
+        _copy = std::move(copy);
+    });
+    if (_mapping) {
+        return std::string_view(static_cast<const char *>(_mapping), _size);
+    }
+    return _copy;
+}
+
+SelectionPayload::~SelectionPayload() {
+    if (_mapping) {
+        munmap(_mapping, _size);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef ELECTRON_CLIPBOARD_EX_SELECTION_PAYLOAD_H
+#define ELECTRON_CLIPBOARD_EX_SELECTION_PAYLOAD_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Bytes served for one or more targets by the Linux selection owners that
+// do not go through GTK. They are kept in a sealed memfd (or the file they
+// were opened from), immutable once created, so any number of requestors
+// can be served from the same pages concurrently. Linux only.
+class SelectionPayload {
+public:
+    static std::shared_ptr<SelectionPayload> FromBytes(const char *data, size_t size);
+
+    static std::shared_ptr<SelectionPayload> FromFile(const std::string &path);
+
+    // Produced by the thread serving the first request, then kept for the
+    // later ones. `produce` may block; requests get no data if it returns
+    // nullptr.
+    static std::shared_ptr<SelectionPayload> Lazy(std::function<std::shared_ptr<SelectionPayload>()> produce);
+
+    ~SelectionPayload();
+
+    SelectionPayload(const SelectionPayload &) = delete;
+
+    SelectionPayload &operator=(const SelectionPayload &) = delete;
+
+    // The payload holding the bytes: this one, or the produced one of a
+    // lazy payload.
+    SelectionPayload *Resolve();
+
+    // True for a lazy payload whose `Resolve` would still have to produce it.
+    bool NeedsProducing() const {
+        return _lazy && !_produced_ready.load(std::memory_order_acquire);
+    }
+
+    int fd() const {
+        return _fd;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    // The bytes in memory, for owners that cannot splice. A memfd is mapped
+    // read-only, a file is read once (mapping it would fault if it shrank).
+    // Empty on failure.
+    std::string_view Bytes();
+
+private:
+    SelectionPayload(int fd, size_t size, bool sealed) : _fd(fd), _size(size), _sealed(sealed) {}
+
+    int _fd;
+    size_t _size;
+    bool _sealed;
+    bool _lazy = false;
+    std::function<std::shared_ptr<SelectionPayload>()> _produce;
+    std::once_flag _produced_once;
+    std::shared_ptr<SelectionPayload> _produced;
+    std::atomic<bool> _produced_ready{false};
+    std::once_flag _bytes_once;
+    void *_mapping = nullptr;
+    std::string _copy;
+};
+
+// Target (mime type) and payload pairs, one payload may serve several.
+using SelectionOffer = std::vector<std::pair<std::string, std::shared_ptr<SelectionPayload>>>;
+
+#endif //ELECTRON_CLIPBOARD_EX_SELECTION_PAYLOAD_H
@@ -0,0 +1,101 @@
+#include "shared_memory.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+int CreateSharedFd(size_t size) {
+#ifdef __linux__
+    int fd = memfd_create("clipboard-ex-image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+    // A receiver shrinking the memory would fault our mapping. Writes cannot
+    // be sealed while JS holds a writable view.
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    static std::atomic<unsigned> counter{0};
+    std::string name = "/clipboard-ex-" + std::to_string(getpid()) + "-" + std::to_string(++counter);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    shm_unlink(name.c_str()); // Only reachable through descriptors from now on
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+#endif
+
+} // namespace
+
+std::unique_ptr<SharedMemory> SharedMemory::Create(size_t size) {
+    if (size == 0) {
+        return nullptr;
+    }
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32),
+                                        static_cast<DWORD>(size & 0xffffffffu), nullptr);
+    if (!mapping) {
+        return nullptr;
+    }
+    void *data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!data) {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    return std::unique_ptr<SharedMemory>(new SharedMemory(static_cast<char *>(data), size, -1, mapping));
+#else
+    int fd = CreateSharedFd(size);
+    if (fd < 0) {
+        return nullptr;
+    }
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<SharedMemory>(new SharedMemory(static_cast<char *>(data), size, fd, nullptr));
+#endif
+}
+
+SharedMemory::~SharedMemory() {
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(static_cast<HANDLE>(_handle));
+#else
+    munmap(_data, _size);
+    if (_fd >= 0) {
+        close(_fd);
+    }
+#endif
+}
+
+int SharedMemory::ReleaseFd() {
+    int fd = _fd;
+    _fd = -1;
+    return fd;
+}
+
+void SharedMemory::Delete(void *hint) {
+    delete static_cast<SharedMemory *>(hint);
+}
@@ -0,0 +1,50 @@
+#ifndef ELECTRON_CLIPBOARD_EX_SHARED_MEMORY_H
+#define ELECTRON_CLIPBOARD_EX_SHARED_MEMORY_H
+
+#include <cstddef>
+#include <memory>
+
+// A read-write block of memory that other processes can map through a file
+// descriptor: a memfd on Linux, whose size is sealed, or an unlinked POSIX
+// shared memory object on macOS. On Windows it is a file mapping without a
+// descriptor, `fd()` is -1 there.
+class SharedMemory {
+public:
+    // nullptr if `size` is 0 or the memory cannot be created.
+    static std::unique_ptr<SharedMemory> Create(size_t size);
+
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory &) = delete;
+
+    SharedMemory &operator=(const SharedMemory &) = delete;
+
+    char *data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    int fd() const {
+        return _fd;
+    }
+
+    // Hands the descriptor over, the caller has to close it. The mapping
+    // stays valid either way.
+    int ReleaseFd();
+
+    // `ClipboardData::ReleaseFunc` for a heap allocated SharedMemory.
+    static void Delete(void *hint);
+
+private:
+    SharedMemory(char *data, size_t size, int fd, void *handle) : _data(data), _size(size), _fd(fd), _handle(handle) {}
+
+    char *_data;
+    size_t _size;
+    int _fd;
+    void *_handle; // The file mapping on Windows
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_SHARED_MEMORY_H
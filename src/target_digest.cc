@@ -0,0 +1,62 @@
+#include "target_digest.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+#include "hash.h"
+
+namespace {
+
+struct CachedDigest {
+    uint64_t sequence = 0;
+    uint64_t digest = 0;
+    uint64_t size = 0;
+};
+
+std::mutex mutex;
+std::map<std::pair<ClipboardSelection, std::string>, CachedDigest> cache;
+
+} // namespace
+
+bool GetTargetDigest(const std::string &mime_type, ClipboardSelection selection, TargetDigest &digest) {
+    // Taken before the read: content replaced meanwhile is hashed again on
+    // the next call
+    uint64_t sequence = ClipboardSequenceNumber(selection);
+    auto key = std::make_pair(selection, mime_type);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(key);
+        if (it != cache.end() && it->second.sequence == sequence) {
+            digest.digest = it->second.digest;
+            digest.size = it->second.size;
+            digest.cached = true;
+            return true;
+        }
+    }
+
+    Xxh64Stream stream;
+    if (!ReadClipboardTarget(mime_type, selection, [&stream](const char *data, size_t size) {
+        stream.Update(data, size);
+        return true;
+    })) {
+        return false;
+    }
+    digest.digest = stream.Digest();
+    digest.size = stream.size();
+    digest.cached = false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Digests of earlier content of the selection are of no further use
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (it->first.first == selection && it->second.sequence != sequence) {
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    CachedDigest &entry = cache[key];
+    entry.sequence = sequence;
+    entry.digest = digest.digest;
+    entry.size = digest.size;
+    return true;
+}
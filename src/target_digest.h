@@ -0,0 +1,20 @@
+#ifndef ELECTRON_CLIPBOARD_EX_TARGET_DIGEST_H
+#define ELECTRON_CLIPBOARD_EX_TARGET_DIGEST_H
+
+#include <cstdint>
+#include <string>
+#include "clipboard.h"
+
+struct TargetDigest {
+    uint64_t digest = 0; // XXH64 of the target's bytes
+    uint64_t size = 0;
+    bool cached = false; // The selection has not changed since it was computed
+};
+
+// Change detection without decoding: the raw bytes of a target are hashed
+// as `ReadClipboardTarget` streams them in, never held whole. Digests are
+// kept per selection and target until the selection's sequence number
+// changes. False if the target is not offered. Thread-safe.
+bool GetTargetDigest(const std::string &mime_type, ClipboardSelection selection, TargetDigest &digest);
+
+#endif //ELECTRON_CLIPBOARD_EX_TARGET_DIGEST_H
@@ -0,0 +1,33 @@
+#include "task_batch.h"
+
+#include <algorithm>
+#include <thread>
+
+std::shared_ptr<TaskBatch> TaskBatch::Start(size_t count, unsigned threads, std::function<void(size_t)> task,
+                                            std::function<void()> on_done) {
+    std::shared_ptr<TaskBatch> batch(new TaskBatch(count, std::move(task), std::move(on_done)));
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+    batch->_running = threads;
+    // Detached, every thread keeps the batch alive until it ran out of tasks
+    for (unsigned i = 0; i < threads; ++i) {
+        std::thread([batch] { batch->Work(); }).detach();
+    }
+    return batch;
+}
+
+unsigned TaskBatch::DefaultThreads(unsigned max_threads) {
+    return std::min(max_threads, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+void TaskBatch::Work() {
+    while (!cancelled()) {
+        size_t index = _next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= _count) {
+            break;
+        }
+        _task(index);
+    }
+    if (_running.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _on_done();
+    }
+}
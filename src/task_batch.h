@@ -0,0 +1,44 @@
+#ifndef ELECTRON_CLIPBOARD_EX_TASK_BATCH_H
+#define ELECTRON_CLIPBOARD_EX_TASK_BATCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// Runs `task(0)` .. `task(count - 1)` on a few detached threads. Each thread
+// claims the next unstarted index, so a few slow tasks do not hold up the
+// rest, and memory is bounded by one task per thread.
+class TaskBatch {
+public:
+    // `task` runs on the batch's threads, `on_done` once after the last task.
+    static std::shared_ptr<TaskBatch> Start(size_t count, unsigned threads, std::function<void(size_t)> task,
+                                            std::function<void()> on_done);
+
+    // One thread per core, at most `max_threads`.
+    static unsigned DefaultThreads(unsigned max_threads);
+
+    // Unstarted tasks are skipped, `on_done` still runs.
+    void Cancel() {
+        _cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled() const {
+        return _cancelled.load(std::memory_order_relaxed);
+    }
+
+private:
+    TaskBatch(size_t count, std::function<void(size_t)> task, std::function<void()> on_done)
+            : _count(count), _task(std::move(task)), _on_done(std::move(on_done)) {}
+
+    void Work();
+
+    size_t _count;
+    std::function<void(size_t)> _task;
+    std::function<void()> _on_done;
+    std::atomic<size_t> _next{0};
+    std::atomic<unsigned> _running{0};
+    std::atomic<bool> _cancelled{false};
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_TASK_BATCH_H
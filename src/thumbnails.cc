@@ -0,0 +1,69 @@
+#include "thumbnails.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include "hash.h"
+#include "image_files.h"
+
+namespace {
+
+const unsigned kMaxThreads = 8;
+
+// Changes whenever the source file or anything affecting the output does
+std::string CacheName(const std::string &path, const FileStat &stat, const ThumbnailOptions &options) {
+    uint64_t key[] = {
+            stat.size,
+            static_cast<uint64_t>(stat.mtime_ns),
+            options.size,
+            static_cast<uint64_t>(options.format),
+            static_cast<uint64_t>(options.format == ImageFormat::Jpeg ? options.quality * 100 : 0),
+    };
+    uint64_t hash = Xxh64(key, sizeof(key), Xxh64(path.data(), path.size()));
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".%s", hash, options.format == ImageFormat::Jpeg ? "jpg" : "png");
+    return name;
+}
+
+ThumbnailResult GenerateThumbnail(size_t index, const std::string &path, const ThumbnailOptions &options) {
+    ThumbnailResult result;
+    result.index = index;
+    result.path = path;
+
+    FileStat stat;
+    if (!StatFile(path, stat)) {
+        result.error = "Cannot access " + path;
+        return result;
+    }
+    std::string thumbnail_path = JoinPath(options.cache_dir, CacheName(path, stat, options));
+    FileStat cached;
+    if (StatFile(thumbnail_path, cached)) {
+        result.thumbnail_path = thumbnail_path;
+        result.cached = true;
+        return result;
+    }
+
+    ImagePixels image;
+    if (!DecodeImageFile(path, options.size, image)) {
+        result.error = "Cannot decode " + path;
+    } else if (!SaveImagePixelsAtomically(image, thumbnail_path, options.format, options.quality)) {
+        result.error = "Cannot write " + thumbnail_path;
+    } else {
+        result.thumbnail_path = thumbnail_path;
+    }
+    return result;
+}
+
+} // namespace
+
+std::shared_ptr<TaskBatch> StartThumbnails(std::vector<std::string> paths, ThumbnailOptions options,
+                                           std::function<void(const ThumbnailResult &result)> on_result,
+                                           std::function<void()> on_done) {
+    unsigned threads = options.threads ? options.threads : TaskBatch::DefaultThreads(kMaxThreads);
+    size_t count = paths.size();
+    auto shared_paths = std::make_shared<std::vector<std::string>>(std::move(paths));
+    auto shared_options = std::make_shared<ThumbnailOptions>(std::move(options));
+    return TaskBatch::Start(count, threads, [shared_paths, shared_options, on_result](size_t index) {
+        on_result(GenerateThumbnail(index, (*shared_paths)[index], *shared_options));
+    }, std::move(on_done));
+}
@@ -0,0 +1,36 @@
+#ifndef ELECTRON_CLIPBOARD_EX_THUMBNAILS_H
+#define ELECTRON_CLIPBOARD_EX_THUMBNAILS_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "clipboard.h"
+#include "task_batch.h"
+
+struct ThumbnailOptions {
+    uint32_t size = 256; // Longest edge in pixels
+    ImageFormat format = ImageFormat::Png;
+    float quality = 0.8f; // JPEG only
+    std::string cache_dir; // Must exist
+    unsigned threads = 0; // 0 picks one per core, at most 8
+};
+
+struct ThumbnailResult {
+    size_t index = 0; // Into the requested paths
+    std::string path;
+    std::string thumbnail_path; // Empty on error
+    bool cached = false; // Served from the cache
+    std::string error;
+};
+
+// Generates thumbnails of image files on a task batch, results are
+// delivered in completion order. Thumbnails are cached in `cache_dir` under
+// a hash of the path, its size and mtime and the thumbnail options, and
+// reused while the file is unchanged.
+std::shared_ptr<TaskBatch> StartThumbnails(std::vector<std::string> paths, ThumbnailOptions options,
+                                           std::function<void(const ThumbnailResult &result)> on_result,
+                                           std::function<void()> on_done);
+
+#endif //ELECTRON_CLIPBOARD_EX_THUMBNAILS_H
@@ -0,0 +1,182 @@
+#include "tile_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include "hash.h"
+
+TileStore::Tile *TileStore::Intern(const uint8_t *pixels, uint32_t width, uint32_t height, bool &added) {
+    size_t size = static_cast<size_t>(width) * height * 4;
+    uint64_t hash = Xxh64(pixels, size, (static_cast<uint64_t>(width) << 32) | height);
+    std::vector<std::unique_ptr<Tile>> &bucket = _tiles[hash];
+    for (const std::unique_ptr<Tile> &tile : bucket) {
+        if (tile->width == width && tile->height == height && memcmp(tile->pixels.get(), pixels, size) == 0) {
+            ++tile->refs;
+            added = false;
+            return tile.get();
+        }
+    }
+    auto tile = std::unique_ptr<Tile>(new Tile{hash, width, height, 1, std::unique_ptr<uint8_t[]>(new uint8_t[size])});
+    memcpy(tile->pixels.get(), pixels, size);
+    bucket.push_back(std::move(tile));
+    ++_stats.unique_tiles;
+    _stats.stored_bytes += size;
+    added = true;
+    return bucket.back().get();
+}
+
+void TileStore::Release(Tile *tile) {
+    if (--tile->refs) {
+        return;
+    }
+    auto it = _tiles.find(tile->hash);
+    std::vector<std::unique_ptr<Tile>> &bucket = it->second;
+    --_stats.unique_tiles;
+    _stats.stored_bytes -= static_cast<uint64_t>(tile->width) * tile->height * 4;
+    bucket.erase(std::find_if(bucket.begin(), bucket.end(), [tile](const std::unique_ptr<Tile> &candidate) {
+        return candidate.get() == tile;
+    }));
+    if (bucket.empty()) {
+        _tiles.erase(it);
+    }
+}
+
+TileStore::EntryInfo TileStore::Add(const ImagePixels &image) {
+    EntryInfo info;
+    info.width = image.width;
+    info.height = image.height;
+    uint32_t columns = (image.width + _tile_size - 1) / _tile_size;
+    uint32_t rows = (image.height + _tile_size - 1) / _tile_size;
+    Entry entry{image.width, image.height, {}};
+    entry.tiles.reserve(static_cast<size_t>(columns) * rows);
+
+    // Tiles are packed into a scratch buffer first, hashing and comparing
+    // contiguous bytes is what XXH64 and memcmp are fastest at
+    std::vector<uint8_t> scratch(static_cast<size_t>(_tile_size) * _tile_size * 4);
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (uint32_t row = 0; row < rows; ++row) {
+        uint32_t y = row * _tile_size;
+        uint32_t height = std::min(_tile_size, image.height - y);
+        for (uint32_t column = 0; column < columns; ++column) {
+            uint32_t x = column * _tile_size;
+            uint32_t width = std::min(_tile_size, image.width - x);
+            size_t row_bytes = static_cast<size_t>(width) * 4;
+            for (uint32_t line = 0; line < height; ++line) {
+                memcpy(scratch.data() + line * row_bytes, image.pixels.data() + (y + line) * image.stride + x * 4,
+                       row_bytes);
+            }
+            bool added;
+            entry.tiles.push_back(Intern(scratch.data(), width, height, added));
+            if (added) {
+                ++info.new_tiles;
+                info.delta_bytes += row_bytes * height;
+            }
+        }
+    }
+    info.id = _next_id++;
+    info.tiles = static_cast<uint32_t>(entry.tiles.size());
+    ++_stats.entries;
+    _stats.logical_bytes += static_cast<uint64_t>(image.width) * image.height * 4;
+    _entries.emplace(info.id, std::move(entry));
+    return info;
+}
+
+bool TileStore::Read(uint64_t id, ImagePixels &image) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return false;
+    }
+    const Entry &entry = it->second;
+    image.width = entry.width;
+    image.height = entry.height;
+    image.stride = static_cast<size_t>(entry.width) * 4;
+    image.pixels = PooledBuffer(image.stride * entry.height);
+    if (!image.pixels.data()) {
+        return false;
+    }
+    uint32_t columns = (entry.width + _tile_size - 1) / _tile_size;
+    for (size_t i = 0; i < entry.tiles.size(); ++i) {
+        const Tile *tile = entry.tiles[i];
+        uint32_t x = static_cast<uint32_t>(i % columns) * _tile_size;
+        uint32_t y = static_cast<uint32_t>(i / columns) * _tile_size;
+        size_t row_bytes = static_cast<size_t>(tile->width) * 4;
+        for (uint32_t line = 0; line < tile->height; ++line) {
+            memcpy(image.pixels.data() + (y + line) * image.stride + x * 4, tile->pixels.get() + line * row_bytes,
+                   row_bytes);
+        }
+    }
+    return true;
+}
+
+bool TileStore::Remove(uint64_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return false;
+    }
+    for (Tile *tile : it->second.tiles) {
+        Release(tile);
+    }
+    --_stats.entries;
+    _stats.logical_bytes -= static_cast<uint64_t>(it->second.width) * it->second.height * 4;
+    _entries.erase(it);
+    return true;
+}
+
+bool TileStore::ChangedRegions(uint64_t id, uint64_t previous, std::vector<Region> &regions) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto current_it = _entries.find(id);
+    auto previous_it = _entries.find(previous);
+    if (current_it == _entries.end() || previous_it == _entries.end()) {
+        return false;
+    }
+    const Entry &current = current_it->second;
+    const Entry &before = previous_it->second;
+    regions.clear();
+    if (current.width != before.width || current.height != before.height) {
+        regions.push_back({0, 0, current.width, current.height});
+        return true;
+    }
+
+    // Runs of changed tiles per tile row, a run continues the region above
+    // it when both span the same columns
+    uint32_t columns = (current.width + _tile_size - 1) / _tile_size;
+    uint32_t rows = (current.height + _tile_size - 1) / _tile_size;
+    std::vector<size_t> open; // Indexes into `regions` that ended on the previous row
+    for (uint32_t row = 0; row < rows; ++row) {
+        std::vector<size_t> next_open;
+        uint32_t y = row * _tile_size;
+        uint32_t height = std::min(_tile_size, current.height - y);
+        for (uint32_t column = 0; column < columns;) {
+            size_t index = static_cast<size_t>(row) * columns + column;
+            if (current.tiles[index] == before.tiles[index]) {
+                ++column;
+                continue;
+            }
+            uint32_t start = column;
+            while (column < columns && current.tiles[static_cast<size_t>(row) * columns + column] !=
+                                       before.tiles[static_cast<size_t>(row) * columns + column]) {
+                ++column;
+            }
+            uint32_t x = start * _tile_size;
+            uint32_t width = std::min(column * _tile_size, current.width) - x;
+            auto above = std::find_if(open.begin(), open.end(), [&](size_t region) {
+                return regions[region].x == x && regions[region].width == width;
+            });
+            if (above != open.end()) {
+                regions[*above].height += height;
+                next_open.push_back(*above);
+            } else {
+                regions.push_back({x, y, width, height});
+                next_open.push_back(regions.size() - 1);
+            }
+        }
+        open = std::move(next_open);
+    }
+    return true;
+}
+
+TileStore::Stats TileStore::GetStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
@@ -0,0 +1,82 @@
+#ifndef ELECTRON_CLIPBOARD_EX_TILE_STORE_H
+#define ELECTRON_CLIPBOARD_EX_TILE_STORE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "clipboard.h"
+
+// Image history that stores near-identical images (successive screenshots
+// of the same window) cheaply. Images are cut into square tiles, each tile
+// is hashed and stored once with a reference count, and entries are grids
+// of tile references that are reassembled on read. Thread-safe.
+class TileStore {
+public:
+    struct EntryInfo {
+        uint64_t id = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t tiles = 0;
+        uint32_t new_tiles = 0; // Not shared with any earlier entry
+        uint64_t delta_bytes = 0; // Pixel bytes the entry added to the store
+    };
+
+    struct Region {
+        uint32_t x, y, width, height;
+    };
+
+    struct Stats {
+        uint64_t entries = 0;
+        uint64_t unique_tiles = 0;
+        uint64_t stored_bytes = 0; // Pixels of the unique tiles
+        uint64_t logical_bytes = 0; // Pixels of all entries
+    };
+
+    explicit TileStore(uint32_t tile_size = 64) : _tile_size(tile_size) {}
+
+    EntryInfo Add(const ImagePixels &image);
+
+    bool Read(uint64_t id, ImagePixels &image) const;
+
+    bool Remove(uint64_t id);
+
+    // Rectangles covering the tiles of `id` that differ from `previous`,
+    // found by comparing tile references only. Differently sized images
+    // differ everywhere. False if either entry is missing.
+    bool ChangedRegions(uint64_t id, uint64_t previous, std::vector<Region> &regions) const;
+
+    Stats GetStats() const;
+
+private:
+    struct Tile {
+        uint64_t hash;
+        uint32_t width;
+        uint32_t height;
+        uint32_t refs = 0;
+        std::unique_ptr<uint8_t[]> pixels; // Packed rows
+    };
+
+    struct Entry {
+        uint32_t width;
+        uint32_t height;
+        std::vector<Tile *> tiles; // Row major grid
+    };
+
+    // Returns the stored tile equal to the packed `pixels`, adding it if new
+    Tile *Intern(const uint8_t *pixels, uint32_t width, uint32_t height, bool &added);
+
+    void Release(Tile *tile);
+
+    uint32_t _tile_size;
+    mutable std::mutex _mutex;
+    uint64_t _next_id = 1;
+    std::map<uint64_t, Entry> _entries;
+    // Hash to tiles, more than one only on a hash collision
+    std::unordered_map<uint64_t, std::vector<std::unique_ptr<Tile>>> _tiles;
+    Stats _stats;
+};
+
+#endif //ELECTRON_CLIPBOARD_EX_TILE_STORE_H
@@ -0,0 +1,150 @@
+#include <cstdint>
+#include <cstring>
+#include "utf8.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CLIPBOARD_EX_HAVE_SSE2 1
+#endif
+
+namespace {
+
+// Length of the leading ASCII run
+size_t AsciiPrefixLength(const unsigned char *data, size_t size) {
+    size_t i = 0;
+#ifdef CLIPBOARD_EX_HAVE_SSE2
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        int mask = _mm_movemask_epi8(chunk);
+        if (mask != 0) {
+            return i + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#else
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+#endif
+    while (i < size && data[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+} // namespace
+
+bool IsValidUtf8(const char *data, size_t size) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    size_t i = 0;
+    while (i < size) {
+        i += AsciiPrefixLength(p + i, size - i);
+        if (i == size) {
+            return true;
+        }
+
+        unsigned char lead = p[i];
+        size_t length;
+        unsigned char min = 0x80;
+        unsigned char max = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            if (lead == 0xE0) {
+                min = 0xA0; // overlong
+            } else if (lead == 0xED) {
+                max = 0x9F; // surrogates
+            }
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            if (lead == 0xF0) {
+                min = 0x90; // overlong
+            } else if (lead == 0xF4) {
+                max = 0x8F; // above U+10FFFF
+            }
+        } else {
+            return false;
+        }
+
+        if (size - i < length) {
+            return false;
+        }
+        if (p[i + 1] < min || p[i + 1] > max) {
+            return false;
+        }
+        for (size_t k = 2; k < length; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+size_t Latin1ToUtf8Length(const char *data, size_t size) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    size_t length = size;
+    size_t i = 0;
+    while (i < size) {
+        i += AsciiPrefixLength(p + i, size - i);
+        if (i < size) {
+            ++length;
+            ++i;
+        }
+    }
+    return length;
+}
+
+size_t Latin1ToUtf8(const char *data, size_t size, char *out) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    size_t written = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t ascii = AsciiPrefixLength(p + i, size - i);
+        memcpy(out + written, p + i, ascii);
+        written += ascii;
+        i += ascii;
+        if (i < size) {
+            out[written++] = static_cast<char>(0xC0 | (p[i] >> 6));
+            out[written++] = static_cast<char>(0x80 | (p[i] & 0x3F));
+            ++i;
+        }
+    }
+    return written;
+}
+
+size_t Utf8ToLatin1(const char *data, size_t size, char *out) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    size_t written = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t ascii = AsciiPrefixLength(p + i, size - i);
+        memcpy(out + written, p + i, ascii);
+        written += ascii;
+        i += ascii;
+        if (i >= size) {
+            break;
+        }
+        // Two byte sequences up to U+00FF map to one Latin-1 byte
+        if ((p[i] == 0xC2 || p[i] == 0xC3) && i + 1 < size && (p[i + 1] & 0xC0) == 0x80) {
+            out[written++] = static_cast<char>(((p[i] & 0x03) << 6) | (p[i + 1] & 0x3F));
+            i += 2;
+            continue;
+        }
+        // Anything else is one '?' per character: the lead byte and its
+        // continuation bytes
+        out[written++] = '?';
+        ++i;
+        if (p[i - 1] >= 0xC0) {
+            while (i < size && (p[i] & 0xC0) == 0x80) {
+                ++i;
+            }
+        }
+    }
+    return written;
+}
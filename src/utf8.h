@@ -0,0 +1,22 @@
+#ifndef ELECTRON_CLIPBOARD_EX_UTF8_H
+#define ELECTRON_CLIPBOARD_EX_UTF8_H
+
+#include <cstddef>
+
+// Validates UTF-8 as specified by RFC 3629 (no overlongs, surrogates or
+// code points above U+10FFFF). ASCII runs are skipped 16 bytes at a time.
+bool IsValidUtf8(const char *data, size_t size);
+
+// Number of bytes `Latin1ToUtf8` writes for `size` Latin-1 characters.
+size_t Latin1ToUtf8Length(const char *data, size_t size);
+
+// Converts ISO-8859-1 (the X11 STRING target) to UTF-8. `out` must hold
+// `Latin1ToUtf8Length(data, size)` bytes, returns the number written.
+size_t Latin1ToUtf8(const char *data, size_t size, char *out);
+
+// Converts UTF-8 to ISO-8859-1 for requestors of the STRING target.
+// Characters above U+00FF and invalid bytes become '?'. `out` must hold
+// `size` bytes, returns the number written.
+size_t Utf8ToLatin1(const char *data, size_t size, char *out);
+
+#endif //ELECTRON_CLIPBOARD_EX_UTF8_H
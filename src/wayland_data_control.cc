@@ -0,0 +1,813 @@
+#include "wayland_data_control.h"
+#include "buffer_pool.h"
+
+#ifdef CLIPBOARD_EX_WAYLAND
+
+#include <wayland-client.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace wayland_data_control {
+
+namespace {
+
+// An owner that stays silent this long is considered gone
+const int kTransferTimeoutMs = 5000;
+const int kSyncTimeoutMs = 1000;
+const size_t kSpliceChunk = 1 << 20;
+
+// ext-data-control-v1 and zwlr-data-control-unstable-v1 have the same
+// requests and events in the same order, only the interface names and the
+// version that introduced the primary selection differ. The tables are
+// built at runtime instead of being generated by wayland-scanner, which
+// keeps the protocol XML out of the build.
+enum ManagerRequest : uint32_t {
+    kManagerCreateDataSource = 0,
+    kManagerGetDataDevice = 1,
+    kManagerDestroy = 2,
+};
+
+enum DeviceRequest : uint32_t {
+    kDeviceSetSelection = 0,
+    kDeviceDestroy = 1,
+    kDeviceSetPrimarySelection = 2,
+};
+
+enum SourceRequest : uint32_t {
+    kSourceOffer = 0,
+    kSourceDestroy = 1,
+};
+
+enum OfferRequest : uint32_t {
+    kOfferReceive = 0,
+    kOfferDestroy = 1,
+};
+
+struct Protocol {
+    std::string manager_name;
+    std::string device_name;
+    std::string source_name;
+    std::string offer_name;
+    uint32_t max_version;
+    uint32_t primary_since;
+
+    wl_interface manager{};
+    wl_interface device{};
+    wl_interface source{};
+    wl_interface offer{};
+
+    const wl_interface *null_types[2] = {nullptr, nullptr};
+    const wl_interface *create_source_types[1];
+    const wl_interface *get_device_types[2];
+    const wl_interface *source_types[1];
+    const wl_interface *offer_types[1];
+
+    wl_message manager_requests[3];
+    wl_message device_requests[3];
+    wl_message device_events[4];
+    wl_message source_requests[2];
+    wl_message source_events[2];
+    wl_message offer_requests[2];
+    wl_message offer_events[1];
+
+    Protocol(const char *prefix, uint32_t max_version, uint32_t primary_since)
+            : manager_name(std::string(prefix) + "_manager_v1"),
+              device_name(std::string(prefix) + "_device_v1"),
+              source_name(std::string(prefix) + "_source_v1"),
+              offer_name(std::string(prefix) + "_offer_v1"),
+              max_version(max_version),
+              primary_since(primary_since) {
+        const char *primary_signature = primary_since > 1 ? "2?o" : "?o";
+
+        create_source_types[0] = &source;
+        get_device_types[0] = &device;
+        get_device_types[1] = &wl_seat_interface;
+        source_types[0] = &source;
+        offer_types[0] = &offer;
+
+        manager_requests[kManagerCreateDataSource] = {"create_data_source", "n", create_source_types};
+        manager_requests[kManagerGetDataDevice] = {"get_data_device", "no", get_device_types};
+        manager_requests[kManagerDestroy] = {"destroy", "", null_types};
+
+        device_requests[kDeviceSetSelection] = {"set_selection", "?o", source_types};
+        device_requests[kDeviceDestroy] = {"destroy", "", null_types};
+        device_requests[kDeviceSetPrimarySelection] = {"set_primary_selection", primary_signature, source_types};
+        device_events[0] = {"data_offer", "n", offer_types};
+        device_events[1] = {"selection", "?o", offer_types};
+        device_events[2] = {"finished", "", null_types};
+        device_events[3] = {"primary_selection", primary_signature, offer_types};
+
+        source_requests[kSourceOffer] = {"offer", "s", null_types};
+        source_requests[kSourceDestroy] = {"destroy", "", null_types};
+        source_events[0] = {"send", "sh", null_types};
+        source_events[1] = {"cancelled", "", null_types};
+
+        offer_requests[kOfferReceive] = {"receive", "sh", null_types};
+        offer_requests[kOfferDestroy] = {"destroy", "", null_types};
+        offer_events[0] = {"offer", "s", null_types};
+
+        int version = static_cast<int>(max_version);
+        manager = {manager_name.c_str(), version, 3, manager_requests, 0, nullptr};
+        device = {device_name.c_str(), version, 3, device_requests, 4, device_events};
+        source = {source_name.c_str(), version, 2, source_requests, 2, source_events};
+        offer = {offer_name.c_str(), version, 2, offer_requests, 1, offer_events};
+    }
+};
+
+const Protocol &ExtProtocol() {
+    static const Protocol protocol("ext_data_control", 1, 1);
+    return protocol;
+}
+
+const Protocol &WlrProtocol() {
+    static const Protocol protocol("zwlr_data_control", 2, 2);
+    return protocol;
+}
+
+struct DeviceListener {
+    void (*data_offer)(void *data, wl_proxy *device, wl_proxy *offer);
+    void (*selection)(void *data, wl_proxy *device, wl_proxy *offer);
+    void (*finished)(void *data, wl_proxy *device);
+    void (*primary_selection)(void *data, wl_proxy *device, wl_proxy *offer);
+};
+
+struct OfferListener {
+    void (*offer)(void *data, wl_proxy *offer, const char *mime_type);
+};
+
+struct SourceListener {
+    void (*send)(void *data, wl_proxy *source, const char *mime_type, int32_t fd);
+    void (*cancelled)(void *data, wl_proxy *source);
+};
+
+template<typename Listener>
+void AddListener(wl_proxy *proxy, const Listener &listener, void *data) {
+    wl_proxy_add_listener(proxy, reinterpret_cast<void (**)(void)>(const_cast<Listener *>(&listener)), data);
+}
+
+void DestroyProxy(wl_proxy *proxy, uint32_t destroy_opcode) {
+    wl_proxy_marshal(proxy, destroy_opcode);
+    wl_proxy_destroy(proxy);
+}
+
+struct OfferState {
+    wl_proxy *proxy = nullptr;
+    std::vector<std::string> mime_types;
+};
+
+struct SourceState {
+    wl_proxy *proxy = nullptr;
+    Offer offer;
+};
+
+struct SelectionSlot {
+    OfferState *offer = nullptr;
+    uint64_t sequence = 0;
+};
+
+struct SyncWaiter {
+    bool done = false;
+    bool abandoned = false;
+};
+
+bool WaitFd(int fd, short events) {
+    pollfd pfd = {fd, events, 0};
+    int ready;
+    do {
+        ready = poll(&pfd, 1, kTransferTimeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0;
+}
+
+// Copies the rest of `in` to `out` through userspace, for fds splice() rejects
+bool CopyFd(int in, int out) {
+    char buffer[64 * 1024];
+    for (;;) {
+        ssize_t n = read(in, buffer, sizeof(buffer));
+        if (n == 0) {
+            return true;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN && WaitFd(in, POLLIN)) {
+                continue;
+            }
+            return false;
+        }
+        for (ssize_t written = 0; written < n;) {
+            ssize_t m = write(out, buffer + written, static_cast<size_t>(n - written));
+            if (m < 0) {
+                if (errno == EINTR || (errno == EAGAIN && WaitFd(out, POLLOUT))) {
+                    continue;
+                }
+                return false;
+            }
+            written += m;
+        }
+    }
+}
+
+// Serves `payload` into the requestor's pipe. splice() moves page cache
+// pages of the memfd or file into the pipe, the bytes are never copied
+// through userspace.
+void ServePayload(std::shared_ptr<Payload> lazy_payload, int fd) {
+    Payload *payload = lazy_payload->Resolve();
+    if (!payload) {
+        close(fd);
+        return;
+    }
+    loff_t offset = 0;
+    size_t remaining = payload->size();
+    bool use_sendfile = false;
+    while (remaining > 0) {
+        size_t chunk = std::min(remaining, kSpliceChunk);
+        ssize_t n;
+        if (use_sendfile) {
+            off_t file_offset = static_cast<off_t>(offset);
+            n = sendfile(fd, payload->fd(), &file_offset, chunk);
+            if (n > 0) {
+                offset = file_offset;
+            }
+        } else {
+            n = splice(payload->fd(), &offset, fd, nullptr, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        }
+        if (n < 0) {
+            if (errno == EINTR || (errno == EAGAIN && WaitFd(fd, POLLOUT))) {
+                continue;
+            }
+            if (errno == EINVAL && !use_sendfile) {
+                use_sendfile = true; // `fd` is not a pipe
+                continue;
+            }
+            break; // EPIPE: the requestor went away
+        }
+        if (n == 0) {
+            break;
+        }
+        remaining -= static_cast<size_t>(n);
+    }
+    close(fd);
+}
+
+class Connection {
+public:
+    // nullptr when not on Wayland or when the compositor lacks data-control
+    static Connection *Get() {
+        static Connection *connection = Create();
+        return connection;
+    }
+
+    bool Supports(ClipboardSelection selection) const {
+        if (selection == ClipboardSelection::Clipboard) {
+            return true;
+        }
+        return selection == ClipboardSelection::Primary && _version >= _protocol->primary_since;
+    }
+
+    std::vector<std::string> MimeTypes(ClipboardSelection selection) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        OfferState *offer = Slot(selection).offer;
+        return offer ? offer->mime_types : std::vector<std::string>();
+    }
+
+    // Returns the non-blocking read end of a pipe the owner writes
+    // `mime_type` into, -1 if it is not offered. Readers wait with WaitFd,
+    // so an owner that never writes times out instead of blocking them.
+    int Receive(ClipboardSelection selection, const std::string &mime_type) {
+        int fds[2];
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            OfferState *offer = Slot(selection).offer;
+            if (!offer || std::find(offer->mime_types.begin(), offer->mime_types.end(), mime_type) ==
+                          offer->mime_types.end()) {
+                return -1;
+            }
+            if (pipe2(fds, O_CLOEXEC) != 0) {
+                return -1;
+            }
+            // Only our end, the owner gets a separate blocking file description
+            fcntl(fds[0], F_SETFL, O_NONBLOCK);
+            wl_proxy_marshal(offer->proxy, kOfferReceive, mime_type.c_str(), fds[1]);
+        }
+        // The fd was duplicated into the request, our copy must be closed
+        // for the read end to see EOF
+        wl_display_flush(_display);
+        close(fds[1]);
+        return fds[0];
+    }
+
+    bool SetSelection(ClipboardSelection selection, const Offer *offer) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            wl_proxy *source = nullptr;
+            if (offer) {
+                source = wl_proxy_marshal_constructor(_manager, kManagerCreateDataSource,
+                                                      &_protocol->source, nullptr);
+                if (!source) {
+                    return false;
+                }
+                SourceState *state = new SourceState();
+                state->proxy = source;
+                state->offer = *offer;
+                AddListener(source, kSourceListener, state);
+                for (const auto &entry : state->offer) {
+                    wl_proxy_marshal(source, kSourceOffer, entry.first.c_str());
+                }
+            }
+            // The previous source is released by its `cancelled` event
+            uint32_t opcode = selection == ClipboardSelection::Primary
+                              ? kDeviceSetPrimarySelection : kDeviceSetSelection;
+            wl_proxy_marshal(_device, opcode, source);
+        }
+        wl_display_flush(_display);
+        Sync();
+        return true;
+    }
+
+    uint64_t Sequence(ClipboardSelection selection) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return Slot(selection).sequence;
+    }
+
+private:
+    static Connection *Create() {
+        if (!getenv("WAYLAND_DISPLAY")) {
+            return nullptr;
+        }
+        wl_display *display = wl_display_connect(nullptr);
+        if (!display) {
+            return nullptr;
+        }
+        Connection *connection = new Connection(display);
+        if (!connection->Initialize()) {
+            delete connection;
+            return nullptr;
+        }
+        std::thread(&Connection::Run, connection).detach();
+        return connection;
+    }
+
+    explicit Connection(wl_display *display) : _display(display) {}
+
+    ~Connection() {
+        if (_device) {
+            DestroyProxy(_device, kDeviceDestroy);
+        }
+        if (_manager) {
+            DestroyProxy(_manager, kManagerDestroy);
+        }
+        if (_seat) {
+            wl_proxy_destroy(_seat);
+        }
+        if (_registry) {
+            wl_registry_destroy(_registry);
+        }
+        wl_display_disconnect(_display);
+    }
+
+    bool Initialize() {
+        static const wl_registry_listener registry_listener = {OnGlobal, OnGlobalRemove};
+        _registry = wl_display_get_registry(_display);
+        wl_registry_add_listener(_registry, &registry_listener, this);
+        if (wl_display_roundtrip(_display) < 0 || !_seat_name) {
+            return false;
+        }
+
+        // Prefer the standardized protocol when both are advertised
+        uint32_t manager_name = _ext_name;
+        uint32_t manager_version = _ext_version;
+        _protocol = &ExtProtocol();
+        if (!manager_name) {
+            manager_name = _wlr_name;
+            manager_version = _wlr_version;
+            _protocol = &WlrProtocol();
+        }
+        if (!manager_name) {
+            return false;
+        }
+        _version = std::min(manager_version, _protocol->max_version);
+        _manager = static_cast<wl_proxy *>(wl_registry_bind(_registry, manager_name, &_protocol->manager, _version));
+        _seat = static_cast<wl_proxy *>(wl_registry_bind(_registry, _seat_name, &wl_seat_interface, 1));
+        _device = wl_proxy_marshal_constructor(_manager, kManagerGetDataDevice, &_protocol->device, nullptr, _seat);
+        if (!_device) {
+            return false;
+        }
+        AddListener(_device, kDeviceListener, this);
+
+        // The device announces the current selections right away
+        return wl_display_roundtrip(_display) >= 0;
+    }
+
+    void Run() {
+        int display_fd = wl_display_get_fd(_display);
+        for (;;) {
+            while (wl_display_prepare_read(_display) != 0) {
+                wl_display_dispatch_pending(_display);
+            }
+            wl_display_flush(_display);
+            pollfd pfd = {display_fd, POLLIN, 0};
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                wl_display_cancel_read(_display);
+                break;
+            }
+            if (pfd.revents & POLLIN) {
+                if (wl_display_read_events(_display) < 0) {
+                    break;
+                }
+            } else {
+                wl_display_cancel_read(_display);
+            }
+            if (pfd.revents & (POLLERR | POLLHUP)) {
+                break;
+            }
+            if (wl_display_dispatch_pending(_display) < 0) {
+                break;
+            }
+        }
+        // The compositor went away, readers see empty selections from now on
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (SelectionSlot &slot : _slots) {
+            slot.offer = nullptr;
+        }
+    }
+
+    // Waits until the compositor processed every request sent so far, so
+    // that a read right after a write sees the new selection
+    void Sync() {
+        static const wl_callback_listener callback_listener = {OnSyncDone};
+        SyncWaiter *waiter = new SyncWaiter();
+        wl_callback *callback;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            callback = wl_display_sync(_display);
+            wl_callback_add_listener(callback, &callback_listener, waiter);
+        }
+        wl_display_flush(_display);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _synced.wait_for(lock, std::chrono::milliseconds(kSyncTimeoutMs), [waiter] { return waiter->done; });
+        if (waiter->done) {
+            delete waiter;
+        } else {
+            waiter->abandoned = true;
+        }
+    }
+
+    SelectionSlot &Slot(ClipboardSelection selection) {
+        return _slots[selection == ClipboardSelection::Primary ? 1 : 0];
+    }
+
+    void SetOffer(ClipboardSelection selection, wl_proxy *proxy) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        SelectionSlot &slot = Slot(selection);
+        if (slot.offer) {
+            DestroyProxy(slot.offer->proxy, kOfferDestroy);
+            delete slot.offer;
+        }
+        slot.offer = proxy ? static_cast<OfferState *>(wl_proxy_get_user_data(proxy)) : nullptr;
+        ++slot.sequence;
+    }
+
+    static void OnGlobal(void *data, wl_registry *registry, uint32_t name, const char *interface,
+                         uint32_t version) {
+        (void)registry;
+        Connection *self = static_cast<Connection *>(data);
+        if (strcmp(interface, wl_seat_interface.name) == 0 && !self->_seat_name) {
+            self->_seat_name = name;
+        } else if (ExtProtocol().manager_name == interface) {
+            self->_ext_name = name;
+            self->_ext_version = version;
+        } else if (WlrProtocol().manager_name == interface) {
+            self->_wlr_name = name;
+            self->_wlr_version = version;
+        }
+    }
+
+    static void OnGlobalRemove(void *data, wl_registry *registry, uint32_t name) {
+        (void)data;
+        (void)registry;
+        (void)name;
+    }
+
+    static void OnSyncDone(void *data, wl_callback *callback, uint32_t serial) {
+        (void)serial;
+        Connection *self = Get();
+        SyncWaiter *waiter = static_cast<SyncWaiter *>(data);
+        wl_callback_destroy(callback);
+        std::lock_guard<std::mutex> lock(self->_mutex);
+        if (waiter->abandoned) {
+            delete waiter;
+            return;
+        }
+        waiter->done = true;
+        self->_synced.notify_all();
+    }
+
+    static void OnDataOffer(void *data, wl_proxy *device, wl_proxy *proxy) {
+        (void)data;
+        (void)device;
+        OfferState *offer = new OfferState();
+        offer->proxy = proxy;
+        AddListener(proxy, kOfferListener, offer);
+    }
+
+    static void OnSelection(void *data, wl_proxy *device, wl_proxy *proxy) {
+        (void)device;
+        static_cast<Connection *>(data)->SetOffer(ClipboardSelection::Clipboard, proxy);
+    }
+
+    static void OnPrimarySelection(void *data, wl_proxy *device, wl_proxy *proxy) {
+        (void)device;
+        static_cast<Connection *>(data)->SetOffer(ClipboardSelection::Primary, proxy);
+    }
+
+    static void OnFinished(void *data, wl_proxy *device) {
+        (void)device;
+        // The seat is gone, leaving the device inert
+        Connection *self = static_cast<Connection *>(data);
+        self->SetOffer(ClipboardSelection::Clipboard, nullptr);
+        self->SetOffer(ClipboardSelection::Primary, nullptr);
+    }
+
+    static void OnOfferMimeType(void *data, wl_proxy *proxy, const char *mime_type) {
+        (void)proxy;
+        // Mime types arrive before the offer is announced as a selection,
+        // no reader can see it yet
+        static_cast<OfferState *>(data)->mime_types.emplace_back(mime_type);
+    }
+
+    static void OnSend(void *data, wl_proxy *proxy, const char *mime_type, int32_t fd) {
+        (void)proxy;
+        SourceState *source = static_cast<SourceState *>(data);
+        for (const auto &entry : source->offer) {
+            if (entry.first == mime_type && entry.second) {
+                // A slow requestor must not stall the event loop
+                std::thread(ServePayload, entry.second, fd).detach();
+                return;
+            }
+        }
+        close(fd);
+    }
+
+    static void OnCancelled(void *data, wl_proxy *proxy) {
+        DestroyProxy(proxy, kSourceDestroy);
+        delete static_cast<SourceState *>(data);
+    }
+
+    static const DeviceListener kDeviceListener;
+    static const OfferListener kOfferListener;
+    static const SourceListener kSourceListener;
+
+    wl_display *_display;
+    wl_registry *_registry = nullptr;
+    wl_proxy *_seat = nullptr;
+    wl_proxy *_manager = nullptr;
+    wl_proxy *_device = nullptr;
+    const Protocol *_protocol = nullptr;
+    uint32_t _version = 0;
+    uint32_t _seat_name = 0;
+    uint32_t _ext_name = 0;
+    uint32_t _ext_version = 0;
+    uint32_t _wlr_name = 0;
+    uint32_t _wlr_version = 0;
+
+    std::mutex _mutex;
+    std::condition_variable _synced;
+    SelectionSlot _slots[2];
+};
+
+const DeviceListener Connection::kDeviceListener = {
+        Connection::OnDataOffer,
+        Connection::OnSelection,
+        Connection::OnFinished,
+        Connection::OnPrimarySelection,
+};
+
+const OfferListener Connection::kOfferListener = {
+        Connection::OnOfferMimeType,
+};
+
+const SourceListener Connection::kSourceListener = {
+        Connection::OnSend,
+        Connection::OnCancelled,
+};
+
+Connection *GetConnection(ClipboardSelection selection) {
+    Connection *connection = Connection::Get();
+    return connection && connection->Supports(selection) ? connection : nullptr;
+}
+
+} // namespace
+
+bool IsAvailable(ClipboardSelection selection) {
+    return GetConnection(selection) != nullptr;
+}
+
+std::vector<std::string> GetMimeTypes(ClipboardSelection selection) {
+    Connection *connection = GetConnection(selection);
+    return connection ? connection->MimeTypes(selection) : std::vector<std::string>();
+}
+
+bool HasMimeType(ClipboardSelection selection, const std::string &mime_type) {
+    std::vector<std::string> mime_types = GetMimeTypes(selection);
+    return std::find(mime_types.begin(), mime_types.end(), mime_type) != mime_types.end();
+}
+
+bool Read(ClipboardSelection selection, const std::string &mime_type, ClipboardData &data,
+          ProgressSink *progress) {
+    Connection *connection = GetConnection(selection);
+    int fd = connection ? connection->Receive(selection, mime_type) : -1;
+    if (fd < 0) {
+        return false;
+    }
+
+    // Reads straight into the pooled buffer handed to JS, sized by what the
+    // pipe already holds and doubled as the owner keeps writing
+    int pending = 0;
+    size_t initial = 64 * 1024;
+    if (ioctl(fd, FIONREAD, &pending) == 0 && static_cast<size_t>(pending) > initial) {
+        initial = static_cast<size_t>(pending);
+    }
+    PooledBuffer buffer(initial);
+    size_t size = 0;
+    bool ok = buffer.data() != nullptr;
+    while (ok) {
+        if (size == buffer.capacity() && !buffer.Grow(size * 2, size)) {
+            ok = false;
+            break;
+        }
+        ssize_t n = read(fd, buffer.data() + size, buffer.capacity() - size);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            ok = errno == EINTR || (errno == EAGAIN && WaitFd(fd, POLLIN));
+            continue;
+        }
+        size += static_cast<size_t>(n);
+        // Closing the read end makes the owner's next write fail with EPIPE
+        ok = ReportProgress(progress, ProgressPhase::Transfer, size, 0);
+    }
+    close(fd);
+    if (!ok) {
+        return false;
+    }
+    PooledBuffer *owner = new PooledBuffer(std::move(buffer));
+    data = ClipboardData(owner->data(), size, PooledBuffer::Delete, owner);
+    return true;
+}
+
+bool ReadToFd(ClipboardSelection selection, const std::string &mime_type, int fd, ProgressSink *progress) {
+    Connection *connection = GetConnection(selection);
+    int pipe_fd = connection ? connection->Receive(selection, mime_type) : -1;
+    if (pipe_fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    uint64_t size = 0;
+    for (;;) {
+        if (!WaitFd(pipe_fd, POLLIN)) {
+            ok = false;
+            break;
+        }
+        ssize_t n = splice(pipe_fd, nullptr, fd, nullptr, kSpliceChunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            // Targets such as O_APPEND files reject splice()
+            ok = errno == EINVAL && CopyFd(pipe_fd, fd);
+            break;
+        }
+        size += static_cast<uint64_t>(n);
+        if (!ReportProgress(progress, ProgressPhase::Transfer, size, 0)) {
+            ok = false;
+            break;
+        }
+    }
+    close(pipe_fd);
+    return ok;
+}
+
+bool ReadChunks(ClipboardSelection selection, const std::string &mime_type, const ChunkConsumer &consume) {
+    Connection *connection = GetConnection(selection);
+    int fd = connection ? connection->Receive(selection, mime_type) : -1;
+    if (fd < 0) {
+        return false;
+    }
+    // Only one chunk is held at a time
+    PooledBuffer chunk(kSpliceChunk);
+    bool ok = chunk.data() != nullptr;
+    while (ok) {
+        ssize_t n = read(fd, chunk.data(), chunk.capacity());
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            ok = errno == EINTR || (errno == EAGAIN && WaitFd(fd, POLLIN));
+            continue;
+        }
+        ok = consume(chunk.data(), static_cast<size_t>(n));
+    }
+    close(fd);
+    return ok;
+}
+
+bool Write(ClipboardSelection selection, const Offer &offer) {
+    Connection *connection = GetConnection(selection);
+    return connection && connection->SetSelection(selection, &offer);
+}
+
+bool Clear(ClipboardSelection selection) {
+    Connection *connection = GetConnection(selection);
+    return connection && connection->SetSelection(selection, nullptr);
+}
+
+uint64_t SequenceNumber(ClipboardSelection selection) {
+    Connection *connection = GetConnection(selection);
+    return connection ? connection->Sequence(selection) : 0;
+}
+
+} // namespace wayland_data_control
+
+#else
+
+// Built without wayland-client, every Wayland session goes through GTK
+namespace wayland_data_control {
+
+bool IsAvailable(ClipboardSelection selection) {
+    (void)selection;
+    return false;
+}
+
+std::vector<std::string> GetMimeTypes(ClipboardSelection selection) {
+    (void)selection;
+    return std::vector<std::string>();
+}
+
+bool HasMimeType(ClipboardSelection selection, const std::string &mime_type) {
+    (void)selection;
+    (void)mime_type;
+    return false;
+}
+
+bool Read(ClipboardSelection selection, const std::string &mime_type, ClipboardData &data,
+          ProgressSink *progress) {
+    (void)selection;
+    (void)mime_type;
+    (void)data;
+    (void)progress;
+    return false;
+}
+
+bool ReadToFd(ClipboardSelection selection, const std::string &mime_type, int fd, ProgressSink *progress) {
+    (void)selection;
+    (void)mime_type;
+    (void)fd;
+    (void)progress;
+    return false;
+}
+
+bool ReadChunks(ClipboardSelection selection, const std::string &mime_type, const ChunkConsumer &consume) {
+    (void)selection;
+    (void)mime_type;
+    (void)consume;
+    return false;
+}
+
+bool Write(ClipboardSelection selection, const Offer &offer) {
+    (void)selection;
+    (void)offer;
+    return false;
+}
+
+bool Clear(ClipboardSelection selection) {
+    (void)selection;
+    return false;
+}
+
+uint64_t SequenceNumber(ClipboardSelection selection) {
+    (void)selection;
+    return 0;
+}
+
+} // namespace wayland_data_control
+
+#endif
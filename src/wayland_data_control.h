@@ -0,0 +1,58 @@
+#ifndef ELECTRON_CLIPBOARD_EX_WAYLAND_DATA_CONTROL_H
+#define ELECTRON_CLIPBOARD_EX_WAYLAND_DATA_CONTROL_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "clipboard.h"
+#include "selection_payload.h"
+
+// Clipboard access through ext-data-control-v1 or wlr-data-control-unstable-v1.
+// Unlike wl_data_device these protocols need neither a surface nor keyboard
+// focus, so they work from background processes. Events are dispatched on a
+// private thread with its own wl_display connection; all functions may be
+// called from any thread.
+namespace wayland_data_control {
+
+// True on a Wayland session whose compositor offers one of the protocols.
+// Only `Clipboard` and `Primary` selections exist there.
+bool IsAvailable(ClipboardSelection selection);
+
+// Mime types offered by the current owner.
+std::vector<std::string> GetMimeTypes(ClipboardSelection selection);
+
+bool HasMimeType(ClipboardSelection selection, const std::string &mime_type);
+
+// Reads `mime_type` from the owner's pipe into memory, reporting the bytes
+// received as `ProgressPhase::Transfer`.
+bool Read(ClipboardSelection selection, const std::string &mime_type, ClipboardData &data,
+          ProgressSink *progress = nullptr);
+
+// Moves `mime_type` from the owner's pipe into `fd` with splice(), reporting
+// the bytes moved like `Read`.
+bool ReadToFd(ClipboardSelection selection, const std::string &mime_type, int fd,
+              ProgressSink *progress = nullptr);
+
+// Passes `mime_type` on read by read, without collecting it.
+bool ReadChunks(ClipboardSelection selection, const std::string &mime_type, const ChunkConsumer &consume);
+
+// Payloads are kept in sealed memfds (or the files they were opened from)
+// and spliced into each requestor's pipe.
+using Payload = SelectionPayload;
+
+using Offer = SelectionOffer;
+
+// Takes ownership of the selection, offering every mime type of `offer`.
+bool Write(ClipboardSelection selection, const Offer &offer);
+
+// Sets an empty selection.
+bool Clear(ClipboardSelection selection);
+
+// Increases with every selection event.
+uint64_t SequenceNumber(ClipboardSelection selection);
+
+} // namespace wayland_data_control
+
+#endif //ELECTRON_CLIPBOARD_EX_WAYLAND_DATA_CONTROL_H
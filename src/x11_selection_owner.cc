@@ -0,0 +1,867 @@
+#include "x11_selection_owner.h"
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "utf8.h"
+
+namespace x11_selection_owner {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// ICCCM leaves the INCR threshold to the owner; GTK uses the largest
+// request the server takes, capped so one requestor's chunk stays short
+const size_t kMaxChunk = 256 << 10;
+// A requestor that has not deleted a chunk for this long is gone
+const std::chrono::milliseconds kTransferTimeout(10000);
+const std::chrono::milliseconds kOwnTimeout(2000);
+// How long exiting waits for the clipboard manager to copy our targets
+const std::chrono::milliseconds kStoreTimeout(5000);
+
+// Conversion state of one requestor, keyed by its window and property
+struct Transfer {
+    std::shared_ptr<SelectionPayload> payload; // Keeps `bytes` alive
+    std::string_view bytes;
+    Atom type = None;
+    size_t offset = 0;
+    Clock::time_point last_activity;
+};
+
+// A read of a target, answered by the selection owner on our window. The
+// caller blocks until it finishes, so `consume` runs while its captures
+// are alive.
+struct Conversion {
+    ChunkConsumer consume;
+    Atom selection = None;
+    Atom target = None;
+    bool incr = false;
+    std::chrono::milliseconds timeout{0};
+    Clock::time_point deadline; // Moved on with every chunk
+    std::promise<bool> result;
+};
+
+struct Ownership {
+    std::map<Atom, std::shared_ptr<SelectionPayload>> targets;
+    Time time = CurrentTime;
+    bool owned = false;
+};
+
+std::atomic<Display *> owner_display{nullptr};
+XErrorHandler previous_error_handler = nullptr;
+std::atomic<bool> error_handler_installed{false};
+
+// Requestors may be destroyed in the middle of a transfer, errors of our
+// connection are ignored. Those of other connections go to the handler
+// this one replaced, GDK's, which traps or reports them as before.
+int OnXError(Display *display, XErrorEvent *error) {
+    if (display == owner_display.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    return previous_error_handler ? previous_error_handler(display, error) : 0;
+}
+
+// Steps of an `Own` call; the caller abandons a command the owner thread
+// has not started in time, so a failed write never takes the selection later
+enum class OwnState {
+    Pending,
+    Running,
+    Abandoned,
+};
+
+struct OwnRequest {
+    std::atomic<OwnState> state{OwnState::Pending};
+    std::promise<bool> result;
+};
+
+class Owner {
+public:
+    // nullptr when no X11 display can be opened, or before
+    // InstallErrorHandler
+    static Owner *Get(bool create) {
+        static std::mutex mutex;
+        static Owner *owner = nullptr;
+        static bool attempted = false;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!attempted && create && error_handler_installed.load(std::memory_order_acquire)) {
+            attempted = true;
+            Display *display = XOpenDisplay(nullptr);
+            if (display) {
+                owner_display.store(display, std::memory_order_release);
+                owner = new Owner(display);
+                if (!owner->Start()) {
+                    delete owner;
+                    owner = nullptr;
+                } else {
+                    std::atexit(WaitForStoreAtExit);
+                }
+            }
+        }
+        return owner;
+    }
+
+    bool Own(ClipboardSelection selection, const SelectionOffer &offer) {
+        auto request = std::make_shared<OwnRequest>();
+        std::future<bool> owned = request->result.get_future();
+        Post([this, selection, offer, request]() {
+            OwnState pending = OwnState::Pending;
+            if (request->state.compare_exchange_strong(pending, OwnState::Running)) {
+                request->result.set_value(TakeOwnership(selection, offer));
+            }
+        });
+        if (owned.wait_for(kOwnTimeout) != std::future_status::ready) {
+            OwnState pending = OwnState::Pending;
+            if (request->state.compare_exchange_strong(pending, OwnState::Abandoned)) {
+                return false;
+            }
+            // Already running, its outcome is the one to report
+        }
+        return owned.get();
+    }
+
+    Window window() const {
+        return _window;
+    }
+
+    // Lets the clipboard manager finish copying the last CLIPBOARD we took
+    void WaitForStore() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stored.wait_for(lock, kStoreTimeout, [this] { return !_storing; });
+    }
+
+    bool Read(ClipboardSelection selection, const std::string &target, std::chrono::milliseconds timeout,
+              const ChunkConsumer &consume) {
+        auto conversion = std::make_shared<Conversion>();
+        conversion->consume = consume;
+        conversion->timeout = timeout;
+        std::future<bool> done = conversion->result.get_future();
+        Post([this, selection, target, conversion]() {
+            StartConversion(selection, target, conversion);
+        });
+        // Conversions that stall are expired by the owner thread
+        return done.get();
+    }
+
+    void Release(ClipboardSelection selection) {
+        Post([this, selection]() {
+            Ownership &ownership = _ownerships[static_cast<size_t>(selection)];
+            if (ownership.owned) {
+                XSetSelectionOwner(_display, _selection_atoms[static_cast<size_t>(selection)], None,
+                                   ownership.time);
+                ownership = Ownership();
+            }
+        });
+    }
+
+    ServingStats Stats() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+private:
+    explicit Owner(Display *display) : _display(display) {}
+
+    static void WaitForStoreAtExit() {
+        if (Owner *owner = Get(false)) {
+            owner->WaitForStore();
+        }
+    }
+
+    bool Start() {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+            return false;
+        }
+        _wake_read = fds[0];
+        _wake_write = fds[1];
+
+        XSetWindowAttributes attributes = {};
+        attributes.event_mask = PropertyChangeMask;
+        _window = XCreateWindow(_display, DefaultRootWindow(_display), -10, -10, 1, 1, 0, CopyFromParent,
+                                InputOnly, CopyFromParent, CWEventMask, &attributes);
+        // Read by the backend's owner statistics like any other owner's
+        long pid = static_cast<long>(getpid());
+        XChangeProperty(_display, _window, XInternAtom(_display, "_NET_WM_PID", False), XA_CARDINAL, 32,
+                        PropModeReplace, reinterpret_cast<unsigned char *>(&pid), 1);
+
+        _selection_atoms[0] = XInternAtom(_display, "CLIPBOARD", False);
+        _selection_atoms[1] = XA_PRIMARY;
+        _selection_atoms[2] = XA_SECONDARY;
+        _targets_atom = XInternAtom(_display, "TARGETS", False);
+        _timestamp_atom = XInternAtom(_display, "TIMESTAMP", False);
+        _incr_atom = XInternAtom(_display, "INCR", False);
+        _multiple_atom = XInternAtom(_display, "MULTIPLE", False);
+        _atom_pair_atom = XInternAtom(_display, "ATOM_PAIR", False);
+        _utf8_atom = XInternAtom(_display, "UTF8_STRING", False);
+        _text_atom = XInternAtom(_display, "TEXT", False);
+        _time_property = XInternAtom(_display, "_CLIPBOARD_EX_TIME", False);
+        _manager_atom = XInternAtom(_display, "CLIPBOARD_MANAGER", False);
+        _save_targets_atom = XInternAtom(_display, "SAVE_TARGETS", False);
+
+        // Requests are limited to this many 4 byte units, minus the header
+        size_t max_request = static_cast<size_t>(XMaxRequestSize(_display)) * 4;
+        _chunk_size = std::min(kMaxChunk, max_request > 1024 ? max_request - 512 : max_request / 2);
+        XFlush(_display);
+
+        std::thread(&Owner::Run, this).detach();
+        return true;
+    }
+
+    void Post(std::function<void()> command) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _commands.push_back(std::move(command));
+        }
+        char byte = 0;
+        ssize_t written = write(_wake_write, &byte, 1);
+        (void)written; // A full pipe already wakes the thread
+    }
+
+    void Run() {
+        for (;;) {
+            while (XPending(_display) > 0) {
+                XEvent event;
+                XNextEvent(_display, &event);
+                Handle(event);
+            }
+
+            std::vector<std::function<void()>> commands;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                commands.swap(_commands);
+            }
+            for (auto &command : commands) {
+                command();
+            }
+            ExpireTransfers();
+            ExpireConversions();
+            XFlush(_display);
+            if (XPending(_display) > 0) {
+                continue;
+            }
+
+            pollfd fds[2] = {
+                {ConnectionNumber(_display), POLLIN, 0},
+                {_wake_read, POLLIN, 0},
+            };
+            poll(fds, 2, _transfers.empty() && _conversions.empty() ? -1 : 250);
+            if (fds[1].revents & POLLIN) {
+                char buffer[64];
+                while (read(_wake_read, buffer, sizeof(buffer)) > 0) {
+                }
+            }
+        }
+    }
+
+    static Bool IsTimeEvent(Display *display, XEvent *event, XPointer arg) {
+        (void)display;
+        const Owner *owner = reinterpret_cast<const Owner *>(arg);
+        return event->type == PropertyNotify && event->xproperty.window == owner->_window &&
+               event->xproperty.atom == owner->_time_property;
+    }
+
+    // A server timestamp for XSetSelectionOwner, ICCCM forbids CurrentTime.
+    // Other events, such as INCR chunks of conversions, stay queued.
+    Time ServerTime() {
+        XChangeProperty(_display, _window, _time_property, XA_STRING, 8, PropModeAppend, nullptr, 0);
+        XEvent event;
+        XIfEvent(_display, &event, IsTimeEvent, reinterpret_cast<XPointer>(this));
+        return event.xproperty.time;
+    }
+
+    bool TakeOwnership(ClipboardSelection selection, const SelectionOffer &offer) {
+        size_t index = static_cast<size_t>(selection);
+        Ownership ownership;
+        std::vector<char *> names;
+        for (const auto &entry : offer) {
+            names.push_back(const_cast<char *>(entry.first.c_str()));
+        }
+        std::vector<Atom> atoms(names.size());
+        if (!names.empty() &&
+            !XInternAtoms(_display, names.data(), static_cast<int>(names.size()), False, atoms.data())) {
+            return false;
+        }
+        for (size_t i = 0; i < offer.size(); ++i) {
+            if (offer[i].second) {
+                ownership.targets.emplace(atoms[i], offer[i].second);
+            }
+        }
+        AddLegacyTextTargets(ownership);
+
+        ownership.time = ServerTime();
+        XSetSelectionOwner(_display, _selection_atoms[index], _window, ownership.time);
+        if (XGetSelectionOwner(_display, _selection_atoms[index]) != _window) {
+            return false;
+        }
+        ownership.owned = true;
+        Time time = ownership.time;
+        _ownerships[index] = std::move(ownership);
+        if (selection == ClipboardSelection::Clipboard) {
+            StartStore(time);
+        }
+        return true;
+    }
+
+    // freedesktop ClipboardManager: a running manager converts our targets
+    // (served like any other requestor's) and takes CLIPBOARD over, so it
+    // outlives the process the way gtk_clipboard_store makes GTK's do. No
+    // target list is given, the manager saves what it wants. Exiting waits
+    // for it in WaitForStore.
+    void StartStore(Time time) {
+        bool manager = XGetSelectionOwner(_display, _manager_atom) != None;
+        if (manager) {
+            XConvertSelection(_display, _manager_atom, _save_targets_atom, None, _window, time);
+            _store_time = time;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _storing = manager;
+        _stored.notify_all();
+    }
+
+    void FinishStore() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _storing = false;
+        _stored.notify_all();
+    }
+
+    // Requestors predating UTF8_STRING ask for STRING, which is Latin-1, or
+    // TEXT, which the owner answers in an encoding of its choice: UTF-8 here
+    void AddLegacyTextTargets(Ownership &ownership) {
+        auto utf8 = ownership.targets.find(_utf8_atom);
+        if (utf8 == ownership.targets.end()) {
+            return;
+        }
+        std::shared_ptr<SelectionPayload> source = utf8->second;
+        ownership.targets.emplace(_text_atom, source);
+        ownership.targets.emplace(XA_STRING, SelectionPayload::Lazy([source]() {
+            std::shared_ptr<SelectionPayload> latin1;
+            SelectionPayload *resolved = source->Resolve();
+            std::string_view bytes = resolved ? resolved->Bytes() : std::string_view();
+            if (resolved && (!bytes.empty() || resolved->size() == 0)) {
+                std::string converted(bytes.size(), '\0');
+                converted.resize(Utf8ToLatin1(bytes.data(), bytes.size(), &converted[0]));
+                latin1 = SelectionPayload::FromBytes(converted.data(), converted.size());
+            }
+            return latin1;
+        }));
+    }
+
+    // Type of the property a target is answered with
+    Atom ReplyType(Atom target) const {
+        return target == _text_atom ? _utf8_atom : target;
+    }
+
+    Ownership *FindOwnership(Atom selection) {
+        for (size_t i = 0; i < 3; ++i) {
+            if (_selection_atoms[i] == selection) {
+                return &_ownerships[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void Handle(const XEvent &event) {
+        switch (event.type) {
+            case SelectionRequest: {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    ++_stats.requests;
+                }
+                HandleRequest(event.xselectionrequest);
+                break;
+            }
+            case SelectionClear: {
+                Ownership *ownership = FindOwnership(event.xselectionclear.selection);
+                if (ownership && ownership->owned && event.xselectionclear.time >= ownership->time) {
+                    *ownership = Ownership();
+                }
+                break;
+            }
+            case SelectionNotify:
+                if (event.xselection.requestor == _window) {
+                    OnSelectionNotify(event.xselection);
+                }
+                break;
+            case PropertyNotify:
+                if (event.xproperty.state == PropertyDelete) {
+                    auto it = _transfers.find(std::make_pair(event.xproperty.window, event.xproperty.atom));
+                    if (it != _transfers.end()) {
+                        SendChunk(it);
+                    }
+                } else if (event.xproperty.window == _window) {
+                    auto it = _conversions.find(event.xproperty.atom);
+                    if (it != _conversions.end() && it->second->incr) {
+                        ReceiveChunk(it);
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void HandleRequest(const XSelectionRequestEvent &request) {
+        // Obsolete requestors leave the property to the owner
+        Atom property = request.property == None ? request.target : request.property;
+        Ownership *ownership = FindOwnership(request.selection);
+        bool current = ownership && ownership->owned &&
+                       (request.time == CurrentTime || request.time >= ownership->time);
+        if (current && Defer(*ownership, request)) {
+            return;
+        }
+        bool converted = current && Convert(*ownership, request.requestor, request.target, property);
+
+        XSelectionEvent reply = {};
+        reply.type = SelectionNotify;
+        reply.display = request.display;
+        reply.requestor = request.requestor;
+        reply.selection = request.selection;
+        reply.target = request.target;
+        reply.time = request.time;
+        reply.property = converted ? property : None;
+        XSendEvent(_display, request.requestor, False, NoEventMask, reinterpret_cast<XEvent *>(&reply));
+    }
+
+    // A lazy payload (a PNG encode, a uri-list of a temporary file) is
+    // produced on a thread of its own, and the requests for it are answered
+    // once it is ready. Meanwhile this thread keeps serving other requests
+    // and transfers. Requestors simply wait longer for SelectionNotify.
+    // MULTIPLE waits for each lazy target it names in turn.
+    bool Defer(const Ownership &ownership, const XSelectionRequestEvent &request) {
+        std::vector<Atom> targets = {request.target};
+        if (request.target == _multiple_atom) {
+            std::vector<long> pairs;
+            targets.clear();
+            if (ReadMultiplePairs(request.requestor, request.property, pairs)) {
+                for (size_t i = 0; i < pairs.size(); i += 2) {
+                    targets.push_back(static_cast<Atom>(pairs[i]));
+                }
+            }
+        }
+        std::shared_ptr<SelectionPayload> payload;
+        for (Atom target : targets) {
+            auto it = ownership.targets.find(target);
+            if (it != ownership.targets.end() && it->second->NeedsProducing()) {
+                payload = it->second;
+                break;
+            }
+        }
+        if (!payload) {
+            return false;
+        }
+        std::vector<XSelectionRequestEvent> &waiting = _rendering[payload];
+        waiting.push_back(request);
+        if (waiting.size() == 1) {
+            std::thread([this, payload]() {
+                Clock::time_point start = Clock::now();
+                payload->Resolve();
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+                Post([this, payload, elapsed]() {
+                    FinishRendering(payload, static_cast<uint32_t>(elapsed.count()));
+                });
+            }).detach();
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_stats.deferred;
+        _stats.rendering = static_cast<uint32_t>(_rendering.size());
+        return true;
+    }
+
+    void FinishRendering(const std::shared_ptr<SelectionPayload> &payload, uint32_t render_ms) {
+        auto it = _rendering.find(payload);
+        if (it == _rendering.end()) {
+            return;
+        }
+        std::vector<XSelectionRequestEvent> waiting = std::move(it->second);
+        _rendering.erase(it);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.rendering = static_cast<uint32_t>(_rendering.size());
+            _stats.max_render_ms = std::max(_stats.max_render_ms, render_ms);
+        }
+        // The selection may have changed hands meanwhile, so the requests are
+        // checked again; a new owner's refusal is answered like any other
+        for (const auto &request : waiting) {
+            HandleRequest(request);
+        }
+    }
+
+    // The (target, property) pairs of a MULTIPLE request
+    bool ReadMultiplePairs(Window requestor, Atom property, std::vector<long> &pairs) {
+        Atom type = None;
+        int format = 0;
+        unsigned long n_items = 0;
+        unsigned long bytes_after = 0;
+        unsigned char *data = nullptr;
+        if (property == None ||
+            XGetWindowProperty(_display, requestor, property, 0, 0x10000, False, AnyPropertyType, &type, &format,
+                               &n_items, &bytes_after, &data) != Success) {
+            return false;
+        }
+        bool ok = data && format == 32 && n_items % 2 == 0;
+        if (ok) {
+            const long *items = reinterpret_cast<const long *>(data); // 32 bit items are stored as long
+            pairs.assign(items, items + n_items);
+        }
+        if (data) {
+            XFree(data);
+        }
+        return ok;
+    }
+
+    // ICCCM 2.6.2: each pair is converted like a request of its own, those
+    // that fail get their property replaced by None in the list
+    bool ConvertMultiple(const Ownership &ownership, Window requestor, Atom property) {
+        std::vector<long> pairs;
+        if (!ReadMultiplePairs(requestor, property, pairs)) {
+            return false;
+        }
+        for (size_t i = 0; i < pairs.size(); i += 2) {
+            auto target = static_cast<Atom>(pairs[i]);
+            auto target_property = static_cast<Atom>(pairs[i + 1]);
+            if (target == _multiple_atom || target_property == None ||
+                !Convert(ownership, requestor, target, target_property)) {
+                pairs[i + 1] = None;
+            }
+        }
+        XChangeProperty(_display, requestor, property, _atom_pair_atom, 32, PropModeReplace,
+                        reinterpret_cast<unsigned char *>(pairs.data()), static_cast<int>(pairs.size()));
+        return true;
+    }
+
+    bool Convert(const Ownership &ownership, Window requestor, Atom target, Atom property) {
+        if (target == _multiple_atom) {
+            return ConvertMultiple(ownership, requestor, property);
+        }
+        if (target == _targets_atom) {
+            std::vector<long> atoms = {static_cast<long>(_targets_atom), static_cast<long>(_timestamp_atom),
+                                       static_cast<long>(_multiple_atom)};
+            for (const auto &entry : ownership.targets) {
+                atoms.push_back(static_cast<long>(entry.first));
+            }
+            XChangeProperty(_display, requestor, property, XA_ATOM, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char *>(atoms.data()), static_cast<int>(atoms.size()));
+            return true;
+        }
+        if (target == _timestamp_atom) {
+            long time = static_cast<long>(ownership.time);
+            XChangeProperty(_display, requestor, property, XA_INTEGER, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char *>(&time), 1);
+            return true;
+        }
+
+        auto it = ownership.targets.find(target);
+        if (it == ownership.targets.end()) {
+            return false;
+        }
+        // Already produced, see Defer
+        SelectionPayload *payload = it->second->Resolve();
+        std::string_view bytes = payload ? payload->Bytes() : std::string_view();
+        if (!payload || (bytes.empty() && payload->size() > 0)) {
+            return false;
+        }
+
+        if (bytes.size() < _chunk_size) {
+            XChangeProperty(_display, requestor, property, ReplyType(target), 8, PropModeReplace,
+                            reinterpret_cast<const unsigned char *>(bytes.data()), static_cast<int>(bytes.size()));
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.bytes += bytes.size();
+            return true;
+        }
+
+        // The requestor deletes the INCR property once it has seen the
+        // reply, which asks for the first chunk
+        XSelectInput(_display, requestor, PropertyChangeMask);
+        long size = static_cast<long>(bytes.size());
+        XChangeProperty(_display, requestor, property, _incr_atom, 32, PropModeReplace,
+                        reinterpret_cast<unsigned char *>(&size), 1);
+        Transfer &transfer = _transfers[std::make_pair(requestor, property)];
+        transfer.payload = it->second;
+        transfer.bytes = bytes;
+        transfer.type = ReplyType(target);
+        transfer.offset = 0;
+        transfer.last_activity = Clock::now();
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_stats.incr_transfers;
+        _stats.active_transfers = static_cast<uint32_t>(_transfers.size());
+        _stats.max_active_transfers = std::max(_stats.max_active_transfers, _stats.active_transfers);
+        return true;
+    }
+
+    using ConversionMap = std::map<Atom, std::shared_ptr<Conversion>>;
+
+    void StartConversion(ClipboardSelection selection, const std::string &target,
+                         const std::shared_ptr<Conversion> &conversion) {
+        conversion->selection = _selection_atoms[static_cast<size_t>(selection)];
+        conversion->target = XInternAtom(_display, target.c_str(), False);
+        conversion->deadline = Clock::now() + conversion->timeout;
+        Atom property;
+        if (_free_properties.empty()) {
+            std::string name = "_CLIPBOARD_EX_READ" + std::to_string(_property_serial++);
+            property = XInternAtom(_display, name.c_str(), False);
+        } else {
+            property = _free_properties.back();
+            _free_properties.pop_back();
+        }
+        XDeleteProperty(_display, _window, property);
+        XConvertSelection(_display, conversion->selection, conversion->target, property, _window, CurrentTime);
+        _conversions[property] = conversion;
+    }
+
+    void OnSelectionNotify(const XSelectionEvent &event) {
+        if (event.selection == _manager_atom && event.target == _save_targets_atom) {
+            // Saved or refused, either way the manager is done. The reply
+            // echoes the request's time, one for an older store is ignored.
+            if (event.time == CurrentTime || event.time == _store_time) {
+                FinishStore();
+            }
+            return;
+        }
+        auto it = _conversions.end();
+        if (event.property != None) {
+            it = _conversions.find(event.property);
+        } else {
+            // A refusal names no property, it answers the first matching read
+            it = std::find_if(_conversions.begin(), _conversions.end(),
+                              [&event](const ConversionMap::value_type &entry) {
+                                  return !entry.second->incr && entry.second->selection == event.selection &&
+                                         entry.second->target == event.target;
+                              });
+        }
+        if (it == _conversions.end() || it->second->incr) {
+            return;
+        }
+        if (event.property == None) {
+            FinishConversion(it, false, false);
+            return;
+        }
+        Atom type = None;
+        size_t size = 0;
+        if (!ReadProperty(it->first, *it->second, type, size)) {
+            FinishConversion(it, false, true);
+        } else if (type == _incr_atom) {
+            // Deleting the INCR property asked the owner for the first chunk
+            it->second->incr = true;
+            it->second->deadline = Clock::now() + it->second->timeout;
+        } else {
+            FinishConversion(it, true, true);
+        }
+    }
+
+    // The zero length chunk after the data ends the transfer
+    void ReceiveChunk(ConversionMap::iterator it) {
+        Atom type = None;
+        size_t size = 0;
+        if (!ReadProperty(it->first, *it->second, type, size)) {
+            FinishConversion(it, false, true);
+        } else if (size == 0) {
+            FinishConversion(it, true, true);
+        } else {
+            it->second->deadline = Clock::now() + it->second->timeout;
+        }
+    }
+
+    // Reads the property in pieces and deletes it, which lets an INCR owner
+    // write the next chunk. Only the INCR announcement itself is held back.
+    bool ReadProperty(Atom property, Conversion &conversion, Atom &type, size_t &size) {
+        bool ok = true;
+        long offset = 0;
+        for (;;) {
+            int format = 0;
+            unsigned long n_items = 0;
+            unsigned long bytes_after = 0;
+            unsigned char *data = nullptr;
+            if (XGetWindowProperty(_display, _window, property, offset, static_cast<long>(kMaxChunk / 4), False,
+                                   AnyPropertyType, &type, &format, &n_items, &bytes_after, &data) != Success) {
+                ok = false;
+                break;
+            }
+            ok = type != None;
+            if (ok && type != _incr_atom && n_items > 0) {
+                ok = Deliver(conversion, data, format, n_items, size);
+            }
+            if (data) {
+                XFree(data);
+            }
+            if (!ok || bytes_after == 0 || type == _incr_atom) {
+                break;
+            }
+            offset += static_cast<long>(n_items * static_cast<unsigned long>(format) / 32);
+        }
+        XDeleteProperty(_display, _window, property);
+        return ok;
+    }
+
+    static bool Deliver(Conversion &conversion, const unsigned char *data, int format, unsigned long n_items,
+                        size_t &size) {
+        if (format != 32) {
+            size_t length = n_items * static_cast<size_t>(format / 8);
+            size += length;
+            return conversion.consume(reinterpret_cast<const char *>(data), length);
+        }
+        // Xlib hands 32 bit items over as longs, they are passed on as 4 bytes
+        std::vector<uint32_t> items(n_items);
+        for (unsigned long i = 0; i < n_items; ++i) {
+            items[i] = static_cast<uint32_t>(reinterpret_cast<const unsigned long *>(data)[i]);
+        }
+        size += items.size() * 4;
+        return conversion.consume(reinterpret_cast<const char *>(items.data()), items.size() * 4);
+    }
+
+    // The property is reused unless a late reply could still arrive on it
+    void FinishConversion(ConversionMap::iterator it, bool ok, bool reuse_property) {
+        it->second->result.set_value(ok);
+        if (reuse_property) {
+            _free_properties.push_back(it->first);
+        }
+        _conversions.erase(it);
+    }
+
+    void ExpireConversions() {
+        Clock::time_point now = Clock::now();
+        for (auto it = _conversions.begin(); it != _conversions.end();) {
+            auto next = std::next(it);
+            if (now > it->second->deadline) {
+                FinishConversion(it, false, false);
+            }
+            it = next;
+        }
+    }
+
+    using TransferMap = std::map<std::pair<Window, Atom>, Transfer>;
+
+    // The zero length chunk after the data ends the transfer
+    void SendChunk(TransferMap::iterator it) {
+        Transfer &transfer = it->second;
+        size_t size = std::min(_chunk_size, transfer.bytes.size() - transfer.offset);
+        XChangeProperty(_display, it->first.first, it->first.second, transfer.type, 8, PropModeReplace,
+                        reinterpret_cast<const unsigned char *>(transfer.bytes.data() + transfer.offset),
+                        static_cast<int>(size));
+        transfer.offset += size;
+        transfer.last_activity = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.bytes += size;
+        }
+        if (size == 0) {
+            EndTransfer(it);
+        }
+    }
+
+    void EndTransfer(TransferMap::iterator it) {
+        Window requestor = it->first.first;
+        _transfers.erase(it);
+        bool others = std::any_of(_transfers.begin(), _transfers.end(),
+                                  [requestor](const TransferMap::value_type &entry) {
+                                      return entry.first.first == requestor;
+                                  });
+        // Our own window keeps its mask for conversions and timestamps
+        if (!others && requestor != _window) {
+            XSelectInput(_display, requestor, NoEventMask);
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.active_transfers = static_cast<uint32_t>(_transfers.size());
+    }
+
+    void ExpireTransfers() {
+        Clock::time_point now = Clock::now();
+        for (auto it = _transfers.begin(); it != _transfers.end();) {
+            auto next = std::next(it);
+            if (now - it->second.last_activity > kTransferTimeout) {
+                EndTransfer(it);
+                std::lock_guard<std::mutex> lock(_mutex);
+                ++_stats.timeouts;
+            }
+            it = next;
+        }
+    }
+
+    Display *_display;
+    Window _window = None;
+    int _wake_read = -1;
+    int _wake_write = -1;
+    size_t _chunk_size = 0;
+    Atom _selection_atoms[3] = {None, None, None};
+    Atom _targets_atom = None;
+    Atom _timestamp_atom = None;
+    Atom _incr_atom = None;
+    Atom _multiple_atom = None;
+    Atom _atom_pair_atom = None;
+    Atom _utf8_atom = None;
+    Atom _text_atom = None;
+    Atom _time_property = None;
+    Atom _manager_atom = None;
+    Atom _save_targets_atom = None;
+
+    // Only touched by the owner thread
+    Ownership _ownerships[3];
+    TransferMap _transfers;
+    ConversionMap _conversions;
+    std::vector<Atom> _free_properties;
+    unsigned _property_serial = 0;
+    Time _store_time = CurrentTime;
+    // Requests waiting for a lazy payload, keyed by the payload
+    std::map<std::shared_ptr<SelectionPayload>, std::vector<XSelectionRequestEvent>> _rendering;
+
+    // Guards the command queue, the statistics and the store state
+    std::mutex _mutex;
+    std::vector<std::function<void()>> _commands;
+    ServingStats _stats;
+    bool _storing = false;
+    std::condition_variable _stored;
+};
+
+} // namespace
+
+void InstallErrorHandler() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        previous_error_handler = XSetErrorHandler(OnXError);
+        error_handler_installed.store(true, std::memory_order_release);
+    });
+}
+
+bool Own(ClipboardSelection selection, const SelectionOffer &offer) {
+    Owner *owner = Owner::Get(true);
+    return owner && owner->Own(selection, offer);
+}
+
+void Release(ClipboardSelection selection) {
+    if (Owner *owner = Owner::Get(false)) {
+        owner->Release(selection);
+    }
+}
+
+bool ReadTarget(ClipboardSelection selection, const std::string &target, std::chrono::milliseconds timeout,
+                const ChunkConsumer &consume) {
+    Owner *owner = Owner::Get(true);
+    return owner && owner->Read(selection, target, timeout, consume);
+}
+
+unsigned long OwnerWindow() {
+    Owner *owner = Owner::Get(false);
+    return owner ? owner->window() : None;
+}
+
+ServingStats GetStats() {
+    Owner *owner = Owner::Get(false);
+    return owner ? owner->Stats() : ServingStats();
+}
+
+} // namespace x11_selection_owner
@@ -0,0 +1,53 @@
+#ifndef ELECTRON_CLIPBOARD_EX_X11_SELECTION_OWNER_H
+#define ELECTRON_CLIPBOARD_EX_X11_SELECTION_OWNER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "clipboard.h"
+#include "selection_payload.h"
+
+// Owns X11 selections from a private Xlib connection and thread instead of
+// GTK's main loop, which answers requestors one at a time. Every requestor
+// gets its own conversion state: targets below the server's request size
+// are answered with a single property, larger ones with an INCR transfer
+// whose next chunk is written as soon as that requestor deletes the
+// previous one. Transfers interleave, a slow requestor never holds up the
+// others, and every chunk is written straight from the shared immutable
+// payload. Reads of other owners' targets share the connection. All
+// functions may be called from any thread.
+namespace x11_selection_owner {
+
+// Xlib's error handler is process-wide. This installs ours once, to be
+// called right after GTK opened its display: errors of the private
+// connection are ignored, all others are handed to the handler it replaces
+// (GDK's, or the host's). Until then `Own` and `ReadTarget` fail.
+void InstallErrorHandler();
+
+// Takes ownership of the selection with every target of `offer`. False if
+// no X11 display can be opened, another client won the race, or the owner
+// thread did not get to it in time; the ownership is then never taken.
+// CLIPBOARD is handed to a running clipboard manager, which keeps it after
+// the process exits; exiting waits a few seconds for the manager's copy.
+bool Own(ClipboardSelection selection, const SelectionOffer &offer);
+
+// Gives the selection up if it is still ours. Transfers in progress finish.
+void Release(ClipboardSelection selection);
+
+// Converts `target` of the selection's current owner on the same
+// connection and passes the property, or every INCR chunk as it arrives,
+// to `consume`; the target is never held whole. False if the owner refuses
+// or stops answering for `timeout`. Not for selections this process owns
+// through GTK, whose replies need the main loop the caller blocks.
+bool ReadTarget(ClipboardSelection selection, const std::string &target, std::chrono::milliseconds timeout,
+                const ChunkConsumer &consume);
+
+// The window selections are owned with, None before the owner started.
+unsigned long OwnerWindow();
+
+// Counters since the owner started, all 0 before the first `Own`.
+ServingStats GetStats();
+
+} // namespace x11_selection_owner
+
+#endif //ELECTRON_CLIPBOARD_EX_X11_SELECTION_OWNER_H
@@ -1,4 +1,4 @@
-const {readFilePaths, writeFilePaths} = require('..');
+const {readFilePaths, writeFilePaths, readFilePathList, PathList} = require('..');
 
 const getMockPaths = () => {
   if (process.platform === 'win32') {
@@ -48,3 +48,55 @@ test('write non-string path -- throw', () => {
     writeFilePaths([1]);
   }).toThrow();
 });
+
+test('write invalid selection -- throw', () => {
+  expect(() => {
+    writeFilePaths(getMockPaths(), {selection: 'tertiary'});
+  }).toThrow();
+});
+
+(process.platform === 'linux' ? test : test.skip)('write & read primary selection', () => {
+  const paths = getMockPaths();
+  writeFilePaths([]);
+  writeFilePaths(paths, {selection: 'primary'});
+  expect(readFilePaths({selection: 'primary'})).toEqual(paths);
+  expect(readFilePaths()).toEqual([]);
+});
+
+test('write & read a PathList', () => {
+  const paths = getMockPaths();
+  const written = writeFilePaths(new PathList(paths));
+  expect(written).toBeInstanceOf(PathList);
+  expect(written.toArray()).toEqual(paths);
+  expect(readFilePaths()).toEqual(paths);
+  expect([...readFilePathList()]).toEqual(paths);
+});
+
+test('PathList -- access and packing', () => {
+  const paths = [];
+  for (let i = 0; i < 5000; i++) {
+    paths.push(`/srv/assets/set ${Math.floor(i / 100)}/é_${i}.png`);
+  }
+  const list = new PathList(paths);
+  expect(list.length).toBe(paths.length);
+  expect(list.get(4321)).toBe(paths[4321]);
+  expect(list.get(paths.length)).toBeUndefined();
+  expect(list.slice(-3)).toEqual(paths.slice(-3));
+  expect([...list]).toEqual(paths);
+  expect(list.commonPrefix()).toBe('/srv/assets/set ');
+  expect(list.encodedBytes).toBeLessThan(paths.join('').length / 2);
+
+  const restored = PathList.fromPacked(list.toPacked());
+  expect(restored.toArray()).toEqual(paths);
+  expect(() => PathList.fromPacked(Buffer.from('junk'))).toThrow();
+});
+
+(process.platform === 'linux' ? test : test.skip)('write & read a file list larger than one X request', () => {
+  const paths = [];
+  for (let i = 0; i < 20000; i++) {
+    paths.push(`/home/user/Pictures/holiday ${Math.floor(i / 50)}/IMG_${i}.jpg`);
+  }
+  writeFilePaths(paths);
+  expect(readFilePaths()).toEqual(paths);
+  expect(readFilePaths({selection: 'clipboard'})).toEqual(paths);
+});
@@ -0,0 +1,119 @@
+const {
+  setBackend, getBackend, clear, readText, writeText, readRich, writeRich,
+  readFilePaths, writeFilePaths, getSequenceNumber,
+} = require('..');
+
+let previousBackend;
+
+beforeAll(() => {
+  previousBackend = getBackend();
+  setBackend('memory');
+});
+
+afterAll(() => {
+  setBackend(previousBackend);
+});
+
+beforeEach(() => {
+  clear();
+  clear({selection: 'primary'});
+});
+
+test('memory -- selections are independent', () => {
+  expect(writeText('clipboard')).toBe(true);
+  expect(writeText('primary', {selection: 'primary'})).toBe(true);
+  expect(readText()).toBe('clipboard');
+  expect(readText({selection: 'primary'})).toBe('primary');
+});
+
+test('memory -- flavors', () => {
+  writeFilePaths(['/a/b.txt', '/c.png']);
+  expect(readFilePaths()).toEqual(['/a/b.txt', '/c.png']);
+  expect(readText()).toBe('/a/b.txt\n/c.png');
+
+  expect(writeRich({html: '<p>Hello <b>world</b></p>'})).toBe(true);
+  expect(readRich()).toEqual({html: '<p>Hello <b>world</b></p>', text: 'Hello world'});
+  expect(readFilePaths()).toEqual([]);
+});
+
+test('memory -- sequence number', () => {
+  const before = getSequenceNumber();
+  writeText('one');
+  writeText('two');
+  expect(getSequenceNumber()).toBe(before + 2);
+  expect(getSequenceNumber({selection: 'primary'})).not.toBe(before + 2);
+});
+
+test('set unknown backend -- throw', () => {
+  expect(() => setBackend('x11')).toThrow();
+});
+
+test('memory -- image history dedupes a repeated image', () => {
+  const {putImageSync, createImageHistory} = require('..');
+  const history = createImageHistory({tileSize: 16});
+  expect(putImageSync(`${__dirname}/data/image.png`)).toBe(true);
+  const first = history.add();
+  const second = history.add();
+  expect(first.newTiles).toBeGreaterThan(0);
+  expect(second.newTiles).toBe(0);
+  expect(history.changedRegions(second.id, first.id)).toEqual([]);
+  const {width, height, data} = history.get(second.id);
+  expect([width, height]).toEqual([first.width, first.height]);
+  expect(data.length).toBe(width * height * 4);
+  expect(history.stats().entries).toBe(2);
+  expect(history.remove(first.id)).toBe(true);
+  expect(history.get(first.id)).toBeNull();
+});
+
+test('memory -- saveImageTransformed rotates the decoded image', async () => {
+  const {putImageSync, saveImageTransformed, createImageHistory} = require('..');
+  const os = require('os');
+  const path = require('path');
+  const history = createImageHistory();
+  expect(putImageSync(`${__dirname}/data/image.png`)).toBe(true);
+  const original = history.add();
+
+  const target = path.join(os.tmpdir(), `clipboard-transformed-${process.pid}.png`);
+  expect(await saveImageTransformed(target, {rotate: 90, flipHorizontal: true})).toBe(true);
+  expect(putImageSync(target)).toBe(true);
+  const rotated = history.add();
+  expect([rotated.width, rotated.height]).toEqual([original.height, original.width]);
+  require('fs').unlinkSync(target);
+
+  await expect(saveImageTransformed(target, {rotate: 45})).rejects.toThrow();
+});
+
+test('memory -- readImageShared returns BGRA pixels', () => {
+  const {putImageSync, readImageShared, createImageHistory} = require('..');
+  expect(readImageShared()).toBeNull();
+  expect(putImageSync(`${__dirname}/data/image.png`)).toBe(true);
+  const history = createImageHistory();
+  const {width, height, data: rgba} = history.get(history.add().id);
+  const image = readImageShared({premultiplied: false, fd: process.platform !== 'win32'});
+  expect(image.stride).toBe(image.width * 4);
+  expect(image.data.byteLength).toBe(image.stride * image.height);
+  const bgra = new Uint8Array(image.data);
+  expect([bgra[0], bgra[1], bgra[2], bgra[3]]).toEqual([rgba[2], rgba[1], rgba[0], rgba[3]]);
+  expect([image.width, image.height]).toEqual([width, height]);
+  if (process.platform !== 'win32') {
+    expect(require('fs').fstatSync(image.fd).size).toBe(image.data.byteLength);
+    require('fs').closeSync(image.fd);
+  } else {
+    expect(image.fd).toBeNull();
+  }
+});
+
+test('memory -- targetDigest is cached until the content changes', () => {
+  const {targetDigest} = require('..');
+  expect(writeText('abc')).toBe(true);
+  const first = targetDigest('text/plain');
+  expect(first).toEqual({digest: '44bc2cf5ad770999', size: 3, cached: false});
+  expect(targetDigest('text/plain')).toEqual({...first, cached: true});
+  expect(targetDigest('text/html')).toBeNull();
+
+  expect(writeText('abd')).toBe(true);
+  const second = targetDigest('text/plain');
+  expect(second.cached).toBe(false);
+  expect(second.digest).not.toBe(first.digest);
+  expect(() => targetDigest()).toThrow();
+});
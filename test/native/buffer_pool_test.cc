@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "buffer_pool.h"
+#include "check.h"
+
+void TestReuse() {
+    BufferPoolStats before = GetBufferPoolStats();
+    char *first = nullptr;
+    {
+        PooledBuffer buffer(3 << 20);
+        CHECK(buffer.data() != nullptr);
+        CHECK(buffer.capacity() >= (3u << 20));
+        // Huge page sized buffers are 2 MiB aligned
+        CHECK(reinterpret_cast<uintptr_t>(buffer.data()) % (2 << 20) == 0);
+        memset(buffer.data(), 0xab, buffer.capacity());
+        first = buffer.data();
+    }
+    BufferPoolStats released = GetBufferPoolStats();
+    CHECK(released.retained_buffers == before.retained_buffers + 1);
+
+    PooledBuffer again((3 << 20) - 100);
+    CHECK(again.data() == first);
+    BufferPoolStats after = GetBufferPoolStats();
+    CHECK(after.acquires == before.acquires + 2);
+    CHECK(after.hits == before.hits + 1);
+    CHECK(after.retained_buffers == before.retained_buffers);
+}
+
+void TestSmall() {
+    PooledBuffer buffer(10);
+    CHECK(buffer.data() != nullptr);
+    CHECK(buffer.capacity() >= 10);
+    CHECK(reinterpret_cast<uintptr_t>(buffer.data()) % 64 == 0);
+}
+
+void TestGrow() {
+    PooledBuffer buffer(100);
+    memcpy(buffer.data(), "pooled", 6);
+    CHECK(buffer.Grow(5 << 20, 6));
+    CHECK(buffer.capacity() >= (5u << 20));
+    CHECK(memcmp(buffer.data(), "pooled", 6) == 0);
+    size_t capacity = buffer.capacity();
+    CHECK(buffer.Grow(100, 6));
+    CHECK(buffer.capacity() == capacity);
+}
+
+void TestMove() {
+    PooledBuffer buffer(1 << 20);
+    char *data = buffer.data();
+    PooledBuffer moved(std::move(buffer));
+    CHECK(moved.data() == data);
+    CHECK(buffer.data() == nullptr);
+    PooledBuffer *heap = new PooledBuffer(std::move(moved));
+    PooledBuffer::Delete(heap);
+}
+
+void TestRetainedCap() {
+    // Only a few buffers of a class are kept, the rest is freed
+    BufferPoolStats before = GetBufferPoolStats();
+    {
+        PooledBuffer buffers[8];
+        for (PooledBuffer &buffer : buffers) {
+            buffer = PooledBuffer(96 << 10);
+        }
+    }
+    BufferPoolStats after = GetBufferPoolStats();
+    CHECK(after.retained_buffers - before.retained_buffers <= 4);
+}
+
+void TestOversized() {
+    PooledBuffer buffer(200u << 20);
+    CHECK(buffer.data() != nullptr);
+    CHECK(buffer.capacity() >= (200u << 20));
+}
+
+int main() {
+    TestReuse();
+    TestSmall();
+    TestGrow();
+    TestMove();
+    TestRetainedCap();
+    TestOversized();
+    return CheckResult("buffer_pool");
+}
@@ -0,0 +1,29 @@
+#ifndef ELECTRON_CLIPBOARD_EX_TEST_CHECK_H
+#define ELECTRON_CLIPBOARD_EX_TEST_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Failed CHECKs so far. A failing CHECK is reported and the test goes on,
+// so that one run lists every failure.
+inline int failures = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+// Prints the summary of test `name`, returns the exit status for main().
+inline int CheckResult(const char *name) {
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("%s: all checks passed\n", name);
+    return EXIT_SUCCESS;
+}
+
+#endif //ELECTRON_CLIPBOARD_EX_TEST_CHECK_H
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "clipboard_formats.h"
+
+using namespace clipboard_formats;
+
+template<typename Func>
+void Bench(const char *name, size_t bytes, int iterations, Func func) {
+    func(); // warm up
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        func();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double per_iteration = elapsed.count() / iterations;
+    printf("%-28s %10.3f ms %10.1f MB/s\n", name, per_iteration * 1e3, bytes / per_iteration / 1e6);
+}
+
+int main() {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 100000; ++i) {
+        paths.emplace_back("/home/user/projects/asset library/textures/中文/tile_" + std::to_string(i) + ".png");
+    }
+
+    std::vector<char> uri_list(EncodeUriList(paths.begin(), paths.end(), nullptr, 0));
+    Bench("uri-list encode (100k)", uri_list.size(), 20, [&]() {
+        EncodeUriList(paths.begin(), paths.end(), uri_list.data(), uri_list.size());
+    });
+
+    std::vector<char> path_buffer(4096);
+    size_t decoded = 0;
+    Bench("uri-list decode (100k)", uri_list.size(), 20, [&]() {
+        UriListReader reader(std::string_view(uri_list.data(), uri_list.size()));
+        std::string_view uri;
+        while (reader.Next(uri)) {
+            decoded += DecodeFileUri(uri, path_buffer.data());
+        }
+    });
+
+    std::vector<std::u16string> wide_paths;
+    for (int i = 0; i < 100000; ++i) {
+        std::string path = "C:\\Users\\user\\asset library\\tile_" + std::to_string(i) + ".png";
+        wide_paths.emplace_back(path.begin(), path.end());
+    }
+    std::vector<uint8_t> drop_files(EncodeDropFilesWide(wide_paths.begin(), wide_paths.end(), nullptr, 0));
+    Bench("DROPFILES encode (100k)", drop_files.size(), 20, [&]() {
+        EncodeDropFilesWide(wide_paths.begin(), wide_paths.end(), drop_files.data(), drop_files.size());
+    });
+    Bench("DROPFILES decode (100k)", drop_files.size(), 20, [&]() {
+        DropFilesReader reader(drop_files.data(), drop_files.size());
+        const uint8_t *path;
+        size_t length;
+        while (reader.Next(path, length)) {
+            decoded += length;
+        }
+    });
+
+    const uint32_t width = 3840;
+    const uint32_t height = 2160;
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<uint8_t>(i * 31);
+    }
+    for (uint16_t bits : {24, 32}) {
+        std::vector<uint8_t> dib(EncodeDib(pixels.data(), width, height, width * 4, PixelFormat::Rgba,
+                                           bits, false, nullptr, 0));
+        std::string label = "DIB " + std::to_string(bits) + "bit encode (4K)";
+        Bench(label.c_str(), pixels.size(), 10, [&]() {
+            EncodeDib(pixels.data(), width, height, width * 4, PixelFormat::Rgba, bits, false,
+                      dib.data(), dib.size());
+        });
+        DibInfo info;
+        ParseDib(dib.data(), dib.size(), info);
+        label = "DIB " + std::to_string(bits) + "bit decode (4K)";
+        Bench(label.c_str(), pixels.size(), 10, [&]() {
+            DecodeDibPixels(dib.data(), dib.size(), info, PixelFormat::Rgba, pixels.data(), width * 4);
+        });
+    }
+
+    return decoded == 0;
+}
@@ -0,0 +1,181 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "clipboard_formats.h"
+#include "check.h"
+
+using namespace clipboard_formats;
+
+template<typename It>
+std::string UriList(It first, It last) {
+    std::string result(EncodeUriList(first, last, nullptr, 0), '\0');
+    CHECK(EncodeUriList(first, last, &result[0], result.size()) == result.size());
+    return result;
+}
+
+std::vector<std::string> DecodePaths(UriListReader reader) {
+    std::vector<std::string> paths;
+    std::string_view uri;
+    while (reader.Next(uri)) {
+        std::string path(uri.size(), '\0');
+        size_t length = DecodeFileUri(uri, &path[0]);
+        if (length) {
+            path.resize(length);
+            paths.emplace_back(path);
+        }
+    }
+    return paths;
+}
+
+void TestUriList() {
+    std::vector<std::string> paths = {"/Users/x/a.txt", "/中文路径/中文文件名.jpg", "relative", "/with space/#hash%"};
+    std::string encoded = UriList(paths.begin(), paths.end());
+    CHECK(encoded == "file:///Users/x/a.txt\r\n"
+                     "file:///%E4%B8%AD%E6%96%87%E8%B7%AF%E5%BE%84/%E4%B8%AD%E6%96%87%E6%96%87%E4%BB%B6%E5%90%8D.jpg\r\n"
+                     "file:///with%20space/%23hash%25\r\n");
+
+    std::vector<std::string> expected = {paths[0], paths[1], paths[3]};
+    CHECK(DecodePaths(UriListReader(encoded)) == expected);
+
+    // Truncated output keeps snprintf semantics
+    char small[8];
+    CHECK(EncodeUriList(paths.begin(), paths.end(), small, sizeof(small)) == encoded.size());
+
+    std::vector<std::string> none;
+    CHECK(UriList(none.begin(), none.end()).empty());
+
+    std::string foreign = "# comment\n\nhttp://example.com/a\nfile://localhost/tmp/b\nfile://host/tmp/c\nfile:///bad%2\nfile:///tmp/d";
+    CHECK(DecodePaths(UriListReader(foreign)) == std::vector<std::string>({"/tmp/b", "/tmp/d"}));
+
+    char out[32];
+    CHECK(DecodeFileUri("file:///nul%00byte", out) == 0);
+    CHECK(DecodeFileUri("FILE:///upper", out) == 6);
+}
+
+void TestGnomeCopiedFiles() {
+    std::vector<std::string> paths = {"/a b", "/c"};
+    std::string encoded(EncodeGnomeCopiedFiles(FileOperation::Cut, paths.begin(), paths.end(), nullptr, 0), '\0');
+    EncodeGnomeCopiedFiles(FileOperation::Cut, paths.begin(), paths.end(), &encoded[0], encoded.size());
+    CHECK(encoded == "cut\nfile:///a%20b\nfile:///c");
+
+    GnomeCopiedFilesReader reader(encoded);
+    CHECK(reader.valid());
+    CHECK(reader.operation() == FileOperation::Cut);
+    std::string_view uri;
+    CHECK(reader.Next(uri) && uri == "file:///a%20b");
+    CHECK(reader.Next(uri) && uri == "file:///c");
+    CHECK(!reader.Next(uri));
+
+    CHECK(!GnomeCopiedFilesReader("move\nfile:///a").valid());
+    CHECK(GnomeCopiedFilesReader("copy").valid());
+}
+
+void TestDropFiles() {
+    std::vector<std::u16string> wide = {u"C:\\Windows\\mock.dll", u"D:\\中文路径\\中文文件名.jpg"};
+    std::vector<uint8_t> buffer(EncodeDropFilesWide(wide.begin(), wide.end(), nullptr, 0));
+    CHECK(buffer.size() == kDropFilesHeaderSize + (wide[0].size() + 1 + wide[1].size() + 1 + 1) * 2);
+    EncodeDropFilesWide(wide.begin(), wide.end(), buffer.data(), buffer.size());
+
+    DropFilesReader reader(buffer.data(), buffer.size());
+    CHECK(reader.valid() && reader.wide());
+    const uint8_t *path;
+    size_t length;
+    for (const auto &expected : wide) {
+        CHECK(reader.Next(path, length));
+        CHECK(length == expected.size() && memcmp(path, expected.data(), length * 2) == 0);
+    }
+    CHECK(!reader.Next(path, length));
+    CHECK(reader.valid());
+
+    std::vector<std::string> ansi = {"C:\\a.txt", "C:\\b.txt"};
+    std::vector<uint8_t> ansi_buffer(EncodeDropFilesAnsi(ansi.begin(), ansi.end(), nullptr, 0));
+    EncodeDropFilesAnsi(ansi.begin(), ansi.end(), ansi_buffer.data(), ansi_buffer.size());
+    DropFilesReader ansi_reader(ansi_buffer.data(), ansi_buffer.size());
+    CHECK(ansi_reader.valid() && !ansi_reader.wide());
+    CHECK(ansi_reader.Next(path, length) && std::string(reinterpret_cast<const char *>(path), length) == ansi[0]);
+    CHECK(ansi_reader.Next(path, length) && std::string(reinterpret_cast<const char *>(path), length) == ansi[1]);
+    CHECK(!ansi_reader.Next(path, length));
+
+    // Missing terminator
+    ansi_buffer.resize(ansi_buffer.size() - 4);
+    DropFilesReader truncated(ansi_buffer.data(), ansi_buffer.size());
+    CHECK(truncated.Next(path, length));
+    CHECK(!truncated.Next(path, length));
+    CHECK(!truncated.valid());
+}
+
+void TestDib() {
+    const uint32_t width = 3;
+    const uint32_t height = 2;
+    // Top-down RGBA
+    const uint8_t rgba[] = {
+        255, 0, 0, 255, 0, 255, 0, 128, 0, 0, 255, 0,
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+    };
+
+    for (uint16_t bits : {24, 32}) {
+        for (bool top_down : {false, true}) {
+            size_t size = EncodeDib(rgba, width, height, width * 4, PixelFormat::Rgba, bits, top_down, nullptr, 0);
+            std::vector<uint8_t> dib(size);
+            CHECK(EncodeDib(rgba, width, height, width * 4, PixelFormat::Rgba, bits, top_down,
+                            dib.data(), dib.size()) == size);
+
+            DibInfo info;
+            CHECK(ParseDib(dib.data(), dib.size(), info));
+            CHECK(info.width == width && info.height == height);
+            CHECK(info.bits_per_pixel == bits && info.top_down == top_down);
+            CHECK(info.stride % 4 == 0);
+
+            uint8_t decoded[sizeof(rgba)];
+            CHECK(DecodeDibPixels(dib.data(), dib.size(), info, PixelFormat::Rgba, decoded, width * 4));
+            for (size_t i = 0; i < sizeof(rgba); ++i) {
+                uint8_t expected = (bits == 24 && i % 4 == 3) ? 255 : rgba[i];
+                CHECK(decoded[i] == expected);
+            }
+
+            uint8_t bgra[sizeof(rgba)];
+            CHECK(DecodeDibPixels(dib.data(), dib.size(), info, PixelFormat::Bgra, bgra, width * 4));
+            CHECK(bgra[0] == 0 && bgra[2] == 255);
+        }
+    }
+
+    size_t bmp_size = EncodeBmp(rgba, width, height, width * 4, PixelFormat::Rgba, 24, false, nullptr, 0);
+    std::vector<uint8_t> bmp(bmp_size);
+    EncodeBmp(rgba, width, height, width * 4, PixelFormat::Rgba, 24, false, bmp.data(), bmp.size());
+    DibInfo info;
+    CHECK(ParseBmp(bmp.data(), bmp.size(), info));
+    CHECK(info.pixel_offset == kBitmapFileHeaderSize + kBitmapInfoHeaderSize);
+    CHECK(!ParseDib(bmp.data(), bmp.size(), info));
+    CHECK(!ParseBmp(bmp.data(), bmp.size() - 1, info));
+
+    // 32 bit BI_RGB with an unused alpha channel is opaque
+    const uint8_t transparent[] = {10, 20, 30, 0};
+    std::vector<uint8_t> dib(EncodeDib(transparent, 1, 1, 4, PixelFormat::Bgra, 32, false, nullptr, 0));
+    EncodeDib(transparent, 1, 1, 4, PixelFormat::Bgra, 32, false, dib.data(), dib.size());
+    CHECK(ParseDib(dib.data(), dib.size(), info));
+    uint8_t pixel[4];
+    CHECK(DecodeDibPixels(dib.data(), dib.size(), info, PixelFormat::Bgra, pixel, 4));
+    CHECK(pixel[0] == 10 && pixel[3] == 255);
+
+    // BI_BITFIELDS with the masks following a BITMAPINFOHEADER
+    std::vector<uint8_t> bitfields(dib.begin(), dib.begin() + kBitmapInfoHeaderSize);
+    bitfields[16] = 3;
+    const uint8_t masks[] = {0, 0, 0xFF, 0, 0, 0xFF, 0, 0, 0xFF, 0, 0, 0};
+    bitfields.insert(bitfields.end(), masks, masks + sizeof(masks));
+    bitfields.insert(bitfields.end(), dib.begin() + kBitmapInfoHeaderSize, dib.end());
+    CHECK(ParseDib(bitfields.data(), bitfields.size(), info));
+    CHECK(info.pixel_offset == kBitmapInfoHeaderSize + sizeof(masks));
+
+    // Unsupported depth
+    dib[14] = 8;
+    CHECK(!ParseDib(dib.data(), dib.size(), info));
+}
+
+int main() {
+    TestUriList();
+    TestGnomeCopiedFiles();
+    TestDropFiles();
+    TestDib();
+    return CheckResult("clipboard_formats");
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs a command against a headless sway, the way xvfb-run does for X11.
+# wlroots compositors offer both data-control protocols; weston offers
+# neither. The compositor gets a private runtime dir, so the command sees
+# only its socket.
+
+runtime=$(mktemp -d)
+env -u DISPLAY -u WAYLAND_DISPLAY XDG_RUNTIME_DIR="$runtime" WLR_BACKENDS=headless WLR_RENDERER=pixman \
+    WLR_LIBINPUT_NO_DEVICES=1 sway -c /dev/null >"$runtime/sway.log" 2>&1 &
+sway=$!
+trap 'kill $sway 2>/dev/null; wait $sway 2>/dev/null; rm -rf "$runtime"' EXIT
+
+socket=
+for attempt in $(seq 100); do
+    socket=$(cd "$runtime" && ls wayland-* 2>/dev/null | grep -v '\.lock$' | head -n 1)
+    [ -n "$socket" ] && break
+    if ! kill -0 $sway 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+if [ -z "$socket" ]; then
+    echo "headless-sway: sway did not start" >&2
+    cat "$runtime/sway.log" >&2
+    exit 1
+fi
+
+env -u DISPLAY XDG_RUNTIME_DIR="$runtime" WAYLAND_DISPLAY="$socket" "$@"
@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <gtk/gtk.h>
+#include "clipboard.h"
+#include "check.h"
+
+// Plays an Electron-like host under Xvfb: the main thread iterates GLib's
+// default main context for the whole test and first uses the backend from
+// one of its dispatches. Reads on a worker then have to be answered by that
+// loop, while the main thread keeps changing the owner under them.
+
+const char kFirst[] = "first text";
+const char kSecond[] = "second text";
+const int kReads = 50;
+
+struct HostTest {
+    GMainLoop *loop = nullptr;
+    std::thread worker;
+    int writes = 0;
+    bool reading = true;
+    int reads_ok = 0;
+    bool unexpected_text = false;
+    bool has_image = false;
+};
+
+gboolean QuitLoop(gpointer user_data) {
+    auto *test = static_cast<HostTest *>(user_data);
+    test->reading = false;
+    g_main_loop_quit(test->loop);
+    return G_SOURCE_REMOVE;
+}
+
+// Owner changes dispatched on this thread while the worker reads
+gboolean ChangeOwner(gpointer user_data) {
+    auto *test = static_cast<HostTest *>(user_data);
+    if (!test->reading) {
+        return G_SOURCE_REMOVE;
+    }
+    const char *text = ++test->writes % 2 ? kSecond : kFirst;
+    CHECK(WriteText(text, strlen(text)));
+    return G_SOURCE_CONTINUE;
+}
+
+void ReadOnWorker(HostTest *test) {
+    for (int i = 0; i < kReads; ++i) {
+        ClipboardData text;
+        if (!ReadText(text)) {
+            continue; // The owner may change between TARGETS and the read
+        }
+        std::string read(text.data(), text.size());
+        if (read == kFirst || read == kSecond) {
+            ++test->reads_ok;
+        } else {
+            test->unexpected_text = true;
+        }
+    }
+    test->has_image = ClipboardHasImage();
+    g_main_context_invoke(nullptr, QuitLoop, test);
+}
+
+gboolean StartInDispatch(gpointer user_data) {
+    auto *test = static_cast<HostTest *>(user_data);
+    // Seen from a dispatch of the default context, the backend leaves the
+    // context to this loop from now on
+    ClipboardSequenceNumber();
+    CHECK(WriteText(kFirst, strlen(kFirst)));
+    test->worker = std::thread(ReadOnWorker, test);
+    g_timeout_add(5, ChangeOwner, test);
+    return G_SOURCE_REMOVE;
+}
+
+gboolean OnWatchdog(gpointer) {
+    fprintf(stderr, "host_context: worker reads did not finish\n");
+    _exit(EXIT_FAILURE); // The worker may be stuck, it cannot be joined
+}
+
+int main() {
+    if (!gtk_init_check(nullptr, nullptr)) {
+        fprintf(stderr, "host_context: no display, run under xvfb-run\n");
+        return EXIT_FAILURE;
+    }
+
+    HostTest test;
+    test.loop = g_main_loop_new(nullptr, FALSE);
+    g_idle_add(StartInDispatch, &test);
+    g_timeout_add_seconds(60, OnWatchdog, nullptr);
+    g_main_loop_run(test.loop);
+    test.worker.join();
+    g_main_loop_unref(test.loop);
+
+    CHECK(test.reads_ok > 0);
+    CHECK(!test.unexpected_text);
+    CHECK(!test.has_image);
+    CHECK(test.writes > 0);
+
+    // The worker's requests were timed by the main thread, none timed out
+    bool timed_targets = false;
+    for (const OwnerStats &owner : GetClipboardStats().owners) {
+        for (const TargetStats &target : owner.targets) {
+            if (target.target == "TARGETS" && target.requests > 0) {
+                timed_targets = true;
+                CHECK(target.timeouts == 0);
+            }
+        }
+    }
+    CHECK(timed_targets);
+    return CheckResult("host_context");
+}
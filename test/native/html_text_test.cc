@@ -0,0 +1,72 @@
+#include <cstring>
+#include <string>
+#include "html_text.h"
+#include "check.h"
+
+std::string Text(const char *html) {
+    return HtmlToText(html, strlen(html));
+}
+
+void TestEntities() {
+    CHECK(Text("a &amp; b &lt;c&gt; &quot;d&quot; &apos;e&apos;") == "a & b <c> \"d\" 'e'");
+    CHECK(Text("x&nbsp;y") == "x y");
+    CHECK(Text("&#65;&#x42;&#X43;") == "ABC");
+    CHECK(Text("&#233;&#x20AC;&#x1F600;") == "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+    // Invalid code points become U+FFFD
+    CHECK(Text("&#0;&#xD800;&#x110000;") == "\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd");
+    // Unknown, unterminated and malformed references stay as they are
+    CHECK(Text("&copy; &amp &#12a; AT&T") == "&copy; &amp &#12a; AT&T");
+}
+
+void TestBreaks() {
+    CHECK(Text("one<br>two<br/>three") == "one\ntwo\nthree");
+    CHECK(Text("<p>first</p><p>second</p>") == "first\nsecond");
+    CHECK(Text("<DIV>upper</DIV><Li>case</Li>") == "upper\ncase");
+    // Consecutive <br> keep the empty line, other blocks do not add one
+    CHECK(Text("a<br><br>b") == "a\n\nb");
+    CHECK(Text("<div><div>nested</div></div>") == "nested");
+    CHECK(Text("<ul><li>x</li><li>y</li></ul>") == "x\ny");
+    // Inline elements add nothing
+    CHECK(Text("<b>bold</b> and <i>it</i><span>alic</span>") == "bold and italic");
+}
+
+void TestWhitespace() {
+    CHECK(Text("  lots \n\t of\r\n   space  ") == "lots of space");
+    CHECK(Text("<p>  padded  </p>  <p>\n  block </p>") == "padded\nblock");
+    CHECK(Text("") == "");
+    CHECK(Text(" \n ") == "");
+}
+
+void TestSkipped() {
+    CHECK(Text("a<script>var s = '<p>no</p>';</script>b") == "ab");
+    CHECK(Text("a<STYLE type=\"text/css\">p { color: red }</STYLE>b") == "ab");
+    // A closing tag of another element does not end the script
+    CHECK(Text("<script>if (a</b) x();</script>after") == "after");
+    CHECK(Text("before<!-- <p>comment</p> -->after") == "beforeafter");
+    // Unterminated script and comment swallow the rest
+    CHECK(Text("kept<script>lost") == "kept");
+    CHECK(Text("kept<!-- lost") == "kept");
+}
+
+void TestMalformed() {
+    // An unclosed tag runs to the end
+    CHECK(Text("text<a href=\"x") == "text");
+    CHECK(Text("1 < 2") == "1");
+    CHECK(Text("<>empty<>tags") == "emptytags");
+    CHECK(Text("</>x</p") == "x");
+    CHECK(Text("a > b") == "a > b");
+    // Attributes go with their tag
+    CHECK(Text("<a href=\"x\" title='y'>link</a>") == "link");
+    // Embedded NULs are copied
+    std::string nul("a\0b", 3);
+    CHECK(HtmlToText(nul.data(), nul.size()) == nul);
+}
+
+int main() {
+    TestEntities();
+    TestBreaks();
+    TestWhitespace();
+    TestSkipped();
+    TestMalformed();
+    return CheckResult("html_text");
+}
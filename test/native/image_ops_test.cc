@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "hash.h"
+#include "image_ops.h"
+#include "check.h"
+#include "test_image.h"
+
+void TestXxh64() {
+    // Reference values of the xxHash project
+    CHECK(Xxh64("", 0) == 0xEF46DB3751D8E999ULL);
+    CHECK(Xxh64("abc", 3) == 0x44BC2CF5AD770999ULL);
+
+    // Lengths around the 32 byte stripes and the 8/4/1 byte tails
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data += static_cast<char>(i * 7);
+    }
+    CHECK(Xxh64(data.data(), 7) == 0xD734A6B26F3DA63EULL);
+    CHECK(Xxh64(data.data(), 31) == 0x0F187C62B1E722B7ULL);
+    CHECK(Xxh64(data.data(), 32) == 0x91B0CB0931A8C629ULL);
+    CHECK(Xxh64(data.data(), 33) == 0x931B043CF8D65B94ULL);
+    CHECK(Xxh64(data.data(), 100, 12345) == 0x65193C8E88F402DFULL);
+    CHECK(Xxh64(data.data(), 1000) == 0x25275608A9CFC168ULL);
+
+    // Streamed in uneven pieces, crossing stripe boundaries
+    for (size_t piece : {1, 5, 31, 32, 33, 100}) {
+        for (size_t length : {0, 7, 32, 33, 1000}) {
+            Xxh64Stream stream(12345);
+            for (size_t offset = 0; offset < length; offset += piece) {
+                stream.Update(data.data() + offset, std::min(piece, length - offset));
+            }
+            CHECK(stream.size() == length);
+            CHECK(stream.Digest() == Xxh64(data.data(), length, 12345));
+        }
+    }
+}
+
+void TestFitWithin() {
+    uint32_t width, height;
+    FitWithin(4000, 3000, 0, width, height);
+    CHECK(width == 4000 && height == 3000);
+    FitWithin(100, 50, 200, width, height);
+    CHECK(width == 100 && height == 50);
+    FitWithin(4000, 3000, 1000, width, height);
+    CHECK(width == 1000 && height == 750);
+    FitWithin(3000, 2, 100, width, height);
+    CHECK(width == 100 && height == 1);
+}
+
+void TestDownscale() {
+    ImagePixels src = MakeImage(4, 2, 4 * 4);
+    // Left half opaque red, right half transparent with a green color that
+    // must not bleed into the average
+    for (uint32_t y = 0; y < 2; ++y) {
+        for (uint32_t x = 0; x < 4; ++x) {
+            uint8_t *pixel = PixelAt(src, x, y);
+            if (x < 2) {
+                pixel[0] = 255;
+                pixel[3] = 255;
+            } else {
+                pixel[1] = 255;
+            }
+        }
+    }
+    ImagePixels dst;
+    CHECK(Downscale(src, 2, 1, dst));
+    CHECK(dst.width == 2 && dst.height == 1 && dst.stride == 8);
+    CHECK(memcmp(PixelAt(dst, 0, 0), "\xff\x00\x00\xff", 4) == 0);
+    CHECK(memcmp(PixelAt(dst, 1, 0), "\x00\x00\x00\x00", 4) == 0);
+
+    ImagePixels half;
+    CHECK(Downscale(src, 1, 1, half));
+    CHECK(memcmp(PixelAt(half, 0, 0), "\xff\x00\x00\x80", 4) == 0);
+
+    CHECK(!Downscale(src, 5, 1, dst));
+}
+
+void TestFingerprint() {
+    ImagePixels packed = MakeImage(3, 2, 3 * 4);
+    ImagePixels padded = MakeImage(3, 2, 3 * 4 + 20);
+    for (uint32_t y = 0; y < 2; ++y) {
+        memset(PixelAt(packed, 0, y), static_cast<int>(y + 1), 12);
+        memset(PixelAt(padded, 0, y), static_cast<int>(y + 1), 12);
+        memset(PixelAt(padded, 3, y), 0x5a, 20);
+    }
+    CHECK(FingerprintPixels(packed) == FingerprintPixels(padded));
+
+    ImagePixels transposed = MakeImage(2, 3, 2 * 4);
+    CHECK(FingerprintPixels(transposed) != FingerprintPixels(MakeImage(3, 2, 3 * 4)));
+    PixelAt(packed, 2, 1)[3] ^= 1;
+    CHECK(FingerprintPixels(packed) != FingerprintPixels(padded));
+}
+
+void TestToBgra() {
+    ImagePixels image = MakeImage(2, 2, 3 * 4);
+    uint8_t opaque[] = {10, 20, 30, 255};
+    uint8_t half[] = {200, 100, 50, 128};
+    memcpy(PixelAt(image, 0, 0), opaque, 4);
+    memcpy(PixelAt(image, 1, 1), half, 4);
+
+    char out[2 * 2 * 4];
+    ToBgra(image, false, out, 2 * 4);
+    const auto *bytes = reinterpret_cast<const uint8_t *>(out);
+    CHECK(bytes[0] == 30 && bytes[1] == 20 && bytes[2] == 10 && bytes[3] == 255);
+    CHECK(bytes[12] == 50 && bytes[13] == 100 && bytes[14] == 200 && bytes[15] == 128);
+
+    ToBgra(image, true, out, 2 * 4);
+    CHECK(bytes[0] == 30 && bytes[1] == 20 && bytes[2] == 10 && bytes[3] == 255);
+    CHECK(bytes[12] == 25 && bytes[13] == 50 && bytes[14] == 100 && bytes[15] == 128);
+    CHECK(bytes[4] == 0 && bytes[7] == 0); // Transparent stays zero
+}
+
+void TestRowToBgra() {
+    uint8_t rgb[] = {10, 20, 30, 40, 50, 60};
+    uint8_t out[2 * 4];
+    RowToBgra(rgb, 3, 2, true, out);
+    CHECK(out[0] == 30 && out[1] == 20 && out[2] == 10 && out[3] == 255);
+    CHECK(out[4] == 60 && out[5] == 50 && out[6] == 40 && out[7] == 255);
+
+    uint8_t rgba[] = {200, 100, 50, 128};
+    RowToBgra(rgba, 4, 1, true, rgba); // In place
+    CHECK(rgba[0] == 25 && rgba[1] == 50 && rgba[2] == 100 && rgba[3] == 128);
+
+    UnpremultiplyRow(rgba, 1);
+    CHECK(rgba[0] == 50 && rgba[1] == 100 && rgba[2] == 199 && rgba[3] == 128);
+    uint8_t transparent[] = {0, 0, 0, 0};
+    UnpremultiplyRow(transparent, 1);
+    CHECK(transparent[0] == 0 && transparent[3] == 0);
+}
+
+int main() {
+    TestXxh64();
+    TestFitWithin();
+    TestDownscale();
+    TestFingerprint();
+    TestToBgra();
+    TestRowToBgra();
+    return CheckResult("image_ops");
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <jpeglib.h>
+#include "image_ops.h"
+#include "jpeg_codec.h"
+#include "jpeg_transform.h"
+#include "check.h"
+
+// Smooth gradients, so that quantization barely changes them
+std::vector<unsigned char> EncodeJpeg(uint32_t width, uint32_t height, int components) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * components);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t *pixel = &pixels[(static_cast<size_t>(y) * width + x) * components];
+            pixel[0] = static_cast<uint8_t>(x * 255 / width);
+            if (components == 3) {
+                pixel[1] = static_cast<uint8_t>(y * 255 / height);
+                pixel[2] = static_cast<uint8_t>((x + y) * 127 / (width + height));
+            }
+        }
+    }
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char *buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = components;
+    cinfo.in_color_space = components == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 95, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < height) {
+        JSAMPROW row = &pixels[static_cast<size_t>(cinfo.next_scanline) * width * components];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    std::vector<unsigned char> jpeg(buffer, buffer + size);
+    free(buffer);
+    return jpeg;
+}
+
+bool DecodeJpeg(const unsigned char *data, size_t size, ImagePixels &image) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char *>(data), size);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+    image.width = cinfo.output_width;
+    image.height = cinfo.output_height;
+    image.stride = static_cast<size_t>(image.width) * 4;
+    image.pixels = PooledBuffer(image.stride * image.height);
+    std::vector<unsigned char> row(image.width * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        unsigned char *out = reinterpret_cast<unsigned char *>(image.pixels.data() +
+                                                               cinfo.output_scanline * image.stride);
+        JSAMPROW rows[] = {row.data()};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        for (uint32_t x = 0; x < image.width; ++x) {
+            memcpy(out + x * 4, &row[x * 3], 3);
+            out[x * 4 + 3] = 255;
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+int MaxDifference(const ImagePixels &a, const ImagePixels &b) {
+    int max = 0;
+    for (uint32_t y = 0; y < a.height; ++y) {
+        for (uint32_t x = 0; x < a.width * 4; ++x) {
+            int difference = static_cast<uint8_t>(a.pixels.data()[y * a.stride + x]) -
+                             static_cast<uint8_t>(b.pixels.data()[y * b.stride + x]);
+            max = std::max(max, std::abs(difference));
+        }
+    }
+    return max;
+}
+
+// The lossless result matches the decoded source transformed in pixels.
+// `expected` is the region actually moved: MCU aligned and trimmed.
+void CheckTransform(const std::vector<unsigned char> &jpeg, const ImageTransform &transform,
+                    const ImageTransform &expected) {
+    ImagePixels source, decoded, reference;
+    CHECK(DecodeJpeg(jpeg.data(), jpeg.size(), source));
+    PooledBuffer out;
+    size_t out_size = 0;
+    CHECK(TransformJpeg(reinterpret_cast<const char *>(jpeg.data()), jpeg.size(), transform, out, out_size));
+    CHECK(out_size > 0);
+    CHECK(DecodeJpeg(reinterpret_cast<const unsigned char *>(out.data()), out_size, decoded));
+    CHECK(TransformPixels(source, expected, reference));
+    CHECK(decoded.width == reference.width && decoded.height == reference.height);
+    if (decoded.width == reference.width && decoded.height == reference.height) {
+        int difference = MaxDifference(decoded, reference);
+        if (difference > 2) {
+            fprintf(stderr, "rotate %u flip %d/%d: max difference %d\n", transform.rotate,
+                    transform.flip_horizontal, transform.flip_vertical, difference);
+        }
+        CHECK(difference <= 2);
+    }
+}
+
+void TestOrientations() {
+    // 4:2:0, 16 pixel MCUs, with partial MCUs on both edges
+    std::vector<unsigned char> jpeg = EncodeJpeg(100, 75, 3);
+    for (uint32_t rotate : {0u, 90u, 180u, 270u}) {
+        for (int flip = 0; flip < 4; ++flip) {
+            ImageTransform transform;
+            transform.rotate = rotate;
+            transform.flip_horizontal = flip & 1;
+            transform.flip_vertical = flip & 2;
+            Orientation o = GetOrientation(transform);
+            ImageTransform expected = transform;
+            bool mirror_source_x = o.transpose ? o.mirror_y : o.mirror_x;
+            bool mirror_source_y = o.transpose ? o.mirror_x : o.mirror_y;
+            expected.crop_width = mirror_source_x ? 96 : 100;
+            expected.crop_height = mirror_source_y ? 64 : 75;
+            CheckTransform(jpeg, transform, expected);
+        }
+    }
+}
+
+void TestCrop() {
+    std::vector<unsigned char> jpeg = EncodeJpeg(100, 75, 3);
+    ImageTransform transform;
+    transform.crop_x = 20;
+    transform.crop_y = 35;
+    transform.crop_width = 50;
+    transform.crop_height = 30;
+    // The origin moves to the MCU at (16, 32), the far edge stays
+    ImageTransform expected;
+    expected.crop_x = 16;
+    expected.crop_y = 32;
+    expected.crop_width = 54;
+    expected.crop_height = 33;
+    CheckTransform(jpeg, transform, expected);
+
+    // Rotated by 90 degrees the source rows are mirrored: 33 rows trim to 32
+    transform.rotate = expected.rotate = 90;
+    expected.crop_height = 32;
+    CheckTransform(jpeg, transform, expected);
+}
+
+void TestGrayscale() {
+    // 8 pixel MCUs, rotating by 270 degrees mirrors the source columns
+    std::vector<unsigned char> jpeg = EncodeJpeg(30, 20, 1);
+    ImageTransform transform;
+    transform.rotate = 270;
+    ImageTransform expected = transform;
+    expected.crop_width = 24;
+    CheckTransform(jpeg, transform, expected);
+}
+
+void TestInvalid() {
+    PooledBuffer out;
+    size_t out_size = 0;
+    ImageTransform transform;
+    CHECK(!TransformJpeg("not a jpeg", 10, transform, out, out_size));
+    std::vector<unsigned char> jpeg = EncodeJpeg(100, 75, 3);
+    CHECK(!TransformJpeg(reinterpret_cast<const char *>(jpeg.data()), jpeg.size() / 2, transform, out, out_size) ||
+          out_size > 0);
+    transform.crop_x = 100;
+    CHECK(!TransformJpeg(reinterpret_cast<const char *>(jpeg.data()), jpeg.size(), transform, out, out_size));
+    // Mirroring a crop narrower than one MCU leaves nothing
+    transform.crop_x = 0;
+    transform.crop_width = 10;
+    transform.flip_horizontal = true;
+    CHECK(!TransformJpeg(reinterpret_cast<const char *>(jpeg.data()), jpeg.size(), transform, out, out_size));
+}
+
+class CancelSink : public ProgressSink {
+public:
+    bool Report(ProgressPhase phase, uint64_t done, uint64_t total) override {
+        (void)phase;
+        (void)done;
+        (void)total;
+        return false;
+    }
+};
+
+// Padded rows of the same gradients as EncodeJpeg
+std::vector<uint8_t> Gradient(uint32_t width, uint32_t height, int channels, size_t stride) {
+    std::vector<uint8_t> pixels(stride * height, 0x55);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t *pixel = &pixels[y * stride + x * channels];
+            pixel[0] = static_cast<uint8_t>(x * 255 / width);
+            pixel[1] = static_cast<uint8_t>(y * 255 / height);
+            pixel[2] = static_cast<uint8_t>((x + y) * 127 / (width + height));
+            if (channels == 4) {
+                pixel[3] = static_cast<uint8_t>(x);
+            }
+        }
+    }
+    return pixels;
+}
+
+void CheckCompress(int channels, float quality) {
+    const uint32_t width = 70, height = 45;
+    size_t stride = width * channels + 6;
+    std::vector<uint8_t> pixels = Gradient(width, height, channels, stride);
+    PooledBuffer out;
+    size_t out_size = 0;
+    CHECK(CompressJpeg(pixels.data(), width, height, stride, channels, quality, out, out_size));
+    ImagePixels decoded;
+    CHECK(out_size > 0 && DecodeJpeg(reinterpret_cast<const unsigned char *>(out.data()), out_size, decoded));
+    CHECK(decoded.width == width && decoded.height == height);
+    if (decoded.width != width || decoded.height != height) {
+        return;
+    }
+    int max = 0;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                int difference = pixels[y * stride + x * channels + c] -
+                                 static_cast<uint8_t>(decoded.pixels.data()[y * decoded.stride + x * 4 + c]);
+                max = std::max(max, std::abs(difference));
+            }
+        }
+    }
+    CHECK(max <= 16);
+}
+
+void TestCompress() {
+    CodecContextStats before = GetJpegContextStats();
+    CheckCompress(4, 0.9f);
+    CheckCompress(3, 0.9f);
+    CheckCompress(4, 0.5f);
+    CodecContextStats after = GetJpegContextStats();
+    // The transforms before set the compressor up on this thread
+    CHECK(after.acquires == before.acquires + 3);
+    CHECK(after.reuses == before.reuses + 3);
+    CHECK(after.live == 2);
+
+    // A grayscale transform replaces the compressor's parameters
+    TestGrayscale();
+    CheckCompress(3, 0.9f);
+
+    std::vector<uint8_t> pixels = Gradient(16, 64, 3, 48);
+    PooledBuffer out;
+    size_t out_size = 0;
+    CancelSink cancel;
+    CHECK(!CompressJpeg(pixels.data(), 16, 64, 48, 3, 0.9f, out, out_size, &cancel));
+    CHECK(!CompressJpeg(pixels.data(), 16, 64, 48, 2, 0.9f, out, out_size));
+    CheckCompress(4, 0.9f);
+}
+
+int main() {
+    TestOrientations();
+    TestCrop();
+    TestGrayscale();
+    TestInvalid();
+    TestCompress();
+    return CheckResult("jpeg_transform");
+}
@@ -0,0 +1,189 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_clipboard.h"
+#include "check.h"
+
+// Codec stand-ins: "images" are 2x1 and take their color from the first byte
+static std::string saved_path;
+
+bool DecodeImageData(const char *data, size_t size, ImagePixels &image) {
+    if (size == 0) {
+        return false;
+    }
+    image.width = 2;
+    image.height = 1;
+    image.stride = 16; // Padded, readers get packed rows
+    image.pixels = PooledBuffer(image.stride);
+    memset(image.pixels.data(), data[0], image.stride);
+    return true;
+}
+
+bool DecodeImageFile(const std::string &path, uint32_t, ImagePixels &image) {
+    return path != "missing.png" && DecodeImageData(path.data(), path.size(), image);
+}
+
+bool SaveImagePixels(const ImagePixels &image, const std::string &target_path, ImageFormat, float, ProgressSink *) {
+    saved_path = target_path;
+    return image.width == 2;
+}
+
+std::string ReadAll(ClipboardSelection selection) {
+    ClipboardData text;
+    if (!memory_clipboard::ReadText(text, selection)) {
+        return "<none>";
+    }
+    return std::string(text.data(), text.size());
+}
+
+void TestText() {
+    const auto clipboard = ClipboardSelection::Clipboard;
+    const auto primary = ClipboardSelection::Primary;
+    uint64_t sequence = memory_clipboard::SequenceNumber(clipboard);
+    CHECK(memory_clipboard::WriteText("one", 3, clipboard));
+    CHECK(memory_clipboard::WriteText("two", 3, primary));
+    CHECK(ReadAll(clipboard) == "one");
+    CHECK(ReadAll(primary) == "two");
+    CHECK(memory_clipboard::SequenceNumber(clipboard) == sequence + 1);
+
+    memory_clipboard::Clear(clipboard);
+    CHECK(ReadAll(clipboard) == "<none>");
+    CHECK(memory_clipboard::SequenceNumber(clipboard) == sequence + 2);
+}
+
+void TestFlavors() {
+    const auto clipboard = ClipboardSelection::Clipboard;
+    memory_clipboard::WriteFilePaths({"/a", "/b c"}, clipboard);
+    CHECK(memory_clipboard::ReadFilePaths(clipboard) == std::vector<std::string>({"/a", "/b c"}));
+    CHECK(ReadAll(clipboard) == "/a\n/b c");
+    CHECK(!memory_clipboard::HasImage(clipboard));
+
+    RichContent rich;
+    rich.html = "<b>bold</b> text";
+    CHECK(memory_clipboard::WriteRich(rich, clipboard));
+    CHECK(memory_clipboard::ReadFilePaths(clipboard).empty());
+    CHECK(memory_clipboard::ReadRich(clipboard).html == rich.html);
+    CHECK(ReadAll(clipboard) == "bold text");
+
+    std::string html;
+    auto append = [&html](const char *data, size_t size) {
+        html.append(data, size);
+        return true;
+    };
+    CHECK(memory_clipboard::ReadTarget("text/html", clipboard, append));
+    CHECK(html == rich.html);
+    CHECK(!memory_clipboard::ReadTarget("text/rtf", clipboard, append));
+    CHECK(!memory_clipboard::ReadTarget("text/html", clipboard, [](const char *, size_t) { return false; }));
+
+    MultiContent multi;
+    multi.file_paths = {"/x.png"};
+    multi.image_data = "\x7f";
+    CHECK(memory_clipboard::WriteMulti(multi, clipboard));
+    CHECK(ReadAll(clipboard) == "/x.png");
+    CHECK(memory_clipboard::HasImage(clipboard));
+    std::string uri_list;
+    CHECK(memory_clipboard::ReadTarget("text/uri-list", clipboard, [&uri_list](const char *data, size_t size) {
+        uri_list.append(data, size);
+        return true;
+    }));
+    CHECK(uri_list == "file:///x.png\r\n");
+    CHECK(!memory_clipboard::ReadTarget("image/png", clipboard, [](const char *, size_t) { return true; }));
+
+    multi.image_data.clear();
+    multi.image_path = "missing.png";
+    uint64_t sequence = memory_clipboard::SequenceNumber(clipboard);
+    CHECK(!memory_clipboard::WriteMulti(multi, clipboard));
+    CHECK(memory_clipboard::SequenceNumber(clipboard) == sequence);
+}
+
+void TestLazyImageFile() {
+    const auto clipboard = ClipboardSelection::Clipboard;
+    MultiContent multi;
+    multi.image_data = std::string("\x89PNG\r\n\x1a\n", 8) + "pixels";
+    multi.image_file_name = "../Screen shot";
+    CHECK(memory_clipboard::WriteMulti(multi, clipboard));
+    CHECK(memory_clipboard::HasImage(clipboard));
+    CHECK(ReadAll(clipboard) == "<none>");
+
+    std::vector<std::string> paths = memory_clipboard::ReadFilePaths(clipboard);
+    CHECK(paths.size() == 1);
+    std::string path = paths.empty() ? std::string() : paths[0];
+    const std::string name = "/Screen shot.png";
+    CHECK(path.size() > name.size() && path.compare(path.size() - name.size(), name.size(), name) == 0);
+    CHECK(memory_clipboard::ReadFilePaths(clipboard) == paths);
+    FILE *file = fopen(path.c_str(), "rb");
+    CHECK(file);
+    if (file) {
+        char bytes[32];
+        size_t read = fread(bytes, 1, sizeof(bytes), file);
+        fclose(file);
+        CHECK(std::string(bytes, read) == multi.image_data);
+    }
+
+    // Replacing the content removes the file
+    memory_clipboard::Clear(clipboard);
+    file = fopen(path.c_str(), "rb");
+    CHECK(!file);
+    if (file) {
+        fclose(file);
+    }
+}
+
+void TestImages() {
+    const auto clipboard = ClipboardSelection::Clipboard;
+    CHECK(memory_clipboard::PutImage("image.png", clipboard));
+    CHECK(memory_clipboard::HasImage(clipboard));
+    ImagePixels image;
+    CHECK(memory_clipboard::ReadImagePixels(image, clipboard));
+    CHECK(image.width == 2 && image.height == 1 && image.stride == 8);
+    CHECK(image.pixels.data()[7] == 'i');
+    char bgra[8];
+    CHECK(memory_clipboard::ReadImageBgra([&](uint32_t width, uint32_t height) {
+        return width == 2 && height == 1 ? bgra : nullptr;
+    }, false, clipboard));
+    CHECK(bgra[0] == image.pixels.data()[2] && bgra[2] == image.pixels.data()[0] && bgra[7] == 'i');
+    CHECK(!memory_clipboard::ReadImageBgra([](uint32_t, uint32_t) -> char * { return nullptr; }, false,
+                                           clipboard));
+    CHECK(memory_clipboard::SaveImage("out.png", ImageFormat::Png, 0, clipboard, nullptr));
+    CHECK(saved_path == "out.png");
+
+    CHECK(!memory_clipboard::PutImage("missing.png", clipboard));
+    CHECK(memory_clipboard::HasImage(clipboard));
+    memory_clipboard::WriteText("x", 1, clipboard);
+    CHECK(!memory_clipboard::HasImage(clipboard));
+    CHECK(!memory_clipboard::SaveImage("out.png", ImageFormat::Png, 0, clipboard, nullptr));
+}
+
+void TestConcurrentAccess() {
+    const auto secondary = ClipboardSelection::Secondary;
+    uint64_t sequence = memory_clipboard::SequenceNumber(secondary);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([i, secondary] {
+            std::string text(1000, static_cast<char>('a' + i));
+            for (int n = 0; n < 1000; ++n) {
+                memory_clipboard::WriteText(text.data(), text.size(), secondary);
+                std::string read = ReadAll(secondary);
+                // Whole writes only, never a mix
+                CHECK(read.size() == 1000 && read.find_first_not_of(read[0]) == std::string::npos);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    CHECK(memory_clipboard::SequenceNumber(secondary) == sequence + 4000);
+}
+
+int main() {
+    TestText();
+    TestFlavors();
+    TestLazyImageFile();
+    TestImages();
+    TestConcurrentAccess();
+    return CheckResult("memory_clipboard");
+}
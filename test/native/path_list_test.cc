@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "path_list.h"
+#include "check.h"
+
+std::vector<std::string> MakePaths(size_t count) {
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < count; ++i) {
+        paths.push_back("/srv/assets/project/textures/set " + std::to_string(i / 10) + "/tile_" +
+                        std::to_string(i) + ".png");
+    }
+    return paths;
+}
+
+void TestRoundTrip() {
+    std::vector<std::string> paths = MakePaths(1000);
+    PathList list(paths.begin(), paths.end());
+    CHECK(list.size() == paths.size());
+    for (size_t i = 0; i < paths.size(); i += 7) {
+        CHECK(list.Get(i) == paths[i]);
+    }
+    size_t i = 0;
+    for (const std::string &path : list) {
+        CHECK(i < paths.size() && path == paths[i]);
+        ++i;
+    }
+    CHECK(i == paths.size());
+
+    PathList::const_iterator it = list.IteratorAt(37);
+    CHECK(*it == paths[37]);
+    ++it;
+    CHECK(*it == paths[38]);
+    CHECK(list.IteratorAt(paths.size() + 5) == list.end());
+
+    // Front coding keeps a fraction of the raw bytes
+    size_t raw = 0;
+    for (const std::string &path : paths) {
+        raw += path.size();
+    }
+    CHECK(list.encoded_bytes() * 3 < raw);
+}
+
+void TestCommonPrefix() {
+    PathList empty;
+    CHECK(empty.CommonPrefix().empty());
+    CHECK(empty.begin() == empty.end());
+
+    std::vector<std::string> paths = MakePaths(30);
+    PathList list(paths.begin(), paths.end());
+    CHECK(list.CommonPrefix() == "/srv/assets/project/textures/set ");
+
+    // "é" is C3 A9 and "ê" C3 AA, the shared lead byte is not returned
+    PathList accented;
+    accented.Append("/tmp/caf\xc3\xa9");
+    accented.Append("/tmp/caf\xc3\xaa");
+    CHECK(accented.CommonPrefix() == "/tmp/caf");
+
+    PathList single;
+    single.Append("/a/b");
+    CHECK(single.CommonPrefix() == "/a/b");
+}
+
+void TestPacked() {
+    std::vector<std::string> paths = MakePaths(100);
+    paths.push_back("");
+    paths.push_back("/");
+    PathList list(paths.begin(), paths.end());
+    std::string packed = list.ToPacked();
+
+    PathList restored;
+    CHECK(PathList::FromPacked(packed, restored));
+    CHECK(restored.size() == paths.size());
+    CHECK(restored.CommonPrefix() == list.CommonPrefix());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        CHECK(restored.Get(i) == paths[i]);
+    }
+    restored.Append("/appended");
+    CHECK(restored.Get(paths.size()) == "/appended");
+
+    PathList untouched;
+    untouched.Append("/kept");
+    CHECK(!PathList::FromPacked("PATHLST2", untouched));
+    CHECK(!PathList::FromPacked(packed.substr(0, packed.size() - 1), untouched));
+    CHECK(!PathList::FromPacked(packed + "x", untouched));
+    CHECK(untouched.size() == 1 && untouched.Get(0) == "/kept");
+}
+
+int main() {
+    TestRoundTrip();
+    TestCommonPrefix();
+    TestPacked();
+    return CheckResult("path_list");
+}
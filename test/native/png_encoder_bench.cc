@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <png.h>
+#include "png_encoder.h"
+#include "test_image.h"
+
+// Compares EncodeScreenshotPng with libpng at its defaults, which is what
+// gdk_pixbuf_save writes PNGs with. Without arguments a synthetic corpus of
+// screenshot-like images is used; pass PNG files to measure real
+// screenshots instead.
+
+struct Sample {
+    std::string name;
+    ImagePixels image;
+};
+
+struct Color {
+    uint8_t r, g, b, a;
+};
+
+void Fill(ImagePixels &image, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, Color color) {
+    for (uint32_t y = y0; y < std::min(image.height, y0 + height); ++y) {
+        for (uint32_t x = x0; x < std::min(image.width, x0 + width); ++x) {
+            memcpy(image.pixels.data() + y * image.stride + x * 4, &color, 4);
+        }
+    }
+}
+
+uint32_t NextRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// Anti-aliased text: glyphs are fixed random 7x13 coverage patterns, blended
+// with the background like subpixel-free font rendering
+class TextRenderer {
+public:
+    TextRenderer() {
+        uint32_t state = 12345;
+        for (auto &glyph : _glyphs) {
+            for (auto &coverage : glyph) {
+                uint32_t r = NextRandom(state) % 10;
+                coverage = static_cast<uint8_t>(r < 5 ? 0 : r < 7 ? 255 : r < 8 ? 170 : 85);
+            }
+        }
+    }
+
+    void Draw(ImagePixels &image, uint32_t x, uint32_t y, uint32_t width, Color foreground, Color background,
+              uint32_t &state) {
+        uint32_t end = std::min(image.width, x + width);
+        while (x + 8 <= end) {
+            uint32_t word = 2 + NextRandom(state) % 9;
+            for (uint32_t i = 0; i < word && x + 8 <= end; ++i, x += 8) {
+                const uint8_t *glyph = _glyphs[NextRandom(state) % kGlyphs];
+                for (uint32_t gy = 0; gy < 13 && y + gy < image.height; ++gy) {
+                    for (uint32_t gx = 0; gx < 7; ++gx) {
+                        uint8_t coverage = glyph[gy * 7 + gx];
+                        Color color = {Blend(foreground.r, background.r, coverage),
+                                       Blend(foreground.g, background.g, coverage),
+                                       Blend(foreground.b, background.b, coverage), 255};
+                        memcpy(image.pixels.data() + (y + gy) * image.stride + (x + gx) * 4, &color, 4);
+                    }
+                }
+            }
+            x += 8; // Space
+        }
+    }
+
+private:
+    static const int kGlyphs = 70;
+
+    static uint8_t Blend(uint8_t foreground, uint8_t background, uint8_t coverage) {
+        return static_cast<uint8_t>((foreground * coverage + background * (255 - coverage)) / 255);
+    }
+
+    uint8_t _glyphs[kGlyphs][7 * 13];
+};
+
+Sample CodeEditor(TextRenderer &text) {
+    Sample sample{"code editor 1920x1080", MakeImage(1920, 1080)};
+    ImagePixels &image = sample.image;
+    Color background = {30, 30, 30, 255};
+    Fill(image, 0, 0, 1920, 1080, background);
+    Fill(image, 0, 0, 48, 1080, {37, 37, 38, 255});
+    Fill(image, 0, 0, 1920, 35, {50, 50, 52, 255});
+    const Color syntax[] = {{212, 212, 212, 255}, {86, 156, 214, 255}, {206, 145, 120, 255},
+                            {106, 153, 85, 255}, {197, 134, 192, 255}};
+    uint32_t state = 1;
+    for (uint32_t y = 45; y + 13 < 1080; y += 19) {
+        uint32_t indent = 60 + (NextRandom(state) % 6) * 32;
+        uint32_t x = indent;
+        while (x < 1500 && NextRandom(state) % 8) {
+            uint32_t width = 24 + NextRandom(state) % 200;
+            text.Draw(image, x, y, width, syntax[NextRandom(state) % 5], background, state);
+            x += width + 8;
+        }
+        text.Draw(image, 8, y, 32, {133, 133, 133, 255}, {37, 37, 38, 255}, state);
+    }
+    return sample;
+}
+
+Sample WebPage(TextRenderer &text) {
+    Sample sample{"web page 1920x1080", MakeImage(1920, 1080)};
+    ImagePixels &image = sample.image;
+    Fill(image, 0, 0, 1920, 1080, {255, 255, 255, 255});
+    for (uint32_t y = 0; y < 64; ++y) {
+        Fill(image, 0, y, 1920, 1, {static_cast<uint8_t>(20 + y / 4), 90, static_cast<uint8_t>(180 + y), 255});
+    }
+    Fill(image, 0, 64, 280, 1016, {246, 247, 249, 255});
+    uint32_t state = 2;
+    for (uint32_t y = 90; y < 1000; y += 36) {
+        text.Draw(image, 24, y, 200, {60, 64, 67, 255}, {246, 247, 249, 255}, state);
+    }
+    for (uint32_t y = 100; y + 13 < 1060; y += 22) {
+        if (NextRandom(state) % 9 == 0) {
+            y += 20;
+            Fill(image, 320, y, 140, 36, {26, 115, 232, 255});
+            text.Draw(image, 336, y + 12, 110, {255, 255, 255, 255}, {26, 115, 232, 255}, state);
+            y += 40;
+            continue;
+        }
+        text.Draw(image, 320, y, 900 + NextRandom(state) % 400, {32, 33, 36, 255}, {255, 255, 255, 255}, state);
+    }
+    return sample;
+}
+
+Sample PageWithPhoto(TextRenderer &text) {
+    Sample sample = WebPage(text);
+    sample.name = "page with photo 1920x1080";
+    ImagePixels &image = sample.image;
+    uint32_t state = 3;
+    for (uint32_t y = 300; y < 780; ++y) {
+        for (uint32_t x = 1300; x < 1900; ++x) {
+            uint32_t noise = NextRandom(state) % 24;
+            Color color = {static_cast<uint8_t>((x - 1300) * 200 / 600 + noise),
+                           static_cast<uint8_t>((y - 300) * 180 / 480 + noise),
+                           static_cast<uint8_t>(120 + noise * 3), 255};
+            memcpy(image.pixels.data() + y * image.stride + x * 4, &color, 4);
+        }
+    }
+    return sample;
+}
+
+Sample DialogWithShadow(TextRenderer &text) {
+    Sample sample{"dialog with shadow 840x640", MakeImage(840, 640)};
+    ImagePixels &image = sample.image;
+    const uint32_t margin = 20;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            uint32_t dx = x < margin ? margin - x : x >= image.width - margin ? x - (image.width - margin - 1) : 0;
+            uint32_t dy = y < margin ? margin - y : y >= image.height - margin ? y - (image.height - margin - 1) : 0;
+            uint32_t distance = std::max(dx, dy);
+            Color shadow = {0, 0, 0, static_cast<uint8_t>(distance ? 90 - distance * 90 / margin : 255)};
+            memcpy(image.pixels.data() + y * image.stride + x * 4, &shadow, 4);
+        }
+    }
+    Fill(image, margin, margin, 800, 600, {242, 242, 242, 255});
+    Fill(image, margin, margin, 800, 40, {222, 222, 222, 255});
+    uint32_t state = 4;
+    text.Draw(image, margin + 16, margin + 14, 200, {20, 20, 20, 255}, {222, 222, 222, 255}, state);
+    for (uint32_t y = margin + 70; y < margin + 500; y += 24) {
+        text.Draw(image, margin + 24, y, 600, {50, 50, 50, 255}, {242, 242, 242, 255}, state);
+    }
+    Fill(image, margin + 660, margin + 550, 120, 32, {0, 120, 212, 255});
+    return sample;
+}
+
+bool LoadPng(const char *path, ImagePixels &image) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path)) {
+        return false;
+    }
+    png.format = PNG_FORMAT_RGBA;
+    image = MakeImage(png.width, png.height);
+    return png_image_finish_read(&png, nullptr, image.pixels.data(), static_cast<png_int_32>(image.stride), nullptr);
+}
+
+void WriteToVector(png_structp png, png_bytep data, png_size_t size) {
+    auto *out = static_cast<std::vector<uint8_t> *>(png_get_io_ptr(png));
+    out->insert(out->end(), data, data + size);
+}
+
+void FlushNothing(png_structp png) {
+    (void)png;
+}
+
+// libpng with default compression and filters, RGB when opaque like a
+// pixbuf without alpha
+bool IsOpaque(const ImagePixels &image) {
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            if (static_cast<uint8_t>(image.pixels.data()[y * image.stride + x * 4 + 3]) != 255) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t EncodeLibpng(const ImagePixels &image) {
+    // Read after setjmp
+    volatile bool opaque = IsOpaque(image);
+    std::vector<uint8_t> out;
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png_create_info_struct(png);
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        return 0;
+    }
+    png_set_write_fn(png, &out, WriteToVector, FlushNothing);
+    png_set_IHDR(png, info, image.width, image.height, 8, opaque ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGBA,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    if (opaque) {
+        png_set_filler(png, 0, PNG_FILLER_AFTER);
+    }
+    for (uint32_t y = 0; y < image.height; ++y) {
+        png_write_row(png, reinterpret_cast<png_const_bytep>(image.pixels.data() + y * image.stride));
+    }
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+    return out.size();
+}
+
+size_t EncodeScreenshot(const ImagePixels &image) {
+    PooledBuffer out;
+    size_t out_size = 0;
+    return EncodeScreenshotPng(image, out, out_size) ? out_size : 0;
+}
+
+// Best of a few runs, in ms
+template<typename Func>
+double Time(Func func, size_t &size) {
+    double best = 1e9;
+    for (int i = 0; i < 3; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        size = func();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    std::vector<Sample> corpus;
+    for (int i = 1; i < argc; ++i) {
+        Sample sample{argv[i], ImagePixels()};
+        if (!LoadPng(argv[i], sample.image)) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        corpus.push_back(std::move(sample));
+    }
+    if (corpus.empty()) {
+        TextRenderer text;
+        corpus.push_back(CodeEditor(text));
+        corpus.push_back(WebPage(text));
+        corpus.push_back(PageWithPhoto(text));
+        corpus.push_back(DialogWithShadow(text));
+    }
+
+    printf("%-28s %21s %21s %8s %8s\n", "", "libpng default", "screenshot preset", "size", "speed");
+    double libpng_total_ms = 0, screenshot_total_ms = 0;
+    size_t libpng_total = 0, screenshot_total = 0;
+    for (const Sample &sample : corpus) {
+        size_t libpng_size = 0, screenshot_size = 0;
+        double libpng_ms = Time([&]() { return EncodeLibpng(sample.image); }, libpng_size);
+        double screenshot_ms = Time([&]() { return EncodeScreenshot(sample.image); }, screenshot_size);
+        printf("%-28s %8.1f ms %8zu B %8.1f ms %8zu B %7.1f%% %7.1fx\n", sample.name.c_str(), libpng_ms,
+               libpng_size, screenshot_ms, screenshot_size, 100.0 * screenshot_size / libpng_size,
+               libpng_ms / screenshot_ms);
+        libpng_total_ms += libpng_ms;
+        screenshot_total_ms += screenshot_ms;
+        libpng_total += libpng_size;
+        screenshot_total += screenshot_size;
+    }
+    printf("%-28s %8.1f ms %8zu B %8.1f ms %8zu B %7.1f%% %7.1fx\n", "total", libpng_total_ms, libpng_total,
+           screenshot_total_ms, screenshot_total, 100.0 * screenshot_total / libpng_total,
+           libpng_total_ms / screenshot_total_ms);
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <png.h>
+#include <zlib.h>
+#include "deflate_encoder.h"
+#include "png_encoder.h"
+#include "check.h"
+#include "test_image.h"
+
+class CancelSink : public ProgressSink {
+public:
+    bool Report(ProgressPhase phase, uint64_t done, uint64_t total) override {
+        (void)phase;
+        (void)done;
+        (void)total;
+        return false;
+    }
+};
+
+uint32_t NextRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// Decodes with libpng, which checks every CRC and the Adler-32, and
+// compares with the source pixels. Returns the IHDR color type.
+int CheckRoundTrip(const ImagePixels &image, int expected_depth = 0) {
+    PooledBuffer png;
+    size_t png_size = 0;
+    CHECK(EncodeScreenshotPng(image, png, png_size));
+    if (png_size < 33) {
+        return -1;
+    }
+    const auto *bytes = reinterpret_cast<const uint8_t *>(png.data());
+    if (expected_depth) {
+        CHECK(bytes[24] == expected_depth);
+    }
+
+    png_image decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    decoded.version = PNG_IMAGE_VERSION;
+    CHECK(png_image_begin_read_from_memory(&decoded, bytes, png_size));
+    decoded.format = PNG_FORMAT_RGBA;
+    std::vector<uint8_t> pixels(PNG_IMAGE_SIZE(decoded));
+    CHECK(png_image_finish_read(&decoded, nullptr, pixels.data(), 0, nullptr));
+    CHECK(decoded.width == image.width && decoded.height == image.height);
+    if (decoded.width != image.width || decoded.height != image.height) {
+        return -1;
+    }
+    bool same = true;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        same = same && memcmp(pixels.data() + y * image.width * 4, image.pixels.data() + y * image.stride,
+                              image.width * 4) == 0;
+    }
+    CHECK(same);
+    return bytes[25];
+}
+
+void TestPalette() {
+    // Two colors: 1 bit indices, with a width that leaves a partial byte
+    ImagePixels image = MakeImage(13, 7, 13 * 4 + 8, 0x5a);
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            bool on = (x + y) % 3 == 0;
+            SetPixel(image, x, y, on ? 255 : 30, on ? 255 : 30, on ? 255 : 30, 255);
+        }
+    }
+    CHECK(CheckRoundTrip(image, 1) == 3);
+
+    // 16 colors, some of them translucent: 4 bits and a tRNS chunk
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            uint8_t color = static_cast<uint8_t>((x * 7 + y) % 16);
+            SetPixel(image, x, y, color * 16, 255 - color * 16, color, color < 4 ? color * 60 : 255);
+        }
+    }
+    CHECK(CheckRoundTrip(image, 4) == 3);
+
+    // 256 colors still fit, with 8 bit indices
+    ImagePixels gray = MakeImage(256, 3, 256 * 4, 0x5a);
+    for (uint32_t y = 0; y < gray.height; ++y) {
+        for (uint32_t x = 0; x < gray.width; ++x) {
+            SetPixel(gray, x, y, static_cast<uint8_t>(x), static_cast<uint8_t>(x), 0, 255);
+        }
+    }
+    CHECK(CheckRoundTrip(gray, 8) == 3);
+}
+
+void TestTruecolor() {
+    // More than 256 colors, opaque: RGB without alpha
+    ImagePixels image = MakeImage(300, 40, 300 * 4 + 4, 0x5a);
+    uint32_t state = 1;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            // Gradients, flat bands and noise, so that every filter wins somewhere
+            uint8_t noise = static_cast<uint8_t>(NextRandom(state));
+            if (y < 10) {
+                SetPixel(image, x, y, static_cast<uint8_t>(x), static_cast<uint8_t>(y * 5), 90, 255);
+            } else if (y < 20) {
+                SetPixel(image, x, y, 200, 200, 200, 255);
+            } else {
+                SetPixel(image, x, y, noise, static_cast<uint8_t>(x + y), static_cast<uint8_t>(noise / 2), 255);
+            }
+        }
+    }
+    CHECK(CheckRoundTrip(image, 8) == 2);
+
+    // The same with alpha: RGBA
+    SetPixel(image, 5, 5, 1, 2, 3, 128);
+    CHECK(CheckRoundTrip(image, 8) == 6);
+}
+
+void TestFlatImage() {
+    // A blank 1920x1080 window shrinks to almost nothing
+    ImagePixels image = MakeImage(1920, 1080, 1920 * 4, 0x5a);
+    for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+            SetPixel(image, x, y, 240, 240, 240, 255);
+        }
+    }
+    PooledBuffer png;
+    size_t png_size = 0;
+    CHECK(EncodeScreenshotPng(image, png, png_size));
+    CHECK(png_size < 4096);
+    CheckRoundTrip(image, 1);
+
+    CancelSink cancel;
+    CHECK(!EncodeScreenshotPng(image, png, png_size, &cancel));
+}
+
+std::vector<uint8_t> Inflate(const PooledBuffer &compressed, size_t size, size_t expected) {
+    std::vector<uint8_t> out(expected + 1);
+    uLongf out_size = static_cast<uLongf>(out.size());
+    int result = uncompress(out.data(), &out_size, reinterpret_cast<const Bytef *>(compressed.data()),
+                            static_cast<uLong>(size));
+    CHECK(result == Z_OK);
+    out.resize(result == Z_OK ? out_size : 0);
+    return out;
+}
+
+void CheckDeflate(const std::vector<uint8_t> &data) {
+    PooledBuffer compressed;
+    size_t size = 0;
+    DeflateOptions options;
+    options.run_distances[1] = 4;
+    options.run_distances[2] = 1001;
+    CHECK(CompressZlib(data.data(), data.size(), options, compressed, size));
+    CHECK(Inflate(compressed, size, data.size()) == data);
+}
+
+void TestDeflate() {
+    CHECK(Adler32(reinterpret_cast<const uint8_t *>("Wikipedia"), 9) == 0x11e60398);
+    CheckDeflate({});
+    CheckDeflate({42});
+
+    // Incompressible: stored blocks
+    uint32_t state = 7;
+    std::vector<uint8_t> noise(200000);
+    for (uint8_t &byte : noise) {
+        byte = static_cast<uint8_t>(NextRandom(state));
+    }
+    CheckDeflate(noise);
+
+    // Fibonacci frequencies need codes longer than 15 bits before limiting
+    std::vector<uint8_t> skewed;
+    uint32_t a = 1, b = 1;
+    for (int symbol = 0; symbol < 26; ++symbol) {
+        skewed.insert(skewed.end(), a, static_cast<uint8_t>(symbol * 9));
+        uint32_t next = a + b;
+        a = b;
+        b = next;
+    }
+    for (size_t i = skewed.size() - 1; i > 0; --i) {
+        std::swap(skewed[i], skewed[NextRandom(state) % (i + 1)]);
+    }
+    CheckDeflate(skewed);
+
+    // Runs, repeats at the row distance and text-like data over many blocks
+    std::vector<uint8_t> mixed;
+    for (int row = 0; row < 3000; ++row) {
+        for (int i = 0; i < 1001; ++i) {
+            if (row % 7 == 0) {
+                mixed.push_back(static_cast<uint8_t>(i % 4 == 3 ? 255 : i / 4));
+            } else if (row % 7 < 4) {
+                mixed.push_back(mixed[mixed.size() - 1001]);
+            } else {
+                mixed.push_back(static_cast<uint8_t>("lorem ipsum dolor sit amet "[NextRandom(state) % 27]));
+            }
+        }
+    }
+    CheckDeflate(mixed);
+}
+
+int main() {
+    TestPalette();
+    TestTruecolor();
+    TestFlatImage();
+    TestDeflate();
+    return CheckResult("png_encoder");
+}
@@ -0,0 +1,33 @@
+#ifndef ELECTRON_CLIPBOARD_EX_TEST_IMAGE_H
+#define ELECTRON_CLIPBOARD_EX_TEST_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "clipboard.h"
+
+// RGBA image of `stride` bytes per row, tightly packed when 0, with every
+// byte set to `fill`
+inline ImagePixels MakeImage(uint32_t width, uint32_t height, size_t stride = 0, uint8_t fill = 0) {
+    ImagePixels image;
+    image.width = width;
+    image.height = height;
+    image.stride = stride ? stride : static_cast<size_t>(width) * 4;
+    image.pixels = PooledBuffer(image.stride * height);
+    memset(image.pixels.data(), fill, image.stride * height);
+    return image;
+}
+
+inline uint8_t *PixelAt(const ImagePixels &image, uint32_t x, uint32_t y) {
+    return reinterpret_cast<uint8_t *>(image.pixels.data() + y * image.stride + x * 4);
+}
+
+inline void SetPixel(ImagePixels &image, uint32_t x, uint32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    uint8_t *pixel = PixelAt(image, x, y);
+    pixel[0] = r;
+    pixel[1] = g;
+    pixel[2] = b;
+    pixel[3] = a;
+}
+
+#endif //ELECTRON_CLIPBOARD_EX_TEST_IMAGE_H
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "tile_store.h"
+#include "check.h"
+#include "test_image.h"
+
+// A gradient, so that every tile differs from its neighbours
+ImagePixels MakeGradient(uint32_t width, uint32_t height) {
+    ImagePixels image = MakeImage(width, height, static_cast<size_t>(width) * 4 + 12); // Padded rows
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            SetPixel(image, x, y, static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(x ^ y), 0xff);
+        }
+    }
+    return image;
+}
+
+void Paint(ImagePixels &image, uint32_t x, uint32_t y) {
+    image.pixels.data()[y * image.stride + x * 4] ^= 0x55;
+}
+
+bool SamePixels(const ImagePixels &a, const ImagePixels &b) {
+    if (a.width != b.width || a.height != b.height) {
+        return false;
+    }
+    for (uint32_t y = 0; y < a.height; ++y) {
+        if (memcmp(a.pixels.data() + y * a.stride, b.pixels.data() + y * b.stride, a.width * 4) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestRoundTrip() {
+    TileStore store(16);
+    ImagePixels image = MakeGradient(50, 35); // Partial tiles on both edges
+    TileStore::EntryInfo info = store.Add(image);
+    CHECK(info.tiles == 4 * 3);
+    CHECK(info.new_tiles == info.tiles);
+    CHECK(info.delta_bytes == 50 * 35 * 4);
+    ImagePixels read;
+    CHECK(store.Read(info.id, read));
+    CHECK(SamePixels(image, read));
+    CHECK(!store.Read(info.id + 1, read));
+}
+
+void TestDeduplication() {
+    TileStore store(16);
+    ImagePixels first = MakeGradient(64, 64);
+    ImagePixels second = MakeGradient(64, 64);
+    Paint(second, 20, 5);
+    Paint(second, 40, 5); // Same tile row, adjacent changed tiles merge
+    Paint(second, 3, 60);
+
+    TileStore::EntryInfo a = store.Add(first);
+    TileStore::EntryInfo b = store.Add(second);
+    CHECK(b.new_tiles == 3);
+    CHECK(b.delta_bytes == 3 * 16 * 16 * 4);
+    TileStore::Stats stats = store.GetStats();
+    CHECK(stats.entries == 2);
+    CHECK(stats.unique_tiles == 16 + 3);
+    CHECK(stats.logical_bytes == 2 * 64 * 64 * 4);
+
+    std::vector<TileStore::Region> regions;
+    CHECK(store.ChangedRegions(b.id, a.id, regions));
+    CHECK(regions.size() == 2);
+    CHECK(regions[0].x == 16 && regions[0].y == 0 && regions[0].width == 32 && regions[0].height == 16);
+    CHECK(regions[1].x == 0 && regions[1].y == 48 && regions[1].width == 16 && regions[1].height == 16);
+    CHECK(store.ChangedRegions(a.id, a.id, regions) && regions.empty());
+
+    ImagePixels read;
+    CHECK(store.Read(b.id, read) && SamePixels(second, read));
+    CHECK(store.Remove(a.id));
+    CHECK(!store.Remove(a.id));
+    CHECK(store.GetStats().unique_tiles == 16);
+    CHECK(store.Read(b.id, read) && SamePixels(second, read));
+    CHECK(store.Remove(b.id));
+    stats = store.GetStats();
+    CHECK(stats.unique_tiles == 0 && stats.stored_bytes == 0 && stats.logical_bytes == 0);
+}
+
+void TestVerticalMerge() {
+    TileStore store(8);
+    ImagePixels first = MakeGradient(32, 32);
+    ImagePixels second = MakeGradient(32, 32);
+    for (uint32_t y = 0; y < 24; y += 8) {
+        Paint(second, 9, y + 1);
+    }
+    TileStore::EntryInfo a = store.Add(first);
+    TileStore::EntryInfo b = store.Add(second);
+    std::vector<TileStore::Region> regions;
+    CHECK(store.ChangedRegions(b.id, a.id, regions));
+    CHECK(regions.size() == 1);
+    CHECK(regions[0].x == 8 && regions[0].y == 0 && regions[0].width == 8 && regions[0].height == 24);
+
+    TileStore::EntryInfo c = store.Add(MakeGradient(16, 16));
+    CHECK(store.ChangedRegions(c.id, a.id, regions) && regions.size() == 1 && regions[0].width == 16);
+}
+
+int main() {
+    TestRoundTrip();
+    TestDeduplication();
+    TestVerticalMerge();
+    return CheckResult("tile_store");
+}
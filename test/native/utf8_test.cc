@@ -0,0 +1,43 @@
+#include <string>
+#include "utf8.h"
+#include "check.h"
+
+std::string ToLatin1(const std::string &utf8) {
+    std::string out(utf8.size(), '\0');
+    out.resize(Utf8ToLatin1(utf8.data(), utf8.size(), &out[0]));
+    return out;
+}
+
+std::string ToUtf8(const std::string &latin1) {
+    std::string out(Latin1ToUtf8Length(latin1.data(), latin1.size()), '\0');
+    CHECK(Latin1ToUtf8(latin1.data(), latin1.size(), &out[0]) == out.size());
+    return out;
+}
+
+void TestValidate() {
+    CHECK(IsValidUtf8("", 0));
+    CHECK(IsValidUtf8("plain ascii text that is longer than sixteen bytes", 50));
+    CHECK(IsValidUtf8("\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", 9));
+    CHECK(!IsValidUtf8("\xc0\xaf", 2)); // Overlong
+    CHECK(!IsValidUtf8("\xed\xa0\x80", 3)); // Surrogate
+    CHECK(!IsValidUtf8("\xf4\x90\x80\x80", 4)); // Above U+10FFFF
+    CHECK(!IsValidUtf8("\xe2\x82", 2)); // Truncated
+}
+
+void TestLatin1() {
+    std::string latin1 = "caf\xe9 \xa0\xff and a long ASCII tail after it";
+    CHECK(ToUtf8(latin1) == "caf\xc3\xa9 \xc2\xa0\xc3\xbf and a long ASCII tail after it");
+    CHECK(ToLatin1(ToUtf8(latin1)) == latin1);
+
+    // Outside Latin-1: one '?' per character, whatever its length
+    CHECK(ToLatin1("\xe2\x82\xac 5, \xf0\x9f\x98\x80!") == "? 5, ?!");
+    // Invalid bytes: one '?' each
+    CHECK(ToLatin1("a\x80\x80" "b\xc3") == "a??b?");
+    CHECK(ToLatin1("") == "");
+}
+
+int main() {
+    TestValidate();
+    TestLatin1();
+    return CheckResult("utf8");
+}
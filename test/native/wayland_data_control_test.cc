@@ -0,0 +1,113 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "wayland_data_control.h"
+#include "check.h"
+
+// Runs the data-control backend against a headless compositor: a selection
+// written by this client is read back through the compositor, as another
+// client would.
+
+using wayland_data_control::Payload;
+
+const char kTextMime[] = "text/plain;charset=utf-8";
+const size_t kLargeSize = 48 * 1024 * 1024;
+
+bool Offers(ClipboardSelection selection, const std::string &mime_type) {
+    std::vector<std::string> mime_types = wayland_data_control::GetMimeTypes(selection);
+    return std::find(mime_types.begin(), mime_types.end(), mime_type) != mime_types.end();
+}
+
+std::string ReadString(ClipboardSelection selection, const std::string &mime_type) {
+    ClipboardData data;
+    if (!wayland_data_control::Read(selection, mime_type, data)) {
+        return "<failed>";
+    }
+    return std::string(data.data(), data.size());
+}
+
+void TestWriteRead() {
+    const std::string text = "data-control text";
+    uint64_t sequence = wayland_data_control::SequenceNumber(ClipboardSelection::Clipboard);
+    std::shared_ptr<Payload> payload = Payload::FromBytes(text.data(), text.size());
+    CHECK(wayland_data_control::Write(ClipboardSelection::Clipboard, {{kTextMime, payload}, {"text/plain", payload}}));
+    CHECK(wayland_data_control::SequenceNumber(ClipboardSelection::Clipboard) > sequence);
+    CHECK(Offers(ClipboardSelection::Clipboard, kTextMime));
+    CHECK(Offers(ClipboardSelection::Clipboard, "text/plain"));
+    CHECK(!Offers(ClipboardSelection::Clipboard, "image/png"));
+    CHECK(ReadString(ClipboardSelection::Clipboard, kTextMime) == text);
+    CHECK(ReadString(ClipboardSelection::Clipboard, "text/plain") == text);
+
+    ClipboardData missing;
+    CHECK(!wayland_data_control::Read(ClipboardSelection::Clipboard, "image/png", missing));
+
+    CHECK(wayland_data_control::Clear(ClipboardSelection::Clipboard));
+    CHECK(!Offers(ClipboardSelection::Clipboard, kTextMime));
+}
+
+void TestPrimary() {
+    if (!wayland_data_control::IsAvailable(ClipboardSelection::Primary)) {
+        fprintf(stderr, "wayland_data_control: compositor lacks the primary selection, skipped\n");
+        return;
+    }
+    const std::string clipboard = "clipboard text";
+    const std::string primary = "primary text";
+    CHECK(wayland_data_control::Write(ClipboardSelection::Clipboard,
+                                      {{kTextMime, Payload::FromBytes(clipboard.data(), clipboard.size())}}));
+    CHECK(wayland_data_control::Write(ClipboardSelection::Primary,
+                                      {{kTextMime, Payload::FromBytes(primary.data(), primary.size())}}));
+    // Each selection keeps its own owner
+    CHECK(ReadString(ClipboardSelection::Primary, kTextMime) == primary);
+    CHECK(ReadString(ClipboardSelection::Clipboard, kTextMime) == clipboard);
+
+    CHECK(wayland_data_control::Clear(ClipboardSelection::Primary));
+    CHECK(!Offers(ClipboardSelection::Primary, kTextMime));
+    CHECK(ReadString(ClipboardSelection::Clipboard, kTextMime) == clipboard);
+}
+
+// Many times the pipe buffer, so the owner and ReadToFd splice concurrently
+void TestLargeReadToFd() {
+    std::string bytes(kLargeSize, '\0');
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = static_cast<char>((i * 131) >> 7);
+    }
+    CHECK(wayland_data_control::Write(ClipboardSelection::Clipboard,
+                                      {{"application/octet-stream", Payload::FromBytes(bytes.data(), bytes.size())}}));
+
+    int fd = memfd_create("wayland_data_control_test", MFD_CLOEXEC);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    CHECK(wayland_data_control::ReadToFd(ClipboardSelection::Clipboard, "application/octet-stream", fd));
+    CHECK(lseek(fd, 0, SEEK_CUR) == static_cast<off_t>(kLargeSize));
+
+    std::string read(kLargeSize, '\0');
+    size_t size = 0;
+    while (size < read.size()) {
+        ssize_t n = pread(fd, &read[size], read.size() - size, static_cast<off_t>(size));
+        if (n <= 0) {
+            break;
+        }
+        size += static_cast<size_t>(n);
+    }
+    close(fd);
+    CHECK(size == kLargeSize);
+    CHECK(read == bytes);
+    CHECK(wayland_data_control::Clear(ClipboardSelection::Clipboard));
+}
+
+int main() {
+    if (!wayland_data_control::IsAvailable(ClipboardSelection::Clipboard)) {
+        fprintf(stderr, "wayland_data_control: no data-control compositor, run with `make test-wayland`\n");
+        return EXIT_FAILURE;
+    }
+    TestWriteRead();
+    TestPrimary();
+    TestLargeReadToFd();
+    return CheckResult("wayland_data_control");
+}
@@ -3,7 +3,9 @@ const fs = require('fs-extra');
 const {
   clear,
   saveImageAsJpeg, saveImageAsPng, putImage,
-  saveImageAsJpegSync, saveImageAsPngSync, putImageSync, hasImage
+  saveImageAsJpegSync, saveImageAsPngSync, putImageSync, hasImage,
+  writeMulti, readFilePaths, readText, startAutoArchive, thumbnailsForPaths,
+  convertImages,
 } = require('..');
 
 const tempPath = path.resolve(__dirname, '../temp');
@@ -36,6 +38,82 @@ test('save png -- normal', async () => {
   expect(fs.pathExistsSync(pngPath)).toBe(true);
 });
 
+test('save png -- progress', async () => {
+  expect(await putImage(sourceImage)).toBe(true);
+  const phases = new Set();
+  const result = await saveImageAsPng(pngPath, {onProgress: ({phase}) => phases.add(phase)});
+  expect(result).toBe(true);
+  // Updates may still be queued when the promise resolves
+  await new Promise((resolve) => setImmediate(resolve));
+  expect(phases.has('encode')).toBe(true);
+});
+
+test('save png -- screenshot preset', async () => {
+  expect(await putImage(sourceImage)).toBe(true);
+  const result = await saveImageAsPng(pngPath, {preset: 'screenshot'});
+  expect(result).toBe(true);
+  const header = fs.readFileSync(pngPath).subarray(0, 8);
+  expect(header.equals(Buffer.from([0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a]))).toBe(true);
+  expect(() => saveImageAsPngSync(pngPath, {preset: 'tiny'})).toThrow(TypeError);
+});
+
+test('save png -- aborted', async () => {
+  expect(await putImage(sourceImage)).toBe(true);
+  const controller = new AbortController();
+  controller.abort();
+  await expect(saveImageAsPng(pngPath, {signal: controller.signal})).rejects.toMatchObject({name: 'AbortError'});
+  expect(fs.pathExistsSync(pngPath)).toBe(false);
+});
+
+test('auto archive -- deduped and scaled', async () => {
+  const archive = startAutoArchive(tempPath, {maxSize: 16, interval: 20});
+  try {
+    const archived = new Promise((resolve, reject) => {
+      archive.once('archived', resolve);
+      archive.once('error', reject);
+    });
+    expect(await putImage(sourceImage)).toBe(true);
+    const image = await archived;
+    expect(Math.max(image.width, image.height)).toBeLessThanOrEqual(16);
+    expect(fs.pathExistsSync(image.path)).toBe(true);
+
+    const events = [];
+    archive.on('archived', (event) => events.push(event));
+    expect(await putImage(sourceImage)).toBe(true);
+    await new Promise((resolve) => setTimeout(resolve, 200));
+    expect(events).toHaveLength(0);
+  } finally {
+    archive.stop();
+  }
+});
+
+test('thumbnails -- generated then cached', async () => {
+  const paths = [sourceImage, path.resolve(tempPath, 'missing.png')];
+  const collect = async () => {
+    const results = [];
+    for await (const result of thumbnailsForPaths(paths, {size: 32, cacheDir: tempPath})) {
+      results[result.index] = result;
+    }
+    return results;
+  };
+  const [image, missing] = await collect();
+  expect(image.cached).toBe(false);
+  expect(fs.pathExistsSync(image.thumbnailPath)).toBe(true);
+  expect(missing.error).toBeTruthy();
+  expect((await collect())[0]).toMatchObject({thumbnailPath: image.thumbnailPath, cached: true});
+});
+
+test('convert images -- scaled and failed tasks', async () => {
+  const results = await convertImages([
+    {src: sourceImage, dst: jpegPath, maxSize: 8},
+    {src: path.resolve(tempPath, 'missing.png'), dst: pngPath},
+  ]);
+  expect(Math.max(results[0].width, results[0].height)).toBe(8);
+  expect(fs.pathExistsSync(jpegPath)).toBe(true);
+  expect(results[1].error).toBeTruthy();
+  expect(fs.pathExistsSync(pngPath)).toBe(false);
+});
+
 test('save jpeg sync -- normal', () => {
   expect(putImageSync(sourceImage)).toBe(true);
   const result = saveImageAsJpegSync(jpegPath, 1.0);
@@ -74,3 +152,21 @@ test('has image -- true', () => {
   putImageSync(sourceImage);
   expect(hasImage()).toBe(true);
 });
+
+test('write multi -- files, image and text', () => {
+  expect(writeMulti({files: [sourceImage], imagePath: sourceImage})).toBe(true);
+  expect(readFilePaths()).toEqual([sourceImage]);
+  expect(hasImage()).toBe(true);
+  expect(readText()).toBe(sourceImage);
+  expect(saveImageAsPngSync(pngPath)).toBe(true);
+});
+
+test('write multi -- image buffer', () => {
+  expect(writeMulti({imageBuffer: fs.readFileSync(sourceImage), text: 'image'})).toBe(true);
+  expect(hasImage()).toBe(true);
+  expect(readText()).toBe('image');
+});
+
+test('write multi -- non-exist image', () => {
+  expect(writeMulti({imagePath: '/non/exist/path'})).toBe(false);
+});
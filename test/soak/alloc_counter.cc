@@ -0,0 +1,165 @@
+// LD_PRELOAD shim counting heap operations of the whole process. Counters
+// live in a shared mapping of the file named by ALLOC_COUNTER_FILE, so
+// soak.js reads them synchronously as little-endian uint64s, see `Counters`
+// for the layout. glibc's mallinfo is refreshed there every 100 ms.
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+}
+
+namespace {
+
+struct Counters {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<int64_t> live_bytes; // malloc_usable_size of the blocks not freed yet
+    std::atomic<uint64_t> allocated_bytes;
+    std::atomic<uint64_t> arena_bytes; // mallinfo: heap obtained with sbrk
+    std::atomic<uint64_t> mmap_bytes; // mallinfo: blocks obtained with mmap
+    std::atomic<uint64_t> in_use_bytes; // mallinfo: allocated heap blocks
+    std::atomic<uint64_t> free_bytes; // mallinfo: free heap blocks
+};
+
+// Counts go here until the file is mapped
+Counters early_counters;
+std::atomic<Counters *> counters{&early_counters};
+
+void *Counted(void *pointer) {
+    if (pointer) {
+        size_t size = malloc_usable_size(pointer);
+        Counters *c = counters.load(std::memory_order_relaxed);
+        c->allocations.fetch_add(1, std::memory_order_relaxed);
+        c->allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        c->live_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    }
+    return pointer;
+}
+
+void Uncount(size_t size) {
+    Counters *c = counters.load(std::memory_order_relaxed);
+    c->frees.fetch_add(1, std::memory_order_relaxed);
+    c->live_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+void *PublishMallinfo(void *) {
+    for (;;) {
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+        struct mallinfo2 info = mallinfo2();
+#else
+        struct mallinfo info = mallinfo();
+#endif
+        Counters *c = counters.load(std::memory_order_relaxed);
+        c->arena_bytes.store(static_cast<uint64_t>(info.arena), std::memory_order_relaxed);
+        c->mmap_bytes.store(static_cast<uint64_t>(info.hblkhd), std::memory_order_relaxed);
+        c->in_use_bytes.store(static_cast<uint64_t>(info.uordblks), std::memory_order_relaxed);
+        c->free_bytes.store(static_cast<uint64_t>(info.fordblks), std::memory_order_relaxed);
+        usleep(100 * 1000);
+    }
+    return nullptr;
+}
+
+__attribute__((constructor)) void StartPublishing() {
+    const char *path = getenv("ALLOC_COUNTER_FILE");
+    if (!path || !*path) {
+        return;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(Counters)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    void *mapping = mmap(nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+    // The file starts zeroed, carry over what was counted while loading
+    auto *mapped = static_cast<Counters *>(mapping);
+    mapped->allocations.store(early_counters.allocations.load());
+    mapped->frees.store(early_counters.frees.load());
+    mapped->live_bytes.store(early_counters.live_bytes.load());
+    mapped->allocated_bytes.store(early_counters.allocated_bytes.load());
+    counters.store(mapped);
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, PublishMallinfo, nullptr) == 0) {
+        pthread_detach(thread);
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void *malloc(size_t size) {
+    return Counted(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size) {
+    return Counted(__libc_calloc(count, size));
+}
+
+void *realloc(void *pointer, size_t size) {
+    if (!pointer) {
+        return Counted(__libc_realloc(nullptr, size));
+    }
+    // A resize counts as a free and an allocation
+    size_t old_size = malloc_usable_size(pointer);
+    void *result = __libc_realloc(pointer, size);
+    if (result || size == 0) {
+        Uncount(old_size);
+    }
+    return Counted(result);
+}
+
+void free(void *pointer) {
+    if (pointer) {
+        Uncount(malloc_usable_size(pointer));
+    }
+    __libc_free(pointer);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    return Counted(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return Counted(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *pointer = Counted(__libc_memalign(alignment, size));
+    if (!pointer && size) {
+        return ENOMEM;
+    }
+    *result = pointer;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    return Counted(__libc_memalign(static_cast<size_t>(sysconf(_SC_PAGESIZE)), size));
+}
+
+void *pvalloc(size_t size) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return Counted(__libc_memalign(page, (size + page - 1) / page * page));
+}
+
+} // extern "C"
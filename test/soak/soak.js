@@ -0,0 +1,268 @@
+'use strict';
+
+// Runs tens of thousands of mixed clipboard operations and fails when RSS or
+// the live heap keeps growing. Meant for Linux under Xvfb, see
+// `npm run test:soak`; with test/soak/alloc_counter.so preloaded it also
+// reports allocations per operation and glibc's malloc statistics.
+//
+// Environment:
+//   SOAK_OPERATIONS       operations of the soak phase, default 100000
+//   SOAK_CONCURRENCY      operation lanes, async ones overlap, default 4
+//   SOAK_MAX_RSS_GROWTH   MiB the RSS trend may add after warm-up, default 32
+//   SOAK_MAX_HEAP_GROWTH  MiB the live malloc heap trend may add, default 8
+//   ALLOC_COUNTER_FILE    counters written by alloc_counter.so
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const clipboard = require('../..');
+
+const OPERATIONS = Number(process.env.SOAK_OPERATIONS || 100000);
+const CONCURRENCY = Number(process.env.SOAK_CONCURRENCY || 4);
+const MAX_RSS_GROWTH = Number(process.env.SOAK_MAX_RSS_GROWTH || 32) * 1024 * 1024;
+const MAX_HEAP_GROWTH = Number(process.env.SOAK_MAX_HEAP_GROWTH || 8) * 1024 * 1024;
+const CALIBRATION_RUNS = 200;
+const SAMPLES = 100;
+const WARM_UP = 0.2;
+
+const IMAGE_PATH = path.join(__dirname, '..', 'data', 'image.png');
+const workDir = fs.mkdtempSync(path.join(os.tmpdir(), 'clipboard-soak-'));
+
+// Counters of alloc_counter.cc, in the order of its `Counters` struct
+const COUNTER_NAMES = [
+  'allocations', 'frees', 'liveBytes', 'allocatedBytes',
+  'arenaBytes', 'mmapBytes', 'inUseBytes', 'freeBytes',
+];
+
+function readCounters() {
+  const file = process.env.ALLOC_COUNTER_FILE;
+  if (!file) {
+    return null;
+  }
+  const bytes = fs.readFileSync(file);
+  const values = new BigInt64Array(bytes.buffer, bytes.byteOffset, COUNTER_NAMES.length);
+  const counters = {};
+  COUNTER_NAMES.forEach((name, i) => {
+    counters[name] = Number(values[i]);
+  });
+  return counters;
+}
+
+function collectGarbage() {
+  if (global.gc) {
+    global.gc();
+  }
+}
+
+// Deterministic, so that a failing run can be repeated
+function random(state) {
+  state.seed = (Math.imul(state.seed, 1664525) + 1013904223) >>> 0;
+  return state.seed / 0x100000000;
+}
+
+function randomText(state) {
+  const length = 1 + Math.floor(random(state) * 4096);
+  return 'soak é中 '.repeat(Math.ceil(length / 8)).slice(0, length);
+}
+
+function randomPaths(state) {
+  const paths = [];
+  const count = 1 + Math.floor(random(state) * 16);
+  for (let i = 0; i < count; i++) {
+    paths.push(path.join(workDir, `file ${i} #${Math.floor(random(state) * 1000)}.txt`));
+  }
+  return paths;
+}
+
+// [name, weight, run(state, lane)], image operations are far slower than
+// the others and get a lower weight
+const OPERATION_TYPES = [
+  ['writeText/readText', 20, (state) => {
+    clipboard.writeText(randomText(state));
+    clipboard.readText();
+  }],
+  ['readText buffer', 5, () => {
+    clipboard.readText({as: 'buffer'});
+  }],
+  ['primary text', 5, (state) => {
+    clipboard.writeText(randomText(state), {selection: 'primary'});
+    clipboard.readText({selection: 'primary'});
+  }],
+  ['writeFilePaths/readFilePaths', 15, (state) => {
+    clipboard.writeFilePaths(randomPaths(state));
+    clipboard.readFilePaths();
+  }],
+  ['writeRich/readRich', 10, (state) => {
+    clipboard.writeRich({html: `<p>${randomText(state)}</p>`, rtf: '{\\rtf1 soak}'});
+    clipboard.readRich();
+  }],
+  ['writeMulti', 5, (state) => {
+    clipboard.writeMulti({files: randomPaths(state), imagePath: IMAGE_PATH});
+    clipboard.readFilePaths();
+    clipboard.hasImage();
+  }],
+  ['putImageSync/hasImage', 3, () => {
+    clipboard.putImageSync(IMAGE_PATH);
+    clipboard.hasImage();
+  }],
+  ['putImage', 2, () => clipboard.putImage(IMAGE_PATH)],
+  ['saveImageAsPng', 2, (state, lane) => clipboard.saveImageAsPng(path.join(workDir, `${lane}.png`))],
+  ['saveImageAsJpeg', 2, (state, lane) => clipboard.saveImageAsJpeg(path.join(workDir, `${lane}.jpg`), 0.8)],
+  ['aborted save', 1, (state, lane) => {
+    const controller = new AbortController();
+    const saving = clipboard.saveImageAsPng(path.join(workDir, `${lane}-aborted.png`), {signal: controller.signal});
+    controller.abort();
+    return saving.catch((error) => {
+      if (error.name !== 'AbortError') {
+        throw error;
+      }
+    });
+  }],
+  ['clear/getSequenceNumber', 5, () => {
+    clipboard.clear();
+    clipboard.getSequenceNumber();
+  }],
+];
+
+const TOTAL_WEIGHT = OPERATION_TYPES.reduce((sum, [, weight]) => sum + weight, 0);
+
+function pickOperation(state) {
+  let pick = random(state) * TOTAL_WEIGHT;
+  for (const type of OPERATION_TYPES) {
+    pick -= type[1];
+    if (pick < 0) {
+      return type;
+    }
+  }
+  return OPERATION_TYPES[OPERATION_TYPES.length - 1];
+}
+
+// Allocations and retained bytes per operation, one type at a time
+async function calibrate() {
+  const state = {seed: 1};
+  const overhead = readCounters();
+  const baseline = readCounters();
+  const readCost = baseline.allocations - overhead.allocations;
+  const results = [];
+  for (const [name, , run] of OPERATION_TYPES) {
+    await run(state, 'calibration'); // First use initializes caches
+    collectGarbage();
+    const before = readCounters();
+    for (let i = 0; i < CALIBRATION_RUNS; i++) {
+      await run(state, 'calibration');
+    }
+    collectGarbage();
+    const after = readCounters();
+    results.push({
+      name,
+      allocationsPerOp: Math.max(0, (after.allocations - before.allocations - readCost) / CALIBRATION_RUNS),
+      bytesPerOp: (after.allocatedBytes - before.allocatedBytes) / CALIBRATION_RUNS,
+      retainedPerOp: (after.liveBytes - before.liveBytes) / CALIBRATION_RUNS,
+    });
+  }
+  return results;
+}
+
+function sample(done) {
+  collectGarbage();
+  return {done, rss: process.memoryUsage().rss, counters: readCounters()};
+}
+
+async function soak() {
+  const samples = [sample(0)];
+  const sampleEvery = Math.max(1, Math.floor(OPERATIONS / SAMPLES));
+  let next = 0;
+  let done = 0;
+  const lane = async (index) => {
+    const state = {seed: 1000 + index};
+    while (next < OPERATIONS) {
+      next++;
+      const [, , run] = pickOperation(state);
+      await run(state, index);
+      done++;
+      if (done % sampleEvery === 0) {
+        samples.push(sample(done));
+      }
+    }
+  };
+  const lanes = [];
+  for (let i = 0; i < CONCURRENCY; i++) {
+    lanes.push(lane(i));
+  }
+  await Promise.all(lanes);
+  return samples;
+}
+
+// Least squares slope of `value` per operation
+function slope(samples, value) {
+  const n = samples.length;
+  const meanX = samples.reduce((sum, s) => sum + s.done, 0) / n;
+  const meanY = samples.reduce((sum, s) => sum + value(s), 0) / n;
+  let numerator = 0;
+  let denominator = 0;
+  for (const s of samples) {
+    numerator += (s.done - meanX) * (value(s) - meanY);
+    denominator += (s.done - meanX) * (s.done - meanX);
+  }
+  return denominator ? numerator / denominator : 0;
+}
+
+function mib(bytes) {
+  return `${(bytes / 1024 / 1024).toFixed(2)} MiB`;
+}
+
+async function main() {
+  if (process.platform !== 'linux') {
+    console.log('soak: Linux only, skipped');
+    return;
+  }
+  const failures = [];
+  const counted = readCounters() !== null;
+  if (counted) {
+    console.log('operation                       allocs/op    bytes/op  retained/op');
+    for (const result of await calibrate()) {
+      console.log(`${result.name.padEnd(30)} ${result.allocationsPerOp.toFixed(1).padStart(10)} ` +
+                  `${result.bytesPerOp.toFixed(0).padStart(11)} ${result.retainedPerOp.toFixed(1).padStart(12)}`);
+    }
+  } else {
+    console.log('soak: ALLOC_COUNTER_FILE not set, reporting RSS only');
+  }
+
+  const started = Date.now();
+  const samples = await soak();
+  const seconds = (Date.now() - started) / 1000;
+  const measured = samples.filter((s) => s.done >= OPERATIONS * WARM_UP);
+  const window = OPERATIONS * (1 - WARM_UP);
+  const rssGrowth = slope(measured, (s) => s.rss) * window;
+  console.log(`\n${OPERATIONS} operations on ${CONCURRENCY} lanes in ${seconds.toFixed(1)} s`);
+  console.log(`rss ${mib(samples[0].rss)} -> ${mib(samples[samples.length - 1].rss)}, ` +
+              `trend after warm-up ${mib(rssGrowth)}`);
+  if (rssGrowth > MAX_RSS_GROWTH) {
+    failures.push(`RSS grows by ${mib(rssGrowth)} over ${window} operations`);
+  }
+  if (counted) {
+    const first = samples[0].counters;
+    const last = samples[samples.length - 1].counters;
+    const heapGrowth = slope(measured, (s) => s.counters.liveBytes) * window;
+    console.log(`live heap ${mib(first.liveBytes)} -> ${mib(last.liveBytes)}, trend after warm-up ${mib(heapGrowth)}`);
+    console.log(`malloc arena ${mib(last.arenaBytes)}, mmap ${mib(last.mmapBytes)}, ` +
+                `in use ${mib(last.inUseBytes)}, free ${mib(last.freeBytes)}`);
+    console.log(`${((last.allocations - first.allocations) / OPERATIONS).toFixed(1)} allocations per operation`);
+    if (heapGrowth > MAX_HEAP_GROWTH) {
+      failures.push(`live heap grows by ${mib(heapGrowth)} over ${window} operations`);
+    }
+  }
+
+  fs.rmSync(workDir, {recursive: true, force: true});
+  if (failures.length) {
+    console.error(`\nsoak failed:\n  ${failures.join('\n  ')}`);
+    process.exitCode = 1;
+  } else {
+    console.log('\nsoak: no unbounded growth');
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exitCode = 1;
+});
@@ -0,0 +1,70 @@
+const {readText, writeText, readRich, writeRich, clear, getStats} = require('..');
+
+beforeEach(() => {
+  clear();
+});
+
+afterEach(() => {
+  clear();
+});
+
+test('write & read text', () => {
+  expect(writeText('plain 中文 text')).toBe(true);
+  expect(readText()).toBe('plain 中文 text');
+});
+
+test('write buffer & read buffer', () => {
+  const bytes = Buffer.from('buffered 中文 text', 'utf8');
+  expect(writeText(bytes)).toBe(true);
+  expect(readText({as: 'buffer'}).equals(bytes)).toBe(true);
+});
+
+test('read empty clipboard', () => {
+  expect(readText()).toBe('');
+  expect(readText({as: 'buffer'}).length).toBe(0);
+});
+
+test('write invalid utf-8 -- throw', () => {
+  expect(() => {
+    writeText(Buffer.from([0xc0, 0x80]));
+  }).toThrow();
+});
+
+test('write non-text -- throw', () => {
+  expect(() => {
+    writeText(1);
+  }).toThrow();
+});
+
+test('write & read rich', () => {
+  expect(writeRich({html: '<p>Hello <b>world</b></p>', rtf: '{\\rtf1 Hello world}', text: 'Hello world'})).toBe(true);
+  expect(readRich()).toEqual({
+    html: '<p>Hello <b>world</b></p>',
+    rtf: '{\\rtf1 Hello world}',
+    text: 'Hello world',
+  });
+});
+
+test('write rich -- text derived from html', () => {
+  expect(writeRich({html: '<p>One &amp; two</p><p>three</p>'})).toBe(true);
+  expect(readText()).toBe('One & two\nthree');
+});
+
+test('stats -- owners', () => {
+  expect(writeText('stats')).toBe(true);
+  expect(readText()).toBe('stats');
+  const {owners, bufferPool, serving, codecContexts} = getStats();
+  expect(Array.isArray(owners)).toBe(true);
+  expect(bufferPool.hits).toBeLessThanOrEqual(bufferPool.acquires);
+  expect(serving.incrTransfers).toBeLessThanOrEqual(serving.requests);
+  expect(serving.activeTransfers).toBeLessThanOrEqual(serving.maxActiveTransfers);
+  expect(serving.deferred).toBeLessThanOrEqual(serving.requests);
+  expect(codecContexts.reuses).toBeLessThanOrEqual(codecContexts.acquires);
+  for (const owner of owners) {
+    expect(typeof owner.wmClass).toBe('string');
+    for (const target of Object.values(owner.targets)) {
+      expect(target.requests).toBeGreaterThanOrEqual(target.timeouts);
+      expect(target.timeoutMs).toBeGreaterThan(0);
+    }
+  }
+});